@@ -0,0 +1,89 @@
+/*
+ * 无需GPU即可运行的压测入口
+ * 用法：./benchmark <name>，不带参数时列出所有用例
+ */
+#include <string.h>
+#include <functional>
+#include <vector>
+#include "src/TrtLib/common/ilogger.hpp"
+#include "src/app_bench/bench.hpp"
+
+using namespace std;
+
+struct BenchCase
+{
+    const char *name;
+    const char *description;
+    function<int()> run;
+};
+
+int main(int argc, char **argv)
+{
+    vector<BenchCase> cases = {
+        {"pipeline", "InferController throughput and latency on the CPU backend", []()
+         { return bench_cpu_pipeline(); }},
+        {"batching", "Deadline-aware dynamic batching at different max queue delays", []()
+         { return bench_batching(); }},
+        {"stages", "Inline pre/post processing vs separate stage thread pools", []()
+         { return bench_stages(); }},
+        {"priority", "Live camera latency under a bulk commits() with and without priority classes", []()
+         { return bench_priority(); }},
+        {"admission", "Overloaded cameras with unbounded, bounded and latest-frame-wins admission", []()
+         { return bench_admission(); }},
+        {"cancellation", "Work saved by per-job deadlines and cancellation tokens under overload", []()
+         { return bench_cancellation(); }},
+        {"allocations", "Heap allocations per frame for future vs callback commits", []()
+         { return bench_allocations(); }},
+        {"metrics", "Per-stage latency histograms: record cost and a snapshot on the CPU backend", []()
+         { return bench_metrics(); }},
+        {"staging", "Double-buffered batch staging: ordering check and throughput vs a single buffer", []()
+         { return bench_staging(); }},
+        {"replicas", "Replica set dispatch: round robin vs least outstanding, health checks, CPU replicas", []()
+         { return bench_replicas(); }},
+        {"adaptive", "Adaptive batch cap learned from the throughput curve under a p99 SLO vs fixed max batch", []()
+         { return bench_adaptive(); }},
+        {"cache", "Content-hash result cache: hashing cost, single-flight, hit rate and throughput on repeated images", []()
+         { return bench_result_cache(); }},
+        {"nms", "CPU NMS: per-class SoA + SIMD IoU + grid vs cpu_nms at 64~4096 boxes, bitwise identical results, batch parallel", []()
+         { return bench_nms(); }},
+        {"nms-methods", "Soft-NMS (linear/gaussian), DIoU-NMS and class-agnostic NMS vs greedy cpu_nms per 1k boxes", []()
+         { return bench_nms_methods(); }},
+        {"decode", "SIMD CPU decoder vs scalar decode loop on 25200 anchors, single and multi-threaded", []()
+         { return bench_decode(); }},
+        {"preprocess", "Fused SIMD CPU letterbox (warp-affine + normalize + HWC->CHW) vs cv::warpAffine + per-pixel normalize", []()
+         { return bench_preprocess(); }},
+        {"frames", "Zero-copy external frames: strided BGR/RGB/NV12 commits, release accounting, NV12 conversion cost", []()
+         { return bench_external_frames(); }},
+        {"tiles", "Tiled inference on 4K images: small-object recall, seam merging and throughput vs direct downscale", []()
+         { return bench_tiles(); }},
+        {"tracker", "Kalman + ByteTrack-style tracker: detect every frame vs every N frames with uncertainty triggers", []()
+         { return bench_tracker(); }},
+        {"motion", "Motion-gated inference: skip static frames, crop to motion regions, per-camera skip rates vs ungated", []()
+         { return bench_motion(); }},
+        {"mosaic", "Mosaic batching of low-resolution substreams into one network input vs per-frame letterbox", []()
+         { return bench_mosaic(); }},
+        {"cascade", "Detector -> classifier cascade: batched crop warps across frames vs crop-and-classify one by one", []()
+         { return bench_cascade(); }},
+        {"seg", "Segmentation: SIMD argmax and fused inverse-affine resample vs the 4.3 scalar post process", []()
+         { return bench_seg(); }},
+        {"queue", "Lock-free MPMC job queue vs mutex+condvar at 1~64 producers", []()
+         { return bench_job_queue(); }},
+    };
+
+    if (argc < 2)
+    {
+        INFO("Usage: %s <name>", argv[0]);
+        for (auto &item : cases)
+            INFO("  %-16s %s", item.name, item.description);
+        return 0;
+    }
+
+    for (auto &item : cases)
+    {
+        if (strcmp(item.name, argv[1]) == 0)
+            return item.run();
+    }
+
+    INFOE("Unknown benchmark '%s'", argv[1]);
+    return -1;
+}
@@ -29,6 +29,8 @@
 #include "src/TrtLib/common/ilogger.hpp"
 #include "src/TrtLib/builder/trt_builder.hpp"
 #include "src/app_yolo/yolo.hpp"
+#include "src/app_yolo/object_tracker.hpp"
+#include "src/TrtLib/common/result_cache.hpp"
 #include "src/app_http/http_server.hpp"
 
 using namespace std;
@@ -140,7 +142,11 @@ class InferInstance
 public:
     bool startup()
     {
-        yoloIns = get_infer(Yolo::Type::V5);
+        yoloIns = get_infer(type_);
+        params_hash_ = content_hash(engine_file);
+        params_hash_ = hash_combine(params_hash_, (uint64_t)type_);
+        params_hash_ = hash_combine(params_hash_, content_hash(&confidence_threshold_, sizeof(confidence_threshold_)));
+        params_hash_ = hash_combine(params_hash_, content_hash(&nms_threshold_, sizeof(nms_threshold_)));
         return yoloIns != nullptr;
     }
 
@@ -162,6 +168,68 @@ public:
         return true;
     }
 
+    /* image_data为请求中未解码的图像字节，内容与模型、阈值都相同的请求共享一次解码和推理
+       同时到达的相同请求只推理一次，见result_cache.hpp
+    */
+    bool inference(const vector<uint8_t> &image_data, shared_ptr<const Yolo::BoxArray> &boxarray)
+    {
+        if (yoloIns == nullptr)
+        {
+            INFOE("Not Initialize.");
+            return false;
+        }
+
+        uint64_t key = content_hash(image_data.data(), image_data.size(), params_hash_);
+        auto compute = [&]() -> shared_ptr<const Yolo::BoxArray>
+        {
+            auto image = cv::imdecode(image_data, 1);
+            if (image.empty())
+            {
+                INFOE("Image is empty.");
+                return nullptr;
+            }
+
+            // 被拒绝、丢弃的job结果也为空，不能当作没有目标缓存起来
+            JobOptions options;
+            options.outcome = JobOutcome::create();
+            auto boxes = yoloIns->commit(image, options).get();
+            if (options.outcome->rejected())
+            {
+                INFOE("Inference rejected.");
+                return nullptr;
+            }
+            return make_shared<Yolo::BoxArray>(std::move(boxes));
+        };
+
+        try
+        {
+            boxarray = result_cache_.get_or_compute(key, compute).get();
+        }
+        catch (const std::exception &e)
+        {
+            INFOE("Inference failed: %s", e.what());
+            return false;
+        }
+        return boxarray != nullptr;
+    }
+
+    ResultCacheReport cache_report(bool reset)
+    {
+        return result_cache_.report(reset);
+    }
+
+    bool metrics(InferMetricsSnapshot &snapshot, bool reset)
+    {
+        if (yoloIns == nullptr)
+        {
+            INFOE("Not Initialize.");
+            return false;
+        }
+
+        snapshot = yoloIns->metrics(reset);
+        return true;
+    }
+
 private:
     shared_ptr<Yolo::Infer> get_infer(Yolo::Type type)
     {
@@ -177,9 +245,14 @@ private:
         {
             INFOW("%s has been created!", engine_file.c_str());
         }
-        return Yolo::create_infer(engine_file, type, 0, 0.25, 0.45);
+        return Yolo::create_infer(engine_file, type, 0, confidence_threshold_, nms_threshold_);
     }
     shared_ptr<Yolo::Infer> yoloIns;
+    Yolo::Type type_ = Yolo::Type::V5;
+    float confidence_threshold_ = 0.25f;
+    float nms_threshold_ = 0.45f;
+    uint64_t params_hash_ = 0;
+    ResultCache<Yolo::BoxArray> result_cache_;
 };
 
 class LogicalController : public Controller
@@ -197,6 +270,7 @@ public:
     DefRequestMapping(getFile);
     DefRequestMapping(putBase64Image);
     DefRequestMapping(detectBase64Image);
+    DefRequestMapping(metrics);
 
 private:
     shared_ptr<InferInstance> infer_instance_;
@@ -210,16 +284,12 @@ Json::Value LogicalController::detect(const Json::Value &param)
     if (image_data.empty())
         return failure("Image is required");
 
-    auto image = cv::imdecode(image_data, 1);
-    if (image_data.empty())
-        return failure("Image is empty");
-
-    Yolo::BoxArray boxarray;
-    if (!this->infer_instance_->inference(image, boxarray))
+    shared_ptr<const Yolo::BoxArray> boxarray;
+    if (!this->infer_instance_->inference(image_data, boxarray))
         return failure("Server error1");
 
     Json::Value boxarray_json(Json::arrayValue);
-    for (auto &box : boxarray)
+    for (auto &box : *boxarray)
     {
         Json::Value item(Json::objectValue);
         item["left"] = box.left;
@@ -260,16 +330,12 @@ Json::Value LogicalController::detectBase64Image(const Json::Value &param)
     if (image_data.empty())
         return failure("Image is required");
 
-    auto image = cv::imdecode(image_data, 1);
-    if (image_data.empty())
-        return failure("Image is empty");
-
-    Yolo::BoxArray boxarray;
-    if (!this->infer_instance_->inference(image, boxarray))
+    shared_ptr<const Yolo::BoxArray> boxarray;
+    if (!this->infer_instance_->inference(image_data, boxarray))
         return failure("Server error1");
 
     Json::Value boxarray_json(Json::arrayValue);
-    for (auto &box : boxarray)
+    for (auto &box : *boxarray)
     {
         Json::Value item(Json::objectValue);
         item["left"] = box.left;
@@ -284,6 +350,18 @@ Json::Value LogicalController::detectBase64Image(const Json::Value &param)
     return success(boxarray_json);
 }
 
+Json::Value LogicalController::metrics(const Json::Value &param)
+{
+    InferMetricsSnapshot snapshot;
+    bool reset = param.get("reset", false).asBool();
+    if (!this->infer_instance_->metrics(snapshot, reset))
+        return failure("Server error1");
+
+    auto data = snapshot.to_json();
+    data["result_cache"] = this->infer_instance_->cache_report(reset).to_json();
+    return success(data);
+}
+
 Json::Value LogicalController::getCustom(const Json::Value &param)
 {
     auto session = get_current_session();
@@ -366,8 +444,9 @@ int test_http(int port = 8090)
         "4. http://%s/api/getFile                使用自定义写出文件路径作为response\n"
         "5. http://%s/api/putBase64Image         通过提交base64图像数据进行解码后储存\n"
         "6. http://%s/static/img.jpg             直接访问静态文件处理的controller,具体请看函数说明\n"
-        "7. http://%s                            访问web页面,vue开发的",
-        address.c_str(), address.c_str(), address.c_str(), address.c_str(), address.c_str(), address.c_str(), address.c_str());
+        "7. http://%s                            访问web页面,vue开发的\n"
+        "8. http://%s/api/metrics                推理各阶段的延迟分位数、吞吐与丢弃计数，以及结果缓存的命中率",
+        address.c_str(), address.c_str(), address.c_str(), address.c_str(), address.c_str(), address.c_str(), address.c_str(), address.c_str());
 
     INFO("按下Ctrl + C结束程序");
     // iLogger::save_file();
@@ -390,14 +469,29 @@ int main(int argc, char **argv)
         INFOE("Error opening video stream or file");
         return -1;
     }
+
+    // 每3帧检测一次，其余的帧由跟踪器预测，目标重叠、位置不确定或者出现新目标时提前检测
+    ObjectTracker::TrackerConfig tracker_config;
+    tracker_config.detect_interval = 3;
+    auto tracker = ObjectTracker::create_tracker(tracker_config);
     while (cap.read(image))
     {
-        Yolo::BoxArray bbox;
-        Ins.inference(image, bbox);
-        for (auto &box : bbox)
+        const ObjectTracker::TrackedBoxArray *tracks = nullptr;
+        if (tracker->need_detection() != ObjectTracker::DetectTrigger::None)
+        {
+            Yolo::BoxArray bbox;
+            Ins.inference(image, bbox);
+            tracks = &tracker->update(bbox);
+        }
+        else
+        {
+            tracks = &tracker->predict();
+        }
+
+        for (auto &box : *tracks)
         {
             cv::rectangle(image, cv::Point2d(box.left, box.top), cv::Point2d(box.right, box.bottom), cv::Scalar(color_list[box.class_label][0], color_list[box.class_label][1], color_list[box.class_label][2]), 3, 8, 0);
-            auto caption = cv::format("%s %.3f", cocolabels[box.class_label], box.confidence);
+            auto caption = cv::format("#%d %s %.3f", box.track_id, cocolabels[box.class_label], box.confidence);
             cv::putText(image, caption, cv::Point(box.left, box.top - 5), 0, 1, cv::Scalar(color_list[box.class_label][0], color_list[box.class_label][1], color_list[box.class_label][2]), 2, 16);
             // INFO("name: %s , Box:[%.2f, %.2f, %.2f, %.2f], confidence : %.3f", cocolabels[box.class_label], box.left, box.top, box.right, box.bottom, box.confidence);
         }
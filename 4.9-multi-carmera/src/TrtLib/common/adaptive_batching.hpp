@@ -0,0 +1,278 @@
+/**
+ * 在线学习batch上限
+ * 解决的问题：
+ * batch上限直接取引擎的最大batch，实际引擎的吞吐在batch 4~6附近就已经饱和，继续增大batch只增加延迟
+ * 这条曲线与引擎、显卡、输入尺寸、同卡上的其他负载都有关，无法事先配置
+ *
+ * 设计思路：
+ * 1. 按batch大小分别统计：batch从取出到推理完成的耗时(由此得到吞吐 = batch / 耗时)，以及这些job端到端延迟的p99
+ * 2. 每隔evaluation_interval_ms用最近一个窗口的统计更新曲线，耗时做指数平滑，p99取最近一个样本足够的窗口
+ * 3. 选择上限：累计job数量达到min_samples的batch大小参与选择，在p99满足latency_slo_ms的batch大小中找到最大吞吐，取吞吐不低于最大值(1 - tolerance)的最小batch
+ *    所有batch都不满足SLO时说明已经过载，此时取吞吐最大的batch，尽快消化积压
+ * 4. 上限以外的batch大小没有机会被观测，每probe_every个batch交替用上限+1、上限-1作为一次batch的上限，
+ *    探测每次只扩展一格观测范围，评估时上限直接取观测过的batch中最好的一个，负载变化后上限可以重新增长或者下降
+ *
+ * 统计用原子变量和直方图，记录不加锁；评估只在推理线程上进行
+ **/
+
+#ifndef ADAPTIVE_BATCHING_HPP
+#define ADAPTIVE_BATCHING_HPP
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "ilogger.hpp"
+#include "latency_histogram.hpp"
+#include "pipeline_stage.hpp"
+
+struct AdaptiveBatchingPolicy
+{
+    bool enabled = false;
+    double latency_slo_ms = 0;        // 端到端p99延迟的目标，0表示不限制，只按吞吐选择
+    int evaluation_interval_ms = 1000; // 重新评估的间隔
+    int min_samples = 20;              // 一个batch大小至少有这么多job才参与选择，窗口内有这么多job才更新p99
+    double tolerance = 0.05;           // 吞吐在最大值的(1 - tolerance)以内时选择更小的batch
+    int probe_every = 16;              // 每多少个batch探测一次相邻的batch大小，0表示不探测
+
+    static AdaptiveBatchingPolicy disabled() { return AdaptiveBatchingPolicy(); }
+
+    static AdaptiveBatchingPolicy slo(double latency_slo_ms, int evaluation_interval_ms = 1000)
+    {
+        AdaptiveBatchingPolicy policy;
+        policy.enabled = true;
+        policy.latency_slo_ms = latency_slo_ms;
+        policy.evaluation_interval_ms = evaluation_interval_ms;
+        return policy;
+    }
+};
+
+// 学习到的曲线上的一个点
+struct BatchSizePoint
+{
+    int batch_size = 0;
+    long long num_batches = 0; // 累计观测到的batch数量
+    long long num_jobs = 0;
+    double batch_ms = 0;       // 取出到推理完成的平滑耗时
+    double throughput = 0;     // images/s
+    double latency_p99_ms = 0; // 端到端延迟p99
+    bool within_slo = true;
+
+    std::string to_string() const
+    {
+        return iLogger::format(
+            "batch %2d: batches=%lld, jobs=%lld, batch=%.3f ms, throughput=%.2f images/s, p99=%.3f ms%s",
+            batch_size, num_batches, num_jobs, batch_ms, throughput, latency_p99_ms, within_slo ? "" : " (over slo)");
+    }
+};
+
+struct AdaptiveBatchingReport
+{
+    bool enabled = false;
+    int batch_cap = 0; // 当前的batch上限
+    int max_batch_size = 0;
+    double latency_slo_ms = 0;
+    long long num_evaluations = 0;
+    std::vector<BatchSizePoint> curve; // 只包含有观测数据的batch大小
+
+    std::string to_string() const
+    {
+        std::string output = iLogger::format(
+            "%s, cap=%d/%d, slo p99=%.2f ms, evaluations=%lld",
+            enabled ? "enabled" : "disabled", batch_cap, max_batch_size, latency_slo_ms, num_evaluations);
+
+        for (auto &point : curve)
+            output += "\n  " + point.to_string() + (point.batch_size == batch_cap ? " <- cap" : "");
+        return output;
+    }
+};
+
+class AdaptiveBatchController
+{
+public:
+    void set_policy(const AdaptiveBatchingPolicy &policy)
+    {
+        std::unique_lock<std::mutex> l(lock_);
+        policy_ = policy;
+        if (!policy_.enabled)
+            batch_cap_ = max_batch_size_.load();
+    }
+
+    AdaptiveBatchingPolicy get_policy()
+    {
+        std::unique_lock<std::mutex> l(lock_);
+        return policy_;
+    }
+
+    /* 本次凑batch的上限，max_batch_size为引擎的最大batch，limit为批处理策略给出的上限，只由推理线程调用
+       第一次调用时按max_batch_size分配统计，到了评估时间时在这里重新评估
+    */
+    int limit(int max_batch_size, int limit)
+    {
+        std::unique_lock<std::mutex> l(lock_);
+        if (sizes_ == nullptr)
+        {
+            int n = std::max(1, max_batch_size);
+            sizes_.reset(new SizeStatistics[n + 1]);
+            batch_cap_ = n;
+            max_batch_size_.store(n, std::memory_order_release);
+            last_evaluation_us_ = StageStatistics::now_us();
+        }
+
+        if (!policy_.enabled)
+            return limit;
+
+        long long now = StageStatistics::now_us();
+        if (now - last_evaluation_us_ >= policy_.evaluation_interval_ms * 1000LL)
+        {
+            evaluate();
+            last_evaluation_us_ = now;
+        }
+
+        int cap = batch_cap_;
+        if (policy_.probe_every > 0 && ++num_limits_ % policy_.probe_every == 0)
+        {
+            if (num_limits_ / policy_.probe_every % 2 == 1)
+                cap = std::min(cap + 1, max_batch_size_.load());
+            else
+                cap = std::max(cap - 1, 1);
+        }
+        return std::min(limit, cap);
+    }
+
+    /* 一个batch推理完成，batch_us为这个batch占用推理的时间，每个batch记录一次，推理线程调用
+       上一个batch还在推理时取出的batch从上一个batch完成时开始计时，流水线满载时即为相邻两个batch完成的间隔
+    */
+    void record_batch(int batch_size, long long batch_us)
+    {
+        auto size = statistics(batch_size);
+        if (size == nullptr)
+            return;
+
+        size->window_batch_us.fetch_add(batch_us, std::memory_order_relaxed);
+        size->window_batches.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // job的端到端延迟，可能在后处理线程上调用
+    void record_latency(int batch_size, long long latency_us)
+    {
+        auto size = statistics(batch_size);
+        if (size != nullptr)
+            size->window_latency.record(latency_us);
+    }
+
+    AdaptiveBatchingReport report()
+    {
+        std::unique_lock<std::mutex> l(lock_);
+        AdaptiveBatchingReport output;
+        output.enabled = policy_.enabled;
+        output.batch_cap = batch_cap_;
+        output.max_batch_size = max_batch_size_;
+        output.latency_slo_ms = policy_.latency_slo_ms;
+        output.num_evaluations = num_evaluations_;
+        for (int i = 1; sizes_ != nullptr && i <= max_batch_size_; ++i)
+        {
+            if (sizes_[i].point.num_batches > 0)
+                output.curve.emplace_back(sizes_[i].point);
+        }
+        return output;
+    }
+
+private:
+    struct SizeStatistics
+    {
+        std::atomic<long long> window_batch_us{0};
+        std::atomic<long long> window_batches{0};
+        LatencyHistogram window_latency;
+        BatchSizePoint point;
+    };
+
+    SizeStatistics *statistics(int batch_size)
+    {
+        // max_batch_size_在sizes_分配之后才发布，记录可以在其他线程上进行
+        if (batch_size < 1 || batch_size > max_batch_size_.load(std::memory_order_acquire))
+            return nullptr;
+        return &sizes_[batch_size];
+    }
+
+    bool eligible(int batch_size) const
+    {
+        auto &point = sizes_[batch_size].point;
+        return point.num_jobs >= policy_.min_samples && point.throughput > 0;
+    }
+
+    // 需要持有lock_
+    void evaluate()
+    {
+        num_evaluations_++;
+        for (int i = 1; i <= max_batch_size_; ++i)
+        {
+            auto &size = sizes_[i];
+            long long num_batches = size.window_batches.exchange(0, std::memory_order_relaxed);
+            long long batch_us = size.window_batch_us.exchange(0, std::memory_order_relaxed);
+            auto &point = size.point;
+            point.batch_size = i;
+            if (num_batches > 0)
+            {
+                double batch_ms = batch_us / (double)num_batches / 1000.0;
+                point.batch_ms = point.num_batches == 0 ? batch_ms : point.batch_ms * 0.5 + batch_ms * 0.5;
+                point.num_batches += num_batches;
+                point.num_jobs += num_batches * i;
+                point.throughput = point.batch_ms > 0 ? i / point.batch_ms * 1000.0 : 0;
+            }
+
+            if (size.window_latency.count() >= policy_.min_samples)
+            {
+                point.latency_p99_ms = size.window_latency.percentile_us(0.99) / 1000.0;
+                size.window_latency.reset();
+            }
+            point.within_slo = policy_.latency_slo_ms <= 0 || point.latency_p99_ms <= policy_.latency_slo_ms;
+        }
+
+        // 满足SLO的最大吞吐，都不满足时不考虑SLO
+        double best_throughput = 0;
+        bool any_within_slo = false;
+        for (int i = 1; i <= max_batch_size_; ++i)
+        {
+            if (eligible(i) && sizes_[i].point.within_slo)
+                any_within_slo = true;
+        }
+
+        for (int i = 1; i <= max_batch_size_; ++i)
+        {
+            auto &point = sizes_[i].point;
+            if (eligible(i) && (point.within_slo || !any_within_slo))
+                best_throughput = std::max(best_throughput, point.throughput);
+        }
+
+        if (best_throughput <= 0)
+            return;
+
+        for (int i = 1; i <= max_batch_size_; ++i)
+        {
+            auto &point = sizes_[i].point;
+            if (eligible(i) && (point.within_slo || !any_within_slo) &&
+                point.throughput >= best_throughput * (1 - policy_.tolerance))
+            {
+                if (i != batch_cap_)
+                    INFO("Adaptive batching: batch cap %d -> %d, %.2f images/s, p99 %.3f ms", batch_cap_, i, point.throughput, point.latency_p99_ms);
+                batch_cap_ = i;
+                break;
+            }
+        }
+    }
+
+private:
+    std::mutex lock_;
+    AdaptiveBatchingPolicy policy_;
+    std::atomic<int> max_batch_size_{0};
+    int batch_cap_ = 0;
+    long long num_limits_ = 0;
+    long long num_evaluations_ = 0;
+    long long last_evaluation_us_ = 0;
+    std::unique_ptr<SizeStatistics[]> sizes_;
+};
+
+#endif // ADAPTIVE_BATCHING_HPP
@@ -0,0 +1,146 @@
+/**
+ * 准入控制与过载丢弃
+ * 解决的问题：
+ * 生产者快于引擎时，commit在MonopolyAllocator::query里最多阻塞10秒，超时后返回空的结果，与"没有检测到目标"无法区分
+ * 过载时延迟无限增长到数秒
+ *
+ * 策略：
+ * 1. max_queue_depth：已接受但还未进入batch的job数量上限，超过时新的提交被拒绝
+ * 2. max_queue_age_ms：凑batch时丢弃排队超过该时长的job，结果已经没有意义，不再占用引擎
+ * 3. try_commit不阻塞：没有空闲的tensor或者队列已满时立即返回拒绝的状态
+ * 4. 流式数据源(JobOptions::latest_only)：同一租户有更新的帧到来时，尚未进入batch的旧帧被丢弃
+ * 被丢弃的job立即释放tensor，结果为空，并计入对应的计数器
+ **/
+
+#ifndef ADMISSION_CONTROL_HPP
+#define ADMISSION_CONTROL_HPP
+
+#include <atomic>
+#include <string>
+#include "ilogger.hpp"
+
+enum class CommitStatus : int
+{
+    Accepted = 0,
+    QueueFull = 1, // 超过max_queue_depth，或者try_commit时预处理队列已满
+    NoSlot = 2,    // 没有空闲的tensor，try_commit立即返回，commit在等待query_timeout_ms后返回
+    Failed = 3     // 预处理失败或者已经stop
+};
+
+inline const char *commit_status_name(CommitStatus status)
+{
+    switch (status)
+    {
+    case CommitStatus::Accepted:
+        return "Accepted";
+    case CommitStatus::QueueFull:
+        return "QueueFull";
+    case CommitStatus::NoSlot:
+        return "NoSlot";
+    case CommitStatus::Failed:
+        return "Failed";
+    default:
+        return "Unknow";
+    }
+}
+
+struct AdmissionPolicy
+{
+    int max_queue_depth = 0;      // 0表示不限制
+    int max_queue_age_ms = 0;     // 0表示不限制
+    int query_timeout_ms = 10000; // 阻塞的commit等待空闲tensor的最长时间
+
+    static AdmissionPolicy unlimited() { return AdmissionPolicy(); }
+
+    static AdmissionPolicy bounded(int max_queue_depth, int max_queue_age_ms, int query_timeout_ms = 10000)
+    {
+        AdmissionPolicy policy;
+        policy.max_queue_depth = max_queue_depth;
+        policy.max_queue_age_ms = max_queue_age_ms;
+        policy.query_timeout_ms = query_timeout_ms;
+        return policy;
+    }
+};
+
+struct AdmissionReport
+{
+    long long accepted = 0;
+    long long rejected_queue_full = 0;
+    long long rejected_no_slot = 0;
+    long long failed = 0;
+    long long dropped_expired = 0;    // 排队超过max_queue_age_ms
+    long long dropped_superseded = 0; // 被同一数据源更新的帧替代
+    long long queue_depth = 0;
+
+    long long rejected() const { return rejected_queue_full + rejected_no_slot; }
+    long long dropped() const { return dropped_expired + dropped_superseded; }
+
+    std::string to_string() const
+    {
+        return iLogger::format(
+            "accepted=%lld, rejected={queue full=%lld, no slot=%lld}, failed=%lld, dropped={expired=%lld, superseded=%lld}, queue depth=%lld",
+            accepted, rejected_queue_full, rejected_no_slot, failed, dropped_expired, dropped_superseded, queue_depth);
+    }
+};
+
+// 计数器，无锁
+class AdmissionStatistics
+{
+public:
+    AdmissionStatistics() { reset(); }
+
+    void reset()
+    {
+        accepted_ = 0;
+        rejected_queue_full_ = 0;
+        rejected_no_slot_ = 0;
+        failed_ = 0;
+        dropped_expired_ = 0;
+        dropped_superseded_ = 0;
+    }
+
+    void record(CommitStatus status)
+    {
+        switch (status)
+        {
+        case CommitStatus::Accepted:
+            accepted_++;
+            break;
+        case CommitStatus::QueueFull:
+            rejected_queue_full_++;
+            break;
+        case CommitStatus::NoSlot:
+            rejected_no_slot_++;
+            break;
+        default:
+            failed_++;
+            break;
+        }
+    }
+
+    void record_expired(int count = 1) { dropped_expired_ += count; }
+    void record_superseded(int count = 1) { dropped_superseded_ += count; }
+
+    AdmissionReport report(long long queue_depth) const
+    {
+        AdmissionReport output;
+        output.accepted = accepted_;
+        output.rejected_queue_full = rejected_queue_full_;
+        output.rejected_no_slot = rejected_no_slot_;
+        output.failed = failed_;
+        output.dropped_expired = dropped_expired_;
+        output.dropped_superseded = dropped_superseded_;
+        output.queue_depth = queue_depth;
+        return output;
+    }
+
+private:
+    std::atomic<long long> accepted_;
+    std::atomic<long long> rejected_queue_full_;
+    std::atomic<long long> rejected_no_slot_;
+    std::atomic<long long> failed_;
+    std::atomic<long long> dropped_expired_;
+    std::atomic<long long> dropped_superseded_;
+};
+
+#endif // ADMISSION_CONTROL_HPP
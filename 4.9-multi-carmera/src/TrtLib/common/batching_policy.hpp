@@ -0,0 +1,165 @@
+/**
+ * 动态批处理策略
+ * 解决的问题：
+ * get_jobs_and_wait在第一个job到来时立即返回，中等负载下batch几乎总是1，引擎吞吐浪费
+ *
+ * 策略：
+ * 1. 队列中job数量达到preferred_batch_size，立即出发
+ * 2. 否则等待，直到凑够preferred_batch_size，或者最早的job排队时间达到max_queue_delay_us
+ * 3. 每次最多取max_batch_size个job
+ * max_queue_delay_us = 0时与原来的行为一致，不做任何等待
+ *
+ * 同时统计实际的batch大小分布和排队等待时间，用以按部署场景权衡吞吐与延迟
+ **/
+
+#ifndef BATCHING_POLICY_HPP
+#define BATCHING_POLICY_HPP
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include "ilogger.hpp"
+
+struct BatchingPolicy
+{
+    int max_batch_size = 0;       // 0表示使用引擎的最大batch
+    int preferred_batch_size = 0; // 0表示与max_batch_size相同
+    int max_queue_delay_us = 0;   // 最早的job最多等待多久，0表示不等待
+
+    static BatchingPolicy immediate() { return BatchingPolicy(); }
+
+    static BatchingPolicy deadline(int max_queue_delay_us, int preferred_batch_size = 0, int max_batch_size = 0)
+    {
+        BatchingPolicy policy;
+        policy.max_batch_size = max_batch_size;
+        policy.preferred_batch_size = preferred_batch_size;
+        policy.max_queue_delay_us = max_queue_delay_us;
+        return policy;
+    }
+
+    // 根据引擎能力得到本次的上限
+    int limit(int engine_max_batch_size) const
+    {
+        return max_batch_size > 0 ? std::min(max_batch_size, engine_max_batch_size) : engine_max_batch_size;
+    }
+
+    int preferred(int engine_max_batch_size) const
+    {
+        int upper = limit(engine_max_batch_size);
+        return preferred_batch_size > 0 ? std::min(preferred_batch_size, upper) : upper;
+    }
+};
+
+struct BatchingReport
+{
+    std::vector<long long> batch_size_histogram; // 下标为batch大小，值为出现次数
+    long long num_batches = 0;
+    long long num_jobs = 0;
+    double average_batch_size = 0;
+    double queue_wait_mean_ms = 0;
+    double queue_wait_p50_ms = 0;
+    double queue_wait_p99_ms = 0;
+    double queue_wait_max_ms = 0;
+
+    std::string to_string() const
+    {
+        std::string hist;
+        for (int i = 1; i < (int)batch_size_histogram.size(); ++i)
+        {
+            if (batch_size_histogram[i] == 0)
+                continue;
+            hist += iLogger::format("%s%d:%lld", hist.empty() ? "" : ", ", i, batch_size_histogram[i]);
+        }
+        return iLogger::format(
+            "batches=%lld, jobs=%lld, avg batch=%.2f, queue wait mean=%.3f ms, p50=%.3f ms, p99=%.3f ms, max=%.3f ms, batch hist={%s}",
+            num_batches, num_jobs, average_batch_size, queue_wait_mean_ms,
+            queue_wait_p50_ms, queue_wait_p99_ms, queue_wait_max_ms, hist.c_str());
+    }
+};
+
+/* 批处理统计，由调用方加锁保护
+   排队时间使用按2的幂划分的桶统计分位数，精度为桶宽度，开销固定
+*/
+class BatchingStatistics
+{
+public:
+    BatchingStatistics() { reset(); }
+
+    void reset()
+    {
+        batch_size_histogram_.clear();
+        std::fill(std::begin(wait_buckets_), std::end(wait_buckets_), 0);
+        num_batches_ = 0;
+        num_jobs_ = 0;
+        wait_sum_us_ = 0;
+        wait_max_us_ = 0;
+    }
+
+    void record_batch(int batch_size)
+    {
+        if (batch_size >= (int)batch_size_histogram_.size())
+            batch_size_histogram_.resize(batch_size + 1);
+
+        batch_size_histogram_[batch_size]++;
+        num_batches_++;
+        num_jobs_ += batch_size;
+    }
+
+    void record_wait(long long wait_us)
+    {
+        wait_us = std::max(0LL, wait_us);
+        wait_sum_us_ += wait_us;
+        wait_max_us_ = std::max(wait_max_us_, wait_us);
+
+        int ibucket = 0;
+        while (ibucket + 1 < NUM_WAIT_BUCKETS && (1LL << ibucket) <= wait_us)
+            ++ibucket;
+        wait_buckets_[ibucket]++;
+    }
+
+    BatchingReport report() const
+    {
+        BatchingReport output;
+        output.batch_size_histogram = batch_size_histogram_;
+        output.num_batches = num_batches_;
+        output.num_jobs = num_jobs_;
+        if (num_batches_ > 0)
+            output.average_batch_size = num_jobs_ / (double)num_batches_;
+
+        if (num_jobs_ > 0)
+        {
+            output.queue_wait_mean_ms = wait_sum_us_ / (double)num_jobs_ / 1000.0;
+            output.queue_wait_p50_ms = wait_percentile_us(0.5) / 1000.0;
+            output.queue_wait_p99_ms = wait_percentile_us(0.99) / 1000.0;
+            output.queue_wait_max_ms = wait_max_us_ / 1000.0;
+        }
+        return output;
+    }
+
+private:
+    // 返回分位数所在桶的上界，不超过观测到的最大值
+    double wait_percentile_us(double p) const
+    {
+        long long target = (long long)(p * num_jobs_ + 0.5);
+        long long accum = 0;
+        for (int i = 0; i < NUM_WAIT_BUCKETS; ++i)
+        {
+            accum += wait_buckets_[i];
+            if (accum >= target && accum > 0)
+                return std::min((double)(1LL << i), (double)wait_max_us_);
+        }
+        return wait_max_us_;
+    }
+
+private:
+    static const int NUM_WAIT_BUCKETS = 32;
+    std::vector<long long> batch_size_histogram_;
+    long long wait_buckets_[NUM_WAIT_BUCKETS];
+    long long num_batches_ = 0;
+    long long num_jobs_ = 0;
+    long long wait_sum_us_ = 0;
+    long long wait_max_us_ = 0;
+};
+
+#endif // BATCHING_POLICY_HPP
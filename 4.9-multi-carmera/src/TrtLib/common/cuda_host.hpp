@@ -0,0 +1,335 @@
+/**
+ * 没有CUDA时的运行时替代
+ * 解决的问题：
+ * CPU后端和压测程序只用到CUDA运行时的内存、stream、event接口，却要求机器上装有CUDA才能编译链接
+ *
+ * 设计思路：
+ * 1. 编译选项USE_CUDA=OFF时定义CPU_ONLY，cuda_tools.cuh包含这个文件而不是<cuda.h>/<cuda_runtime.h>
+ * 2. 设备内存与锁页内存都是普通的主机内存，拷贝、memset立即在调用线程上完成，stream上没有需要等待的任务
+ * 3. 只有一个设备0，即主机；event记录时间，cudaEventElapsedTime返回两次记录之间的实际耗时
+ * 4. 核函数不参与编译，调用核函数的invoker输出错误日志，CPU后端不会调用它们
+ **/
+
+#ifndef CUDA_HOST_HPP
+#define CUDA_HOST_HPP
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+struct CUstream_st
+{
+};
+
+struct CUevent_st
+{
+    std::chrono::steady_clock::time_point time;
+};
+
+typedef CUstream_st *cudaStream_t;
+typedef CUevent_st *cudaEvent_t;
+
+enum cudaError_t
+{
+    cudaSuccess = 0,
+    cudaErrorInvalidValue = 1,
+    cudaErrorMemoryAllocation = 2,
+    cudaErrorInvalidDevice = 101
+};
+
+enum CUresult
+{
+    CUDA_SUCCESS = 0
+};
+
+enum cudaMemcpyKind
+{
+    cudaMemcpyHostToHost = 0,
+    cudaMemcpyHostToDevice = 1,
+    cudaMemcpyDeviceToHost = 2,
+    cudaMemcpyDeviceToDevice = 3,
+    cudaMemcpyDefault = 4
+};
+
+#define cudaEventDefault 0x00
+#define cudaEventDisableTiming 0x02
+
+struct dim3
+{
+    unsigned int x, y, z;
+    dim3(unsigned int x = 1, unsigned int y = 1, unsigned int z = 1) : x(x), y(y), z(z) {}
+};
+
+struct cudaDeviceProp
+{
+    char name[256];
+    int major;
+    int minor;
+    size_t totalGlobalMem;
+};
+
+inline const char *cudaGetErrorName(cudaError_t e)
+{
+    switch (e)
+    {
+    case cudaSuccess:
+        return "cudaSuccess";
+    case cudaErrorInvalidValue:
+        return "cudaErrorInvalidValue";
+    case cudaErrorMemoryAllocation:
+        return "cudaErrorMemoryAllocation";
+    case cudaErrorInvalidDevice:
+        return "cudaErrorInvalidDevice";
+    }
+    return "cudaErrorUnknown";
+}
+
+inline const char *cudaGetErrorString(cudaError_t e)
+{
+    switch (e)
+    {
+    case cudaSuccess:
+        return "no error";
+    case cudaErrorInvalidValue:
+        return "invalid argument";
+    case cudaErrorMemoryAllocation:
+        return "out of memory";
+    case cudaErrorInvalidDevice:
+        return "invalid device ordinal";
+    }
+    return "unknown error";
+}
+
+inline CUresult cuGetErrorName(CUresult, const char **name)
+{
+    *name = "CUDA_SUCCESS";
+    return CUDA_SUCCESS;
+}
+
+inline CUresult cuGetErrorString(CUresult, const char **message)
+{
+    *message = "no error";
+    return CUDA_SUCCESS;
+}
+
+inline cudaError_t cudaGetLastError() { return cudaSuccess; }
+inline cudaError_t cudaPeekAtLastError() { return cudaSuccess; }
+
+inline cudaError_t cudaGetDeviceCount(int *count)
+{
+    *count = 1;
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaGetDevice(int *device)
+{
+    *device = 0;
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaSetDevice(int device)
+{
+    return device == 0 ? cudaSuccess : cudaErrorInvalidDevice;
+}
+
+inline cudaError_t cudaGetDeviceProperties(cudaDeviceProp *prop, int device)
+{
+    if (device != 0)
+        return cudaErrorInvalidDevice;
+
+    memset(prop, 0, sizeof(*prop));
+    strcpy(prop->name, "host");
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaMemGetInfo(size_t *free_mem, size_t *total_mem)
+{
+    *free_mem = 0;
+    *total_mem = 0;
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaMalloc(void **ptr, size_t size)
+{
+    *ptr = malloc(size);
+    return *ptr != nullptr || size == 0 ? cudaSuccess : cudaErrorMemoryAllocation;
+}
+
+inline cudaError_t cudaMallocHost(void **ptr, size_t size) { return cudaMalloc(ptr, size); }
+
+inline cudaError_t cudaFree(void *ptr)
+{
+    free(ptr);
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaFreeHost(void *ptr) { return cudaFree(ptr); }
+
+inline cudaError_t cudaMemset(void *ptr, int value, size_t size)
+{
+    memset(ptr, value, size);
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaMemsetAsync(void *ptr, int value, size_t size, cudaStream_t = nullptr) { return cudaMemset(ptr, value, size); }
+
+inline cudaError_t cudaMemcpy(void *dst, const void *src, size_t size, cudaMemcpyKind)
+{
+    memcpy(dst, src, size);
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaMemcpyAsync(void *dst, const void *src, size_t size, cudaMemcpyKind kind, cudaStream_t = nullptr)
+{
+    return cudaMemcpy(dst, src, size, kind);
+}
+
+inline cudaError_t cudaMemcpy2DAsync(void *dst, size_t dpitch, const void *src, size_t spitch, size_t width, size_t height,
+                                     cudaMemcpyKind, cudaStream_t = nullptr)
+{
+    for (size_t y = 0; y < height; ++y)
+        memcpy((uint8_t *)dst + y * dpitch, (const uint8_t *)src + y * spitch, width);
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaMemcpyPeerAsync(void *dst, int, const void *src, int, size_t size, cudaStream_t = nullptr)
+{
+    memcpy(dst, src, size);
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaStreamCreate(cudaStream_t *stream)
+{
+    *stream = new CUstream_st();
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaStreamDestroy(cudaStream_t stream)
+{
+    delete stream;
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaStreamSynchronize(cudaStream_t) { return cudaSuccess; }
+inline cudaError_t cudaStreamWaitEvent(cudaStream_t, cudaEvent_t, unsigned int = 0) { return cudaSuccess; }
+
+inline cudaError_t cudaEventCreate(cudaEvent_t *event)
+{
+    *event = new CUevent_st();
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaEventCreateWithFlags(cudaEvent_t *event, unsigned int) { return cudaEventCreate(event); }
+
+inline cudaError_t cudaEventDestroy(cudaEvent_t event)
+{
+    delete event;
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaEventRecord(cudaEvent_t event, cudaStream_t = nullptr)
+{
+    event->time = std::chrono::steady_clock::now();
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaEventQuery(cudaEvent_t) { return cudaSuccess; }
+inline cudaError_t cudaEventSynchronize(cudaEvent_t) { return cudaSuccess; }
+
+inline cudaError_t cudaEventElapsedTime(float *ms, cudaEvent_t start, cudaEvent_t end)
+{
+    *ms = std::chrono::duration<float, std::milli>(end->time - start->time).count();
+    return cudaSuccess;
+}
+
+// IEEE 754半精度，float转half时就近舍入到偶数，与cuda_fp16.h一致
+struct __half
+{
+    uint16_t x;
+};
+
+inline float __half2float(__half value)
+{
+    uint32_t sign = (uint32_t)(value.x & 0x8000) << 16;
+    uint32_t exponent = (value.x >> 10) & 0x1F;
+    uint32_t mantissa = value.x & 0x3FF;
+    uint32_t bits;
+    if (exponent == 0x1F)
+    {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    }
+    else if (exponent != 0)
+    {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    else if (mantissa == 0)
+    {
+        bits = sign;
+    }
+    else
+    {
+        // 非规格化数，规格化后再组装
+        exponent = 113;
+        while ((mantissa & 0x400) == 0)
+        {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    }
+
+    float output;
+    memcpy(&output, &bits, sizeof(output));
+    return output;
+}
+
+inline __half __float2half(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    __half output;
+    if (((bits >> 23) & 0xFF) == 0xFF)
+    {
+        output.x = sign | 0x7C00 | (mantissa ? 0x200 : 0);
+        return output;
+    }
+
+    if (exponent >= 0x1F)
+    {
+        output.x = sign | 0x7C00;
+        return output;
+    }
+
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+        {
+            output.x = sign;
+            return output;
+        }
+
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half_mantissa = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half_mantissa & 1)))
+            half_mantissa++;
+        output.x = sign | half_mantissa;
+        return output;
+    }
+
+    uint32_t half_bits = ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half_bits & 1)))
+        half_bits++; // 进位到指数时正好得到下一个指数或者inf
+    output.x = sign | half_bits;
+    return output;
+}
+
+#endif // CUDA_HOST_HPP
@@ -14,8 +14,12 @@
  *  系统关于CUDA的功能函数
  */
 
+#ifdef CPU_ONLY
+#include "cuda_host.hpp"
+#else
 #include <cuda.h>
 #include <cuda_runtime.h>
+#endif
 #include "ilogger.hpp"
 
 #define GPU_BLOCK_THREADS 512
@@ -28,6 +32,10 @@
 #define checkCudaDriver(call)  CUDATools::check_driver(call, #call, __LINE__, __FILE__)
 #define checkCudaRuntime(call) CUDATools::check_runtime(call, #call, __LINE__, __FILE__)
 
+// 没有CUDA时核函数不参与编译，启动核函数只输出错误
+#ifdef CPU_ONLY
+#define checkCudaKernel(...) INFOE("launch failed: built without CUDA, %s", #__VA_ARGS__);
+#else
 #define checkCudaKernel(...)                                            \
     __VA_ARGS__;                                                        \
     do                                                                  \
@@ -38,6 +46,7 @@
             INFOE("launch failed: %s", cudaGetErrorString(cudaStatus)); \
         }                                                               \
     } while (0);
+#endif
 
 #define Assert(op)                        \
     do                                    \
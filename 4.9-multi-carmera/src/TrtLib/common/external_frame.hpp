@@ -0,0 +1,109 @@
+/**
+ * 外部持有的帧
+ * 解决的问题：
+ * 提交只接受连续的BGR cv::Mat，预处理总是先memcpy到固定内存再上传；解码器输出的显存帧、
+ * 固定内存中的帧、带行对齐的NV12帧都要先转成cv::Mat，多一次转换和拷贝
+ *
+ * 设计思路：
+ * 1. ExternalFrame只描述一块内存：指针、宽高、每行字节数、像素格式、所在位置，以及用完后的release回调
+ * 2. 按所在位置决定怎么读取：
+ *    Device   在预处理stream上直接读取，不拷贝；其他卡上的帧异步拷贝一次
+ *    Pinned   直接从这块内存异步上传，不经过中转的固定内存
+ *    Host     可分页内存不能异步上传，按行拷贝到固定内存后上传，与cv::Mat相同
+ * 3. 按行读取，每行字节数可以大于width * 通道数(ROI、解码器的行对齐)
+ * 4. 提交时包装为shared_ptr，最后一个引用释放时调用release，
+ *    读取是异步的，引擎持有引用直到这一帧的推理完成，被拒绝、失败、取消时同样调用release，且只调用一次
+ **/
+
+#ifndef EXTERNAL_FRAME_HPP
+#define EXTERNAL_FRAME_HPP
+
+#include <memory>
+#include <cstdint>
+#include <functional>
+
+enum class PixelFormat : int
+{
+    BGR = 0,
+    RGB = 1,
+    NV12 = 2 // Y平面之后是交错的UV平面，UV平面的行数为(height + 1) / 2，每行字节数与Y平面相同
+};
+
+inline const char *pixel_format_name(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::BGR:
+        return "BGR";
+    case PixelFormat::RGB:
+        return "RGB";
+    case PixelFormat::NV12:
+        return "NV12";
+    default:
+        return "Unknow";
+    }
+}
+
+enum class MemoryLocation : int
+{
+    Host = 0,   // 可分页的主机内存
+    Pinned = 1, // cudaMallocHost/cudaHostAlloc分配的主机内存
+    Device = 2  // 显存
+};
+
+inline const char *memory_location_name(MemoryLocation location)
+{
+    switch (location)
+    {
+    case MemoryLocation::Host:
+        return "Host";
+    case MemoryLocation::Pinned:
+        return "Pinned";
+    case MemoryLocation::Device:
+        return "Device";
+    default:
+        return "Unknow";
+    }
+}
+
+// 提交时这一帧必须已经就绪，例如解码器的stream已经同步
+struct ExternalFrame
+{
+    const uint8_t *data = nullptr; // BGR/RGB为交错的3通道，NV12为Y平面
+    const uint8_t *uv = nullptr;   // NV12的UV平面，nullptr表示紧跟在Y平面之后，即data + line_size() * height
+    int width = 0;
+    int height = 0;
+    int stride = 0; // 每行字节数，0表示没有行对齐
+    PixelFormat format = PixelFormat::BGR;
+    MemoryLocation location = MemoryLocation::Host;
+    int device_id = -1; // Device时所在的卡，-1表示与引擎相同
+
+    // 引擎不再读取这块内存时调用，可以为空；在推理线程或者提交线程上调用，应当尽快返回
+    std::function<void()> release;
+
+    bool empty() const { return data == nullptr || width <= 0 || height <= 0; }
+
+    // 没有行对齐时NV12每行为偶数个字节，UV平面每行有(width + 1) / 2对UV
+    int line_size() const
+    {
+        if (stride > 0)
+            return stride;
+        return format == PixelFormat::NV12 ? (width + 1) / 2 * 2 : width * 3;
+    }
+
+    const uint8_t *uv_plane() const { return uv != nullptr ? uv : data + (size_t)line_size() * height; }
+};
+
+typedef std::shared_ptr<const ExternalFrame> SharedFrame;
+
+// 最后一个引用释放时调用frame.release
+inline SharedFrame share_frame(const ExternalFrame &frame)
+{
+    return SharedFrame(new ExternalFrame(frame), [](const ExternalFrame *p)
+                       {
+        if (p->release)
+            p->release();
+        delete p; });
+}
+
+#endif // EXTERNAL_FRAME_HPP
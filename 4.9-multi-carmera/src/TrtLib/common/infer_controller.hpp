@@ -14,23 +14,48 @@
 #include <memory>
 #include <mutex>
 #include <thread>
-#include <queue>
-#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <functional>
 
 #include "../infer/trt_infer.hpp"
 #include "monopoly_allocator.hpp"
+#include "batching_policy.hpp"
+#include "mpmc_queue.hpp"
+#include "pipeline_stage.hpp"
+#include "job_scheduler.hpp"
+#include "admission_control.hpp"
+#include "object_pool.hpp"
+#include "infer_metrics.hpp"
+#include "adaptive_batching.hpp"
 
 template <class Input, class Output, class StartParam = std::tuple<std::string, int>, class JobAdditional = int>
 class InferController
 {
 public:
+    /* 完成回调，在推理线程或者后处理线程上调用，被拒绝、丢弃、取消时output为空
+       回调返回后output被清空并回收，需要保留时应当std::swap或者std::move出去
+    */
+    typedef std::function<void(Output &output)> Callback;
+
     struct Job
     {
         Input input;
         Output output;
         JobAdditional additional;
         MonopolyAllocator<TRT::Tensor>::MonopolyDataPointer mono_tensor;
-        std::shared_ptr<std::promise<Output>> pro;
+        std::shared_ptr<std::promise<Output>> pro; // 与callback二选一
+        Callback callback;
+        std::chrono::steady_clock::time_point enqueue_time;
+        std::chrono::steady_clock::time_point commit_time;
+        JobPriority priority = JobPriority::Interactive;
+        int tenant = 0;
+        bool latest_only = false;
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+        std::shared_ptr<CancellationToken> cancel_token;
+        std::shared_ptr<JobOutcome> outcome;
+        int batch_size = 0;    // 所在batch的大小，取出batch时设置
+        long long fetch_us = 0; // 所在batch被取出的时刻
     };
 
     virtual ~InferController()
@@ -41,140 +66,734 @@ public:
     void stop()
     {
         run_ = false;
-        cond_.notify_all();
 
-        ////////////////////////////////////////// cleanup jobs
-        {
-            std::unique_lock<std::mutex> l(jobs_lock_);
-            while (!jobs_.empty())
-            {
-                auto &item = jobs_.front();
-                if (item.pro)
-                    item.pro->set_value(Output());
-                jobs_.pop();
-            }
-        };
+        // 按流水线的方向依次停止，上游的线程先退出，保证下游的队列不再有新的job
+        preprocess_jobs_.close();
+        join_threads(preprocess_threads_);
 
+        jobs_.close();
         if (worker_)
         {
             worker_->join();
             worker_.reset();
         }
+
+        // 已经推理完的job仍然完成后处理
+        postprocess_jobs_.close();
+        join_threads(postprocess_threads_);
+
+        ////////////////////////////////////////// cleanup jobs
+        Job item;
+        while (preprocess_jobs_.try_pop(item) || jobs_.try_pop(item))
+        {
+            if (item.pro || item.callback)
+                abort_job(item);
+        }
+
+        std::vector<Job> pending;
+        scheduler_.pop_all(pending);
+        for (auto &job : pending)
+            abort_job(job);
+
+        for (auto &counter : num_pending_)
+            counter = 0;
+
+        // 排队中的job持有mono tensor，分配器在全部释放之后才销毁，worker退出时不销毁
+        tensor_allocator_.reset();
     }
 
-    bool startup(const StartParam &param)
+    /* pipeline：预处理、后处理线程池的配置，默认与原来的行为一致，见pipeline_stage.hpp
+     */
+    bool startup(const StartParam &param, const PipelineConfig &pipeline = PipelineConfig())
     {
         run_ = true;
+        jobs_.reopen();
+        pipeline_config_ = pipeline;
+        preprocess_jobs_.reset(pipeline.queue_capacity);
+        postprocess_jobs_.reset(pipeline.queue_capacity);
+        reset_pipeline_statistics();
 
         std::promise<bool> pro;
         start_param_ = param;
         worker_ = std::make_shared<std::thread>(&InferController::worker, this, std::ref(pro));
-        return pro.get_future().get();
+        if (!pro.get_future().get())
+            return false;
+
+        for (int i = 0; i < pipeline.num_preprocess_threads; ++i)
+            preprocess_threads_.emplace_back(new std::thread(&InferController::preprocess_thread_proc, this));
+
+        for (int i = 0; i < pipeline.num_postprocess_threads; ++i)
+            postprocess_threads_.emplace_back(new std::thread(&InferController::postprocess_thread_proc, this));
+        return true;
     }
 
     virtual std::shared_future<Output> commit(const Input &input)
     {
-
-        Job job;
-        job.pro = std::make_shared<std::promise<Output>>();
-        if (!preprocess(job, input))
-        {
-            job.pro->set_value(Output());
-            return job.pro->get_future();
-        }
-
-        ///////////////////////////////////////////////////////////
-        {
-            std::unique_lock<std::mutex> l(jobs_lock_);
-            jobs_.push(job);
-        };
-        cond_.notify_one();
-        return job.pro->get_future();
+        return commit(input, JobOptions());
     }
 
     virtual std::vector<std::shared_future<Output>> commits(const std::vector<Input> &inputs)
     {
+        return commits(inputs, JobOptions());
+    }
+
+    /* options：优先级与租户，见job_scheduler.hpp
+       被准入控制拒绝时结果为空，通过get_admission_report的计数器区分
+     */
+    virtual std::shared_future<Output> commit(const Input &input, const JobOptions &options)
+    {
+        std::shared_future<Output> result;
+        submit(input, options, true, result);
+        return result;
+    }
 
-        int batch_size = std::min((int)inputs.size(), this->tensor_allocator_->capacity());
-        std::vector<Job> jobs(inputs.size());
+    virtual std::vector<std::shared_future<Output>> commits(const std::vector<Input> &inputs, const JobOptions &options)
+    {
         std::vector<std::shared_future<Output>> results(inputs.size());
+        for (int i = 0; i < (int)inputs.size(); ++i)
+            submit(inputs[i], options, true, results[i]);
+        return results;
+    }
 
-        int nepoch = (inputs.size() + batch_size - 1) / batch_size;
-        for (int epoch = 0; epoch < nepoch; ++epoch)
-        {
-            int begin = epoch * batch_size;
-            int end = std::min((int)inputs.size(), begin + batch_size);
+    /* 不阻塞的提交，没有空闲的tensor或者队列已满时立即返回拒绝的状态
+       只有返回Accepted时result才会有有效的结果
+    */
+    CommitStatus try_commit(const Input &input, std::shared_future<Output> &result, const JobOptions &options = JobOptions())
+    {
+        return submit(input, options, false, result);
+    }
 
-            for (int i = begin; i < end; ++i)
-            {
-                Job &job = jobs[i];
-                job.pro = std::make_shared<std::promise<Output>>();
-                if (!preprocess(job, inputs[i]))
-                {
-                    job.pro->set_value(Output());
-                }
-                results[i] = job.pro->get_future();
-            }
+    /* 回调形式的提交，不分配promise和共享状态，output来自回收池
+       blocking = false时与try_commit一样不阻塞，被拒绝时回调已经在当前线程以空的output调用过
+    */
+    CommitStatus commit(const Input &input, const Callback &callback, const JobOptions &options = JobOptions(), bool blocking = true)
+    {
+        return submit(input, options, blocking, callback);
+    }
+
+    void set_admission_policy(const AdmissionPolicy &policy)
+    {
+        std::unique_lock<std::mutex> l(stats_lock_);
+        admission_policy_ = policy;
+    }
+
+    AdmissionPolicy get_admission_policy()
+    {
+        std::unique_lock<std::mutex> l(stats_lock_);
+        return admission_policy_;
+    }
+
+    AdmissionReport get_admission_report(bool reset = false)
+    {
+        auto report = admission_statistics_.report(num_pending());
+        if (reset)
+            admission_statistics_.reset();
+        return report;
+    }
+
+    void set_batching_policy(const BatchingPolicy &policy)
+    {
+        std::unique_lock<std::mutex> l(stats_lock_);
+        batching_policy_ = policy;
+    }
+
+    BatchingPolicy get_batching_policy()
+    {
+        std::unique_lock<std::mutex> l(stats_lock_);
+        return batching_policy_;
+    }
+
+    BatchingReport get_batching_report(bool reset = false)
+    {
+        std::unique_lock<std::mutex> l(stats_lock_);
+        auto report = batching_statistics_.report();
+        if (reset)
+            batching_statistics_.reset();
+        return report;
+    }
+
+    /* 按实测的吞吐曲线在线调整batch上限，见adaptive_batching.hpp
+       上限与批处理策略的max_batch_size同时生效，取较小者
+    */
+    void set_adaptive_batching(const AdaptiveBatchingPolicy &policy)
+    {
+        adaptive_batching_.set_policy(policy);
+    }
 
-            ///////////////////////////////////////////////////////////
+    AdaptiveBatchingPolicy get_adaptive_batching()
+    {
+        return adaptive_batching_.get_policy();
+    }
+
+    // 学习到的batch大小 - 吞吐/延迟曲线与当前的上限
+    AdaptiveBatchingReport get_adaptive_batching_report()
+    {
+        return adaptive_batching_.report();
+    }
+
+    PipelineReport get_pipeline_report(bool reset = false)
+    {
+        PipelineReport report;
+        report.preprocess = preprocess_statistics_.report("preprocess", preprocess_threads_.size(), preprocess_jobs_.size());
+        report.inference = inference_statistics_.report("inference", 1, jobs_.size());
+        report.postprocess = postprocess_statistics_.report("postprocess", postprocess_threads_.size(), postprocess_jobs_.size());
+        if (reset)
+            reset_pipeline_statistics();
+        return report;
+    }
+
+    /* 各阶段的延迟分布、吞吐、batch填充率与丢弃计数的快照，可以在任意线程调用
+       reset = true时同时清空准入控制与取消的计数，开始新的统计窗口
+    */
+    InferMetricsSnapshot get_metrics(bool reset = false)
+    {
+        auto snapshot = metrics_.snapshot();
+        snapshot.admission = get_admission_report(reset);
+        snapshot.cancellation = get_cancellation_report(reset);
+        if (reset)
+            metrics_.reset();
+        return snapshot;
+    }
+
+    // 取消与截止时间跳过的job数量，以及按各阶段平均耗时估算的节省量
+    CancellationReport get_cancellation_report(bool reset = false)
+    {
+        auto pipeline = get_pipeline_report();
+        auto report = cancellation_statistics_.report(pipeline.inference.average_ms, pipeline.postprocess.average_ms);
+        if (reset)
+            cancellation_statistics_.reset();
+        return report;
+    }
+
+    // 同一优先级内租户的权重，默认为1
+    void set_tenant_weight(int tenant, int weight)
+    {
+        scheduler_.set_tenant_weight(tenant, weight);
+    }
+
+    SchedulingReport get_scheduling_report(bool reset = false)
+    {
+        SchedulingReport report;
+        for (int i = 0; i < NUM_JOB_PRIORITY; ++i)
+        {
+            PriorityClassReport item;
+            item.priority = (JobPriority)i;
+            item.num_pending = num_pending_[i];
+            item.queue_wait = class_queue_wait_[i].summary();
+            item.latency = class_latency_[i].summary();
+            report.classes.emplace_back(item);
+
+            if (reset)
             {
-                std::unique_lock<std::mutex> l(jobs_lock_);
-                for (int i = begin; i < end; ++i)
-                {
-                    jobs_.emplace(std::move(jobs[i]));
-                };
+                class_queue_wait_[i].reset();
+                class_latency_[i].reset();
             }
-            cond_.notify_one();
         }
-        return results;
+        return report;
     }
 
 protected:
     virtual void worker(std::promise<bool> &result) = 0;
     virtual bool preprocess(Job &job, const Input &input) = 0;
 
+    // worker按batch记录上传、前向、解码的耗时
+    void record_stage(MetricStage stage, long long elapsed_us)
+    {
+        metrics_.record(stage, elapsed_us);
+    }
+
+    /* 推理线程已经把结果读回到job.output之后，在后处理阶段对其进一步处理，例如CPU NMS
+       配置了后处理线程池时在池中执行，可能多个线程同时调用
+    */
+    virtual void postprocess(Job &job) {}
+
+    /* 预处理之后仍在异步读取job.input时(例如显存、固定内存中的外部帧)，job被丢弃之前等待读取结束
+       之后job.input和mono tensor才会被释放，可能在任意线程上调用
+    */
+    virtual void wait_input(Job &job) {}
+
+    /* worker对每个推理完的job调用，代替直接job.pro->set_value
+       有后处理线程池时交给线程池，推理线程立即去取下一个batch
+    */
+    void finish_job(Job &job)
+    {
+        record_finished(job);
+        if (!postprocess_threads_.empty())
+        {
+            if (!postprocess_jobs_.push(std::move(job)))
+                reject_job(job);
+            return;
+        }
+        postprocess_and_notify(job);
+    }
+
+    /* max_size为引擎的最大batch
+       按batching_policy_凑batch：达到preferred立即返回，否则等到最早的job超过max_queue_delay_us
+       策略在凑batch开始时读取一次，新的策略从下一个batch开始生效
+       job先从无锁队列搬运到scheduler_，再按优先级和租户权重取出，高优先级的job在下一个batch边界抢占
+    */
     virtual bool get_jobs_and_wait(std::vector<Job> &fetch_jobs, int max_size)
     {
+        // 从上一次返回到这一次调用之间，推理线程处于忙碌状态
+        if (inference_begin_us_ > 0)
+            inference_statistics_.record(StageStatistics::now_us() - inference_begin_us_, inference_batch_size_);
+
+        inference_begin_us_ = 0;
+        fetch_jobs.clear();
 
-        std::unique_lock<std::mutex> l(jobs_lock_);
-        cond_.wait(l, [&]()
-                   { return !run_ || !jobs_.empty(); });
+        // 取出的job全部被丢弃(取消、超时)时重新等待
+        while (fetch_jobs.empty())
+        {
+            if (!wait_for_jobs())
+                return false;
 
-        if (!run_)
-            return false;
+            BatchingPolicy policy = get_batching_policy();
+            int limit = adaptive_batching_.limit(max_size, policy.limit(max_size));
+            if (policy.max_queue_delay_us > 0)
+            {
+                Job job;
+                int preferred = std::min(policy.preferred(max_size), limit);
+                auto deadline = scheduler_.oldest_enqueue_time() + std::chrono::microseconds(policy.max_queue_delay_us);
+                while (run_ && (int)scheduler_.size() < preferred && jobs_.pop_wait_until(job, deadline))
+                {
+                    schedule_job(std::move(job));
+                    drain_jobs();
+                }
+            }
+
+            if (!run_)
+                return false;
+
+            pop_valid_jobs(fetch_jobs, limit);
+        }
 
+        record_fetched(fetch_jobs, max_size);
+        return true;
+    }
+
+    /* 不阻塞的get_jobs_and_wait，用于上一个batch还在推理时提前取下一个batch，见staging_pipeline.hpp
+       只有按批处理策略已经可以出发时(达到preferred或者最早的job已经超过max_queue_delay_us)才取出，否则返回false
+    */
+    virtual bool try_get_jobs(std::vector<Job> &fetch_jobs, int max_size)
+    {
         fetch_jobs.clear();
-        for (int i = 0; i < max_size && !jobs_.empty(); ++i)
+        drain_jobs();
+        if (!run_ || scheduler_.empty())
+            return false;
+
+        BatchingPolicy policy = get_batching_policy();
+        int limit = adaptive_batching_.limit(max_size, policy.limit(max_size));
+        if (policy.max_queue_delay_us > 0 && (int)scheduler_.size() < std::min(policy.preferred(max_size), limit))
         {
-            fetch_jobs.emplace_back(std::move(jobs_.front()));
-            jobs_.pop();
+            auto deadline = scheduler_.oldest_enqueue_time() + std::chrono::microseconds(policy.max_queue_delay_us);
+            if (std::chrono::steady_clock::now() < deadline)
+                return false;
         }
+
+        pop_valid_jobs(fetch_jobs, limit);
+        if (fetch_jobs.empty())
+            return false;
+
+        // 两个batch重叠时，推理线程的忙碌时间按取到batch的时刻分段统计
+        if (inference_begin_us_ > 0)
+            inference_statistics_.record(StageStatistics::now_us() - inference_begin_us_, inference_batch_size_);
+
+        record_fetched(fetch_jobs, max_size);
         return true;
     }
 
     virtual bool get_job_and_wait(Job &fetch_job)
     {
+        // 取出的job全部被丢弃(取消、超时)时重新等待
+        std::vector<Job> fetch_jobs;
+        while (fetch_jobs.empty())
+        {
+            if (!wait_for_jobs())
+                return false;
+
+            pop_valid_jobs(fetch_jobs, 1);
+        }
+
+        fetch_job = std::move(fetch_jobs[0]);
+        num_pending_[(int)fetch_job.priority]--;
+        return true;
+    }
+
+private:
+    void record_fetched(std::vector<Job> &fetch_jobs, int max_size)
+    {
+        auto now = std::chrono::steady_clock::now();
+        auto now_us = StageStatistics::now_us();
+        std::unique_lock<std::mutex> l(stats_lock_);
+        for (auto &item : fetch_jobs)
+        {
+            item.batch_size = fetch_jobs.size();
+            item.fetch_us = now_us;
+            auto wait_us = std::chrono::duration_cast<std::chrono::microseconds>(now - item.enqueue_time).count();
+            batching_statistics_.record_wait(wait_us);
+            class_queue_wait_[(int)item.priority].record(wait_us);
+            metrics_.record(MetricStage::QueueWait, wait_us);
+            num_pending_[(int)item.priority]--;
+        }
+        batching_statistics_.record_batch(fetch_jobs.size());
+        metrics_.record_batch(fetch_jobs.size(), max_size);
+        inference_begin_us_ = now_us;
+        inference_batch_size_ = fetch_jobs.size();
+    }
+
+    /* batch的第一个job推理完成时记录这个batch占用推理的时间，推理线程调用
+       上一个batch完成之前取出的batch(双缓冲)从上一个batch完成时开始计时
+    */
+    void record_finished(const Job &job)
+    {
+        if (job.fetch_us == 0 || job.fetch_us == finished_fetch_us_)
+            return;
+
+        auto now_us = StageStatistics::now_us();
+        adaptive_batching_.record_batch(job.batch_size, now_us - std::max(job.fetch_us, finished_us_));
+        finished_fetch_us_ = job.fetch_us;
+        finished_us_ = now_us;
+    }
+
+    void init_job(Job &job, const JobOptions &options)
+    {
+        job.priority = (JobPriority)std::min(std::max((int)options.priority, 0), NUM_JOB_PRIORITY - 1);
+        job.tenant = options.tenant;
+        job.latest_only = options.latest_only;
+        job.cancel_token = options.cancel_token;
+        job.outcome = options.outcome;
+        if (options.deadline_ms > 0)
+            job.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.deadline_ms);
+        job.commit_time = std::chrono::steady_clock::now();
+    }
+
+    long long num_pending()
+    {
+        long long output = 0;
+        for (auto &counter : num_pending_)
+            output += counter;
+        return output;
+    }
+
+    // 单个job的提交流程：准入检查 -> 预处理(调用线程或者预处理线程池) -> 进入推理队列
+    CommitStatus submit(const Input &input, const JobOptions &options, bool blocking, std::shared_future<Output> &result)
+    {
+        Job job;
+        init_job(job, options);
+        job.pro = make_promise();
+        result = job.pro->get_future();
+        return submit(job, input, blocking);
+    }
+
+    CommitStatus submit(const Input &input, const JobOptions &options, bool blocking, const Callback &callback)
+    {
+        Job job;
+        init_job(job, options);
+        job.callback = callback;
+        output_pool_.acquire(job.output);
+        return submit(job, input, blocking);
+    }
+
+    CommitStatus submit(Job &job, const Input &input, bool blocking)
+    {
+        auto status = admit(job, blocking);
+        if (status != CommitStatus::Accepted)
+        {
+            admission_statistics_.record(status);
+            reject_job(job);
+            return status;
+        }
+
+        if (!preprocess_threads_.empty())
+        {
+            job.input = input;
+            bool pushed = blocking ? preprocess_jobs_.push(std::move(job)) : preprocess_jobs_.try_push(std::move(job));
+            if (!pushed)
+            {
+                status = run_ ? CommitStatus::QueueFull : CommitStatus::Failed;
+                admission_statistics_.record(status);
+                abort_job(job);
+                return status;
+            }
+            admission_statistics_.record(status);
+            return status;
+        }
 
-        std::unique_lock<std::mutex> l(jobs_lock_);
-        cond_.wait(l, [&]()
-                   { return !run_ || !jobs_.empty(); });
+        if (!preprocess_timed(job, input))
+        {
+            admission_statistics_.record(CommitStatus::Failed);
+            abort_job(job);
+            return CommitStatus::Failed;
+        }
+
+        admission_statistics_.record(status);
+        job.enqueue_time = std::chrono::steady_clock::now();
+        if (!jobs_.push(std::move(job)))
+            abort_job(job);
+        return status;
+    }
 
+    // 准入检查并占用一个tensor，通过后计入num_pending_
+    CommitStatus admit(Job &job, bool blocking)
+    {
         if (!run_)
+            return CommitStatus::Failed;
+
+        AdmissionPolicy policy = get_admission_policy();
+        if (policy.max_queue_depth > 0 && num_pending() >= policy.max_queue_depth)
+            return CommitStatus::QueueFull;
+
+        if (tensor_allocator_ != nullptr)
+        {
+            auto begin = StageStatistics::now_us();
+            job.mono_tensor = tensor_allocator_->query(blocking ? policy.query_timeout_ms : 0);
+            metrics_.record(MetricStage::AllocatorWait, StageStatistics::now_us() - begin);
+            if (job.mono_tensor == nullptr)
+                return CommitStatus::NoSlot;
+        }
+
+        num_pending_[(int)job.priority]++;
+        return CommitStatus::Accepted;
+    }
+
+    // 已经准入的job不再继续执行，立即释放输入和tensor，结果为空
+    void abort_job(Job &job)
+    {
+        wait_input(job);
+        job.input = Input();
+        if (job.mono_tensor)
+        {
+            job.mono_tensor->release();
+            job.mono_tensor.reset();
+        }
+        num_pending_[(int)job.priority]--;
+        reject_job(job);
+    }
+
+    // 结果为空
+    void reject_job(Job &job)
+    {
+        reset_for_reuse(job.output);
+        if (job.outcome)
+            job.outcome->set(true);
+        notify_job(job);
+    }
+
+    // 结果以move的方式交给future或者回调，回调的output在返回后回收
+    void notify_job(Job &job)
+    {
+        if (job.callback)
+        {
+            job.callback(job.output);
+            job.callback = nullptr;
+            output_pool_.release(std::move(job.output));
+            return;
+        }
+        job.pro->set_value(std::move(job.output));
+    }
+
+    // promise对象、控制块与共享状态都从BlockPool分配
+    static std::shared_ptr<std::promise<Output>> make_promise()
+    {
+        return std::allocate_shared<std::promise<Output>>(
+            PoolAllocator<std::promise<Output>>(), std::allocator_arg, PoolAllocator<Output>());
+    }
+
+    // 把无锁队列中的job全部搬到scheduler_
+    void drain_jobs()
+    {
+        Job job;
+        while (jobs_.try_pop(job))
+            schedule_job(std::move(job));
+    }
+
+    void schedule_job(Job &&job)
+    {
+        superseded_jobs_.clear();
+        scheduler_.push(std::move(job), superseded_jobs_);
+        for (auto &item : superseded_jobs_)
+            abort_job(item);
+
+        admission_statistics_.record_superseded(superseded_jobs_.size());
+        superseded_jobs_.clear();
+    }
+
+    // 已取消或者超过截止时间的job返回true并计数
+    bool should_skip(const Job &job, std::chrono::steady_clock::time_point now, CancellationStatistics::Stage stage)
+    {
+        bool cancelled = job.cancel_token && job.cancel_token->cancelled();
+        if (!cancelled && now <= job.deadline)
             return false;
 
-        fetch_job = std::move(jobs_.front());
-        jobs_.pop();
+        cancellation_statistics_.record(stage, cancelled);
         return true;
     }
 
+    // 从scheduler_取出最多limit个job，已取消、超过截止时间、排队超过max_queue_age_ms的job被丢弃
+    void pop_valid_jobs(std::vector<Job> &fetch_jobs, int limit)
+    {
+        int max_queue_age_ms = get_admission_policy().max_queue_age_ms;
+        while ((int)fetch_jobs.size() < limit && !scheduler_.empty())
+        {
+            int begin = fetch_jobs.size();
+            scheduler_.pop_batch(fetch_jobs, limit);
+            auto now = std::chrono::steady_clock::now();
+            auto expire_time = max_queue_age_ms > 0 ? now - std::chrono::milliseconds(max_queue_age_ms) : std::chrono::steady_clock::time_point::min();
+            auto end = std::remove_if(fetch_jobs.begin() + begin, fetch_jobs.end(), [&](Job &job)
+                                      {
+                if (should_skip(job, now, CancellationStatistics::BeforeInference))
+                {
+                    abort_job(job);
+                    return true;
+                }
+
+                if (job.enqueue_time >= expire_time)
+                    return false;
+
+                abort_job(job);
+                admission_statistics_.record_expired();
+                return true; });
+            fetch_jobs.erase(end, fetch_jobs.end());
+        }
+    }
+
+    // scheduler_为空时阻塞等待，返回false表示需要退出
+    bool wait_for_jobs()
+    {
+        drain_jobs();
+        while (scheduler_.empty())
+        {
+            Job job;
+            if (!jobs_.pop_wait(job))
+                return false;
+
+            schedule_job(std::move(job));
+            drain_jobs();
+        }
+        return run_;
+    }
+
+    bool preprocess_timed(Job &job, const Input &input)
+    {
+        auto begin = StageStatistics::now_us();
+        bool ok = preprocess(job, input);
+        auto elapsed_us = StageStatistics::now_us() - begin;
+        preprocess_statistics_.record(elapsed_us);
+        metrics_.record(MetricStage::Preprocess, elapsed_us);
+        return ok;
+    }
+
+    /* 输入以浅拷贝的形式保存在job中，由预处理线程完成预处理后释放
+       预处理之后仍然会读取输入时(例如异步读取外部的缓冲)，preprocess把输入存回job.input，直到job完成
+    */
+    void preprocess_thread_proc()
+    {
+        Job job;
+        while (preprocess_jobs_.pop_wait(job))
+        {
+            Input input = std::move(job.input);
+            job.input = Input();
+            bool ok = run_ && preprocess_timed(job, input);
+            input = Input();
+            if (!ok)
+            {
+                // 提交时已经计入accepted，与dropped一样是准入之后的结果
+                admission_statistics_.record(CommitStatus::Failed);
+                abort_job(job);
+                job = Job();
+                continue;
+            }
+
+            job.enqueue_time = std::chrono::steady_clock::now();
+            if (!jobs_.push(std::move(job)))
+                abort_job(job);
+            job = Job();
+        }
+    }
+
+    void postprocess_thread_proc()
+    {
+        Job job;
+        while (postprocess_jobs_.pop_wait(job))
+        {
+            postprocess_and_notify(job);
+            job = Job();
+        }
+    }
+
+    void postprocess_and_notify(Job &job)
+    {
+        // 推理完成后tensor已经释放，这里只需要跳过后处理
+        if (should_skip(job, std::chrono::steady_clock::now(), CancellationStatistics::BeforePostprocess))
+        {
+            reject_job(job);
+            return;
+        }
+
+        auto begin = StageStatistics::now_us();
+        postprocess(job);
+        auto end = StageStatistics::now_us();
+        postprocess_statistics_.record(end - begin);
+        metrics_.record(MetricStage::NMS, end - begin);
+
+        // 在结果可见之前记录，调用方拿到结果后读取的统计已经包含这个job
+        auto latency_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - job.commit_time).count();
+        class_latency_[(int)job.priority].record(latency_us);
+        metrics_.record(MetricStage::Total, latency_us);
+        adaptive_batching_.record_latency(job.batch_size, latency_us);
+        if (job.outcome)
+            job.outcome->set(false);
+        notify_job(job);
+    }
+
+    void join_threads(std::vector<std::shared_ptr<std::thread>> &threads)
+    {
+        for (auto &t : threads)
+            t->join();
+        threads.clear();
+    }
+
+    void reset_pipeline_statistics()
+    {
+        preprocess_statistics_.reset();
+        inference_statistics_.reset();
+        postprocess_statistics_.reset();
+    }
+
 protected:
     StartParam start_param_;
     std::atomic<bool> run_;
-    std::mutex jobs_lock_;
-    std::queue<Job> jobs_;
+    MPMCQueue<Job> jobs_{1024};
     std::shared_ptr<std::thread> worker_;
-    std::condition_variable cond_;
     std::shared_ptr<MonopolyAllocator<TRT::Tensor>> tensor_allocator_;
+    BatchingPolicy batching_policy_;
+    BatchingStatistics batching_statistics_;
+    std::mutex stats_lock_;
+
+    PipelineConfig pipeline_config_;
+    MPMCQueue<Job> preprocess_jobs_{256};
+    MPMCQueue<Job> postprocess_jobs_{256};
+    std::vector<std::shared_ptr<std::thread>> preprocess_threads_;
+    std::vector<std::shared_ptr<std::thread>> postprocess_threads_;
+    StageStatistics preprocess_statistics_;
+    StageStatistics inference_statistics_;
+    StageStatistics postprocess_statistics_;
+    long long inference_begin_us_ = 0;
+    int inference_batch_size_ = 0;
+
+    JobScheduler<Job> scheduler_; // 仅推理线程访问
+    std::atomic<int> num_pending_[NUM_JOB_PRIORITY] = {};
+    std::vector<Job> superseded_jobs_;
+    AdmissionPolicy admission_policy_;
+    AdmissionStatistics admission_statistics_;
+    CancellationStatistics cancellation_statistics_;
+    ObjectPool<Output> output_pool_;
+    InferMetrics metrics_;
+    LatencyHistogram class_queue_wait_[NUM_JOB_PRIORITY];
+    LatencyHistogram class_latency_[NUM_JOB_PRIORITY];
+    AdaptiveBatchController adaptive_batching_;
+    long long finished_fetch_us_ = 0; // 以下仅推理线程访问
+    long long finished_us_ = 0;
 };
 
 #endif // INFER_CONTROLLER_HPP
\ No newline at end of file
@@ -0,0 +1,248 @@
+/**
+ * InferController内置的分阶段延迟统计
+ * 解决的问题：
+ * 只能看到commit到结果的总延迟，无法知道时间花在排队、预处理、拷贝、前向、解码还是NMS上
+ *
+ * 设计思路：
+ * 1. 每个阶段一个直方图，分位数p50/p90/p99/p999，见latency_histogram.hpp
+ * 2. 直方图按线程分片，每个线程固定写入一个分片，分片之间没有共享的缓存行，读取快照时再合并
+ *    记录只是几次relaxed的原子加，不加锁，可以在生产环境常开
+ * 3. 排队、分配器等待、预处理、NMS、总延迟按job记录；上传、前向、解码按batch记录
+ *    GPU上这三个阶段用cuda event测量设备上的耗时，CPU后端用墙上时间
+ * 4. 快照同时带上吞吐、batch填充率和准入控制、取消的丢弃计数，可以输出为json
+ **/
+
+#ifndef INFER_METRICS_HPP
+#define INFER_METRICS_HPP
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include "json.hpp"
+#include "latency_histogram.hpp"
+#include "admission_control.hpp"
+#include "job_cancellation.hpp"
+#include "pipeline_stage.hpp"
+
+enum class MetricStage : int
+{
+    QueueWait = 0,     // 进入推理队列到进入batch
+    AllocatorWait = 1, // 等待空闲的tensor
+    Preprocess = 2,
+    Upload = 3,     // 输入拷贝到引擎的输入tensor(H2D)，按batch
+    Forward = 4,    // 按batch
+    Decode = 5,     // 解码并读回结果，按batch
+    NMS = 6,        // 后处理
+    Total = 7       // commit到结果可用
+};
+
+static const int NUM_METRIC_STAGES = 8;
+
+inline const char *metric_stage_name(MetricStage stage)
+{
+    switch (stage)
+    {
+    case MetricStage::QueueWait:
+        return "queue_wait";
+    case MetricStage::AllocatorWait:
+        return "allocator_wait";
+    case MetricStage::Preprocess:
+        return "preprocess";
+    case MetricStage::Upload:
+        return "upload";
+    case MetricStage::Forward:
+        return "forward";
+    case MetricStage::Decode:
+        return "decode";
+    case MetricStage::NMS:
+        return "nms";
+    case MetricStage::Total:
+        return "total";
+    default:
+        return "unknow";
+    }
+}
+
+// 按线程分片的直方图，分片数固定，线程多于分片时多个线程共用一个分片
+class ShardedLatencyHistogram
+{
+public:
+    void record(long long value_us)
+    {
+        shards_[shard_index()].histogram.record(value_us);
+    }
+
+    void reset()
+    {
+        for (auto &shard : shards_)
+            shard.histogram.reset();
+    }
+
+    void merge_to(LatencyHistogram &output) const
+    {
+        for (auto &shard : shards_)
+            output.merge(shard.histogram);
+    }
+
+private:
+    static const int NUM_SHARDS = 8;
+
+    struct Shard
+    {
+        LatencyHistogram histogram;
+        char padding[64]; // 避免相邻分片的计数落在同一缓存行
+    };
+
+    static int shard_index()
+    {
+        static std::atomic<int> next_index(0);
+        static thread_local int index = next_index.fetch_add(1, std::memory_order_relaxed) % NUM_SHARDS;
+        return index;
+    }
+
+private:
+    Shard shards_[NUM_SHARDS];
+};
+
+struct InferMetricsSnapshot
+{
+    double elapsed_ms = 0;
+    long long num_jobs = 0; // 完成推理的job
+    long long num_batches = 0;
+    double throughput = 0; // jobs/s
+    double average_batch_size = 0;
+    double batch_fill_ratio = 0; // 平均batch / 引擎最大batch
+    LatencySummary stages[NUM_METRIC_STAGES];
+    AdmissionReport admission;
+    CancellationReport cancellation;
+
+    const LatencySummary &stage(MetricStage stage) const { return stages[(int)stage]; }
+
+    // 被拒绝、丢弃、取消的job总数
+    long long num_dropped() const
+    {
+        return admission.rejected() + admission.dropped() + cancellation.skipped_postprocess();
+    }
+
+    std::string to_string() const
+    {
+        std::string output = iLogger::format(
+            "throughput=%.2f jobs/s, batches=%lld, avg batch=%.2f, fill=%.1f%%, dropped=%lld",
+            throughput, num_batches, average_batch_size, batch_fill_ratio * 100, num_dropped());
+
+        for (int i = 0; i < NUM_METRIC_STAGES; ++i)
+        {
+            if (stages[i].count == 0)
+                continue;
+            output += iLogger::format("\n  %-14s %s", metric_stage_name((MetricStage)i), stages[i].to_string().c_str());
+        }
+        return output;
+    }
+
+    Json::Value to_json() const
+    {
+        Json::Value output(Json::objectValue);
+        output["elapsed_ms"] = elapsed_ms;
+        output["num_jobs"] = (Json::Int64)num_jobs;
+        output["num_batches"] = (Json::Int64)num_batches;
+        output["throughput"] = throughput;
+        output["average_batch_size"] = average_batch_size;
+        output["batch_fill_ratio"] = batch_fill_ratio;
+
+        Json::Value stages_json(Json::objectValue);
+        for (int i = 0; i < NUM_METRIC_STAGES; ++i)
+        {
+            auto &item = stages[i];
+            Json::Value stage(Json::objectValue);
+            stage["count"] = (Json::Int64)item.count;
+            stage["mean_ms"] = item.mean_ms;
+            stage["p50_ms"] = item.p50_ms;
+            stage["p90_ms"] = item.p90_ms;
+            stage["p99_ms"] = item.p99_ms;
+            stage["p999_ms"] = item.p999_ms;
+            stage["max_ms"] = item.max_ms;
+            stages_json[metric_stage_name((MetricStage)i)] = stage;
+        }
+        output["stages"] = stages_json;
+
+        Json::Value drops(Json::objectValue);
+        drops["accepted"] = (Json::Int64)admission.accepted;
+        drops["rejected_queue_full"] = (Json::Int64)admission.rejected_queue_full;
+        drops["rejected_no_slot"] = (Json::Int64)admission.rejected_no_slot;
+        drops["failed"] = (Json::Int64)admission.failed;
+        drops["dropped_expired"] = (Json::Int64)admission.dropped_expired;
+        drops["dropped_superseded"] = (Json::Int64)admission.dropped_superseded;
+        drops["cancelled_before_inference"] = (Json::Int64)cancellation.cancelled_before_inference;
+        drops["expired_before_inference"] = (Json::Int64)cancellation.expired_before_inference;
+        drops["cancelled_before_postprocess"] = (Json::Int64)cancellation.cancelled_before_postprocess;
+        drops["expired_before_postprocess"] = (Json::Int64)cancellation.expired_before_postprocess;
+        drops["queue_depth"] = (Json::Int64)admission.queue_depth;
+        output["drops"] = drops;
+        return output;
+    }
+};
+
+class InferMetrics
+{
+public:
+    InferMetrics() { reset(); }
+
+    void reset()
+    {
+        for (auto &item : stages_)
+            item.reset();
+
+        num_jobs_ = 0;
+        num_batches_ = 0;
+        batch_capacity_ = 0;
+        begin_us_ = StageStatistics::now_us();
+    }
+
+    void record(MetricStage stage, long long value_us)
+    {
+        stages_[(int)stage].record(value_us);
+    }
+
+    // 只由推理线程调用
+    void record_batch(int batch_size, int max_batch_size)
+    {
+        num_jobs_.fetch_add(batch_size, std::memory_order_relaxed);
+        num_batches_.fetch_add(1, std::memory_order_relaxed);
+        batch_capacity_.fetch_add(max_batch_size, std::memory_order_relaxed);
+    }
+
+    InferMetricsSnapshot snapshot() const
+    {
+        InferMetricsSnapshot output;
+        output.elapsed_ms = (StageStatistics::now_us() - begin_us_) / 1000.0;
+        output.num_jobs = num_jobs_;
+        output.num_batches = num_batches_;
+
+        long long capacity = batch_capacity_;
+        if (output.elapsed_ms > 0)
+            output.throughput = output.num_jobs / (output.elapsed_ms / 1000.0);
+
+        if (output.num_batches > 0)
+            output.average_batch_size = output.num_jobs / (double)output.num_batches;
+
+        if (capacity > 0)
+            output.batch_fill_ratio = output.num_jobs / (double)capacity;
+
+        for (int i = 0; i < NUM_METRIC_STAGES; ++i)
+        {
+            std::unique_ptr<LatencyHistogram> merged(new LatencyHistogram());
+            stages_[i].merge_to(*merged);
+            output.stages[i] = merged->summary();
+        }
+        return output;
+    }
+
+private:
+    ShardedLatencyHistogram stages_[NUM_METRIC_STAGES];
+    std::atomic<long long> num_jobs_;
+    std::atomic<long long> num_batches_;
+    std::atomic<long long> batch_capacity_;
+    std::atomic<long long> begin_us_;
+};
+
+#endif // INFER_METRICS_HPP
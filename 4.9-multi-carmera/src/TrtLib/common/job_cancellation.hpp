@@ -0,0 +1,136 @@
+/**
+ * job的取消与截止时间
+ * 解决的问题：
+ * job只带有promise，http客户端断开、相机帧已经过时之后，引擎仍然会完成推理和后处理，做的都是无用功
+ *
+ * 设计思路：
+ * 1. 提交时可以带一个CancellationToken，调用方在任意线程cancel()，token可以被多个job共享(例如同一个http请求的多张图)
+ * 2. 提交时可以带一个相对的截止时间deadline_ms，超过截止时间的结果不再有意义
+ * 3. 在两个位置检查：凑batch时(跳过推理与后处理)，以及后处理之前(跳过后处理)
+ *    被跳过的job立即释放tensor，结果为空
+ * 4. 用对应阶段的平均耗时估算节省下来的工作量
+ * 5. 被跳过、被拒绝的job与没有检测到目标的job结果都为空，需要区分时提交时带一个JobOutcome
+ **/
+
+#ifndef JOB_CANCELLATION_HPP
+#define JOB_CANCELLATION_HPP
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include "ilogger.hpp"
+
+class CancellationToken
+{
+public:
+    static std::shared_ptr<CancellationToken> create() { return std::make_shared<CancellationToken>(); }
+
+    void cancel() { cancelled_.store(true, std::memory_order_release); }
+    bool cancelled() const { return cancelled_.load(std::memory_order_acquire); }
+
+private:
+    std::atomic<bool> cancelled_{false};
+};
+
+/* job的最终状态，在结果可用(future就绪或者回调)之前写入
+   拒绝、丢弃(排队超时、被更新的帧替代)、取消、超过截止时间、预处理失败、引擎停止时为rejected
+   被多个job共享时(例如commits)，任意一个被拒绝即为rejected，不会再被completed覆盖
+*/
+class JobOutcome
+{
+public:
+    static std::shared_ptr<JobOutcome> create() { return std::make_shared<JobOutcome>(); }
+
+    void set(bool rejected)
+    {
+        if (rejected)
+        {
+            state_.store(Rejected, std::memory_order_release);
+            return;
+        }
+
+        int expected = Pending;
+        state_.compare_exchange_strong(expected, Completed, std::memory_order_acq_rel);
+    }
+    bool done() const { return state_.load(std::memory_order_acquire) != Pending; }
+    bool rejected() const { return state_.load(std::memory_order_acquire) == Rejected; }
+
+private:
+    enum State : int
+    {
+        Pending = 0,
+        Completed = 1,
+        Rejected = 2
+    };
+    std::atomic<int> state_{Pending};
+};
+
+struct CancellationReport
+{
+    long long cancelled_before_inference = 0;
+    long long expired_before_inference = 0;  // 超过deadline_ms
+    long long cancelled_before_postprocess = 0;
+    long long expired_before_postprocess = 0;
+    double saved_inference_ms = 0;   // 按推理阶段每个job的平均耗时估算
+    double saved_postprocess_ms = 0; // 按后处理阶段每个job的平均耗时估算
+
+    long long skipped_inference() const { return cancelled_before_inference + expired_before_inference; }
+    long long skipped_postprocess() const { return skipped_inference() + cancelled_before_postprocess + expired_before_postprocess; }
+
+    std::string to_string() const
+    {
+        return iLogger::format(
+            "before inference={cancelled=%lld, expired=%lld}, before postprocess={cancelled=%lld, expired=%lld}, saved={inference=%.2f ms, postprocess=%.2f ms}",
+            cancelled_before_inference, expired_before_inference, cancelled_before_postprocess, expired_before_postprocess,
+            saved_inference_ms, saved_postprocess_ms);
+    }
+};
+
+// 计数器，无锁
+class CancellationStatistics
+{
+public:
+    enum Stage
+    {
+        BeforeInference = 0,
+        BeforePostprocess = 1
+    };
+
+    CancellationStatistics() { reset(); }
+
+    void reset()
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            cancelled_[i] = 0;
+            expired_[i] = 0;
+        }
+    }
+
+    void record(Stage stage, bool cancelled)
+    {
+        if (cancelled)
+            cancelled_[stage]++;
+        else
+            expired_[stage]++;
+    }
+
+    // average_*_ms为对应阶段每个job的平均耗时
+    CancellationReport report(double average_inference_ms, double average_postprocess_ms) const
+    {
+        CancellationReport output;
+        output.cancelled_before_inference = cancelled_[BeforeInference];
+        output.expired_before_inference = expired_[BeforeInference];
+        output.cancelled_before_postprocess = cancelled_[BeforePostprocess];
+        output.expired_before_postprocess = expired_[BeforePostprocess];
+        output.saved_inference_ms = output.skipped_inference() * average_inference_ms;
+        output.saved_postprocess_ms = output.skipped_postprocess() * average_postprocess_ms;
+        return output;
+    }
+
+private:
+    std::atomic<long long> cancelled_[2];
+    std::atomic<long long> expired_[2];
+};
+
+#endif // JOB_CANCELLATION_HPP
@@ -0,0 +1,297 @@
+/**
+ * 优先级与租户间的加权公平调度
+ * 解决的问题：
+ * 同一个引擎同时服务实时相机流和http批量上传，单一FIFO下一次500张的commits会让实时帧排队数秒
+ *
+ * 设计思路：
+ * 1. 每个job带有优先级(JobPriority)和租户(tenant，例如相机id、http客户端)
+ * 2. 不同优先级之间严格优先：每次凑batch都先从高优先级取，高优先级不足一个batch时用低优先级补齐
+ *    抢占发生在batch边界，已经在推理的batch不会被打断
+ * 3. 同一优先级内，租户之间按权重做deficit round robin，权重为2的租户获得两倍的份额
+ *
+ * JobScheduler只由推理线程访问，不加锁；生产者仍然通过无锁的MPMCQueue提交，由推理线程搬运到这里
+ **/
+
+#ifndef JOB_SCHEDULER_HPP
+#define JOB_SCHEDULER_HPP
+
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <unordered_map>
+#include "latency_histogram.hpp"
+#include "job_cancellation.hpp"
+
+enum class JobPriority : int
+{
+    Realtime = 0,    // 实时相机流，延迟敏感
+    Interactive = 1, // 单张的http请求，默认
+    Bulk = 2         // 批量任务，使用剩余的算力
+};
+
+static const int NUM_JOB_PRIORITY = 3;
+
+inline const char *job_priority_name(JobPriority priority)
+{
+    switch (priority)
+    {
+    case JobPriority::Realtime:
+        return "realtime";
+    case JobPriority::Interactive:
+        return "interactive";
+    case JobPriority::Bulk:
+        return "bulk";
+    default:
+        return "unknow";
+    }
+}
+
+struct JobOptions
+{
+    JobPriority priority = JobPriority::Interactive;
+    int tenant = 0;
+    bool latest_only = false; // 流式数据源，同一租户只保留最新的一帧，见admission_control.hpp
+    int deadline_ms = 0;      // 相对commit的截止时间，超过后跳过推理或后处理，0表示不限制，见job_cancellation.hpp
+    std::shared_ptr<CancellationToken> cancel_token;
+    std::shared_ptr<JobOutcome> outcome; // 区分空结果与被拒绝的job，见job_cancellation.hpp
+
+    static JobOptions realtime(int tenant = 0)
+    {
+        JobOptions options;
+        options.priority = JobPriority::Realtime;
+        options.tenant = tenant;
+        return options;
+    }
+
+    // 实时相机流：最高优先级，来不及处理的旧帧直接丢弃
+    static JobOptions stream(int tenant)
+    {
+        JobOptions options = realtime(tenant);
+        options.latest_only = true;
+        return options;
+    }
+
+    static JobOptions bulk(int tenant = 0)
+    {
+        JobOptions options;
+        options.priority = JobPriority::Bulk;
+        options.tenant = tenant;
+        return options;
+    }
+};
+
+struct PriorityClassReport
+{
+    JobPriority priority = JobPriority::Interactive;
+    long long num_pending = 0;
+    LatencySummary queue_wait; // 入队到进入batch
+    LatencySummary latency;    // commit到结果可用
+
+    std::string to_string() const
+    {
+        return iLogger::format(
+            "%s[pending=%lld, queue wait {%s}, latency {%s}]",
+            job_priority_name(priority), num_pending, queue_wait.to_string().c_str(), latency.to_string().c_str());
+    }
+};
+
+struct SchedulingReport
+{
+    std::vector<PriorityClassReport> classes;
+
+    std::string to_string() const
+    {
+        std::string output;
+        for (auto &item : classes)
+        {
+            if (item.num_pending == 0 && item.latency.count == 0)
+                continue;
+            output += (output.empty() ? "" : ", ") + item.to_string();
+        }
+        return output;
+    }
+};
+
+template <class _JobType>
+class JobScheduler
+{
+public:
+    /* latest_only的job会替代同一租户尚未取出的latest_only的job，被替代的job移到superseded中
+     */
+    void push(_JobType &&job, std::vector<_JobType> &superseded)
+    {
+        auto &klass = classes_[priority_index(job.priority)];
+        auto &tenant = klass.tenants[job.tenant];
+        bool is_active = !tenant.jobs.empty();
+        if (job.latest_only && is_active)
+        {
+            for (auto iter = tenant.jobs.begin(); iter != tenant.jobs.end();)
+            {
+                if (!iter->latest_only)
+                {
+                    ++iter;
+                    continue;
+                }
+                superseded.emplace_back(std::move(*iter));
+                iter = tenant.jobs.erase(iter);
+                size_--;
+            }
+        }
+
+        if (!is_active)
+        {
+            tenant.deficit = 0;
+            klass.active.push_back(job.tenant);
+        }
+        tenant.jobs.emplace_back(std::move(job));
+        size_++;
+    }
+
+    // 按优先级和权重取出最多max_size个job，追加到output
+    void pop_batch(std::vector<_JobType> &output, int max_size)
+    {
+        for (auto &klass : classes_)
+        {
+            while ((int)output.size() < max_size && !klass.active.empty())
+                output.emplace_back(pop_one(klass));
+        }
+    }
+
+    // 取出全部job，用于stop
+    void pop_all(std::vector<_JobType> &output)
+    {
+        pop_batch(output, output.size() + size_);
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    size_t size(JobPriority priority) const
+    {
+        size_t output = 0;
+        for (auto &item : classes_[priority_index(priority)].tenants)
+            output += item.second.jobs.size();
+        return output;
+    }
+
+    // 所有等待中的job里最早的入队时间，用于动态批处理的deadline
+    std::chrono::steady_clock::time_point oldest_enqueue_time() const
+    {
+        auto output = std::chrono::steady_clock::time_point::max();
+        for (auto &klass : classes_)
+        {
+            for (int tenant : klass.active)
+            {
+                auto &jobs = klass.tenants.at(tenant).jobs;
+                if (!jobs.empty())
+                    output = std::min(output, jobs.front().enqueue_time);
+            }
+        }
+        return output;
+    }
+
+    // 租户权重，默认为1，可以在任意线程调用
+    void set_tenant_weight(int tenant, int weight)
+    {
+        std::unique_lock<std::mutex> l(weights_lock_);
+        weights_[tenant] = std::max(1, weight);
+    }
+
+private:
+    /* 接口与deque相同的队列，[head_, items_.size())为等待中的job
+       job较大时deque每个元素单独分配一个块，这里取空后clear保留容量，稳态下入队不分配内存
+    */
+    class JobList
+    {
+    public:
+        typedef typename std::vector<_JobType>::iterator iterator;
+
+        bool empty() const { return head_ == items_.size(); }
+        size_t size() const { return items_.size() - head_; }
+        _JobType &front() { return items_[head_]; }
+        const _JobType &front() const { return items_[head_]; }
+        iterator begin() { return items_.begin() + head_; }
+        iterator end() { return items_.end(); }
+        iterator erase(iterator iter) { return items_.erase(iter); }
+        void emplace_back(_JobType &&job) { items_.emplace_back(std::move(job)); }
+
+        void pop_front()
+        {
+            if (++head_ == items_.size())
+            {
+                items_.clear();
+                head_ = 0;
+            }
+            else if (head_ >= 64 && head_ * 2 >= items_.size())
+            {
+                // 一直没有取空时，定期把已经取出的部分移除
+                items_.erase(items_.begin(), items_.begin() + head_);
+                head_ = 0;
+            }
+        }
+
+    private:
+        std::vector<_JobType> items_;
+        size_t head_ = 0;
+    };
+
+    struct TenantQueue
+    {
+        JobList jobs;
+        int deficit = 0;
+    };
+
+    struct PriorityClass
+    {
+        std::unordered_map<int, TenantQueue> tenants;
+        std::deque<int> active; // 有job的租户，轮转顺序
+    };
+
+    static int priority_index(JobPriority priority)
+    {
+        return std::min(std::max((int)priority, 0), NUM_JOB_PRIORITY - 1);
+    }
+
+    int tenant_weight(int tenant)
+    {
+        std::unique_lock<std::mutex> l(weights_lock_);
+        auto iter = weights_.find(tenant);
+        return iter == weights_.end() ? 1 : iter->second;
+    }
+
+    // deficit round robin：轮到的租户获得等于权重的额度，每取一个job消耗1
+    _JobType pop_one(PriorityClass &klass)
+    {
+        int tenant_id = klass.active.front();
+        auto &tenant = klass.tenants[tenant_id];
+        if (tenant.deficit <= 0)
+            tenant.deficit += tenant_weight(tenant_id);
+
+        _JobType job = std::move(tenant.jobs.front());
+        tenant.jobs.pop_front();
+        tenant.deficit--;
+        size_--;
+
+        if (tenant.jobs.empty())
+        {
+            tenant.deficit = 0;
+            klass.active.pop_front();
+        }
+        else if (tenant.deficit <= 0)
+        {
+            klass.active.pop_front();
+            klass.active.push_back(tenant_id);
+        }
+        return job;
+    }
+
+private:
+    PriorityClass classes_[NUM_JOB_PRIORITY];
+    size_t size_ = 0;
+    std::mutex weights_lock_;
+    std::unordered_map<int, int> weights_;
+};
+
+#endif // JOB_SCHEDULER_HPP
@@ -0,0 +1,149 @@
+/**
+ * 延迟直方图
+ * 以微秒为单位记录，小于16us的值精确记录，之后每个2的幂区间再均分为8个子桶，相对误差不超过12.5%
+ * 桶计数使用原子变量，多个线程可以同时record，无需加锁
+ **/
+
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <atomic>
+#include <string>
+#include <algorithm>
+#include "ilogger.hpp"
+
+struct LatencySummary
+{
+    long long count = 0;
+    double mean_ms = 0;
+    double p50_ms = 0;
+    double p90_ms = 0;
+    double p99_ms = 0;
+    double p999_ms = 0;
+    double max_ms = 0;
+
+    std::string to_string() const
+    {
+        return iLogger::format(
+            "n=%lld, mean=%.3f ms, p50=%.3f ms, p90=%.3f ms, p99=%.3f ms, p999=%.3f ms, max=%.3f ms",
+            count, mean_ms, p50_ms, p90_ms, p99_ms, p999_ms, max_ms);
+    }
+};
+
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() { reset(); }
+
+    void reset()
+    {
+        for (auto &bucket : buckets_)
+            bucket.store(0, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+        sum_us_.store(0, std::memory_order_relaxed);
+        max_us_.store(0, std::memory_order_relaxed);
+    }
+
+    void record(long long value_us)
+    {
+        value_us = std::max(0LL, value_us);
+        buckets_[bucket_index(value_us)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_us_.fetch_add(value_us, std::memory_order_relaxed);
+
+        long long current = max_us_.load(std::memory_order_relaxed);
+        while (value_us > current && !max_us_.compare_exchange_weak(current, value_us, std::memory_order_relaxed))
+            ;
+    }
+
+    void merge(const LatencyHistogram &other)
+    {
+        for (int i = 0; i < NUM_BUCKETS; ++i)
+            buckets_[i].fetch_add(other.buckets_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+        count_.fetch_add(other.count_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        sum_us_.fetch_add(other.sum_us_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+        long long value_us = other.max_us_.load(std::memory_order_relaxed);
+        long long current = max_us_.load(std::memory_order_relaxed);
+        while (value_us > current && !max_us_.compare_exchange_weak(current, value_us, std::memory_order_relaxed))
+            ;
+    }
+
+    long long count() const { return count_.load(std::memory_order_relaxed); }
+    long long max_us() const { return max_us_.load(std::memory_order_relaxed); }
+
+    double mean_us() const
+    {
+        long long n = count();
+        return n > 0 ? sum_us_.load(std::memory_order_relaxed) / (double)n : 0;
+    }
+
+    // 返回分位数所在桶的中点，不超过观测到的最大值
+    double percentile_us(double p) const
+    {
+        long long n = count();
+        if (n == 0)
+            return 0;
+
+        long long target = std::max(1LL, (long long)(p * n + 0.5));
+        long long accum = 0;
+        for (int i = 0; i < NUM_BUCKETS; ++i)
+        {
+            accum += buckets_[i].load(std::memory_order_relaxed);
+            if (accum >= target)
+                return std::min((bucket_lower(i) + bucket_lower(i + 1)) * 0.5, (double)max_us());
+        }
+        return max_us();
+    }
+
+    LatencySummary summary() const
+    {
+        LatencySummary output;
+        output.count = count();
+        output.mean_ms = mean_us() / 1000.0;
+        output.p50_ms = percentile_us(0.5) / 1000.0;
+        output.p90_ms = percentile_us(0.9) / 1000.0;
+        output.p99_ms = percentile_us(0.99) / 1000.0;
+        output.p999_ms = percentile_us(0.999) / 1000.0;
+        output.max_ms = max_us() / 1000.0;
+        return output;
+    }
+
+private:
+    static const int LINEAR_BUCKETS = 16;
+    static const int SUB_BUCKET_BITS = 3;
+    static const int MAX_EXPONENT = 40;
+    static const int NUM_BUCKETS = LINEAR_BUCKETS + (MAX_EXPONENT - 4) * (1 << SUB_BUCKET_BITS);
+
+    static int bucket_index(long long value)
+    {
+        if (value < LINEAR_BUCKETS)
+            return (int)value;
+
+        int exponent = 63 - __builtin_clzll((unsigned long long)value);
+        if (exponent >= MAX_EXPONENT)
+            return NUM_BUCKETS - 1;
+
+        int sub = (int)(value >> (exponent - SUB_BUCKET_BITS)) & ((1 << SUB_BUCKET_BITS) - 1);
+        return LINEAR_BUCKETS + (exponent - 4) * (1 << SUB_BUCKET_BITS) + sub;
+    }
+
+    static double bucket_lower(int index)
+    {
+        if (index < LINEAR_BUCKETS)
+            return index;
+
+        int exponent = (index - LINEAR_BUCKETS) / (1 << SUB_BUCKET_BITS) + 4;
+        int sub = (index - LINEAR_BUCKETS) % (1 << SUB_BUCKET_BITS);
+        return (double)(1LL << exponent) * (1.0 + sub / (double)(1 << SUB_BUCKET_BITS));
+    }
+
+private:
+    std::atomic<long long> buckets_[NUM_BUCKETS];
+    std::atomic<long long> count_;
+    std::atomic<long long> sum_us_;
+    std::atomic<long long> max_us_;
+};
+
+#endif // LATENCY_HISTOGRAM_HPP
@@ -24,15 +24,26 @@
  * 而引擎推理时，每次拿1个batch的数据进行推理
  * 当引擎推理速度慢而预处理速度快时，输入图像势必需要进行等候。否则缓存队列会越来越大
  * 而这里提到的几个点就是设计的主要目标
+ *
+ * 实现上：
+ * 1. 空闲的座位放在无锁的MPMCQueue中作为free list，query/release都是O(1)，快路径上不加锁
+ * 2. 弹性模式(max_size > size)：没有空闲座位并且等待超过grow_wait_ms时临时加座位，直到max_size
+ *    这样http突发超过2倍batch时预处理不会卡在query的超时上
+ * 3. 每隔shrink_idle_ms检查一次这段时间内同时占用的峰值，撤掉用不到的空闲座位（最少保留size个）
+ *    座位上的tensor随之析构，负载下降后pinned memory还给系统
  **/
 
 #ifndef MONOPOLY_ALLOCATOR_HPP
 #define MONOPOLY_ALLOCATOR_HPP
 
 #include <condition_variable>
+#include <algorithm>
 #include <vector>
 #include <mutex>
 #include <memory>
+#include <atomic>
+#include <chrono>
+#include "mpmc_queue.hpp"
 
 template <class _ItemType>
 class MonopolyAllocator
@@ -42,7 +53,7 @@ public:
        允许query获取的item执行item->release释放自身所有权，该对象可以被复用
        通过item->data()获取储存的对象的指针
     */
-    class MonopolyData
+    class MonopolyData : public std::enable_shared_from_this<MonopolyData>
     {
     public:
         std::shared_ptr<_ItemType> &data() { return data_; }
@@ -55,24 +66,33 @@ public:
         friend class MonopolyAllocator;
         MonopolyAllocator *manager_ = nullptr;
         std::shared_ptr<_ItemType> data_;
-        bool available_ = true;
+        std::atomic<bool> available_{true};
     };
     typedef std::shared_ptr<MonopolyData> MonopolyDataPointer;
 
-    MonopolyAllocator(int size)
+    /* size：常驻的数量
+       max_size：弹性模式下的上限，<= size时为固定容量，与原来的行为一致
+       grow_wait_ms：没有空闲对象时，等待多久后开始扩容
+       shrink_idle_ms：收缩检查的周期
+    */
+    MonopolyAllocator(int size, int max_size = 0, int grow_wait_ms = 2, int shrink_idle_ms = 5000)
+        : free_list_(std::max(size, max_size))
     {
+        min_capacity_ = size;
+        max_capacity_ = std::max(size, max_size);
+        grow_wait_ms_ = grow_wait_ms;
+        shrink_idle_ms_ = shrink_idle_ms;
+        last_shrink_check_ = now_ms();
         capacity_ = size;
-        num_available_ = size;
-        datas_.resize(size);
 
         for (int i = 0; i < size; ++i)
-            datas_[i] = std::shared_ptr<MonopolyData>(new MonopolyData(this));
+            free_list_.try_push(new_one());
     }
 
     virtual ~MonopolyAllocator()
     {
         run_ = false;
-        cv_.notify_all();
+        free_list_.close();
 
         std::unique_lock<std::mutex> l(lock_);
         cv_exit_.wait(l, [&]()
@@ -85,39 +105,41 @@ public:
     */
     MonopolyDataPointer query(int timeout = 10000)
     {
-
-        std::unique_lock<std::mutex> l(lock_);
         if (!run_)
             return nullptr;
 
-        if (num_available_ == 0)
+        MonopolyData *item = nullptr;
+        if (!free_list_.try_pop(item))
         {
-            num_wait_thread_++;
+            {
+                std::unique_lock<std::mutex> l(lock_);
+                num_wait_thread_++;
+            };
 
-            auto state = cv_.wait_for(l, std::chrono::milliseconds(timeout), [&]()
-                                      { return num_available_ > 0 || !run_; });
+            item = wait_or_grow(timeout);
 
-            num_wait_thread_--;
-            cv_exit_.notify_one();
+            {
+                std::unique_lock<std::mutex> l(lock_);
+                num_wait_thread_--;
+                cv_exit_.notify_one();
+            };
 
             // timeout, no available, exit program
-            if (!state || num_available_ == 0 || !run_)
+            if (item == nullptr || !run_)
                 return nullptr;
         }
 
-        auto item = std::find_if(datas_.begin(), datas_.end(), [](MonopolyDataPointer &item)
-                                 { return item->available_; });
-        if (item == datas_.end())
-            return nullptr;
-
-        (*item)->available_ = false;
-        num_available_--;
-        return *item;
+        item->available_ = false;
+        int in_use = ++num_in_use_;
+        int peak = peak_in_use_;
+        while (in_use > peak && !peak_in_use_.compare_exchange_weak(peak, in_use))
+            ;
+        return item->shared_from_this();
     }
 
     int num_available()
     {
-        return num_available_;
+        return free_list_.size();
     }
 
     int capacity()
@@ -125,27 +147,109 @@ public:
         return capacity_;
     }
 
+    int max_capacity()
+    {
+        return max_capacity_;
+    }
+
+    bool elastic()
+    {
+        return max_capacity_ > min_capacity_;
+    }
+
 private:
-    void release_one(MonopolyData *prq)
+    MonopolyData *new_one()
     {
         std::unique_lock<std::mutex> l(lock_);
-        if (!prq->available_)
+        datas_.emplace_back(new MonopolyData(this));
+        return datas_.back().get();
+    }
+
+    MonopolyData *wait_or_grow(int timeout)
+    {
+        MonopolyData *item = nullptr;
+        if (elastic())
         {
-            prq->available_ = true;
-            num_available_++;
-            cv_.notify_one();
+            if (free_list_.pop_wait(item, std::min(timeout, grow_wait_ms_) * 1000LL))
+                return item;
+
+            if (!run_)
+                return nullptr;
+
+            // 持续等不到空闲对象，扩容
+            int capacity = capacity_;
+            while (capacity < max_capacity_)
+            {
+                if (capacity_.compare_exchange_weak(capacity, capacity + 1))
+                    return new_one();
+            }
+            timeout = std::max(0, timeout - grow_wait_ms_);
         }
+
+        if (free_list_.pop_wait(item, timeout * 1000LL))
+            return item;
+        return nullptr;
+    }
+
+    void release_one(MonopolyData *prq)
+    {
+        bool expected = false;
+        if (!prq->available_.compare_exchange_strong(expected, true))
+            return;
+
+        num_in_use_--;
+        free_list_.try_push(prq);
+
+        if (elastic())
+            try_shrink();
+    }
+
+    // shrink_idle_ms周期内的占用峰值以外的空闲对象被销毁
+    void try_shrink()
+    {
+        long long now = now_ms();
+        if (now - last_shrink_check_ < shrink_idle_ms_)
+            return;
+
+        std::unique_lock<std::mutex> l(lock_, std::try_to_lock);
+        if (!l.owns_lock() || now - last_shrink_check_ < shrink_idle_ms_)
+            return;
+
+        last_shrink_check_ = now;
+        int target = std::max(min_capacity_, peak_in_use_.load());
+        peak_in_use_ = num_in_use_.load();
+
+        MonopolyData *item = nullptr;
+        while (capacity_ > target && free_list_.try_pop(item))
+        {
+            capacity_--;
+            auto iter = std::find_if(datas_.begin(), datas_.end(), [&](MonopolyDataPointer &data)
+                                     { return data.get() == item; });
+            if (iter != datas_.end())
+                datas_.erase(iter);
+        }
+    }
+
+    static long long now_ms()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
     }
 
 private:
     std::mutex lock_;
-    std::condition_variable cv_;
     std::condition_variable cv_exit_;
     std::vector<MonopolyDataPointer> datas_;
-    int capacity_ = 0;
-    volatile int num_available_ = 0;
-    volatile int num_wait_thread_ = 0;
-    volatile bool run_ = true;
+    MPMCQueue<MonopolyData *> free_list_;
+    std::atomic<int> capacity_{0};
+    std::atomic<int> num_in_use_{0};
+    std::atomic<int> peak_in_use_{0};
+    std::atomic<long long> last_shrink_check_{0};
+    int num_wait_thread_ = 0;
+    std::atomic<bool> run_{true};
+    int min_capacity_ = 0;
+    int max_capacity_ = 0;
+    int grow_wait_ms_ = 0;
+    int shrink_idle_ms_ = 0;
 };
 
 #endif // MONOPOLY_ALLOCATOR_HPP
\ No newline at end of file
@@ -0,0 +1,395 @@
+/**
+ * 有界无锁多生产者多消费者队列
+ * 解决的问题：
+ * InferController和HttpServerImpl的job都经过同一个mutex保护的std::queue，多路相机、多个http线程下这把锁成为热点
+ *
+ * 设计思路：
+ * 1. 环形缓冲区，每个格子带一个序号(sequence)，参考Dmitry Vyukov的bounded mpmc queue
+ *    生产者和消费者各自用CAS推进enqueue_pos_/dequeue_pos_，入队出队不需要锁
+ * 2. 阻塞等待使用EventCount：等待方先登记(prepare_wait)，再次检查条件，条件仍不满足才真正睡眠(commit_wait)
+ *    通知方只有在存在尚未被唤醒的等待者时才进行系统调用，Linux下直接使用futex，其他平台退化为mutex+condition_variable
+ * 3. close()之后push失败，pop_wait在队列取空后返回false，用于程序退出
+ **/
+
+#ifndef MPMC_QUEUE_HPP
+#define MPMC_QUEUE_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include "ilogger.hpp"
+
+#ifdef U_OS_LINUX
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+/* 等待者与通知者之间的EventCount
+   state_低16位为已登记的等待者数量，高16位为已发出但尚未被领取的唤醒数量
+   notify_one只在 唤醒数 < 等待者数 时才发出唤醒，避免生产者在消费者尚未被调度时反复进行futex系统调用
+*/
+class EventCount
+{
+public:
+    // 登记为等待者，之后必须调用commit_wait或cancel_wait之一
+    void prepare_wait()
+    {
+        state_.fetch_add(WAITER, std::memory_order_seq_cst);
+    }
+
+    // 等待者二次检查时条件已满足，放弃等待。如果有发给等待者的唤醒，一并领取，由本线程去处理对应的数据
+    void cancel_wait()
+    {
+        uint32_t state = state_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            uint32_t next = state - WAITER;
+            if (signals(state) > 0 && signals(state) >= waiters(state))
+                next -= SIGNAL;
+
+            if (state_.compare_exchange_weak(state, next, std::memory_order_seq_cst))
+                return;
+        }
+    }
+
+    // 睡眠直到领取到一个唤醒，timeout_us < 0表示一直等待，返回false表示超时
+    bool commit_wait(long long timeout_us = -1)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(std::max(0LL, timeout_us));
+        for (;;)
+        {
+            uint32_t key = epoch_.load(std::memory_order_seq_cst);
+            uint32_t state = state_.load(std::memory_order_seq_cst);
+            while (signals(state) > 0)
+            {
+                if (state_.compare_exchange_weak(state, state - WAITER - SIGNAL, std::memory_order_seq_cst))
+                    return true;
+            }
+
+            long long remain_us = -1;
+            if (timeout_us >= 0)
+            {
+                remain_us = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+                if (remain_us <= 0)
+                {
+                    cancel_wait();
+                    return false;
+                }
+            }
+            sleep(key, remain_us);
+        }
+    }
+
+    void notify_one()
+    {
+        // 与prepare_wait配对：要么这里看到等待者，要么等待者在睡眠前的二次检查中看到新状态
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t state = state_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            if (signals(state) >= waiters(state))
+                return;
+
+            if (state_.compare_exchange_weak(state, state + SIGNAL, std::memory_order_seq_cst))
+                break;
+        }
+        wake(false);
+    }
+
+    void notify_all()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t state = state_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            if (signals(state) >= waiters(state))
+                return;
+
+            uint32_t next = waiters(state) | (waiters(state) << 16);
+            if (state_.compare_exchange_weak(state, next, std::memory_order_seq_cst))
+                break;
+        }
+        wake(true);
+    }
+
+private:
+    static const uint32_t WAITER = 1;
+    static const uint32_t SIGNAL = 1 << 16;
+    static uint32_t waiters(uint32_t state) { return state & 0xFFFF; }
+    static uint32_t signals(uint32_t state) { return state >> 16; }
+
+    void wake(bool all)
+    {
+        epoch_.fetch_add(1, std::memory_order_seq_cst);
+#ifdef U_OS_LINUX
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&epoch_), FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1, nullptr, nullptr, 0);
+#else
+        std::unique_lock<std::mutex> l(lock_);
+        if (all)
+            cv_.notify_all();
+        else
+            cv_.notify_one();
+#endif
+    }
+
+    // epoch_在key之后发生过变化则立即返回
+    void sleep(uint32_t key, long long timeout_us)
+    {
+#ifdef U_OS_LINUX
+        struct timespec ts;
+        struct timespec *pts = nullptr;
+        if (timeout_us >= 0)
+        {
+            ts.tv_sec = timeout_us / 1000000;
+            ts.tv_nsec = (timeout_us % 1000000) * 1000;
+            pts = &ts;
+        }
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&epoch_), FUTEX_WAIT_PRIVATE, key, pts, nullptr, 0);
+#else
+        std::unique_lock<std::mutex> l(lock_);
+        auto changed = [&]()
+        { return epoch_.load(std::memory_order_seq_cst) != key; };
+
+        if (timeout_us < 0)
+            cv_.wait(l, changed);
+        else
+            cv_.wait_for(l, std::chrono::microseconds(timeout_us), changed);
+#endif
+    }
+
+private:
+    std::atomic<uint32_t> state_{0};
+    std::atomic<uint32_t> epoch_{0};
+
+#ifndef U_OS_LINUX
+    std::mutex lock_;
+    std::condition_variable cv_;
+#endif
+};
+
+template <class _ItemType>
+class MPMCQueue
+{
+public:
+    // capacity会向上取整为2的幂
+    explicit MPMCQueue(size_t capacity = 1024)
+    {
+        reset(capacity);
+    }
+
+    // 重新分配容量并清空，要求此时没有其他线程在使用队列
+    void reset(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+
+        mask_ = size - 1;
+        cells_.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+
+        enqueue_pos_.store(0, std::memory_order_relaxed);
+        dequeue_pos_.store(0, std::memory_order_relaxed);
+        closed_.store(false, std::memory_order_release);
+    }
+
+    MPMCQueue(const MPMCQueue &) = delete;
+    MPMCQueue &operator=(const MPMCQueue &) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // 近似值，并发时仅用于统计
+    size_t size() const
+    {
+        size_t enqueue = enqueue_pos_.load(std::memory_order_relaxed);
+        size_t dequeue = dequeue_pos_.load(std::memory_order_relaxed);
+        return enqueue > dequeue ? enqueue - dequeue : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+    bool try_push(_ItemType &&item)
+    {
+        Cell *cell = nullptr;
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0)
+            {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                // full
+                return false;
+            }
+            else
+            {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = std::move(item);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        not_empty_.notify_one();
+        return true;
+    }
+
+    bool try_push(const _ItemType &item)
+    {
+        _ItemType copy(item);
+        return try_push(std::move(copy));
+    }
+
+    bool try_pop(_ItemType &item)
+    {
+        Cell *cell = nullptr;
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                // empty
+                return false;
+            }
+            else
+            {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        item = std::move(cell->data);
+        cell->data = _ItemType();
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        not_full_.notify_one();
+        return true;
+    }
+
+    // 队列满时阻塞，直到有空位或者队列被关闭，关闭后返回false
+    bool push(_ItemType &&item)
+    {
+        for (;;)
+        {
+            if (closed())
+                return false;
+
+            if (try_push(std::move(item)))
+                return true;
+
+            not_full_.prepare_wait();
+            if (closed() || size() < capacity())
+            {
+                not_full_.cancel_wait();
+                continue;
+            }
+            not_full_.commit_wait();
+        }
+    }
+
+    bool push(const _ItemType &item)
+    {
+        _ItemType copy(item);
+        return push(std::move(copy));
+    }
+
+    /* 队列空时阻塞等待，timeout_us < 0表示一直等待
+       返回false表示超时，或者队列已关闭且为空
+    */
+    bool pop_wait(_ItemType &item, long long timeout_us = -1)
+    {
+        if (try_pop(item))
+            return true;
+
+        std::chrono::steady_clock::time_point deadline;
+        if (timeout_us >= 0)
+            deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+
+        for (;;)
+        {
+            if (try_pop(item))
+                return true;
+
+            if (closed())
+                return false;
+
+            long long remain_us = -1;
+            if (timeout_us >= 0)
+            {
+                remain_us = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+                if (remain_us <= 0)
+                    return false;
+            }
+
+            not_empty_.prepare_wait();
+            if (!empty() || closed())
+            {
+                not_empty_.cancel_wait();
+                continue;
+            }
+            not_empty_.commit_wait(remain_us);
+        }
+    }
+
+    bool pop_wait_until(_ItemType &item, std::chrono::steady_clock::time_point deadline)
+    {
+        auto remain_us = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+        return pop_wait(item, std::max(0LL, (long long)remain_us));
+    }
+
+    // 唤醒所有等待者，之后push返回false，pop_wait把剩余的元素取完后返回false
+    void close()
+    {
+        closed_.store(true, std::memory_order_release);
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+    // 重新打开，用于startup/stop循环使用
+    void reopen()
+    {
+        closed_.store(false, std::memory_order_release);
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        _ItemType data;
+    };
+
+    // 填充到不同的cache line，避免生产者与消费者伪共享
+    char pad0_[64];
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+    char pad1_[64];
+    std::atomic<size_t> enqueue_pos_{0};
+    char pad2_[64];
+    std::atomic<size_t> dequeue_pos_{0};
+    char pad3_[64];
+    std::atomic<bool> closed_{false};
+    EventCount not_empty_;
+    EventCount not_full_;
+};
+
+#endif // MPMC_QUEUE_HPP
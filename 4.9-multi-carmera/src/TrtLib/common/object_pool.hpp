@@ -0,0 +1,137 @@
+/**
+ * 可回收的对象池
+ * 解决的问题：
+ * 每次commit都make_shared一个promise，promise内部再分配共享状态；每个结果都新建一个vector<Box>
+ * 多路相机每秒数千帧时，这些小块内存的分配释放在malloc上产生明显的争用
+ *
+ * 设计思路：
+ * 1. BlockPool：固定大小内存块的空闲链表，使用无锁的MPMCQueue保存，取空时退化为operator new，放满时直接释放
+ *    每种块大小一个全局实例，有意不析构，保证程序退出时仍在使用的future可以安全归还
+ * 2. PoolAllocator：单个对象从BlockPool分配的allocator，用于allocate_shared和promise(allocator_arg_t, ...)
+ *    promise对象、控制块、共享状态、结果的存储全部来自池中
+ * 3. ObjectPool：保留容量的对象的回收，例如回调完成后把BoxArray清空(保留capacity)放回池中，下一帧直接复用
+ **/
+
+#ifndef OBJECT_POOL_HPP
+#define OBJECT_POOL_HPP
+
+#include <new>
+#include <vector>
+#include <memory>
+#include "mpmc_queue.hpp"
+
+template <size_t BlockSize>
+class BlockPool
+{
+public:
+    static BlockPool &instance()
+    {
+        static BlockPool *pool = new BlockPool();
+        return *pool;
+    }
+
+    void *allocate()
+    {
+        void *block = nullptr;
+        if (blocks_.try_pop(block))
+            return block;
+        return ::operator new(BlockSize);
+    }
+
+    void deallocate(void *block)
+    {
+        if (!blocks_.try_push(block))
+            ::operator delete(block);
+    }
+
+private:
+    BlockPool() : blocks_(4096) {}
+
+    MPMCQueue<void *> blocks_;
+};
+
+// 块大小按64字节对齐，相近大小的类型共用一个池
+constexpr size_t pool_block_size(size_t size)
+{
+    return (size + 63) / 64 * 64;
+}
+
+template <class T>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+
+    template <class U>
+    struct rebind
+    {
+        typedef PoolAllocator<U> other;
+    };
+
+    PoolAllocator() {}
+
+    template <class U>
+    PoolAllocator(const PoolAllocator<U> &) {}
+
+    T *allocate(size_t n)
+    {
+        if (n == 1)
+            return static_cast<T *>(BlockPool<pool_block_size(sizeof(T))>::instance().allocate());
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        if (n == 1)
+            BlockPool<pool_block_size(sizeof(T))>::instance().deallocate(p);
+        else
+            ::operator delete(p);
+    }
+};
+
+template <class T, class U>
+bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &) { return true; }
+
+template <class T, class U>
+bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &) { return false; }
+
+// 放回池之前清空对象，默认重新构造；vector只clear，保留已分配的容量
+template <class T>
+void reset_for_reuse(T &object)
+{
+    object = T();
+}
+
+template <class T, class A>
+void reset_for_reuse(std::vector<T, A> &object)
+{
+    object.clear();
+}
+
+template <class T>
+class ObjectPool
+{
+public:
+    ObjectPool(size_t capacity = 256) : objects_(capacity) {}
+
+    // 池为空时返回默认构造的对象
+    void acquire(T &object)
+    {
+        if (!objects_.try_pop(object))
+            object = T();
+    }
+
+    // 池已满时直接丢弃
+    void release(T &&object)
+    {
+        reset_for_reuse(object);
+        objects_.try_push(std::move(object));
+    }
+
+    size_t size() const { return objects_.size(); }
+
+private:
+    MPMCQueue<T> objects_;
+};
+
+#endif // OBJECT_POOL_HPP
@@ -0,0 +1,133 @@
+/**
+ * 常驻线程上的parallel_for
+ * 解决的问题：
+ * batch内多张图的nms、大输出的解码等CPU计算需要拆到多个核上，每次新建线程的开销比计算本身还大
+ *
+ * 设计思路：
+ * 1. 线程在第一次使用时按需创建，之后常驻，进程退出时回收
+ * 2. 任务编号由原子计数器分发，调用线程也参与执行，全部完成后parallel_for才返回
+ * 3. 同一时刻只执行一组任务，其他调用方拿不到执行权时在自己的线程上依次执行，不会互相等待
+ *    后处理线程池中的多个线程同时调用时不会排队
+ **/
+
+#ifndef PARALLEL_FOR_HPP
+#define PARALLEL_FOR_HPP
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+class ParallelWorkers
+{
+public:
+    static ParallelWorkers &instance()
+    {
+        static ParallelWorkers workers;
+        return workers;
+    }
+
+    ~ParallelWorkers()
+    {
+        {
+            std::unique_lock<std::mutex> l(lock_);
+            running_ = false;
+        }
+        cond_.notify_all();
+        for (auto &t : threads_)
+            t.join();
+    }
+
+    // 执行fn(0) ~ fn(num_tasks - 1)，num_threads包括调用线程，<= 0时使用全部核心
+    void run(int num_tasks, int num_threads, const std::function<void(int)> &fn)
+    {
+        if (num_threads <= 0)
+            num_threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+        std::unique_lock<std::mutex> busy(run_lock_, std::try_to_lock);
+        int num_workers = std::min(num_threads, num_tasks) - 1;
+        if (!busy.owns_lock() || num_workers <= 0)
+        {
+            for (int i = 0; i < num_tasks; ++i)
+                fn(i);
+            return;
+        }
+
+        {
+            std::unique_lock<std::mutex> l(lock_);
+            while ((int)threads_.size() < num_workers)
+                threads_.emplace_back(&ParallelWorkers::worker, this, (int)threads_.size());
+
+            fn_ = &fn;
+            num_tasks_ = num_tasks;
+            next_ = 0;
+            num_participants_ = num_workers;
+            num_active_ = num_workers;
+            generation_++;
+        }
+        cond_.notify_all();
+
+        run_tasks();
+
+        std::unique_lock<std::mutex> l(lock_);
+        done_cond_.wait(l, [&]()
+                        { return num_active_ == 0; });
+        fn_ = nullptr;
+    }
+
+private:
+    ParallelWorkers() = default;
+
+    void run_tasks()
+    {
+        int i;
+        while ((i = next_.fetch_add(1)) < num_tasks_)
+            (*fn_)(i);
+    }
+
+    void worker(int id)
+    {
+        long long seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> l(lock_);
+                cond_.wait(l, [&]()
+                           { return !running_ || (generation_ != seen && id < num_participants_); });
+                if (!running_)
+                    return;
+                seen = generation_;
+            }
+
+            run_tasks();
+
+            std::unique_lock<std::mutex> l(lock_);
+            if (--num_active_ == 0)
+                done_cond_.notify_one();
+        }
+    }
+
+private:
+    std::mutex run_lock_;
+    std::mutex lock_;
+    std::condition_variable cond_;
+    std::condition_variable done_cond_;
+    std::vector<std::thread> threads_;
+    bool running_ = true;
+    long long generation_ = 0;
+    int num_participants_ = 0;
+    int num_active_ = 0;
+    int num_tasks_ = 0;
+    std::atomic<int> next_{0};
+    const std::function<void(int)> *fn_ = nullptr;
+};
+
+inline void parallel_for(int num_tasks, int num_threads, const std::function<void(int)> &fn)
+{
+    ParallelWorkers::instance().run(num_tasks, num_threads, fn);
+}
+
+#endif // PARALLEL_FOR_HPP
@@ -0,0 +1,121 @@
+/**
+ * 多阶段流水线配置与统计
+ * 解决的问题：
+ * 原来预处理在commit的调用线程上执行，解码、NMS、promise赋值都在推理线程上执行
+ * CPU NMS较重时，推理线程在做后处理，引擎处于空闲
+ *
+ * 设计思路：
+ * 预处理线程池 -> 推理线程 -> 后处理线程池，阶段之间使用有界的MPMCQueue，队列满时上游阻塞形成背压
+ * 线程数为0时，该阶段退化为原来的行为（预处理在调用线程，后处理在推理线程）
+ *
+ * 每个阶段统计忙碌时间，占用率 = 忙碌时间 / (统计时长 * 线程数)
+ * 推理阶段的占用率接近1说明引擎一直在工作，瓶颈在引擎；远小于1时应增加前后阶段的线程
+ **/
+
+#ifndef PIPELINE_STAGE_HPP
+#define PIPELINE_STAGE_HPP
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include "ilogger.hpp"
+
+struct PipelineConfig
+{
+    int num_preprocess_threads = 0;  // 0表示在commit的调用线程上预处理，此时输入在commit返回前已经拷贝完成
+    int num_postprocess_threads = 0; // 0表示在推理线程上后处理
+    int queue_capacity = 256;        // 阶段之间队列的容量
+    int num_staging_buffers = 2;     // 推理线程的输入输出缓冲组数，2为双缓冲，1时装配与前向串行，见staging_pipeline.hpp
+
+    static PipelineConfig inline_stages() { return PipelineConfig(); }
+
+    static PipelineConfig pools(int num_preprocess_threads, int num_postprocess_threads, int queue_capacity = 256)
+    {
+        PipelineConfig config;
+        config.num_preprocess_threads = num_preprocess_threads;
+        config.num_postprocess_threads = num_postprocess_threads;
+        config.queue_capacity = queue_capacity;
+        return config;
+    }
+};
+
+struct StageReport
+{
+    std::string name;
+    int num_threads = 0; // 0表示在其他线程上内联执行
+    long long num_jobs = 0;
+    double busy_ms = 0;
+    double elapsed_ms = 0;
+    double occupancy = 0;
+    double average_ms = 0;
+    size_t queue_depth = 0;
+
+    std::string to_string() const
+    {
+        return iLogger::format(
+            "%s[threads=%d, jobs=%lld, avg=%.3f ms, occupancy=%.1f%%, queue=%d]",
+            name.c_str(), num_threads, num_jobs, average_ms, occupancy * 100, (int)queue_depth);
+    }
+};
+
+struct PipelineReport
+{
+    StageReport preprocess;
+    StageReport inference;
+    StageReport postprocess;
+
+    std::string to_string() const
+    {
+        return preprocess.to_string() + ", " + inference.to_string() + ", " + postprocess.to_string();
+    }
+};
+
+// 阶段统计，无锁，多个线程可以同时record
+class StageStatistics
+{
+public:
+    StageStatistics() { reset(); }
+
+    void reset()
+    {
+        busy_us_ = 0;
+        num_jobs_ = 0;
+        begin_us_ = now_us();
+    }
+
+    void record(long long busy_us, int num_jobs = 1)
+    {
+        busy_us_ += std::max(0LL, busy_us);
+        num_jobs_ += num_jobs;
+    }
+
+    StageReport report(const std::string &name, int num_threads, size_t queue_depth) const
+    {
+        StageReport output;
+        output.name = name;
+        output.num_threads = num_threads;
+        output.num_jobs = num_jobs_;
+        output.busy_ms = busy_us_ / 1000.0;
+        output.elapsed_ms = (now_us() - begin_us_) / 1000.0;
+        output.queue_depth = queue_depth;
+        if (output.num_jobs > 0)
+            output.average_ms = output.busy_ms / output.num_jobs;
+
+        if (output.elapsed_ms > 0)
+            output.occupancy = output.busy_ms / (output.elapsed_ms * std::max(1, num_threads));
+        return output;
+    }
+
+    static long long now_us()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    std::atomic<long long> busy_us_;
+    std::atomic<long long> num_jobs_;
+    std::atomic<long long> begin_us_;
+};
+
+#endif // PIPELINE_STAGE_HPP
@@ -0,0 +1,321 @@
+#include "preprocess_cpu.hpp"
+#include <cmath>
+#include <algorithm>
+#include "simd.hpp"
+#include "parallel_for.hpp"
+
+namespace CPUKernel
+{
+    static const int ROWS_PER_TASK = 16; // 每个并行任务处理的目标行数
+
+    struct WarpArgs
+    {
+        const uint8_t *src;
+        int src_line_size, src_width, src_height;
+        float *dst;
+        int dst_width, dst_height;
+        const float *m;
+        uint8_t const_value;
+        Norm norm;
+    };
+
+    // 与核函数相同的通道交换与归一化
+    static inline void normalize_pixel(const Norm &norm, float &c0, float &c1, float &c2)
+    {
+        if (norm.channel_type == ChannelType::Invert)
+            std::swap(c0, c2);
+
+        if (norm.type == NormType::MeanStd)
+        {
+            c0 = (c0 * norm.alpha - norm.mean[0]) / norm.std[0];
+            c1 = (c1 * norm.alpha - norm.mean[1]) / norm.std[1];
+            c2 = (c2 * norm.alpha - norm.mean[2]) / norm.std[2];
+        }
+        else if (norm.type == NormType::AlphaBeta)
+        {
+            c0 = c0 * norm.alpha + norm.beta;
+            c1 = c1 * norm.alpha + norm.beta;
+            c2 = c2 * norm.alpha + norm.beta;
+        }
+    }
+
+    // warp_affine_bilinear_and_normalize_plane_kernel中的一个像素
+    static inline void warp_pixel(const WarpArgs &a, int dx, int dy, float &c0, float &c1, float &c2)
+    {
+        const float *m = a.m;
+        float src_x = m[0] * dx + m[1] * dy + m[2];
+        float src_y = m[3] * dx + m[4] * dy + m[5];
+        if (src_x <= -1 || src_x >= a.src_width || src_y <= -1 || src_y >= a.src_height)
+        {
+            c0 = a.const_value;
+            c1 = a.const_value;
+            c2 = a.const_value;
+            return;
+        }
+
+        int y_low = floorf(src_y);
+        int x_low = floorf(src_x);
+        int y_high = y_low + 1;
+        int x_high = x_low + 1;
+
+        const uint8_t const_value[] = {a.const_value, a.const_value, a.const_value};
+        float ly = src_y - y_low;
+        float lx = src_x - x_low;
+        float hy = 1 - ly;
+        float hx = 1 - lx;
+        float w1 = hy * hx, w2 = hy * lx, w3 = ly * hx, w4 = ly * lx;
+        const uint8_t *v1 = const_value;
+        const uint8_t *v2 = const_value;
+        const uint8_t *v3 = const_value;
+        const uint8_t *v4 = const_value;
+        if (y_low >= 0)
+        {
+            if (x_low >= 0)
+                v1 = a.src + y_low * a.src_line_size + x_low * 3;
+
+            if (x_high < a.src_width)
+                v2 = a.src + y_low * a.src_line_size + x_high * 3;
+        }
+
+        if (y_high < a.src_height)
+        {
+            if (x_low >= 0)
+                v3 = a.src + y_high * a.src_line_size + x_low * 3;
+
+            if (x_high < a.src_width)
+                v4 = a.src + y_high * a.src_line_size + x_high * 3;
+        }
+
+        c0 = floorf(w1 * v1[0] + w2 * v2[0] + w3 * v3[0] + w4 * v4[0] + 0.5f);
+        c1 = floorf(w1 * v1[1] + w2 * v2[1] + w3 * v3[1] + w4 * v4[1] + 0.5f);
+        c2 = floorf(w1 * v1[2] + w2 * v2[2] + w3 * v3[2] + w4 * v4[2] + 0.5f);
+    }
+
+    static void warp_rows(const WarpArgs &a, int row_begin, int row_end)
+    {
+        const float *m = a.m;
+        const Norm &norm = a.norm;
+        int area = a.dst_width * a.dst_height;
+        float *plane0 = a.dst;
+        float *plane1 = plane0 + area;
+        float *plane2 = plane1 + area;
+        const uint8_t const_pixel[] = {a.const_value, a.const_value, a.const_value};
+
+        static const float lanes[] = {0, 1, 2, 3};
+        SIMD::f32x4 lane = SIMD::load(lanes);
+        SIMD::f32x4 m0 = SIMD::set1(m[0]), m2 = SIMD::set1(m[2]), m3 = SIMD::set1(m[3]), m5 = SIMD::set1(m[5]);
+        SIMD::f32x4 minus_one = SIMD::set1(-1.0f), one = SIMD::set1(1.0f), half = SIMD::set1(0.5f);
+        SIMD::f32x4 src_w = SIMD::set1((float)a.src_width), src_h = SIMD::set1((float)a.src_height);
+        SIMD::f32x4 const_value = SIMD::set1((float)a.const_value);
+
+        // 归一化写成c * scale + bias或(c * alpha - mean) / std，与核函数的运算顺序相同
+        bool invert = norm.channel_type == ChannelType::Invert;
+        SIMD::f32x4 alpha = SIMD::set1(norm.alpha), beta = SIMD::set1(norm.beta);
+        SIMD::f32x4 mean[3], stdv[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            mean[c] = SIMD::set1(norm.mean[c]);
+            stdv[c] = SIMD::set1(norm.std[c]);
+        }
+
+        auto normalize = [&](SIMD::f32x4 c, int ichannel)
+        {
+            if (norm.type == NormType::MeanStd)
+                return SIMD::div(SIMD::sub(SIMD::mul(c, alpha), mean[ichannel]), stdv[ichannel]);
+            else if (norm.type == NormType::AlphaBeta)
+                return SIMD::add(SIMD::mul(c, alpha), beta);
+            return c;
+        };
+
+        for (int dy = row_begin; dy < row_end; ++dy)
+        {
+            SIMD::f32x4 m1dy = SIMD::set1(m[1] * dy), m4dy = SIMD::set1(m[4] * dy);
+            int offset = dy * a.dst_width;
+            int dx = 0;
+            for (; dx + SIMD::WIDTH <= a.dst_width; dx += SIMD::WIDTH)
+            {
+                SIMD::f32x4 fx = SIMD::add(SIMD::set1((float)dx), lane);
+                SIMD::f32x4 src_x = SIMD::add(SIMD::add(SIMD::mul(m0, fx), m1dy), m2);
+                SIMD::f32x4 src_y = SIMD::add(SIMD::add(SIMD::mul(m3, fx), m4dy), m5);
+
+                // src_x > -1 && src_x < w && src_y > -1 && src_y < h
+                SIMD::f32x4 inside = SIMD::bit_and(
+                    SIMD::bit_and(SIMD::cmpgt(src_x, minus_one), SIMD::cmpgt(src_w, src_x)),
+                    SIMD::bit_and(SIMD::cmpgt(src_y, minus_one), SIMD::cmpgt(src_h, src_y)));
+
+                int inside_mask = SIMD::movemask(inside);
+                SIMD::f32x4 c0, c1, c2;
+                if (inside_mask == 0)
+                {
+                    c0 = c1 = c2 = const_value;
+                }
+                else
+                {
+                    // 图外的lane坐标可能很大，置为0后计算，最后再替换为const_value
+                    src_x = SIMD::bit_and(inside, src_x);
+                    src_y = SIMD::bit_and(inside, src_y);
+                    SIMD::f32x4 x_low = SIMD::floor(src_x), y_low = SIMD::floor(src_y);
+                    SIMD::f32x4 lx = SIMD::sub(src_x, x_low), ly = SIMD::sub(src_y, y_low);
+                    SIMD::f32x4 hx = SIMD::sub(one, lx), hy = SIMD::sub(one, ly);
+                    SIMD::f32x4 w1 = SIMD::mul(hy, hx), w2 = SIMD::mul(hy, lx), w3 = SIMD::mul(ly, hx), w4 = SIMD::mul(ly, lx);
+
+                    float xs[4], ys[4];
+                    SIMD::store(xs, x_low);
+                    SIMD::store(ys, y_low);
+
+                    // 4个角 x 3个通道
+                    float v[4][3][4];
+                    bool interior = inside_mask == 0xF &&
+                                    std::min(std::min(xs[0], xs[1]), std::min(xs[2], xs[3])) >= 0 &&
+                                    std::max(std::max(xs[0], xs[1]), std::max(xs[2], xs[3])) + 1 < a.src_width &&
+                                    std::min(std::min(ys[0], ys[1]), std::min(ys[2], ys[3])) >= 0 &&
+                                    std::max(std::max(ys[0], ys[1]), std::max(ys[2], ys[3])) + 1 < a.src_height;
+                    for (int i = 0; i < SIMD::WIDTH; ++i)
+                    {
+                        int xl = (int)xs[i], yl = (int)ys[i];
+                        int xh = xl + 1, yh = yl + 1;
+                        const uint8_t *p[4];
+                        if (interior)
+                        {
+                            p[0] = a.src + yl * a.src_line_size + xl * 3;
+                            p[1] = p[0] + 3;
+                            p[2] = p[0] + a.src_line_size;
+                            p[3] = p[2] + 3;
+                        }
+                        else
+                        {
+                            p[0] = p[1] = p[2] = p[3] = const_pixel;
+                            if (yl >= 0)
+                            {
+                                if (xl >= 0)
+                                    p[0] = a.src + yl * a.src_line_size + xl * 3;
+                                if (xh < a.src_width)
+                                    p[1] = a.src + yl * a.src_line_size + xh * 3;
+                            }
+
+                            if (yh < a.src_height)
+                            {
+                                if (xl >= 0)
+                                    p[2] = a.src + yh * a.src_line_size + xl * 3;
+                                if (xh < a.src_width)
+                                    p[3] = a.src + yh * a.src_line_size + xh * 3;
+                            }
+                        }
+
+                        for (int k = 0; k < 4; ++k)
+                        {
+                            v[k][0][i] = p[k][0];
+                            v[k][1][i] = p[k][1];
+                            v[k][2][i] = p[k][2];
+                        }
+                    }
+
+                    SIMD::f32x4 c[3];
+                    for (int ch = 0; ch < 3; ++ch)
+                    {
+                        SIMD::f32x4 sum = SIMD::mul(w1, SIMD::load(v[0][ch]));
+                        sum = SIMD::add(sum, SIMD::mul(w2, SIMD::load(v[1][ch])));
+                        sum = SIMD::add(sum, SIMD::mul(w3, SIMD::load(v[2][ch])));
+                        sum = SIMD::add(sum, SIMD::mul(w4, SIMD::load(v[3][ch])));
+                        c[ch] = SIMD::floor(SIMD::add(sum, half));
+                        if (inside_mask != 0xF)
+                            c[ch] = SIMD::select(inside, c[ch], const_value);
+                    }
+                    c0 = c[0];
+                    c1 = c[1];
+                    c2 = c[2];
+                }
+
+                if (invert)
+                    std::swap(c0, c2);
+
+                SIMD::store(plane0 + offset + dx, normalize(c0, 0));
+                SIMD::store(plane1 + offset + dx, normalize(c1, 1));
+                SIMD::store(plane2 + offset + dx, normalize(c2, 2));
+            }
+
+            for (; dx < a.dst_width; ++dx)
+            {
+                float c0, c1, c2;
+                warp_pixel(a, dx, dy, c0, c1, c2);
+                normalize_pixel(norm, c0, c1, c2);
+                plane0[offset + dx] = c0;
+                plane1[offset + dx] = c1;
+                plane2[offset + dx] = c2;
+            }
+        }
+    }
+
+    void warp_affine_bilinear_and_normalize_plane(
+        const uint8_t *src, int src_line_size, int src_width, int src_height,
+        float *dst, int dst_width, int dst_height,
+        const float *matrix_2_3, uint8_t const_value, const Norm &norm,
+        int num_threads)
+    {
+        WarpArgs args = {src, src_line_size, src_width, src_height, dst, dst_width, dst_height, matrix_2_3, const_value, norm};
+        int num_tasks = (dst_height + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+        if (num_threads == 1 || num_tasks <= 1)
+        {
+            warp_rows(args, 0, dst_height);
+            return;
+        }
+
+        // 只捕获一个指针，std::function不需要分配内存
+        const WarpArgs *pargs = &args;
+        parallel_for(num_tasks, num_threads, [pargs](int itask)
+                     {
+            int begin = itask * ROWS_PER_TASK;
+            warp_rows(*pargs, begin, std::min(pargs->dst_height, begin + ROWS_PER_TASK)); });
+    }
+
+    struct NV12Args
+    {
+        const uint8_t *y, *uv;
+        int width, height, linesize;
+        uint8_t *dst;
+    };
+
+    static inline uint8_t cast(float value)
+    {
+        return value < 0 ? 0 : (value > 255 ? 255 : value);
+    }
+
+    // 与convert_nv12_to_bgr_kernel相同的公式
+    static void nv12_rows(const NV12Args &a, int row_begin, int row_end)
+    {
+        for (int oy = row_begin; oy < row_end; ++oy)
+        {
+            const uint8_t *py = a.y + oy * a.linesize;
+            const uint8_t *puv = a.uv + (oy >> 1) * a.linesize;
+            uint8_t *pdst = a.dst + oy * a.width * 3;
+            for (int ox = 0; ox < a.width; ++ox, pdst += 3)
+            {
+                float yvalue = 1.164f * (py[ox] - 16.0f);
+                float u = puv[ox & 0xFFFFFFFE] - 128.0f;
+                float v = puv[(ox & 0xFFFFFFFE) + 1] - 128.0f;
+                pdst[0] = cast(yvalue + 2.018f * u);
+                pdst[1] = cast(yvalue - 0.813f * v - 0.391f * u);
+                pdst[2] = cast(yvalue + 1.596f * v);
+            }
+        }
+    }
+
+    void convert_nv12_to_bgr(
+        const uint8_t *y, const uint8_t *uv, int width, int height, int linesize,
+        uint8_t *dst, int num_threads)
+    {
+        NV12Args args = {y, uv, width, height, linesize, dst};
+        int num_tasks = (height + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+        if (num_threads == 1 || num_tasks <= 1)
+        {
+            nv12_rows(args, 0, height);
+            return;
+        }
+
+        const NV12Args *pargs = &args;
+        parallel_for(num_tasks, num_threads, [pargs](int itask)
+                     {
+            int begin = itask * ROWS_PER_TASK;
+            nv12_rows(*pargs, begin, std::min(pargs->height, begin + ROWS_PER_TASK)); });
+    }
+};
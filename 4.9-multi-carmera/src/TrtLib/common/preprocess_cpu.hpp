@@ -0,0 +1,42 @@
+/**
+ * CPU上的仿射变换 + 归一化 + HWC->CHW
+ * 解决的问题：
+ * 预处理只有CUDAKernel::warp_affine_bilinear_and_normalize_plane，CPU上只能cv::warpAffine之后
+ * 再逐像素做BGR->RGB、归一化、转planar，整张图读写三遍
+ *
+ * 设计思路：
+ * 1. 与warp_affine_bilinear_and_normalize_plane_kernel相同的Norm/ChannelType/仿射矩阵约定与公式，
+ *    双线性插值、取整、通道交换、归一化、写3个plane在一次遍历中完成
+ * 2. 一次计算4个目标像素的源坐标、权重、插值与归一化，见simd.hpp，只有取邻域像素是逐个读取的
+ *    4个像素的邻域都在图内时不需要逐个判断边界
+ * 3. 按行分块，在常驻线程上并行，见parallel_for.hpp
+ * 4. NV12先用convert_nv12_to_bgr转为BGR，与CUDAKernel::convert_nv12_to_bgr_invoke相同
+ **/
+
+#ifndef PREPROCESS_CPU_HPP
+#define PREPROCESS_CPU_HPP
+
+#include <cstdint>
+#include "preprocess_kernel.cuh"
+
+namespace CPUKernel
+{
+    using CUDAKernel::ChannelType;
+    using CUDAKernel::Norm;
+    using CUDAKernel::NormType;
+
+    // 参数与CUDAKernel::warp_affine_bilinear_and_normalize_plane相同，src、dst、matrix_2_3都是主机内存
+    // num_threads为1时在调用线程上执行，<= 0时使用全部核心
+    void warp_affine_bilinear_and_normalize_plane(
+        const uint8_t *src, int src_line_size, int src_width, int src_height,
+        float *dst, int dst_width, int dst_height,
+        const float *matrix_2_3, uint8_t const_value, const Norm &norm,
+        int num_threads = 0);
+
+    // y、uv两个平面的每行字节数都是linesize，dst为连续的width * height * 3，结果截断到[0, 255]
+    void convert_nv12_to_bgr(
+        const uint8_t *y, const uint8_t *uv, int width, int height, int linesize,
+        uint8_t *dst, int num_threads = 0);
+};
+
+#endif // PREPROCESS_CPU_HPP
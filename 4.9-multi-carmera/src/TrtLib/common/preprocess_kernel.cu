@@ -32,6 +32,8 @@ namespace CUDAKernel
         return Norm();
     }
 
+// 没有CUDA时只保留Norm和invoker，见cuda_host.hpp
+#ifndef CPU_ONLY
 #define INTER_RESIZE_COEF_BITS 11
 #define INTER_RESIZE_COEF_SCALE (1 << INTER_RESIZE_COEF_BITS)
 #define CAST_BITS (INTER_RESIZE_COEF_BITS << 1)
@@ -380,10 +382,11 @@ namespace CUDAKernel
         int offset_uv = (oy >> 1) * linesize + (ox & 0xFFFFFFFE);
         const uint8_t &u = uv[offset_uv + 0];
         const uint8_t &v = uv[offset_uv + 1];
-        dst_bgr[position * 3 + 0] = 1.164f * (yvalue - 16.0f) + 2.018f * (u - 128.0f);
-        dst_bgr[position * 3 + 1] = 1.164f * (yvalue - 16.0f) - 0.813f * (v - 128.0f) - 0.391f * (u - 128.0f);
-        dst_bgr[position * 3 + 2] = 1.164f * (yvalue - 16.0f) + 1.596f * (v - 128.0f);
+        dst_bgr[position * 3 + 0] = cast(1.164f * (yvalue - 16.0f) + 2.018f * (u - 128.0f));
+        dst_bgr[position * 3 + 1] = cast(1.164f * (yvalue - 16.0f) - 0.813f * (v - 128.0f) - 0.391f * (u - 128.0f));
+        dst_bgr[position * 3 + 2] = cast(1.164f * (yvalue - 16.0f) + 1.596f * (v - 128.0f));
     }
+#endif // CPU_ONLY
 
     /////////////////////////////////////////////////////////////////////////
     void convert_nv12_to_bgr_invoke(
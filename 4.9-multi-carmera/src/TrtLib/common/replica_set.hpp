@@ -0,0 +1,311 @@
+/**
+ * 多个推理实例(副本)组成的副本集
+ * 解决的问题：
+ * 一张卡上一个引擎的吞吐有上限，多卡或者同一张卡上多个context时，需要调用方自己决定每一帧发给哪个实例，
+ * 简单轮询在实例速度不一致(不同型号的卡、其中一张卡同时在跑别的任务)时，慢的实例排队越来越长
+ *
+ * 设计思路：
+ * 1. 每个副本是一个完整的推理实例，拥有自己的引擎、MonopolyAllocator和推理线程，副本之间不共享任何状态
+ * 2. 默认按最少未完成job(outstanding / weight)分发，相同时轮转，快的副本自然分到更多的job
+ *    job一旦提交就进入副本内部的队列，无法再被其他副本取走，所以不做work stealing，
+ *    最少未完成数在提交时就把job分给最可能先空闲的副本，效果与stealing接近
+ * 3. 健康检查：连续max_consecutive_failures次提交失败的副本标记为不健康，retry_after_ms后放行一个探测job，
+ *    探测成功恢复，失败则继续隔离；被准入控制拒绝(QueueFull/NoSlot)只说明忙，不计入失败
+ * 4. 每个副本统计分发、完成、拒绝、失败数量，吞吐与延迟分位数
+ *
+ * ReplicaSet只负责选择副本和统计，不关心副本的类型，可以用任意的模拟副本测试，见app_bench/bench_replica.cpp
+ * acquire、release可以在任意线程调用，无锁
+ **/
+
+#ifndef REPLICA_SET_HPP
+#define REPLICA_SET_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "ilogger.hpp"
+#include "latency_histogram.hpp"
+#include "pipeline_stage.hpp"
+#include "admission_control.hpp"
+
+enum class ReplicaPolicy : int
+{
+    RoundRobin = 0,
+    LeastOutstanding = 1
+};
+
+struct ReplicaHealthPolicy
+{
+    int max_consecutive_failures = 3;
+    int retry_after_ms = 1000;
+};
+
+struct ReplicaReport
+{
+    int index = 0;
+    std::string name;
+    int weight = 1;
+    bool healthy = true;
+    long long outstanding = 0; // 已分发未完成
+    long long dispatched = 0;
+    long long completed = 0;
+    long long rejected = 0; // 准入控制拒绝
+    long long failed = 0;
+    double elapsed_ms = 0;
+    double throughput = 0; // completed/s
+    LatencySummary latency; // 分发到结果可用
+
+    std::string to_string() const
+    {
+        return iLogger::format(
+            "#%d %s[%s, weight=%d, outstanding=%lld, dispatched=%lld, completed=%lld, rejected=%lld, failed=%lld, throughput=%.2f jobs/s, latency {%s}]",
+            index, name.c_str(), healthy ? "healthy" : "unhealthy", weight, outstanding, dispatched, completed, rejected, failed,
+            throughput, latency.to_string().c_str());
+    }
+};
+
+struct ReplicaSetReport
+{
+    std::vector<ReplicaReport> replicas;
+    long long unavailable = 0; // 没有可用副本而直接失败的提交
+
+    int num_healthy() const
+    {
+        int output = 0;
+        for (auto &item : replicas)
+            output += item.healthy ? 1 : 0;
+        return output;
+    }
+
+    double throughput() const
+    {
+        double output = 0;
+        for (auto &item : replicas)
+            output += item.throughput;
+        return output;
+    }
+
+    std::string to_string() const
+    {
+        std::string output = iLogger::format(
+            "healthy=%d/%d, throughput=%.2f jobs/s, unavailable=%lld",
+            num_healthy(), (int)replicas.size(), throughput(), unavailable);
+
+        for (auto &item : replicas)
+            output += "\n  " + item.to_string();
+        return output;
+    }
+};
+
+template <class _Replica>
+class ReplicaSet
+{
+public:
+    ReplicaSet(
+        const std::vector<std::shared_ptr<_Replica>> &replicas,
+        ReplicaPolicy policy = ReplicaPolicy::LeastOutstanding,
+        const ReplicaHealthPolicy &health = ReplicaHealthPolicy())
+        : states_(new State[replicas.size()]), replicas_(replicas), policy_(policy), health_(health)
+    {
+        reset_statistics();
+    }
+
+    int size() const { return (int)replicas_.size(); }
+    std::shared_ptr<_Replica> &replica(int index) { return replicas_[index]; }
+
+    void set_name(int index, const std::string &name) { states_[index].name = name; }
+
+    // 副本的相对处理能力，例如两张卡速度2:1时设为2和1
+    void set_weight(int index, int weight) { states_[index].weight = std::max(1, weight); }
+
+    /* 选择一个副本并计入outstanding，exclude_mask中的副本不参与选择(第i位对应第i个副本，用于换副本重试)
+       没有可用的副本时返回-1
+    */
+    int acquire(uint64_t exclude_mask = 0)
+    {
+        int n = size();
+        if (n == 0)
+        {
+            unavailable_++;
+            return -1;
+        }
+
+        long long now = StageStatistics::now_us();
+        int start = (int)(next_.fetch_add(1, std::memory_order_relaxed) % n);
+        int best = -1;
+        long long best_load = 0;
+        int best_weight = 1;
+        int probe = -1;
+        for (int k = 0; k < n; ++k)
+        {
+            int index = (start + k) % n;
+            if (index < 64 && (exclude_mask >> index) & 1)
+                continue;
+
+            auto &state = states_[index];
+            if (now < state.unhealthy_until_us.load(std::memory_order_relaxed))
+                continue;
+
+            if (state.unhealthy_until_us.load(std::memory_order_relaxed) > 0)
+            {
+                // 隔离期已过，最多放行一个探测job
+                if (probe == -1)
+                    probe = index;
+                continue;
+            }
+
+            if (policy_ == ReplicaPolicy::RoundRobin)
+            {
+                best = index;
+                break;
+            }
+
+            long long load = state.outstanding.load(std::memory_order_relaxed) + 1;
+            int weight = state.weight.load(std::memory_order_relaxed);
+            if (best == -1 || load * best_weight < best_load * weight)
+            {
+                best = index;
+                best_load = load;
+                best_weight = weight;
+            }
+        }
+
+        if (probe != -1)
+        {
+            // 探测优先于健康的副本，否则负载正常时隔离的副本永远没有机会恢复
+            bool expected = false;
+            if (states_[probe].probing.compare_exchange_strong(expected, true))
+                best = probe;
+        }
+
+        if (best == -1)
+        {
+            unavailable_++;
+            return -1;
+        }
+
+        states_[best].outstanding.fetch_add(1, std::memory_order_relaxed);
+        states_[best].dispatched.fetch_add(1, std::memory_order_relaxed);
+        return best;
+    }
+
+    /* acquire得到的副本处理结束，每次acquire对应一次release
+       status为副本commit的返回值，Accepted时latency_us为分发到结果可用的耗时
+    */
+    void release(int index, CommitStatus status, long long latency_us = 0)
+    {
+        auto &state = states_[index];
+        state.outstanding.fetch_sub(1, std::memory_order_relaxed);
+        switch (status)
+        {
+        case CommitStatus::Accepted:
+            state.completed.fetch_add(1, std::memory_order_relaxed);
+            state.latency.record(latency_us);
+            state.consecutive_failures = 0;
+            if (state.unhealthy_until_us.load(std::memory_order_relaxed) > 0)
+            {
+                state.unhealthy_until_us = 0;
+                state.probing = false;
+                INFO("Replica #%d %s recovered", index, state.name.c_str());
+            }
+            break;
+
+        case CommitStatus::QueueFull:
+        case CommitStatus::NoSlot:
+            state.rejected.fetch_add(1, std::memory_order_relaxed);
+            state.probing = false; // 探测job被拒绝，下次再放行
+            break;
+
+        default:
+            state.failed.fetch_add(1, std::memory_order_relaxed);
+            if (++state.consecutive_failures >= health_.max_consecutive_failures)
+            {
+                bool was_healthy = state.unhealthy_until_us.load(std::memory_order_relaxed) == 0;
+                state.unhealthy_until_us = StageStatistics::now_us() + health_.retry_after_ms * 1000LL;
+                state.probing = false;
+                if (was_healthy)
+                    INFOW("Replica #%d %s marked unhealthy after %d consecutive failures", index, state.name.c_str(), (int)state.consecutive_failures);
+            }
+            break;
+        }
+    }
+
+    bool healthy(int index) const { return states_[index].unhealthy_until_us.load(std::memory_order_relaxed) == 0; }
+
+    ReplicaSetReport report(bool reset = false)
+    {
+        ReplicaSetReport output;
+        long long now = StageStatistics::now_us();
+        double elapsed_ms = (now - begin_us_) / 1000.0;
+        output.unavailable = unavailable_;
+        for (int i = 0; i < size(); ++i)
+        {
+            auto &state = states_[i];
+            ReplicaReport item;
+            item.index = i;
+            item.name = state.name;
+            item.weight = state.weight;
+            item.healthy = healthy(i);
+            item.outstanding = state.outstanding;
+            item.dispatched = state.dispatched;
+            item.completed = state.completed;
+            item.rejected = state.rejected;
+            item.failed = state.failed;
+            item.elapsed_ms = elapsed_ms;
+            if (elapsed_ms > 0)
+                item.throughput = item.completed / (elapsed_ms / 1000.0);
+            item.latency = state.latency.summary();
+            output.replicas.emplace_back(item);
+        }
+
+        if (reset)
+            reset_statistics();
+        return output;
+    }
+
+private:
+    // 只清除计数，outstanding与健康状态保留
+    void reset_statistics()
+    {
+        for (int i = 0; i < size(); ++i)
+        {
+            auto &state = states_[i];
+            state.dispatched = 0;
+            state.completed = 0;
+            state.rejected = 0;
+            state.failed = 0;
+            state.latency.reset();
+        }
+        unavailable_ = 0;
+        begin_us_ = StageStatistics::now_us();
+    }
+
+    struct State
+    {
+        std::string name;
+        std::atomic<int> weight{1};
+        std::atomic<long long> outstanding{0};
+        std::atomic<long long> dispatched{0};
+        std::atomic<long long> completed{0};
+        std::atomic<long long> rejected{0};
+        std::atomic<long long> failed{0};
+        std::atomic<int> consecutive_failures{0};
+        std::atomic<long long> unhealthy_until_us{0}; // 0表示健康
+        std::atomic<bool> probing{false};
+        LatencyHistogram latency;
+    };
+
+private:
+    // 析构时先释放副本，副本停止时回调中的release仍然可以访问states_
+    std::unique_ptr<State[]> states_;
+    std::vector<std::shared_ptr<_Replica>> replicas_;
+    ReplicaPolicy policy_;
+    ReplicaHealthPolicy health_;
+    std::atomic<unsigned long long> next_{0};
+    std::atomic<long long> unavailable_{0};
+    std::atomic<long long> begin_us_{0};
+};
+
+#endif // REPLICA_SET_HPP
@@ -0,0 +1,357 @@
+/**
+ * 按内容哈希缓存推理结果
+ * 解决的问题：
+ * http客户端经常重复提交同一张图(失败重试、看板定时拉取同一张快照)，每次都重新解码、推理
+ *
+ * 设计思路：
+ * 1. key为请求原始字节的64位哈希，再与模型、阈值等参数的哈希合并，参数不同的请求不会命中，见content_hash
+ *    哈希每次读取8字节，比逐字节的FNV快，一张几百KB的jpeg只需要几十微秒，远小于解码
+ * 2. 按key分成num_shards个分片，每个分片一把锁、一个LRU链表和一个哈希表，容量按分片平均分配
+ * 3. single-flight：未命中时先插入一个未完成的条目再在锁外计算，同一个key的并发请求拿到同一个future，
+ *    只有第一个请求(leader)执行计算，其余请求等待它的结果(collapsed)
+ * 4. 计算失败(返回nullptr或者抛出异常)的结果交给正在等待的请求，但不进入缓存，下一次请求重新计算
+ * 5. ttl_ms > 0时完成超过ttl_ms的条目视为未命中，用于快照类的数据
+ * 6. 统计命中、合并、未命中、失败、淘汰、过期的次数与命中率，可以输出为json
+ *
+ * 结果以shared_ptr<const _Value>共享，命中时不拷贝结果
+ **/
+
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+#include "ilogger.hpp"
+#include "json.hpp"
+#include "pipeline_stage.hpp"
+
+// MurmurHash64A，每次处理8字节
+inline uint64_t content_hash(const void *data, size_t size, uint64_t seed = 0)
+{
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = seed ^ (size * m);
+
+    auto bytes = (const unsigned char *)data;
+    size_t num_blocks = size / 8;
+    for (size_t i = 0; i < num_blocks; ++i)
+    {
+        uint64_t k;
+        memcpy(&k, bytes + i * 8, 8);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    auto tail = bytes + num_blocks * 8;
+    switch (size & 7)
+    {
+    case 7: h ^= uint64_t(tail[6]) << 48;
+    case 6: h ^= uint64_t(tail[5]) << 40;
+    case 5: h ^= uint64_t(tail[4]) << 32;
+    case 4: h ^= uint64_t(tail[3]) << 24;
+    case 3: h ^= uint64_t(tail[2]) << 16;
+    case 2: h ^= uint64_t(tail[1]) << 8;
+    case 1:
+        h ^= uint64_t(tail[0]);
+        h *= m;
+    };
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+inline uint64_t content_hash(const std::string &value, uint64_t seed = 0)
+{
+    return content_hash(value.data(), value.size(), seed);
+}
+
+inline uint64_t hash_combine(uint64_t seed, uint64_t value)
+{
+    return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+struct ResultCacheConfig
+{
+    int capacity = 1024; // 所有分片的条目总数
+    int num_shards = 16;
+    int ttl_ms = 0; // 0表示不过期
+};
+
+enum class ResultCacheStatus : int
+{
+    Hit = 0,       // 已完成的结果
+    Collapsed = 1, // 同一个key正在计算，等待其结果
+    Miss = 2       // 由当前请求计算
+};
+
+inline const char *result_cache_status_name(ResultCacheStatus status)
+{
+    switch (status)
+    {
+    case ResultCacheStatus::Hit:
+        return "hit";
+    case ResultCacheStatus::Collapsed:
+        return "collapsed";
+    case ResultCacheStatus::Miss:
+        return "miss";
+    default:
+        return "unknow";
+    }
+}
+
+struct ResultCacheReport
+{
+    long long hits = 0;
+    long long collapsed = 0;
+    long long misses = 0;
+    long long failures = 0;  // 计算失败，没有进入缓存
+    long long evictions = 0; // 超出容量被淘汰
+    long long expired = 0;   // 超过ttl被丢弃
+    long long size = 0;
+    long long capacity = 0;
+
+    long long lookups() const { return hits + collapsed + misses; }
+
+    // 命中与合并都不需要重新计算
+    double hit_rate() const
+    {
+        long long n = lookups();
+        return n > 0 ? (hits + collapsed) / (double)n : 0;
+    }
+
+    std::string to_string() const
+    {
+        return iLogger::format(
+            "lookups=%lld, hit rate=%.1f%%, hits=%lld, collapsed=%lld, misses=%lld, failures=%lld, evictions=%lld, expired=%lld, size=%lld/%lld",
+            lookups(), hit_rate() * 100, hits, collapsed, misses, failures, evictions, expired, size, capacity);
+    }
+
+    Json::Value to_json() const
+    {
+        Json::Value output(Json::objectValue);
+        output["lookups"] = (Json::Int64)lookups();
+        output["hit_rate"] = hit_rate();
+        output["hits"] = (Json::Int64)hits;
+        output["collapsed"] = (Json::Int64)collapsed;
+        output["misses"] = (Json::Int64)misses;
+        output["failures"] = (Json::Int64)failures;
+        output["evictions"] = (Json::Int64)evictions;
+        output["expired"] = (Json::Int64)expired;
+        output["size"] = (Json::Int64)size;
+        output["capacity"] = (Json::Int64)capacity;
+        return output;
+    }
+};
+
+template <class _Value>
+class ResultCache
+{
+public:
+    typedef std::shared_ptr<const _Value> ValuePointer;
+    typedef std::shared_future<ValuePointer> Future;
+
+    // 在调用get_or_compute的线程上同步执行，返回nullptr表示失败，抛出的异常由返回的future转交
+    typedef std::function<ValuePointer()> ComputeFunction;
+
+    ResultCache(const ResultCacheConfig &config = ResultCacheConfig())
+    {
+        config_ = config;
+        config_.num_shards = std::max(1, config.num_shards);
+        config_.capacity = std::max(config_.num_shards, config.capacity);
+        shard_capacity_ = (config_.capacity + config_.num_shards - 1) / config_.num_shards;
+        shards_.reset(new Shard[config_.num_shards]);
+    }
+
+    const ResultCacheConfig &config() const { return config_; }
+
+    /* 查找key，未命中时在当前线程执行compute并缓存结果
+       返回的future在leader计算完成后就绪，Hit时已经就绪
+    */
+    Future get_or_compute(uint64_t key, const ComputeFunction &compute, ResultCacheStatus *status = nullptr)
+    {
+        auto &shard = shards_[key % config_.num_shards];
+        std::promise<ValuePointer> leader;
+        Future future;
+        unsigned long long flight = 0;
+        {
+            std::unique_lock<std::mutex> l(shard.lock);
+            auto iter = shard.entries.find(key);
+            if (iter != shard.entries.end())
+            {
+                auto &entry = *iter->second;
+                if (entry.ready && config_.ttl_ms > 0 && StageStatistics::now_us() - entry.ready_us > config_.ttl_ms * 1000LL)
+                {
+                    shard.lru.erase(iter->second);
+                    shard.entries.erase(iter);
+                    expired_++;
+                }
+                else
+                {
+                    shard.lru.splice(shard.lru.begin(), shard.lru, iter->second);
+                    if (status)
+                        *status = entry.ready ? ResultCacheStatus::Hit : ResultCacheStatus::Collapsed;
+
+                    if (entry.ready)
+                        hits_++;
+                    else
+                        collapsed_++;
+                    return entry.future;
+                }
+            }
+
+            misses_++;
+            flight = ++shard.next_flight;
+            future = leader.get_future().share();
+            shard.lru.emplace_front();
+            auto &entry = shard.lru.front();
+            entry.key = key;
+            entry.flight = flight;
+            entry.future = future;
+            shard.entries[key] = shard.lru.begin();
+
+            // 未完成的条目也可能被淘汰，之后同一个key的请求会重新计算，leader完成时发现条目不在了直接返回
+            while ((int)shard.lru.size() > shard_capacity_)
+            {
+                shard.entries.erase(shard.lru.back().key);
+                shard.lru.pop_back();
+                evictions_++;
+            }
+        }
+
+        if (status)
+            *status = ResultCacheStatus::Miss;
+
+        ValuePointer value;
+        try
+        {
+            value = compute();
+        }
+        catch (...)
+        {
+            // 等待的请求拿到同一个异常，条目被移除
+            leader.set_exception(std::current_exception());
+            finish_flight(shard, key, flight, nullptr);
+            return future;
+        }
+
+        leader.set_value(value);
+        finish_flight(shard, key, flight, value);
+        return future;
+    }
+
+    void erase(uint64_t key)
+    {
+        auto &shard = shards_[key % config_.num_shards];
+        std::unique_lock<std::mutex> l(shard.lock);
+        auto iter = shard.entries.find(key);
+        if (iter == shard.entries.end())
+            return;
+
+        shard.lru.erase(iter->second);
+        shard.entries.erase(iter);
+    }
+
+    void clear()
+    {
+        for (int i = 0; i < config_.num_shards; ++i)
+        {
+            std::unique_lock<std::mutex> l(shards_[i].lock);
+            shards_[i].lru.clear();
+            shards_[i].entries.clear();
+        }
+    }
+
+    ResultCacheReport report(bool reset = false)
+    {
+        ResultCacheReport output;
+        output.hits = hits_;
+        output.collapsed = collapsed_;
+        output.misses = misses_;
+        output.failures = failures_;
+        output.evictions = evictions_;
+        output.expired = expired_;
+        output.capacity = (long long)shard_capacity_ * config_.num_shards;
+        for (int i = 0; i < config_.num_shards; ++i)
+        {
+            std::unique_lock<std::mutex> l(shards_[i].lock);
+            output.size += shards_[i].lru.size();
+        }
+
+        if (reset)
+        {
+            hits_ = 0;
+            collapsed_ = 0;
+            misses_ = 0;
+            failures_ = 0;
+            evictions_ = 0;
+            expired_ = 0;
+        }
+        return output;
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t key = 0;
+        unsigned long long flight = 0; // 区分同一个key先后的两次计算
+        bool ready = false;
+        long long ready_us = 0;
+        Future future;
+    };
+
+    struct Shard
+    {
+        std::mutex lock;
+        std::list<Entry> lru; // 头部为最近使用
+        std::unordered_map<uint64_t, typename std::list<Entry>::iterator> entries;
+        unsigned long long next_flight = 0;
+    };
+
+    // leader计算结束：成功时条目标记为完成，失败时移除；条目已被淘汰或者已经是另一次计算时不处理
+    void finish_flight(Shard &shard, uint64_t key, unsigned long long flight, const ValuePointer &value)
+    {
+        std::unique_lock<std::mutex> l(shard.lock);
+        auto iter = shard.entries.find(key);
+        if (value == nullptr)
+            failures_++;
+
+        if (iter == shard.entries.end() || iter->second->flight != flight)
+            return;
+
+        if (value == nullptr)
+        {
+            shard.lru.erase(iter->second);
+            shard.entries.erase(iter);
+            return;
+        }
+
+        iter->second->ready = true;
+        iter->second->ready_us = StageStatistics::now_us();
+    }
+
+private:
+    ResultCacheConfig config_;
+    int shard_capacity_ = 0;
+    std::unique_ptr<Shard[]> shards_;
+    std::atomic<long long> hits_{0};
+    std::atomic<long long> collapsed_{0};
+    std::atomic<long long> misses_{0};
+    std::atomic<long long> failures_{0};
+    std::atomic<long long> evictions_{0};
+    std::atomic<long long> expired_{0};
+};
+
+#endif // RESULT_CACHE_HPP
@@ -0,0 +1,263 @@
+/**
+ * 4路float的SIMD封装
+ * 解决的问题：
+ * CPU上的NMS、解码、预处理等逐元素的计算需要向量化，直接写intrinsics会在x86和Jetson(aarch64)上各写一遍
+ *
+ * 设计思路：
+ * 1. 只提供4路float，x86-64默认就有SSE2，aarch64默认就有NEON，不需要额外的编译选项
+ * 2. 其他平台退化为4个float的标量实现，结果与向量实现相同
+ * 3. 加减乘除为IEEE单精度，与标量代码逐位一致；min/max只在输入不含NaN时与std::min/std::max一致
+ * 4. 比较的结果为全1/全0的掩码，movemask把4个lane的掩码压缩为低4位
+ * 5. exp等超越函数由上面的基本运算组合而成，不依赖平台的数学库
+ **/
+
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SIMD_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define SIMD_NEON 1
+#endif
+
+namespace SIMD
+{
+    static const int WIDTH = 4;
+
+#if defined(SIMD_SSE2)
+
+    typedef __m128 f32x4;
+
+    inline const char *name() { return "sse2"; }
+    inline f32x4 load(const float *p) { return _mm_loadu_ps(p); }
+    inline void store(float *p, f32x4 a) { _mm_storeu_ps(p, a); }
+    inline f32x4 set1(float v) { return _mm_set1_ps(v); }
+    inline f32x4 zero() { return _mm_setzero_ps(); }
+    inline f32x4 add(f32x4 a, f32x4 b) { return _mm_add_ps(a, b); }
+    inline f32x4 sub(f32x4 a, f32x4 b) { return _mm_sub_ps(a, b); }
+    inline f32x4 mul(f32x4 a, f32x4 b) { return _mm_mul_ps(a, b); }
+    inline f32x4 div(f32x4 a, f32x4 b) { return _mm_div_ps(a, b); }
+    inline f32x4 min(f32x4 a, f32x4 b) { return _mm_min_ps(a, b); }
+    inline f32x4 max(f32x4 a, f32x4 b) { return _mm_max_ps(a, b); }
+    inline f32x4 cmpge(f32x4 a, f32x4 b) { return _mm_cmpge_ps(a, b); }
+    inline f32x4 cmpgt(f32x4 a, f32x4 b) { return _mm_cmpgt_ps(a, b); }
+    inline f32x4 cmpeq(f32x4 a, f32x4 b) { return _mm_cmpeq_ps(a, b); }
+    inline f32x4 bit_and(f32x4 a, f32x4 b) { return _mm_and_ps(a, b); }
+    inline f32x4 bit_or(f32x4 a, f32x4 b) { return _mm_or_ps(a, b); }
+    inline f32x4 bit_andnot(f32x4 mask, f32x4 a) { return _mm_andnot_ps(mask, a); } // ~mask & a
+    inline f32x4 select(f32x4 mask, f32x4 a, f32x4 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+    inline int movemask(f32x4 mask) { return _mm_movemask_ps(mask); }
+
+    inline f32x4 floor(f32x4 a)
+    {
+        f32x4 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+        return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.0f)));
+    }
+
+    // 2^n，n为[-126, 127]内的整数
+    inline f32x4 pow2i(f32x4 n) { return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23)); }
+
+    // 4x4转置，a、b、c、d为4行，转置后为4列
+    inline void transpose4(f32x4 &a, f32x4 &b, f32x4 &c, f32x4 &d) { _MM_TRANSPOSE4_PS(a, b, c, d); }
+
+#elif defined(SIMD_NEON)
+
+    typedef float32x4_t f32x4;
+
+    inline const char *name() { return "neon"; }
+    inline f32x4 load(const float *p) { return vld1q_f32(p); }
+    inline void store(float *p, f32x4 a) { vst1q_f32(p, a); }
+    inline f32x4 set1(float v) { return vdupq_n_f32(v); }
+    inline f32x4 zero() { return vdupq_n_f32(0); }
+    inline f32x4 add(f32x4 a, f32x4 b) { return vaddq_f32(a, b); }
+    inline f32x4 sub(f32x4 a, f32x4 b) { return vsubq_f32(a, b); }
+    inline f32x4 mul(f32x4 a, f32x4 b) { return vmulq_f32(a, b); }
+    inline f32x4 div(f32x4 a, f32x4 b) { return vdivq_f32(a, b); }
+    inline f32x4 min(f32x4 a, f32x4 b) { return vminq_f32(a, b); }
+    inline f32x4 max(f32x4 a, f32x4 b) { return vmaxq_f32(a, b); }
+    inline f32x4 cmpge(f32x4 a, f32x4 b) { return vreinterpretq_f32_u32(vcgeq_f32(a, b)); }
+    inline f32x4 cmpgt(f32x4 a, f32x4 b) { return vreinterpretq_f32_u32(vcgtq_f32(a, b)); }
+    inline f32x4 cmpeq(f32x4 a, f32x4 b) { return vreinterpretq_f32_u32(vceqq_f32(a, b)); }
+    inline f32x4 bit_and(f32x4 a, f32x4 b) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+    inline f32x4 bit_or(f32x4 a, f32x4 b) { return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+    inline f32x4 bit_andnot(f32x4 mask, f32x4 a) { return vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(mask))); }
+    inline f32x4 select(f32x4 mask, f32x4 a, f32x4 b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+    inline int movemask(f32x4 mask)
+    {
+        static const int32_t shifts[4] = {0, 1, 2, 3};
+        uint32x4_t bits = vshrq_n_u32(vreinterpretq_u32_f32(mask), 31);
+        return (int)vaddvq_u32(vshlq_u32(bits, vld1q_s32(shifts)));
+    }
+
+    inline f32x4 floor(f32x4 a) { return vrndmq_f32(a); }
+    inline f32x4 pow2i(f32x4 n) { return vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127)), 23)); }
+
+    inline void transpose4(f32x4 &a, f32x4 &b, f32x4 &c, f32x4 &d)
+    {
+        float32x4x2_t ab = vtrnq_f32(a, b);
+        float32x4x2_t cd = vtrnq_f32(c, d);
+        a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+        b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+        c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+        d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+    }
+
+#else
+
+    struct f32x4
+    {
+        float v[4];
+    };
+
+    inline const char *name() { return "scalar"; }
+
+    inline f32x4 load(const float *p)
+    {
+        f32x4 r;
+        memcpy(r.v, p, sizeof(r.v));
+        return r;
+    }
+
+    inline void store(float *p, f32x4 a) { memcpy(p, a.v, sizeof(a.v)); }
+
+    inline f32x4 set1(float x)
+    {
+        f32x4 r;
+        r.v[0] = r.v[1] = r.v[2] = r.v[3] = x;
+        return r;
+    }
+
+    inline f32x4 zero() { return set1(0); }
+
+#define SIMD_SCALAR_OP(fn, expr)          \
+    inline f32x4 fn(f32x4 a, f32x4 b)     \
+    {                                     \
+        f32x4 r;                          \
+        for (int i = 0; i < 4; ++i)       \
+        {                                 \
+            float x = a.v[i], y = b.v[i]; \
+            r.v[i] = (expr);              \
+        }                                 \
+        return r;                         \
+    }
+
+    inline float mask_value(bool b)
+    {
+        uint32_t bits = b ? 0xFFFFFFFFu : 0;
+        float r;
+        memcpy(&r, &bits, 4);
+        return r;
+    }
+
+    inline uint32_t bits_of(float x)
+    {
+        uint32_t r;
+        memcpy(&r, &x, 4);
+        return r;
+    }
+
+    inline float from_bits(uint32_t x)
+    {
+        float r;
+        memcpy(&r, &x, 4);
+        return r;
+    }
+
+    SIMD_SCALAR_OP(add, x + y)
+    SIMD_SCALAR_OP(sub, x - y)
+    SIMD_SCALAR_OP(mul, x * y)
+    SIMD_SCALAR_OP(div, x / y)
+    SIMD_SCALAR_OP(min, x < y ? x : y)
+    SIMD_SCALAR_OP(max, x > y ? x : y)
+    SIMD_SCALAR_OP(cmpge, mask_value(x >= y))
+    SIMD_SCALAR_OP(cmpgt, mask_value(x > y))
+    SIMD_SCALAR_OP(cmpeq, mask_value(x == y))
+    SIMD_SCALAR_OP(bit_and, from_bits(bits_of(x) & bits_of(y)))
+    SIMD_SCALAR_OP(bit_or, from_bits(bits_of(x) | bits_of(y)))
+    SIMD_SCALAR_OP(bit_andnot, from_bits(~bits_of(x) & bits_of(y)))
+#undef SIMD_SCALAR_OP
+
+    inline f32x4 select(f32x4 mask, f32x4 a, f32x4 b) { return bit_or(bit_and(mask, a), bit_andnot(mask, b)); }
+
+    inline int movemask(f32x4 mask)
+    {
+        int r = 0;
+        for (int i = 0; i < 4; ++i)
+            r |= (bits_of(mask.v[i]) >> 31) << i;
+        return r;
+    }
+
+    inline f32x4 floor(f32x4 a)
+    {
+        f32x4 r;
+        for (int i = 0; i < 4; ++i)
+            r.v[i] = std::floor(a.v[i]);
+        return r;
+    }
+
+    inline f32x4 pow2i(f32x4 n)
+    {
+        f32x4 r;
+        for (int i = 0; i < 4; ++i)
+            r.v[i] = from_bits((uint32_t)((int)n.v[i] + 127) << 23);
+        return r;
+    }
+
+    inline void transpose4(f32x4 &a, f32x4 &b, f32x4 &c, f32x4 &d)
+    {
+        f32x4 *rows[4] = {&a, &b, &c, &d};
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = i + 1; j < 4; ++j)
+                std::swap(rows[i]->v[j], rows[j]->v[i]);
+        }
+    }
+
+#endif
+
+    /* e^x，cephes的多项式近似，相对误差约1e-7，x限制在[-87.3, 88.3]
+       三种实现使用相同的范围缩减和多项式
+    */
+    inline f32x4 exp(f32x4 x)
+    {
+        x = max(min(x, set1(88.3762626647949f)), set1(-87.3365447504019f));
+        f32x4 n = floor(add(mul(x, set1(1.44269504088896341f)), set1(0.5f)));
+        x = sub(x, mul(n, set1(0.693359375f)));
+        x = sub(x, mul(n, set1(-2.12194440e-4f)));
+
+        f32x4 y = set1(1.9875691500E-4f);
+        y = add(mul(y, x), set1(1.3981999507E-3f));
+        y = add(mul(y, x), set1(8.3334519073E-3f));
+        y = add(mul(y, x), set1(4.1665795894E-2f));
+        y = add(mul(y, x), set1(1.6666665459E-1f));
+        y = add(mul(y, x), set1(5.0000001201E-1f));
+        y = add(add(mul(mul(y, x), x), x), set1(1.0f));
+        return mul(y, pow2i(n));
+    }
+
+    // 4个lane中的最大值
+    inline float reduce_max(f32x4 a)
+    {
+        float v[4];
+        store(v, a);
+        return std::max(std::max(v[0], v[1]), std::max(v[2], v[3]));
+    }
+
+    // 4个lane的和
+    inline float reduce_add(f32x4 a)
+    {
+        float v[4];
+        store(v, a);
+        return (v[0] + v[1]) + (v[2] + v[3]);
+    }
+
+}; // namespace SIMD
+
+#endif // SIMD_HPP
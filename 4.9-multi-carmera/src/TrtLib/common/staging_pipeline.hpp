@@ -0,0 +1,106 @@
+/**
+ * 双缓冲的batch装配
+ * 解决的问题：
+ * 推理线程只有一组输入、输出缓冲时，下一个batch必须等上一个batch的前向、解码、读回全部结束后才能开始装配，
+ * 装配(拷贝mono tensor和仿射矩阵到输入)与前向完全串行
+ *
+ * 设计思路：
+ * 1. 两组缓冲(slot)交替使用，每个slot有自己的job、输入、输出和完成事件
+ * 2. 一个batch提交(launch)后不等待它完成，先取下一个batch装配到另一个slot并提交，再等待上一个batch完成并交付结果
+ *    GPU上装配在独立的上传stream上进行，通过event与推理stream同步，因此与上一个batch的前向和解码重叠
+ * 3. 有batch在途时取下一个batch不阻塞，并且只取按批处理策略已经可以出发的batch，见InferController::try_get_jobs
+ * 4. 顺序保证：
+ *    a. slot按提交的顺序complete，结果按batch的顺序交付
+ *    b. 一个slot在complete之前不会被再次装配，所以在途的batch的输入输出不会被覆盖
+ *    c. 退出前一定complete在途的slot
+ *
+ * 循环本身与设备无关，CPU后端用一个后台线程模拟stream，用来验证上面的顺序
+ **/
+
+#ifndef STAGING_PIPELINE_HPP
+#define STAGING_PIPELINE_HPP
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+template <class _Job, class _Buffers>
+class StagingPipeline
+{
+public:
+    static const int MAX_SLOTS = 2;
+
+    struct Slot
+    {
+        int index = 0;
+        long long sequence = 0; // 第几个batch，从0开始
+        std::vector<_Job> jobs;
+        _Buffers buffers;
+    };
+
+    /* 取下一个batch，blocking为false时没有可以出发的batch立即返回false
+       blocking为true时返回false表示需要退出
+    */
+    typedef std::function<bool(std::vector<_Job> &jobs, bool blocking)> FetchFunction;
+    typedef std::function<void(Slot &slot)> SlotFunction;
+
+    // num_slots为1时每个batch完成后才取下一个batch，与单缓冲的行为一致
+    StagingPipeline(int num_slots = MAX_SLOTS)
+    {
+        num_slots_ = std::min(std::max(num_slots, 1), (int)MAX_SLOTS);
+        for (int i = 0; i < MAX_SLOTS; ++i)
+            slots_[i].index = i;
+    }
+
+    int num_slots() const { return num_slots_; }
+    Slot &slot(int index) { return slots_[index]; }
+
+    /* assemble：把slot.jobs的输入拷贝到slot的输入缓冲
+       launch：在slot的缓冲上提交前向和解码，不等待完成
+       complete：等待slot完成，交付slot.jobs的结果；返回后slot.jobs被清空
+    */
+    void run(const FetchFunction &fetch, const SlotFunction &assemble, const SlotFunction &launch, const SlotFunction &complete)
+    {
+        Slot *inflight = nullptr;
+        int next = 0;
+        long long sequence = 0;
+        while (true)
+        {
+            Slot &slot = slots_[next];
+            bool fetched = fetch(slot.jobs, inflight == nullptr);
+            if (!fetched && inflight == nullptr)
+                break;
+
+            if (fetched)
+            {
+                slot.sequence = sequence++;
+                assemble(slot);
+                launch(slot);
+            }
+
+            if (inflight != nullptr)
+            {
+                complete(*inflight);
+                inflight->jobs.clear();
+                inflight = nullptr;
+            }
+
+            if (fetched && num_slots_ == 1)
+            {
+                complete(slot);
+                slot.jobs.clear();
+            }
+            else if (fetched)
+            {
+                inflight = &slot;
+                next = (next + 1) % num_slots_;
+            }
+        }
+    }
+
+private:
+    int num_slots_ = MAX_SLOTS;
+    Slot slots_[MAX_SLOTS];
+};
+
+#endif // STAGING_PIPELINE_HPP
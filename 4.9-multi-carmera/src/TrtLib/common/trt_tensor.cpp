@@ -1,9 +1,10 @@
 
 #include "trt_tensor.hpp"
 #include <algorithm>
-#include <cuda_runtime.h>
 #include "cuda_tools.cuh"
+#ifndef CPU_ONLY
 #include <cuda_fp16.h>
+#endif
 
 using namespace cv;
 using namespace std;
@@ -44,6 +45,9 @@ namespace TRT
 
     inline static int get_device(int device_id)
     {
+        if (device_id == CPU_DEVICE_ID)
+            return device_id;
+
         if (device_id != CURRENT_DEVICE_ID)
         {
             CUDATools::check_device_id(device_id);
@@ -87,7 +91,8 @@ namespace TRT
 
         this->owner_cpu_ = !(cpu && cpu_size > 0);
         this->owner_gpu_ = !(gpu && gpu_size > 0);
-        checkCudaRuntime(cudaGetDevice(&device_id_));
+        if (!host_only())
+            checkCudaRuntime(cudaGetDevice(&device_id_));
     }
 
     MixMemory::~MixMemory()
@@ -98,6 +103,10 @@ namespace TRT
     void *MixMemory::gpu(size_t size)
     {
 
+        // 纯主机内存下，gpu与cpu共用同一块内存
+        if (host_only())
+            return cpu(size);
+
         if (gpu_size_ < size)
         {
             release_gpu();
@@ -118,8 +127,15 @@ namespace TRT
             release_cpu();
 
             cpu_size_ = size;
-            CUDATools::AutoDevice auto_device_exchange(device_id_);
-            checkCudaRuntime(cudaMallocHost(&cpu_, size));
+            if (host_only())
+            {
+                cpu_ = malloc(size);
+            }
+            else
+            {
+                CUDATools::AutoDevice auto_device_exchange(device_id_);
+                checkCudaRuntime(cudaMallocHost(&cpu_, size));
+            }
             Assert(cpu_ != nullptr);
             memset(cpu_, 0, size);
         }
@@ -132,8 +148,15 @@ namespace TRT
         {
             if (owner_cpu_)
             {
-                CUDATools::AutoDevice auto_device_exchange(device_id_);
-                checkCudaRuntime(cudaFreeHost(cpu_));
+                if (host_only())
+                {
+                    free(cpu_);
+                }
+                else
+                {
+                    CUDATools::AutoDevice auto_device_exchange(device_id_);
+                    checkCudaRuntime(cudaFreeHost(cpu_));
+                }
             }
             cpu_ = nullptr;
         }
@@ -306,11 +329,11 @@ namespace TRT
 
     shared_ptr<Tensor> Tensor::clone() const
     {
-        auto new_tensor = make_shared<Tensor>(shape_, dtype_);
+        auto new_tensor = make_shared<Tensor>(shape_, dtype_, nullptr, host_only() ? CPU_DEVICE_ID : CURRENT_DEVICE_ID);
         if (head_ == DataHead::Init)
             return new_tensor;
 
-        if (head_ == DataHead::Host)
+        if (head_ == DataHead::Host || host_only())
         {
             memcpy(new_tensor->cpu(), this->cpu(), this->bytes_);
         }
@@ -343,7 +366,12 @@ namespace TRT
             return *this;
         }
 
-        if (head_ == DataHead::Device)
+        if (host_only())
+        {
+            // 纯主机内存，src也视为主机指针
+            memcpy(cpu<unsigned char>() + offset_location, src, copyed_bytes);
+        }
+        else if (head_ == DataHead::Device)
         {
             int current_device_id = get_device(device_id);
             int gpu_device_id = device();
@@ -390,12 +418,12 @@ namespace TRT
             return *this;
         }
 
-        if (head_ == DataHead::Device)
+        if (head_ == DataHead::Device && !host_only())
         {
             CUDATools::AutoDevice auto_device_exchange(this->device());
             checkCudaRuntime(cudaMemcpyAsync((char *)data_->gpu() + offset_location, src, copyed_bytes, cudaMemcpyHostToDevice, stream_));
         }
-        else if (head_ == DataHead::Host)
+        else if (head_ == DataHead::Host || host_only())
         {
             // checkCudaRuntime(cudaMemcpyAsync((char*)data_->cpu() + offset_location, src, copyed_bytes, cudaMemcpyHostToHost, stream_));
             memcpy((char *)data_->cpu() + offset_location, src, copyed_bytes);
@@ -413,7 +441,7 @@ namespace TRT
         shape_.clear();
         bytes_ = 0;
         head_ = DataHead::Init;
-        if (stream_owner_ && stream_ != nullptr)
+        if (stream_owner_ && stream_ != nullptr && !host_only())
         {
             CUDATools::AutoDevice auto_device_exchange(this->device());
             checkCudaRuntime(cudaStreamDestroy(stream_));
@@ -464,29 +492,30 @@ namespace TRT
 
         Assert(idim >= 0 && idim < shape_.size());
 
-        auto new_shape = shape_;
-        new_shape[idim] = size;
-        return resize(new_shape);
+        shape_[idim] = size;
+        const int *dims = shape_.data();
+        return resize((int)shape_.size(), dims);
     }
 
     Tensor &Tensor::resize(int ndims, const int *dims)
     {
-
-        vector<int> setup_dims(ndims);
+        // 直接在shape_上修改，维数不变时不分配内存，每一帧都会调用
+        // dims可能指向shape_自身，此时ndims与shape_.size()相同，resize不会重新分配，第i维只在读取后写入
+        bool same_ndims = ndims == (int)shape_.size();
+        shape_.resize(ndims);
         for (int i = 0; i < ndims; ++i)
         {
             int dim = dims[i];
             if (dim == -1)
             {
-                Assert(ndims == shape_.size());
+                Assert(same_ndims);
                 dim = shape_[i];
             }
-            setup_dims[i] = dim;
+            shape_[i] = dim;
         }
-        this->shape_ = setup_dims;
 
         // strides = element_size
-        this->strides_.resize(setup_dims.size());
+        this->strides_.resize(shape_.size());
 
         size_t prev_size = element_size();
         size_t prev_shape = 1;
@@ -519,6 +548,9 @@ namespace TRT
 
     Tensor &Tensor::synchronize()
     {
+        if (host_only())
+            return *this;
+
         CUDATools::AutoDevice auto_device_exchange(this->device());
         checkCudaRuntime(cudaStreamSynchronize(stream_));
         return *this;
@@ -533,7 +565,8 @@ namespace TRT
         head_ = DataHead::Device;
         data_->gpu(bytes_);
 
-        if (copy && data_->cpu() != nullptr)
+        // 纯主机内存下gpu与cpu是同一块内存，无需拷贝
+        if (copy && data_->cpu() != nullptr && !host_only())
         {
             CUDATools::AutoDevice auto_device_exchange(this->device());
             checkCudaRuntime(cudaMemcpyAsync(data_->gpu(), data_->cpu(), bytes_, cudaMemcpyHostToDevice, stream_));
@@ -550,7 +583,7 @@ namespace TRT
         head_ = DataHead::Host;
         data_->cpu(bytes_);
 
-        if (copy && data_->gpu() != nullptr)
+        if (copy && data_->gpu() != nullptr && !host_only())
         {
             CUDATools::AutoDevice auto_device_exchange(this->device());
             checkCudaRuntime(cudaMemcpyAsync(data_->cpu(), data_->gpu(), bytes_, cudaMemcpyDeviceToHost, stream_));
@@ -13,6 +13,9 @@ typedef CUstream_st CUStreamRaw;
 
 #define CURRENT_DEVICE_ID -1
 
+// 纯主机内存，不做任何CUDA分配，gpu()与cpu()指向同一块内存，用于CPU后端
+#define CPU_DEVICE_ID -2
+
 namespace TRT
 {
 
@@ -61,8 +64,9 @@ namespace TRT
         inline size_t cpu_size() const { return cpu_size_; }
         inline size_t gpu_size() const { return gpu_size_; }
         inline int device_id() const { return device_id_; }
+        inline bool host_only() const { return device_id_ == CPU_DEVICE_ID; }
 
-        inline void *gpu() const { return gpu_; }
+        inline void *gpu() const { return host_only() ? cpu_ : gpu_; }
 
         // Pinned Memory
         inline void *cpu() const { return cpu_; }
@@ -137,6 +141,7 @@ namespace TRT
         Tensor &resize_single_dim(int idim, int size);
         int count(int start_axis = 0) const;
         int device() const { return device_id_; }
+        bool host_only() const { return device_id_ == CPU_DEVICE_ID; }
 
         Tensor &to_gpu(bool copy = true);
         Tensor &to_cpu(bool copy = true);
@@ -0,0 +1,343 @@
+/*
+ * CPU后端，实现与TensorRT引擎相同的TRT::Infer接口
+ * 所有tensor使用纯主机内存(CPU_DEVICE_ID)，tensor->gpu()与tensor->cpu()指向同一块内存
+ * 因此基于tensor()/forward()/get_max_batch_size()编写的调度、批处理、后处理逻辑，可以在无GPU的机器上运行和压测
+ */
+
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include "common/ilogger.hpp"
+#include "trt_infer.hpp"
+
+using namespace std;
+
+namespace TRT {
+
+	class CPUInferImpl : public Infer {
+
+	public:
+		virtual ~CPUInferImpl() { destroy(); }
+		virtual bool load(const CPUModelConfig& config);
+		virtual void destroy();
+		virtual void forward(bool sync) override;
+		virtual int get_max_batch_size() override { return config_.max_batch_size; }
+		virtual CUStream get_stream() override { return stream_; }
+		virtual void set_stream(CUStream stream) override { stream_ = stream; }
+		virtual void synchronize() override {}
+		virtual size_t get_device_memory_size() override { return 0; }
+		virtual std::shared_ptr<MixMemory> get_workspace() override { return workspace_; }
+		virtual std::shared_ptr<Tensor> input(int index = 0) override;
+		virtual std::string get_input_name(int index = 0) override;
+		virtual std::shared_ptr<Tensor> output(int index = 0) override;
+		virtual std::string get_output_name(int index = 0) override;
+		virtual std::shared_ptr<Tensor> tensor(const std::string& name) override;
+		virtual bool is_output_name(const std::string& name) override;
+		virtual bool is_input_name(const std::string& name) override;
+		virtual void set_input (int index, std::shared_ptr<Tensor> tensor) override;
+		virtual void set_output(int index, std::shared_ptr<Tensor> tensor) override;
+		virtual std::shared_ptr<std::vector<uint8_t>> serial_engine() override;
+		virtual void print() override;
+		virtual int num_output() override { return static_cast<int>(outputs_.size()); }
+		virtual int num_input() override { return static_cast<int>(inputs_.size()); }
+		virtual int device() override { return CPU_DEVICE_ID; }
+
+	private:
+		void yolo_grid_forward(int batch_size);
+		void simulate_cost(int batch_size, double elapsed_ms);
+
+	private:
+		CPUModelConfig config_;
+		std::vector<std::shared_ptr<Tensor>> inputs_;
+		std::vector<std::shared_ptr<Tensor>> outputs_;
+		std::vector<std::string> inputs_name_;
+		std::vector<std::string> outputs_name_;
+		std::shared_ptr<MixMemory> workspace_;
+		CUStream stream_ = nullptr;
+	};
+
+	////////////////////////////////////////////////////////////////////////////////////
+	void CPUInferImpl::destroy() {
+		inputs_.clear();
+		outputs_.clear();
+		inputs_name_.clear();
+		outputs_name_.clear();
+		workspace_.reset();
+	}
+
+	bool CPUInferImpl::load(const CPUModelConfig& config) {
+
+		if (config.inputs.empty() || config.outputs.empty()) {
+			INFOE("CPU model requires at least one input and one output");
+			return false;
+		}
+
+		if (config.max_batch_size < 1) {
+			INFOE("Invalid max batch size %d", config.max_batch_size);
+			return false;
+		}
+
+		destroy();
+		config_ = config;
+		workspace_.reset(new MixMemory(CPU_DEVICE_ID));
+
+		auto make_blob = [&](const std::pair<std::string, std::vector<int>>& item) -> shared_ptr<Tensor> {
+			auto dims = item.second;
+			if (dims.empty()) {
+				INFOE("Blob '%s' has no dims", item.first.c_str());
+				return nullptr;
+			}
+			dims[0] = config_.max_batch_size;
+			auto newTensor = make_shared<Tensor>(dims, DataType::Float, nullptr, CPU_DEVICE_ID);
+			newTensor->set_workspace(workspace_);
+			newTensor->to_cpu(false);
+			return newTensor;
+		};
+
+		for (auto& item : config_.inputs) {
+			auto newTensor = make_blob(item);
+			if (newTensor == nullptr) return false;
+			inputs_.push_back(newTensor);
+			inputs_name_.push_back(item.first);
+		}
+
+		for (auto& item : config_.outputs) {
+			auto newTensor = make_blob(item);
+			if (newTensor == nullptr) return false;
+			outputs_.push_back(newTensor);
+			outputs_name_.push_back(item.first);
+		}
+
+		if (config_.model == CPUModel::YoloGrid) {
+			if (inputs_[0]->ndims() != 4 || outputs_[0]->ndims() != 3 || outputs_[0]->size(2) < 6) {
+				INFOE("YoloGrid model requires input [n, 3, h, w] and output [n, num_bboxes, 5 + num_classes]");
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void CPUInferImpl::print() {
+		INFO("Infer %p detail", this);
+		INFO("\tBase device: CPU, model %s", config_.compute ? "Custom" : (config_.model == CPUModel::YoloGrid ? "YoloGrid" : "Synthetic"));
+		INFO("\tCost: %.3f ms + %.3f ms x batch, %s", config_.base_cost_ms, config_.per_image_cost_ms, config_.busy_wait ? "busy wait" : "sleep");
+		INFO("\tMax Batch Size: %d", this->get_max_batch_size());
+		INFO("\tInputs: %d", inputs_.size());
+		for (int i = 0; i < (int)inputs_.size(); ++i) {
+			INFO("\t\t%d.%s : shape {%s}, %s", i, inputs_name_[i].c_str(), inputs_[i]->shape_string(), data_type_string(inputs_[i]->type()));
+		}
+
+		INFO("\tOutputs: %d", outputs_.size());
+		for (int i = 0; i < (int)outputs_.size(); ++i) {
+			INFO("\t\t%d.%s : shape {%s}, %s", i, outputs_name_[i].c_str(), outputs_[i]->shape_string(), data_type_string(outputs_[i]->type()));
+		}
+	}
+
+	void CPUInferImpl::forward(bool sync) {
+
+		auto tick = iLogger::timestamp_now_float();
+		int inputBatchSize = inputs_[0]->size(0);
+		for (int i = 0; i < (int)outputs_.size(); ++i) {
+			outputs_[i]->resize_single_dim(0, inputBatchSize);
+			outputs_[i]->to_cpu(false);
+		}
+
+		if (config_.compute) {
+			config_.compute(this, inputBatchSize);
+		}
+		else if (config_.model == CPUModel::YoloGrid) {
+			yolo_grid_forward(inputBatchSize);
+		}
+		else {
+			for (auto& output : outputs_)
+				memset(output->cpu(), 0, output->bytes());
+		}
+		simulate_cost(inputBatchSize, iLogger::timestamp_now_float() - tick);
+	}
+
+	void CPUInferImpl::simulate_cost(int batch_size, double elapsed_ms) {
+
+		double remain_ms = config_.base_cost_ms + config_.per_image_cost_ms * batch_size - elapsed_ms;
+		if (remain_ms <= 0)
+			return;
+
+		auto deadline = chrono::steady_clock::now() + chrono::microseconds((long long)(remain_ms * 1000));
+		if (config_.busy_wait) {
+			while (chrono::steady_clock::now() < deadline);
+		}
+		else {
+			this_thread::sleep_until(deadline);
+		}
+	}
+
+	/* 内置的网格模型
+	   把输入划分为 grid x grid 个单元，每个单元对应一个bbox，grid = ceil(sqrt(num_bboxes))
+	   objectness = 单元内三通道均值超过0.5的部分 x 2，类别由第三通道均值决定，box为单元本身（输入尺度下的cx, cy, w, h）
+	   输出只依赖输入内容，结果确定，便于在CPU上验证解码和后处理逻辑
+	*/
+	void CPUInferImpl::yolo_grid_forward(int batch_size) {
+
+		auto& input = inputs_[0];
+		auto& output = outputs_[0];
+		int channels = input->size(1);
+		int height = input->size(2);
+		int width = input->size(3);
+		int num_bboxes = output->size(1);
+		int num_element = output->size(2);
+		int num_classes = num_element - 5;
+		int grid = (int)ceil(sqrt((float)num_bboxes));
+		float cell_width = width / (float)grid;
+		float cell_height = height / (float)grid;
+		const int num_samples = 4;
+
+		for (int ibatch = 0; ibatch < batch_size; ++ibatch) {
+			float* pimage = input->cpu<float>(ibatch);
+			float* pout = output->cpu<float>(ibatch);
+			memset(pout, 0, sizeof(float) * num_bboxes * num_element);
+
+			for (int i = 0; i < num_bboxes && i < grid * grid; ++i) {
+				float cx = (i % grid + 0.5f) * cell_width;
+				float cy = (i / grid + 0.5f) * cell_height;
+				float mean[3] = {0};
+				for (int sy = 0; sy < num_samples; ++sy) {
+					int y = min(height - 1, (int)(cy + (sy - num_samples * 0.5f + 0.5f) * cell_height / num_samples));
+					for (int sx = 0; sx < num_samples; ++sx) {
+						int x = min(width - 1, (int)(cx + (sx - num_samples * 0.5f + 0.5f) * cell_width / num_samples));
+						for (int c = 0; c < 3 && c < channels; ++c)
+							mean[c] += pimage[(c * height + y) * width + x];
+					}
+				}
+
+				for (int c = 0; c < 3; ++c)
+					mean[c] = max(0.0f, min(1.0f, mean[c] / (num_samples * num_samples)));
+
+				float* pbox = pout + i * num_element;
+				int label = min(num_classes - 1, (int)(mean[2] * num_classes));
+				pbox[0] = cx;
+				pbox[1] = cy;
+				pbox[2] = cell_width;
+				pbox[3] = cell_height;
+				pbox[4] = max(0.0f, (mean[0] + mean[1] + mean[2]) / 3.0f - 0.5f) * 2.0f;
+				pbox[5 + label] = 1.0f;
+			}
+		}
+	}
+
+	std::shared_ptr<std::vector<uint8_t>> CPUInferImpl::serial_engine() {
+		return make_shared<std::vector<uint8_t>>();
+	}
+
+	bool CPUInferImpl::is_output_name(const std::string& name) {
+		return std::find(outputs_name_.begin(), outputs_name_.end(), name) != outputs_name_.end();
+	}
+
+	bool CPUInferImpl::is_input_name(const std::string& name) {
+		return std::find(inputs_name_.begin(), inputs_name_.end(), name) != inputs_name_.end();
+	}
+
+	void CPUInferImpl::set_input(int index, std::shared_ptr<Tensor> tensor) {
+		if (index < 0 || index >= (int)inputs_.size()) {
+			INFOF("Input index[%d] out of range [size=%d]", index, inputs_.size());
+		}
+		inputs_[index] = tensor;
+	}
+
+	void CPUInferImpl::set_output(int index, std::shared_ptr<Tensor> tensor) {
+		if (index < 0 || index >= (int)outputs_.size()) {
+			INFOF("Output index[%d] out of range [size=%d]", index, outputs_.size());
+		}
+		outputs_[index] = tensor;
+	}
+
+	std::shared_ptr<Tensor> CPUInferImpl::input(int index) {
+		if (index < 0 || index >= (int)inputs_.size()) {
+			INFOF("Input index[%d] out of range [size=%d]", index, inputs_.size());
+		}
+		return inputs_[index];
+	}
+
+	std::string CPUInferImpl::get_input_name(int index) {
+		if (index < 0 || index >= (int)inputs_name_.size()) {
+			INFOF("Input index[%d] out of range [size=%d]", index, inputs_name_.size());
+		}
+		return inputs_name_[index];
+	}
+
+	std::shared_ptr<Tensor> CPUInferImpl::output(int index) {
+		if (index < 0 || index >= (int)outputs_.size()) {
+			INFOF("Output index[%d] out of range [size=%d]", index, outputs_.size());
+		}
+		return outputs_[index];
+	}
+
+	std::string CPUInferImpl::get_output_name(int index) {
+		if (index < 0 || index >= (int)outputs_name_.size()) {
+			INFOF("Output index[%d] out of range [size=%d]", index, outputs_name_.size());
+		}
+		return outputs_name_[index];
+	}
+
+	std::shared_ptr<Tensor> CPUInferImpl::tensor(const std::string& name) {
+
+		for (int i = 0; i < (int)inputs_name_.size(); ++i) {
+			if (inputs_name_[i] == name) return inputs_[i];
+		}
+
+		for (int i = 0; i < (int)outputs_name_.size(); ++i) {
+			if (outputs_name_[i] == name) return outputs_[i];
+		}
+
+		INFOF("Could not found the input/output node '%s', please makesure your model", name.c_str());
+		return nullptr;
+	}
+
+	CPUModelConfig cpu_yolo_model(
+		int max_batch_size, int input_width, int input_height,
+		int num_bboxes, int num_classes,
+		float base_cost_ms, float per_image_cost_ms) {
+
+		CPUModelConfig config;
+		config.inputs.push_back(make_pair(string("images"), vector<int>{max_batch_size, 3, input_height, input_width}));
+		config.outputs.push_back(make_pair(string("output"), vector<int>{max_batch_size, num_bboxes, 5 + num_classes}));
+		config.max_batch_size = max_batch_size;
+		config.base_cost_ms = base_cost_ms;
+		config.per_image_cost_ms = per_image_cost_ms;
+		config.model = CPUModel::YoloGrid;
+		return config;
+	}
+
+	std::shared_ptr<Infer> load_cpu_infer(const CPUModelConfig& config) {
+
+		std::shared_ptr<CPUInferImpl> Infer(new CPUInferImpl());
+		if (!Infer->load(config))
+			Infer.reset();
+		return Infer;
+	}
+
+#ifdef CPU_ONLY
+	// 没有CUDA和TensorRT时trt_infer.cpp不参与编译，只能加载CPU后端
+	std::shared_ptr<Infer> load_infer_from_memory(const void* pdata, size_t size) {
+		INFOE("TensorRT engine is not available, built with USE_CUDA=OFF");
+		return nullptr;
+	}
+
+	std::shared_ptr<Infer> load_infer(const string& file) {
+		INFOE("TensorRT engine %s is not available, built with USE_CUDA=OFF", file.c_str());
+		return nullptr;
+	}
+
+	DeviceMemorySummary get_current_device_summary() {
+		DeviceMemorySummary info;
+		info.total = 0;
+		info.available = 0;
+		return info;
+	}
+
+	int get_device_count() { return 0; }
+	int get_device() { return 0; }
+	void set_device(int device_id) {}
+	bool init_nv_plugins() { return false; }
+#endif // CPU_ONLY
+};
@@ -14,6 +14,7 @@
 #include <memory>
 #include <vector>
 #include <map>
+#include <functional>
 #include "../common/trt_tensor.hpp"
 
 namespace TRT
@@ -45,6 +46,57 @@ namespace TRT
 		virtual std::shared_ptr<std::vector<uint8_t>> serial_engine() = 0;
 	};
 
+	enum class Backend : int
+	{
+		TensorRT = 0,
+		CPU = 1
+	};
+
+	enum class CPUModel : int
+	{
+		Synthetic = 0, // 输出清零，只模拟计算耗时
+		YoloGrid = 1   // 内置的小模型，按网格统计输入生成yolo格式的输出[batch, num_bboxes, 5 + num_classes]
+	};
+
+	/* CPU后端的模型描述
+	   所有tensor的dims[0]为batch维度，会被max_batch_size覆盖
+	   每次forward的耗时为 base_cost_ms + per_image_cost_ms * batch，用以模拟引擎的吞吐曲线
+	*/
+	struct CPUModelConfig
+	{
+		std::vector<std::pair<std::string, std::vector<int>>> inputs;
+		std::vector<std::pair<std::string, std::vector<int>>> outputs;
+		int max_batch_size = 16;
+		float base_cost_ms = 0;
+		float per_image_cost_ms = 0;
+
+		// true：忙等占用CPU核心，模拟CPU推理；false：sleep，模拟异步设备上的推理
+		bool busy_wait = false;
+		CPUModel model = CPUModel::Synthetic;
+
+		// 自定义计算，设置后替代内置模型，参数为引擎和本次batch大小
+		std::function<void(Infer *engine, int batch_size)> compute;
+	};
+
+	// 输入为images[batch, 3, height, width]，输出为output[batch, num_bboxes, 5 + num_classes]，与Yolo引擎的绑定名一致
+	CPUModelConfig cpu_yolo_model(
+		int max_batch_size, int input_width = 640, int input_height = 640,
+		int num_bboxes = 25200, int num_classes = 80,
+		float base_cost_ms = 0, float per_image_cost_ms = 0);
+
+	// 引擎的来源：TensorRT时从file加载到gpuid上，CPU时按model创建
+	struct EngineSource
+	{
+		Backend backend = Backend::TensorRT;
+		std::string file;
+		int gpuid = 0;
+		CPUModelConfig model;
+
+		EngineSource() = default;
+		EngineSource(const std::string &file, int gpuid) : backend(Backend::TensorRT), file(file), gpuid(gpuid) {}
+		EngineSource(const CPUModelConfig &model) : backend(Backend::CPU), model(model) {}
+	};
+
 	struct DeviceMemorySummary
 	{
 		size_t total;
@@ -58,6 +110,7 @@ namespace TRT
 	void set_device(int device_id);
 	std::shared_ptr<Infer> load_infer_from_memory(const void *pdata, size_t size);
 	std::shared_ptr<Infer> load_infer(const std::string &file);
+	std::shared_ptr<Infer> load_cpu_infer(const CPUModelConfig &config);
 	bool init_nv_plugins();
 
 }; // TRTInfer
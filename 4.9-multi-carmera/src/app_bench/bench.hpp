@@ -0,0 +1,81 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+/**
+ * @brief 无需GPU即可运行的压测用例
+ * 统一由根目录下的benchmark.cpp按名字调用，例如 ./benchmark pipeline
+ */
+
+// CPU后端上InferController的吞吐与延迟
+int bench_cpu_pipeline(int num_producers = 4, int images_per_producer = 200, float base_cost_ms = 2.0f, float per_image_cost_ms = 0.5f);
+
+// 不同max_queue_delay下的batch分布、吞吐和延迟，interval_ms为每个生产者的提交间隔
+int bench_batching(int num_producers = 4, int images_per_producer = 200, double interval_ms = 20.0);
+
+// 预处理/后处理在调用线程、推理线程上执行与使用独立线程池时的吞吐及各阶段占用率
+int bench_stages(int num_producers = 8, int images_per_producer = 50);
+
+// 相机实时帧与批量commits同时进行，单一FIFO与优先级调度下相机帧的延迟
+int bench_priority(int num_cameras = 2, int frames_per_camera = 50, int num_bulk_images = 500);
+
+// 相机帧率超过引擎处理能力时，不限制、限制队列深度/排队时长、只保留最新帧三种方式的延迟与丢弃数量
+int bench_admission(int num_cameras = 4, int frames_per_camera = 100, double interval_ms = 10.0);
+
+// 过载时不设截止时间、设置deadline_ms、deadline加上提交后立即取消，三种情况下跳过的job与节省的推理/后处理时间
+int bench_cancellation(int num_cameras = 4, int frames_per_camera = 100, double interval_ms = 10.0, int deadline_ms = 30);
+
+// future与回调两种提交方式在稳态下每帧的内存分配次数，以及promise不同创建方式的分配次数
+int bench_allocations(int num_frames = 2000);
+
+// 分片直方图与单个原子直方图的记录开销，以及CPU后端上的分阶段延迟快照和json输出
+int bench_metrics(int num_producers = 4, int images_per_producer = 100);
+
+// 推理线程单缓冲与双缓冲：并发提交下结果与逐张推理一致的顺序校验，以及吞吐和上传、前向耗时
+int bench_staging(int num_producers = 8, int images_per_producer = 100);
+
+// 副本集：模拟副本上轮询与最少未完成数分发的延迟和健康检查，以及CPU后端上快慢两个实例组成副本集的吞吐
+int bench_replicas(int num_jobs = 2000, double interval_ms = 0.8);
+
+// 吞吐在batch 5附近饱和的模型上，固定使用最大batch与按p99延迟目标在线学习batch上限的吞吐、延迟和学习到的曲线
+int bench_adaptive(int num_producers = 2, int images_per_producer = 1000, double interval_ms = 10.0, double latency_slo_ms = 40.0);
+
+// 按内容哈希的结果缓存：哈希与解码的耗时、并发相同请求的single-flight，以及热点图片占多数时有无缓存的吞吐和命中率
+int bench_result_cache(int num_threads = 8, int requests_per_thread = 100, int num_images = 64);
+
+// CPU nms：cpu_nms_fast与cpu_nms逐位比较结果，64~4096个框时的耗时，以及batch内多张图并行
+int bench_nms(int batch_size = 16, int repeat = 100);
+
+// NMSMethod的各个CPU方法：DIoU、class-agnostic、soft nms与参考实现的一致性，以及与cpu_nms相比每1k个框的耗时
+int bench_nms_methods(int repeat = 50);
+
+// CPU解码：cpu_decode与标量解码逐位比较，640输入时标量、SIMD、多线程SIMD的耗时
+int bench_decode(int repeat = 50);
+
+// CPU预处理：融合的仿射变换 + 归一化 + HWC->CHW与标量实现逐位比较，以及与cv::warpAffine + 逐像素归一化相比的耗时
+int bench_preprocess(int repeat = 20);
+
+// 外部的帧：带行对齐的BGR、RGB与连续的cv::Mat预处理结果相同，NV12转BGR与核函数相同，release恰好调用一次，以及NV12转BGR的耗时
+int bench_external_frames(int num_frames = 200);
+
+// 切片推理：单个切片与直接推理结果相同，4K图上小目标在不同切片大小、重叠比例下的召回、重复框、吞吐与合并耗时
+int bench_tiles(int num_images = 8, int width = 3840, int height = 2160);
+
+// 多目标跟踪：匈牙利算法与穷举一致，模拟场景中每帧检测与隔N帧检测时的引擎负载、召回、ID切换与跟踪耗时
+int bench_tracker(int num_frames = 1000, int num_objects = 12);
+
+// 运动门控：静止、亮度漂移、移动方块画面上运动检测的正确性，4路相机不门控与门控时提交给引擎的帧数、耗时、跳过率与召回
+int bench_motion(int num_frames = 200, int width = 1280, int height = 720);
+
+// 拼图推理：随机布局上打包与分配的正确性，多路子码流逐帧letterbox与拼图时提交给引擎的图数、填充率、召回与吞吐
+int bench_mosaic(int num_cameras = 24, int num_rounds = 20);
+
+// 检测 -> 分类：softmax与top-k的正确性与耗时，逐个裁剪分类与级联(框直接warp、跨帧凑batch)的准确率、吞吐与每一级的延迟
+int bench_cascade(int num_frames = 16, int width = 640, int height = 360);
+
+// 语义分割：SIMD argmax的正确性与耗时，与4.3后处理的结果比较，RLE、多边形、像素准确率与吞吐
+int bench_seg(int num_frames = 16, int width = 1280, int height = 720);
+
+// 任务队列微基准：mutex+condition_variable队列与MPMCQueue在1~64个生产者下的吞吐与入队到出队延迟
+int bench_job_queue(int num_consumers = 4, int total_items = 200000);
+
+#endif // BENCH_HPP
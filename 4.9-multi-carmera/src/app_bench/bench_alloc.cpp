@@ -0,0 +1,144 @@
+#include "bench.hpp"
+#include "bench_tools.hpp"
+#include "cpu_yolo.hpp"
+#include "TrtLib/common/object_pool.hpp"
+#include <new>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
+
+using namespace std;
+
+/* 替换全局的operator new/delete，统计整个benchmark进程的分配次数
+   bench是只链接到benchmark的静态库，不影响主程序
+*/
+static atomic<long long> g_num_allocations(0);
+
+void *operator new(size_t size)
+{
+    g_num_allocations.fetch_add(1, memory_order_relaxed);
+    void *ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr)
+        throw bad_alloc();
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    free(ptr);
+}
+
+static long long num_allocations()
+{
+    return g_num_allocations.load(memory_order_relaxed);
+}
+
+// 每次创建promise、取future、以拷贝/移动的方式赋值，num_boxes个框
+template <class CreatePromise>
+static double promise_allocations(int num_frames, int num_boxes, bool move_output, CreatePromise create)
+{
+    ObjectDetector::BoxArray boxes(num_boxes);
+    auto begin = num_allocations();
+    for (int i = 0; i < num_frames; ++i)
+    {
+        auto pro = create();
+        shared_future<ObjectDetector::BoxArray> result = pro->get_future();
+        auto output = boxes;
+        if (move_output)
+            pro->set_value(std::move(output));
+        else
+            pro->set_value(output);
+        result.get();
+    }
+    return (num_allocations() - begin) / (double)num_frames;
+}
+
+/* future与回调两种提交方式在稳态下每帧的分配次数
+   前半部分对比promise的创建方式，后半部分是CPU后端上完整的commit流程(包含预处理、解码、nms)
+*/
+int bench_allocations(int num_frames)
+{
+    typedef ObjectDetector::BoxArray BoxArray;
+    INFO("promise per frame (20 boxes):");
+    INFO("  make_shared + copy:  %.2f allocations", promise_allocations(num_frames, 20, false, []()
+                                                                           { return make_shared<promise<BoxArray>>(); }));
+    INFO("  make_shared + move:  %.2f allocations", promise_allocations(num_frames, 20, true, []()
+                                                                           { return make_shared<promise<BoxArray>>(); }));
+    INFO("  pooled + move:       %.2f allocations", promise_allocations(num_frames, 20, true, []()
+                                                                           { return allocate_shared<promise<BoxArray>>(
+                                                                                 PoolAllocator<promise<BoxArray>>(), allocator_arg, PoolAllocator<BoxArray>()); }));
+
+    auto model = TRT::cpu_yolo_model(8, 320, 320, 400, 80, 0.5f, 0.1f);
+    auto infer = CPUYolo::create_infer(model, 0.25f, 0.45f);
+    if (infer == nullptr)
+    {
+        INFOE("Create cpu infer failed.");
+        return -1;
+    }
+
+    vector<cv::Mat> images;
+    for (int i = 0; i < 16; ++i)
+        images.push_back(BenchTools::make_image(640, 360, i));
+
+    // warmup，让allocator、对象池、tensor都达到稳态
+    for (int i = 0; i < 64; ++i)
+        infer->commit(images[i % images.size()]).get();
+
+    vector<shared_future<BoxArray>> results;
+    results.reserve(num_frames);
+    long long num_boxes = 0;
+    auto begin = num_allocations();
+    for (int i = 0; i < num_frames; ++i)
+    {
+        results.emplace_back(infer->commit(images[i % images.size()]));
+        if (results.size() >= 8)
+        {
+            for (auto &item : results)
+                num_boxes += item.get().size();
+            results.clear();
+        }
+    }
+    for (auto &item : results)
+        num_boxes += item.get().size();
+    double future_allocations = (num_allocations() - begin) / (double)num_frames;
+    INFO("commit future:   %.2f allocations per frame, %.1f boxes per frame", future_allocations, num_boxes / (double)num_frames);
+
+    atomic<long long> num_finished(0);
+    atomic<long long> num_callback_boxes(0);
+    auto callback = [&](BoxArray &boxes)
+    {
+        num_callback_boxes += boxes.size();
+        num_finished++;
+    };
+
+    for (int i = 0; i < 64; ++i)
+        infer->commit(images[i % images.size()], callback);
+    while (num_finished < 64)
+        this_thread::yield();
+
+    num_finished = 0;
+    num_callback_boxes = 0;
+    begin = num_allocations();
+    for (int i = 0; i < num_frames; ++i)
+    {
+        infer->commit(images[i % images.size()], callback);
+        while (i + 1 - num_finished >= 8)
+            this_thread::yield();
+    }
+    while (num_finished < num_frames)
+        this_thread::yield();
+
+    double callback_allocations = (num_allocations() - begin) / (double)num_frames;
+    INFO("commit callback: %.2f allocations per frame, %.1f boxes per frame", callback_allocations, num_callback_boxes / (double)num_frames);
+    return 0;
+}
@@ -0,0 +1,171 @@
+#include "bench.hpp"
+#include "bench_tools.hpp"
+#include "cpu_yolo.hpp"
+#include "TrtLib/common/result_cache.hpp"
+#include <thread>
+#include <atomic>
+#include <random>
+
+using namespace std;
+
+typedef ResultCache<ObjectDetector::BoxArray> BoxCache;
+
+// 与main.cpp中/api/detect相同：解码jpeg后推理，被拒绝的job返回nullptr
+static shared_ptr<const ObjectDetector::BoxArray> decode_and_infer(shared_ptr<Yolo::Infer> &infer, const vector<uint8_t> &data,
+                                                                   const JobOptions &job_options = JobOptions())
+{
+    auto image = cv::imdecode(data, 1);
+    if (image.empty())
+        return nullptr;
+
+    JobOptions options = job_options;
+    options.outcome = JobOutcome::create();
+    auto boxes = infer->commit(image, options).get();
+    if (options.outcome->rejected())
+        return nullptr;
+    return make_shared<ObjectDetector::BoxArray>(std::move(boxes));
+}
+
+/* 1. 内容哈希的速度
+   2. single-flight：多个线程同时提交同一张图，只推理一次
+   3. 模拟http请求：num_images张jpeg，80%的请求落在其中1/8的热门图上，对比不使用缓存与使用缓存的吞吐和延迟
+*/
+int bench_result_cache(int num_threads, int requests_per_thread, int num_images)
+{
+    vector<vector<uint8_t>> jpegs(num_images);
+    for (int i = 0; i < num_images; ++i)
+        cv::imencode(".jpg", BenchTools::make_image(640, 360, i), jpegs[i]);
+
+    {
+        const int repeat = 200;
+        uint64_t sum = 0;
+        auto tick = iLogger::timestamp_now_float();
+        for (int i = 0; i < repeat; ++i)
+            sum += content_hash(jpegs[i % num_images].data(), jpegs[i % num_images].size());
+        double elapsed_ms = iLogger::timestamp_now_float() - tick;
+
+        tick = iLogger::timestamp_now_float();
+        for (int i = 0; i < repeat; ++i)
+            sum += cv::imdecode(jpegs[i % num_images], 1).rows;
+        double decode_ms = iLogger::timestamp_now_float() - tick;
+        INFO("content hash: %.1f KB jpeg, hash %.3f ms, decode %.3f ms (checksum %llu)",
+             jpegs[0].size() / 1024.0, elapsed_ms / repeat, decode_ms / repeat, (unsigned long long)(sum & 0xFF));
+    }
+
+    auto model = TRT::cpu_yolo_model(8, 320, 320, 400, 80, 4.0f, 0.5f);
+    auto infer = CPUYolo::create_infer(model, 0.25f, 0.45f);
+    if (infer == nullptr)
+    {
+        INFOE("Create cpu infer failed.");
+        return -1;
+    }
+    infer->commit(BenchTools::make_image(640, 360)).get();
+
+    {
+        BoxCache cache;
+        atomic<int> num_computes(0);
+        vector<thread> threads;
+        vector<shared_ptr<const ObjectDetector::BoxArray>> results(num_threads);
+        uint64_t key = content_hash(jpegs[0].data(), jpegs[0].size());
+        BoxCache::ComputeFunction compute = [&]()
+        {
+            num_computes++;
+            return decode_and_infer(infer, jpegs[0]);
+        };
+
+        for (int i = 0; i < num_threads; ++i)
+        {
+            threads.emplace_back([&, i]()
+                                 { results[i] = cache.get_or_compute(key, compute).get(); });
+        }
+
+        for (auto &t : threads)
+            t.join();
+
+        bool same = true;
+        for (auto &item : results)
+            same = same && item == results[0] && item != nullptr;
+        INFO("single flight: %d concurrent requests, %d computes, shared result %s", num_threads, (int)num_computes, same ? "PASS" : "FAIL");
+        INFO("  %s", cache.report().to_string().c_str());
+    }
+
+    {
+        // 被拒绝的job与抛出异常的计算都不进入缓存，下一次请求重新计算
+        BoxCache cache;
+        uint64_t key = content_hash(jpegs[1].data(), jpegs[1].size());
+        JobOptions cancelled;
+        cancelled.cancel_token = CancellationToken::create();
+        cancelled.cancel_token->cancel();
+        bool rejected = cache.get_or_compute(key, [&]()
+                                             { return decode_and_infer(infer, jpegs[1], cancelled); })
+                            .get() == nullptr;
+
+        bool thrown = false;
+        try
+        {
+            cache.get_or_compute(key, []() -> BoxCache::ValuePointer
+                                 { throw runtime_error("decode failed"); })
+                .get();
+        }
+        catch (const runtime_error &)
+        {
+            thrown = true;
+        }
+
+        bool recomputed = cache.get_or_compute(key, [&]()
+                                               { return decode_and_infer(infer, jpegs[1]); })
+                              .get() != nullptr;
+        auto report = cache.report();
+        bool ok = rejected && thrown && recomputed && report.failures == 2 && report.misses == 3 && report.size == 1;
+        INFO("failures: rejected job %s, exception %s, recomputed %s, %s",
+             rejected ? "not cached" : "cached", thrown ? "propagated" : "lost", recomputed ? "yes" : "no", ok ? "PASS" : "FAIL");
+    }
+
+    const char *modes[] = {"no cache", "cache"};
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        ResultCacheConfig config;
+        config.capacity = num_images / 2;
+        BoxCache cache(config);
+        vector<BenchTools::LatencyStat> latencys(num_threads);
+        vector<thread> threads;
+        auto tick = iLogger::timestamp_now_float();
+        for (int ithread = 0; ithread < num_threads; ++ithread)
+        {
+            threads.emplace_back([&, ithread]()
+                                 {
+                mt19937 rng(ithread);
+                int num_hot = max(1, num_images / 8);
+                for (int i = 0; i < requests_per_thread; ++i)
+                {
+                    int index = rng() % 10 < 8 ? rng() % num_hot : rng() % num_images;
+                    auto &data = jpegs[index];
+                    auto begin = iLogger::timestamp_now_float();
+                    if (mode == 0)
+                    {
+                        decode_and_infer(infer, data);
+                    }
+                    else
+                    {
+                        cache.get_or_compute(content_hash(data.data(), data.size()), [&]()
+                                             { return decode_and_infer(infer, data); })
+                            .get();
+                    }
+                    latencys[ithread].add(iLogger::timestamp_now_float() - begin);
+                } });
+        }
+
+        for (auto &t : threads)
+            t.join();
+
+        double elapsed_ms = iLogger::timestamp_now_float() - tick;
+        BenchTools::LatencyStat latency;
+        for (auto &item : latencys)
+            latency.merge(item);
+
+        INFO("%s: %.2f requests/s, latency {%s}", modes[mode], latency.count() / (elapsed_ms / 1000.0), latency.summary().c_str());
+        if (mode == 1)
+            INFO("  %s", cache.report().to_string().c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,260 @@
+#include "bench.hpp"
+#include "bench_tools.hpp"
+#include "cpu_yolo.hpp"
+#include "app_yolo/cascade.hpp"
+#include <random>
+
+using namespace std;
+
+static const int NUM_SHADES = 10;
+
+// 第c类方块的灰度
+static int shade_of(int label)
+{
+    return 155 + label * 10;
+}
+
+// 暗背景上不同灰度的方块，灰度决定分类的类别，labels为每个方块的类别
+static cv::Mat make_shaded_objects(int width, int height, int seed, vector<cv::Rect> &objects, vector<int> &labels)
+{
+    cv::Mat image(height, width, CV_8UC3, cv::Scalar(30, 30, 30));
+    objects.clear();
+    labels.clear();
+    mt19937 rng(seed);
+    for (int y = 16; y + 64 <= height; y += 96)
+    {
+        for (int x = 16; x + 64 <= width; x += 96)
+        {
+            int size = 32 + rng() % 32;
+            int label = rng() % NUM_SHADES;
+            cv::Rect rect(x + rng() % 16, y + rng() % 16, size, size);
+            image(rect).setTo(cv::Scalar(shade_of(label), shade_of(label), shade_of(label)));
+            objects.emplace_back(rect);
+            labels.emplace_back(label);
+        }
+    }
+    return image;
+}
+
+/* 内置的分类模型：取输入第0通道的最大值还原为灰度，logits为与每一类灰度的距离的相反数
+   结果只依赖框内的像素，框的映射、采样和归一化有误时类别就会错
+*/
+static TRT::CPUModelConfig shade_classifier_model(int max_batch_size, int input_size, float base_cost_ms, float per_image_cost_ms)
+{
+    TRT::CPUModelConfig model;
+    model.inputs.push_back(make_pair(string("images"), vector<int>{max_batch_size, 3, input_size, input_size}));
+    model.outputs.push_back(make_pair(string("output"), vector<int>{max_batch_size, NUM_SHADES}));
+    model.max_batch_size = max_batch_size;
+    model.base_cost_ms = base_cost_ms;
+    model.per_image_cost_ms = per_image_cost_ms;
+    model.compute = [](TRT::Infer *engine, int batch_size)
+    {
+        auto input = engine->input(0);
+        auto output = engine->output(0);
+        int area = input->size(2) * input->size(3);
+        Classifier::ClassifierConfig config;
+        for (int ibatch = 0; ibatch < batch_size; ++ibatch)
+        {
+            // bgr_to_rgb时第0个plane是R，灰度图三个通道相同
+            const float *plane = input->cpu<float>(ibatch);
+            float value = -1e9f;
+            for (int i = 0; i < area; ++i)
+                value = max(value, plane[i]);
+
+            float gray = (value * config.std[0] + config.mean[0]) * 255;
+            float *logits = output->cpu<float>(ibatch);
+            for (int c = 0; c < NUM_SHADES; ++c)
+                logits[c] = -fabs(gray - shade_of(c)) * 0.5f;
+        }
+    };
+    return model;
+}
+
+// 框的中心所在方块的类别，不在任何方块内时为-1
+static int expected_label(const ObjectDetector::Box &box, const vector<cv::Rect> &objects, const vector<int> &labels)
+{
+    float cx = (box.left + box.right) * 0.5f;
+    float cy = (box.top + box.bottom) * 0.5f;
+    for (int i = 0; i < (int)objects.size(); ++i)
+    {
+        auto &o = objects[i];
+        if (cx >= o.x && cx <= o.x + o.width && cy >= o.y && cy <= o.y + o.height)
+            return labels[i];
+    }
+    return -1;
+}
+
+/* 1. softmax与top-k：与std::exp、partial_sort的结果比较，以及1000类时的耗时
+   2. 检测 -> 分类：3.5-full-cnn-classifier的方式(逐帧检测，逐个裁剪、逐个分类)与级联(框直接warp，跨帧凑batch)的
+      分类准确率、吞吐、分类器的平均batch，以及级联每一级的延迟
+*/
+int bench_cascade(int num_frames, int width, int height)
+{
+    int num_fail = 0;
+    {
+        mt19937 rng(11);
+        normal_distribution<float> logit(0, 4);
+        int num_errors = 0;
+        float max_error = 0;
+        for (int t = 0; t < 300; ++t)
+        {
+            int n = 1 + (t * 37) % 1003;
+            int k = 1 + t % 10;
+            vector<float> values(n);
+            for (auto &v : values)
+                v = t % 7 == 0 ? (float)(rng() % 5) : logit(rng);
+
+            // 参考：std::exp的softmax，(值降序, 下标升序)的partial_sort
+            vector<float> reference(values);
+            float max_value = *max_element(reference.begin(), reference.end());
+            double sum = 0;
+            for (auto &v : reference)
+                sum += (v = exp(v - max_value));
+            for (auto &v : reference)
+                v /= sum;
+
+            vector<int> order(n);
+            for (int i = 0; i < n; ++i)
+                order[i] = i;
+            partial_sort(order.begin(), order.begin() + min(k, n), order.end(), [&](int a, int b)
+                         { return values[a] != values[b] ? values[a] > values[b] : a < b; });
+
+            vector<float> probs(values);
+            Classifier::cpu_softmax(probs.data(), n);
+            for (int i = 0; i < n; ++i)
+                max_error = max(max_error, fabs(probs[i] - reference[i]) / max(reference[i], 1e-30f));
+
+            vector<int> labels;
+            vector<float> scores;
+            Classifier::cpu_top_k(values.data(), n, k, labels, scores);
+            num_errors += (int)labels.size() != min(k, n);
+            for (int i = 0; i < (int)labels.size() && i < min(k, n); ++i)
+                num_errors += labels[i] != order[i] || scores[i] != values[order[i]];
+        }
+        bool ok = num_errors == 0 && max_error < 1e-5f;
+        INFO("softmax max relative error %.2e, top-k %d mismatches on 300 vectors, %s", max_error, num_errors, ok ? "PASS" : "FAIL");
+        num_fail += !ok;
+
+        // 1000类的logits，k = 5
+        vector<float> values(1000), work(1000);
+        for (auto &v : values)
+            v = logit(rng);
+        vector<int> labels;
+        vector<float> scores;
+        vector<int> order(1000);
+        int repeat = 20000;
+        auto tick = iLogger::timestamp_now_float();
+        for (int r = 0; r < repeat; ++r)
+        {
+            work = values;
+            float max_value = *max_element(work.begin(), work.end());
+            float sum = 0;
+            for (auto &v : work)
+                sum += (v = exp(v - max_value));
+            for (auto &v : work)
+                v /= sum;
+            for (int i = 0; i < 1000; ++i)
+                order[i] = i;
+            partial_sort(order.begin(), order.begin() + 5, order.end(), [&](int a, int b)
+                         { return work[a] > work[b]; });
+        }
+        double scalar_us = (iLogger::timestamp_now_float() - tick) * 1000 / repeat;
+
+        tick = iLogger::timestamp_now_float();
+        for (int r = 0; r < repeat; ++r)
+        {
+            work = values;
+            Classifier::cpu_softmax(work.data(), 1000);
+            Classifier::cpu_top_k(work.data(), 1000, 5, labels, scores);
+        }
+        double simd_us = (iLogger::timestamp_now_float() - tick) * 1000 / repeat;
+        INFO("1000 classes softmax + top-5: scalar %.2f us, simd %.2f us, %.1fx", scalar_us, simd_us, scalar_us / simd_us);
+    }
+
+    auto detector = CPUYolo::create_infer(TRT::cpu_yolo_model(8, 320, 320, 400, 80, 2.0f, 0.5f), 0.25f, 0.5f);
+    if (detector == nullptr)
+    {
+        INFOE("Create cpu infer failed.");
+        return -1;
+    }
+
+    vector<cv::Mat> images(num_frames);
+    vector<vector<cv::Rect>> objects(num_frames);
+    vector<vector<int>> labels(num_frames);
+    for (int i = 0; i < num_frames; ++i)
+        images[i] = make_shaded_objects(width, height, i + 1, objects[i], labels[i]);
+    INFO("%d frames of %dx%d, %d shaded objects per frame, classifier input 64x64, 1.0 ms + 0.05 ms x batch",
+         num_frames, width, height, (int)objects[0].size());
+
+    for (bool cascade : {false, true})
+    {
+        Classifier::ClassifierConfig config;
+        config.top_k = 3;
+        auto classifier = Classifier::create_cpu_infer(shade_classifier_model(32, 64, 1.0f, 0.05f), config);
+        if (classifier == nullptr)
+        {
+            INFOE("Create classifier failed.");
+            return -1;
+        }
+
+        detector->metrics(true);
+        long long num_boxes = 0, num_correct = 0;
+        auto tick = iLogger::timestamp_now_float();
+        if (!cascade)
+        {
+            // 逐帧检测，框裁剪为小图后逐个分类
+            for (int i = 0; i < num_frames; ++i)
+            {
+                auto boxes = detector->commit(images[i]).get();
+                for (auto &box : boxes)
+                {
+                    int left = max(0, (int)box.left), top = max(0, (int)box.top);
+                    int right = min(width, (int)box.right), bottom = min(height, (int)box.bottom);
+                    cv::Rect rect(left, top, max(1, right - left), max(1, bottom - top));
+                    cv::Mat crop = images[i](rect).clone();
+                    auto result = classifier->commit(crop, ObjectDetector::Box(0, 0, crop.cols, crop.rows, box.confidence, box.class_label)).get();
+                    num_boxes++;
+                    num_correct += result.label() == expected_label(box, objects[i], labels[i]);
+                }
+            }
+        }
+        else
+        {
+            Cascade::CascadeConfig cascade_config;
+            cascade_config.min_confidence = 0.25f;
+            auto infer = Cascade::create_cascade(detector, classifier, cascade_config);
+            auto results = infer->commits(images);
+            for (int i = 0; i < num_frames; ++i)
+            {
+                for (auto &box : results[i].get())
+                {
+                    num_boxes++;
+                    num_correct += box.sub_label == expected_label(box, objects[i], labels[i]);
+                }
+            }
+
+            auto report = infer->report();
+            INFO("%-10s %lld detections, %lld crops, %lld filtered, %lld failed, %.1f crops/frame",
+                 "", report.num_detections, report.num_crops, report.num_filtered, report.num_failed, report.crops_per_frame);
+            INFO("%-10s detect   %s", "", report.detect.to_string().c_str());
+            INFO("%-10s classify %s", "", report.classify.to_string().c_str());
+            INFO("%-10s total    %s", "", report.total.to_string().c_str());
+
+            // latest_only只作用于检测，同一帧的裁剪不会互相替代
+            infer->report(true);
+            infer->commit(images[0], JobOptions::stream(1)).get();
+            report = infer->report();
+            bool stream_ok = report.num_crops > 0 && report.num_failed == 0;
+            INFO("%-10s latest_only frame: %lld crops, %lld failed, %s", "", report.num_crops, report.num_failed, stream_ok ? "PASS" : "FAIL");
+            num_fail += !stream_ok;
+        }
+        double elapsed = iLogger::timestamp_now_float() - tick;
+        auto metrics = classifier->metrics();
+        float accuracy = num_correct / (float)max(1LL, num_boxes);
+        INFO("%-10s %lld boxes, accuracy %.3f, %.1f ms, %.1f frames/s, %.0f crops/s, classifier avg batch %.2f, forward p50 %.3f ms",
+             cascade ? "cascade" : "one by one", num_boxes, accuracy, elapsed, num_frames / elapsed * 1000, num_boxes / elapsed * 1000,
+             metrics.average_batch_size, metrics.stage(MetricStage::Forward).p50_ms);
+        num_fail += accuracy < 0.99f || num_boxes == 0;
+    }
+    return num_fail == 0 ? 0 : -1;
+}
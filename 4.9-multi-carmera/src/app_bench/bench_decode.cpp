@@ -0,0 +1,178 @@
+#include "bench.hpp"
+#include "bench_tools.hpp"
+#include "app_yolo/yolo.hpp"
+#include <thread>
+#include <random>
+#include <cstring>
+
+using namespace std;
+using namespace ObjectDetector;
+
+// 原来cpu_yolo.cpp中逐个anchor、逐个类别比较的解码
+static void reference_decode(
+    const float *predict, int num_bboxes, int num_classes, float confidence_threshold,
+    const float *invert_affine_matrix, BoxArray &output, int max_objects)
+{
+    for (int position = 0; position < num_bboxes && (int)output.size() < max_objects; ++position)
+    {
+        const float *pitem = predict + (5 + num_classes) * position;
+        float objectness = pitem[4];
+        if (objectness < confidence_threshold)
+            continue;
+
+        const float *class_confidence = pitem + 5;
+        float confidence = *class_confidence++;
+        int label = 0;
+        for (int i = 1; i < num_classes; ++i, ++class_confidence)
+        {
+            if (*class_confidence > confidence)
+            {
+                confidence = *class_confidence;
+                label = i;
+            }
+        }
+
+        confidence *= objectness;
+        if (confidence < confidence_threshold)
+            continue;
+
+        float cx = pitem[0];
+        float cy = pitem[1];
+        float width = pitem[2];
+        float height = pitem[3];
+        float left = cx - width * 0.5f;
+        float top = cy - height * 0.5f;
+        float right = cx + width * 0.5f;
+        float bottom = cy + height * 0.5f;
+        const float *m = invert_affine_matrix;
+        output.emplace_back(
+            m[0] * left + m[1] * top + m[2], m[3] * left + m[4] * top + m[5],
+            m[0] * right + m[1] * bottom + m[2], m[3] * right + m[4] * bottom + m[5],
+            confidence, label);
+    }
+}
+
+/* 模拟yolov5的输出：objectness_rate比例的anchor的objectness较高，其余很低
+   类别分数量化为1/32，制造相等的最大值，检查argmax取第一个最大值
+*/
+static vector<float> make_predict(int num_bboxes, int num_classes, float objectness_rate, int seed)
+{
+    mt19937 rng(seed);
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    vector<float> predict((size_t)num_bboxes * (5 + num_classes));
+    for (int i = 0; i < num_bboxes; ++i)
+    {
+        float *p = predict.data() + (size_t)i * (5 + num_classes);
+        p[0] = unit(rng) * 640;
+        p[1] = unit(rng) * 640;
+        p[2] = 4 + unit(rng) * 200;
+        p[3] = 4 + unit(rng) * 200;
+        p[4] = unit(rng) < objectness_rate ? 0.2f + unit(rng) * 0.8f : unit(rng) * 0.05f;
+        for (int c = 0; c < num_classes; ++c)
+            p[5 + c] = (int)(unit(rng) * 32) / 32.0f;
+    }
+    return predict;
+}
+
+/* 1. 正确性：cpu_decode的BoxArray与counter + 7-float两种输出、单线程与多线程，都与标量解码逐位一致，
+      阈值为0时检查max_objects截断与计数
+   2. 640输入(25200个anchor)、80类与1类时标量解码、单线程SIMD、多线程SIMD的耗时
+*/
+int bench_decode(int repeat)
+{
+    const int max_objects = 1024;
+    float d2i[6] = {2.0f, 0, -0.5f, 0, 2.0f, -80.5f};
+    vector<float> parray(1 + max_objects * 7);
+
+    int num_fail = 0;
+    for (int num_classes : {1, 2, 7, 80})
+    {
+        for (float threshold : {0.0f, 0.25f, 0.5f})
+        {
+            int num_bboxes = 9000;
+            auto predict = make_predict(num_bboxes, num_classes, 0.05f, num_classes * 10 + (int)(threshold * 4));
+            BoxArray reference;
+            reference_decode(predict.data(), num_bboxes, num_classes, threshold, d2i, reference, max_objects);
+
+            bool ok = true;
+            for (int num_threads : {1, 0})
+            {
+                BoxArray output;
+                Yolo::cpu_decode(predict.data(), num_bboxes, num_classes, threshold, d2i, output, max_objects, num_threads);
+                ok = ok && BenchTools::same_boxes(reference, output);
+
+                parray[0] = 0;
+                Yolo::cpu_decode(predict.data(), num_bboxes, num_classes, threshold, d2i, parray.data(), max_objects, num_threads);
+                int count = min(max_objects, (int)parray[0]);
+                BoxArray from_array;
+                for (int i = 0; i < count; ++i)
+                {
+                    float *pbox = parray.data() + 1 + i * 7;
+                    if (pbox[6] == 1)
+                        from_array.emplace_back(pbox[0], pbox[1], pbox[2], pbox[3], pbox[4], (int)pbox[5]);
+                }
+                ok = ok && BenchTools::same_boxes(reference, from_array);
+                ok = ok && (threshold > 0 || (int)parray[0] == num_bboxes);
+            }
+
+            if (!ok)
+            {
+                num_fail++;
+                INFOE("mismatch: %d classes, threshold %.2f, %d boxes", num_classes, threshold, (int)reference.size());
+            }
+        }
+    }
+    INFO("correctness: %d fail, %s", num_fail, num_fail == 0 ? "PASS" : "FAIL");
+
+    for (int num_classes : {80, 1})
+    {
+        int num_bboxes = 25200;
+        auto predict = make_predict(num_bboxes, num_classes, 0.03f, num_classes);
+        double reference_ms = 0, single_ms = 0, multi_ms = 0;
+        BoxArray output;
+        output.reserve(max_objects);
+        for (int i = 0; i < repeat; ++i)
+        {
+            output.clear();
+            auto tick = iLogger::timestamp_now_float();
+            reference_decode(predict.data(), num_bboxes, num_classes, 0.25f, d2i, output, max_objects);
+            reference_ms += iLogger::timestamp_now_float() - tick;
+
+            output.clear();
+            tick = iLogger::timestamp_now_float();
+            Yolo::cpu_decode(predict.data(), num_bboxes, num_classes, 0.25f, d2i, output, max_objects, 1);
+            single_ms += iLogger::timestamp_now_float() - tick;
+
+            output.clear();
+            tick = iLogger::timestamp_now_float();
+            Yolo::cpu_decode(predict.data(), num_bboxes, num_classes, 0.25f, d2i, output, max_objects, 0);
+            multi_ms += iLogger::timestamp_now_float() - tick;
+        }
+        INFO("%d anchors, %2d classes, %3d boxes: scalar %.3f ms, simd %.3f ms, simd %d threads %.3f ms",
+             num_bboxes, num_classes, (int)output.size(), reference_ms / repeat, single_ms / repeat,
+             (int)thread::hardware_concurrency(), multi_ms / repeat);
+    }
+
+    // objectness全部通过时，argmax成为主要开销，不限制输出的数量
+    {
+        int num_bboxes = 25200, num_classes = 80;
+        auto predict = make_predict(num_bboxes, num_classes, 1.0f, 3);
+        double reference_ms = 0, single_ms = 0;
+        BoxArray output;
+        for (int i = 0; i < repeat; ++i)
+        {
+            output.clear();
+            auto tick = iLogger::timestamp_now_float();
+            reference_decode(predict.data(), num_bboxes, num_classes, 0.9f, d2i, output, num_bboxes);
+            reference_ms += iLogger::timestamp_now_float() - tick;
+
+            output.clear();
+            tick = iLogger::timestamp_now_float();
+            Yolo::cpu_decode(predict.data(), num_bboxes, num_classes, 0.9f, d2i, output, num_bboxes, 1);
+            single_ms += iLogger::timestamp_now_float() - tick;
+        }
+        INFO("%d anchors, %2d classes, all objectness passed, %d boxes: scalar %.3f ms, simd %.3f ms", num_bboxes, num_classes,
+             (int)output.size(), reference_ms / repeat, single_ms / repeat);
+    }
+    return num_fail == 0 ? 0 : -1;
+}
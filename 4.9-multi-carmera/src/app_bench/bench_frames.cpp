@@ -0,0 +1,227 @@
+#include "bench.hpp"
+#include "bench_tools.hpp"
+#include "cpu_yolo.hpp"
+#include "TrtLib/common/preprocess_cpu.hpp"
+#include "TrtLib/common/external_frame.hpp"
+#include <thread>
+#include <atomic>
+#include <cstring>
+
+using namespace std;
+using CUDAKernel::ChannelType;
+using CUDAKernel::Norm;
+
+static uint8_t clamp_u8(float value)
+{
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+// 与convert_nv12_to_bgr_kernel逐像素相同
+static void reference_nv12_to_bgr(const uint8_t *y, const uint8_t *uv, int width, int height, int linesize, uint8_t *dst)
+{
+    for (int position = 0; position < width * height; ++position)
+    {
+        int ox = position % width;
+        int oy = position / width;
+        uint8_t yvalue = y[oy * linesize + ox];
+        int offset_uv = (oy >> 1) * linesize + (ox & 0xFFFFFFFE);
+        uint8_t u = uv[offset_uv + 0];
+        uint8_t v = uv[offset_uv + 1];
+        dst[position * 3 + 0] = clamp_u8(1.164f * (yvalue - 16.0f) + 2.018f * (u - 128.0f));
+        dst[position * 3 + 1] = clamp_u8(1.164f * (yvalue - 16.0f) - 0.813f * (v - 128.0f) - 0.391f * (u - 128.0f));
+        dst[position * 3 + 2] = clamp_u8(1.164f * (yvalue - 16.0f) + 1.596f * (v - 128.0f));
+    }
+}
+
+// BT.601的BGR转NV12，每行linesize字节，Y平面之后紧跟UV平面
+static vector<uint8_t> make_nv12(const cv::Mat &image, int linesize)
+{
+    int width = image.cols, height = image.rows;
+    vector<uint8_t> output((size_t)linesize * (height + (height + 1) / 2), 0);
+    uint8_t *uv = output.data() + (size_t)linesize * height;
+    for (int r = 0; r < height; ++r)
+    {
+        const uint8_t *p = image.ptr<uint8_t>(r);
+        for (int c = 0; c < width; ++c, p += 3)
+        {
+            float b = p[0], g = p[1], rr = p[2];
+            output[(size_t)r * linesize + c] = clamp_u8(16 + 0.257f * rr + 0.504f * g + 0.098f * b);
+            if (r % 2 == 0 && c % 2 == 0)
+            {
+                uv[(r / 2) * linesize + c + 0] = clamp_u8(128 - 0.148f * rr - 0.291f * g + 0.439f * b);
+                uv[(r / 2) * linesize + c + 1] = clamp_u8(128 + 0.439f * rr - 0.368f * g - 0.071f * b);
+            }
+        }
+    }
+    return output;
+}
+
+/* 1. 正确性：带行对齐的BGR、RGB(通道交换相反)的预处理结果与连续的BGR cv::Mat逐位相同，NV12转BGR与核函数逐位一致
+   2. CPU后端上提交Host的BGR/RGB/NV12帧与Device帧，release在推理完成、拒绝、失败时都恰好调用一次
+   3. 1080p NV12转BGR的耗时，即解码器的帧先转成cv::Mat再提交多出的开销
+*/
+int bench_external_frames(int num_frames)
+{
+    int num_fail = 0;
+    Norm norm = Norm::alpha_beta(1 / 255.0f, 0.0f, ChannelType::Invert);
+    const int dst_width = 320, dst_height = 320;
+    size_t volume = dst_width * dst_height * 3;
+
+    for (int width : {640, 637})
+    {
+        int height = width * 9 / 16;
+        cv::Mat image = BenchTools::make_image(width, height, width % 7);
+        Yolo::AffineMatrix affine;
+        affine.compute(image.size(), cv::Size(dst_width, dst_height));
+        vector<float> reference(volume), output(volume);
+        CPUKernel::warp_affine_bilinear_and_normalize_plane(
+            image.data, image.step, width, height, reference.data(), dst_width, dst_height, affine.d2i, 114, norm, 1);
+
+        // 每行补齐到64字节
+        int stride = iLogger::upbound(width * 3, 64);
+        vector<uint8_t> padded((size_t)stride * height);
+        vector<uint8_t> rgb((size_t)width * height * 3);
+        for (int r = 0; r < height; ++r)
+        {
+            memcpy(padded.data() + (size_t)r * stride, image.ptr<uint8_t>(r), width * 3);
+            for (int c = 0; c < width; ++c)
+            {
+                const uint8_t *p = image.ptr<uint8_t>(r) + c * 3;
+                uint8_t *q = rgb.data() + ((size_t)r * width + c) * 3;
+                q[0] = p[2];
+                q[1] = p[1];
+                q[2] = p[0];
+            }
+        }
+
+        CPUKernel::warp_affine_bilinear_and_normalize_plane(
+            padded.data(), stride, width, height, output.data(), dst_width, dst_height, affine.d2i, 114, norm, 1);
+        bool strided_ok = memcmp(reference.data(), output.data(), volume * sizeof(float)) == 0;
+
+        Norm rgb_norm = norm;
+        rgb_norm.channel_type = ChannelType::None;
+        CPUKernel::warp_affine_bilinear_and_normalize_plane(
+            rgb.data(), width * 3, width, height, output.data(), dst_width, dst_height, affine.d2i, 114, rgb_norm, 1);
+        bool rgb_ok = memcmp(reference.data(), output.data(), volume * sizeof(float)) == 0;
+
+        int linesize = iLogger::upbound(width, 256);
+        auto nv12 = make_nv12(image, linesize);
+        const uint8_t *uv = nv12.data() + (size_t)linesize * height;
+        vector<uint8_t> bgr_reference((size_t)width * height * 3), bgr((size_t)width * height * 3);
+        reference_nv12_to_bgr(nv12.data(), uv, width, height, linesize, bgr_reference.data());
+        bool nv12_ok = true;
+        for (int num_threads : {1, 0})
+        {
+            memset(bgr.data(), 0, bgr.size());
+            CPUKernel::convert_nv12_to_bgr(nv12.data(), uv, width, height, linesize, bgr.data(), num_threads);
+            nv12_ok = nv12_ok && bgr == bgr_reference;
+        }
+
+        INFO("%dx%d: strided BGR %s, RGB %s, NV12 %s", width, height,
+             strided_ok ? "PASS" : "FAIL", rgb_ok ? "PASS" : "FAIL", nv12_ok ? "PASS" : "FAIL");
+        num_fail += !strided_ok + !rgb_ok + !nv12_ok;
+    }
+
+    auto model = TRT::cpu_yolo_model(8, 320, 320, 400, 80, 0.5f, 0.1f);
+    auto infer = CPUYolo::create_infer(model, 0.25f, 0.45f);
+    if (infer == nullptr)
+    {
+        INFOE("Create cpu infer failed.");
+        return -1;
+    }
+
+    {
+        cv::Mat image = BenchTools::make_image(640, 360, 1);
+        int linesize = 768;
+        auto nv12 = make_nv12(image, linesize);
+        cv::Mat roi = BenchTools::make_image(800, 400, 2)(cv::Rect(37, 11, 640, 360));
+
+        atomic<int> num_released(0);
+        atomic<int> num_finished(0);
+        atomic<int> num_empty(0);
+        auto make_frame = [&](int i)
+        {
+            ExternalFrame frame;
+            frame.width = 640;
+            frame.height = 360;
+            frame.release = [&num_released]()
+            { num_released++; };
+
+            if (i % 3 == 2)
+            {
+                frame.data = nv12.data();
+                frame.stride = linesize;
+                frame.format = PixelFormat::NV12;
+            }
+            else
+            {
+                frame.data = roi.data;
+                frame.stride = roi.step;
+                frame.format = i % 3 == 0 ? PixelFormat::BGR : PixelFormat::RGB;
+            }
+            return share_frame(frame);
+        };
+
+        auto callback = [&](ObjectDetector::BoxArray &boxes)
+        {
+            num_empty += boxes.empty();
+            num_finished++;
+        };
+
+        int num_submitted = 0;
+        vector<shared_future<ObjectDetector::BoxArray>> results;
+        for (int i = 0; i < num_frames; ++i, ++num_submitted)
+        {
+            if (i % 2 == 0)
+                results.emplace_back(infer->commit(make_frame(i)));
+            else
+                infer->commit(make_frame(i), callback);
+        }
+
+        // 显存中的帧在CPU后端上预处理失败，结果为空；不阻塞的提交在没有空闲tensor时被拒绝
+        ExternalFrame device_frame;
+        device_frame.data = roi.data;
+        device_frame.width = roi.cols;
+        device_frame.height = roi.rows;
+        device_frame.stride = roi.step;
+        device_frame.location = MemoryLocation::Device;
+        device_frame.release = [&num_released]()
+        { num_released++; };
+        auto status = infer->commit(share_frame(device_frame), callback);
+        num_submitted++;
+
+        int num_rejected = 0;
+        for (int i = 0; i < 64; ++i, ++num_submitted)
+            num_rejected += infer->commit(make_frame(i), callback, JobOptions(), false) != CommitStatus::Accepted;
+
+        for (auto &item : results)
+            item.get();
+        while (num_finished + (int)results.size() < num_submitted)
+            this_thread::yield();
+
+        bool ok = num_released == num_submitted;
+        INFO("release: %d frames, %d released, device frame %s, %d non-blocking rejected, %d empty results, %s",
+             num_submitted, (int)num_released, commit_status_name(status), num_rejected, (int)num_empty, ok ? "PASS" : "FAIL");
+        num_fail += !ok;
+    }
+
+    {
+        const int repeat = 20;
+        cv::Mat image = BenchTools::make_image(1920, 1080, 3);
+        auto nv12 = make_nv12(image, 2048);
+        vector<uint8_t> bgr(1920 * 1080 * 3);
+        double single_ms = 0, multi_ms = 0;
+        for (int i = 0; i < repeat; ++i)
+        {
+            auto tick = iLogger::timestamp_now_float();
+            CPUKernel::convert_nv12_to_bgr(nv12.data(), nv12.data() + 2048 * 1080, 1920, 1080, 2048, bgr.data(), 1);
+            single_ms += iLogger::timestamp_now_float() - tick;
+
+            tick = iLogger::timestamp_now_float();
+            CPUKernel::convert_nv12_to_bgr(nv12.data(), nv12.data() + 2048 * 1080, 1920, 1080, 2048, bgr.data(), 0);
+            multi_ms += iLogger::timestamp_now_float() - tick;
+        }
+        INFO("1080p NV12 -> BGR on CPU: %.3f ms, %d threads %.3f ms", single_ms / repeat, (int)thread::hardware_concurrency(), multi_ms / repeat);
+    }
+    return num_fail == 0 ? 0 : -1;
+}
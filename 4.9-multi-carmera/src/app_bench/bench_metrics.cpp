@@ -0,0 +1,78 @@
+#include "bench.hpp"
+#include "bench_tools.hpp"
+#include "cpu_yolo.hpp"
+#include "TrtLib/common/infer_metrics.hpp"
+#include <thread>
+#include <atomic>
+
+using namespace std;
+
+// num_threads个线程同时记录，返回每次record的平均耗时(ns)
+template <class Histogram>
+static double record_cost_ns(Histogram &histogram, int num_threads, int records_per_thread)
+{
+    vector<thread> threads;
+    auto tick = iLogger::timestamp_now_float();
+    for (int i = 0; i < num_threads; ++i)
+    {
+        threads.emplace_back([&, i]()
+                             {
+            for (int j = 0; j < records_per_thread; ++j)
+                histogram.record((i * 7919 + j) % 20000); });
+    }
+
+    for (auto &t : threads)
+        t.join();
+
+    double elapsed_ms = iLogger::timestamp_now_float() - tick;
+    return elapsed_ms * 1e6 / ((double)num_threads * records_per_thread) * num_threads;
+}
+
+/* 1. 单个原子直方图与按线程分片的直方图在多线程同时记录时的开销
+   2. CPU后端上跑一段负载，输出各阶段的分位数快照和json
+*/
+int bench_metrics(int num_producers, int images_per_producer)
+{
+    INFO("record cost per call (thread time):");
+    for (int num_threads : {1, 2, 4, 8})
+    {
+        unique_ptr<LatencyHistogram> shared(new LatencyHistogram());
+        unique_ptr<ShardedLatencyHistogram> sharded(new ShardedLatencyHistogram());
+        double shared_ns = record_cost_ns(*shared, num_threads, 500000);
+        double sharded_ns = record_cost_ns(*sharded, num_threads, 500000);
+        INFO("  threads=%d: shared %.1f ns, sharded %.1f ns", num_threads, shared_ns, sharded_ns);
+    }
+
+    auto model = TRT::cpu_yolo_model(8, 320, 320, 400, 80, 2.0f, 0.5f);
+    auto infer = CPUYolo::create_infer(model, 0.25f, 0.45f);
+    if (infer == nullptr)
+    {
+        INFOE("Create cpu infer failed.");
+        return -1;
+    }
+
+    vector<cv::Mat> images;
+    for (int i = 0; i < 16; ++i)
+        images.push_back(BenchTools::make_image(640, 360, i));
+
+    infer->set_batching_policy(BatchingPolicy::deadline(2000));
+    infer->commit(images[0]).get();
+    infer->metrics(true);
+
+    vector<thread> producers;
+    for (int iproducer = 0; iproducer < num_producers; ++iproducer)
+    {
+        producers.emplace_back([&, iproducer]()
+                               {
+            for (int i = 0; i < images_per_producer; ++i)
+                infer->commit(images[(i + iproducer) % images.size()]).get(); });
+    }
+
+    for (auto &t : producers)
+        t.join();
+
+    auto snapshot = infer->metrics();
+    INFO("metrics: %s", snapshot.to_string().c_str());
+    INFO("json: %s", snapshot.to_json().toStyledString().c_str());
+    return 0;
+}
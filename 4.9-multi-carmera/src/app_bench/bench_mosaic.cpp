@@ -0,0 +1,265 @@
+#include "bench.hpp"
+#include "bench_tools.hpp"
+#include "cpu_yolo.hpp"
+#include <random>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+// 一路子码流：暗背景上不贴边的32像素亮方块，位置随相机变化
+static cv::Mat make_substream(int width, int height, int seed, vector<cv::Rect> &objects)
+{
+    cv::Mat image(height, width, CV_8UC3, cv::Scalar(30, 30, 30));
+    objects.clear();
+    mt19937 rng(seed);
+    for (int x = 8; x + 40 <= width; x += 56)
+    {
+        uniform_int_distribution<int> y(8, height - 40);
+        cv::Rect rect(x + rng() % 8, y(rng), 32, 32);
+        image(rect).setTo(cv::Scalar(230, 230, 230));
+        objects.emplace_back(rect);
+    }
+    return image;
+}
+
+// 中心落在方块内(放宽margin像素)的框认为检测到了这个方块，每个方块只计一次
+static int count_found(const ObjectDetector::BoxArray &boxes, const vector<cv::Rect> &objects, int margin)
+{
+    int num_found = 0;
+    for (auto &o : objects)
+    {
+        for (auto &box : boxes)
+        {
+            float cx = (box.left + box.right) * 0.5f;
+            float cy = (box.top + box.bottom) * 0.5f;
+            if (cx >= o.x - margin && cx <= o.x + o.width + margin && cy >= o.y - margin && cy <= o.y + o.height + margin)
+            {
+                num_found++;
+                break;
+            }
+        }
+    }
+    return num_found;
+}
+
+/* 1. 正确性：每帧恰好放进一张画布、区域在画布内且互不重叠；帧内的框经i2d画到画布上再分配回来与原框相同，
+      跨两帧的框被丢弃；画布上的像素与原帧相同
+   2. 多路子码流逐帧letterbox与拼图推理：提交给引擎的图数、网络输入的填充率、召回、每个目标的框数与吞吐
+*/
+int bench_mosaic(int num_cameras, int num_rounds)
+{
+    int num_fail = 0;
+    {
+        mt19937 rng(3);
+        uniform_int_distribution<int> side(16, 400);
+        uniform_real_distribution<float> unit(0, 1);
+        int num_layout_errors = 0, num_box_errors = 0, num_straddle_kept = 0, num_pixel_errors = 0;
+        for (int t = 0; t < 200; ++t)
+        {
+            Yolo::MosaicConfig config;
+            config.frame_scale = t % 2 ? 1.0f : 0.5f;
+            config.gap = t % 3 * 4;
+            vector<cv::Size> sizes;
+            int num_frames = 1 + t % 12;
+            for (int i = 0; i < num_frames; ++i)
+                sizes.emplace_back(side(rng), side(rng));
+            if (t % 5 == 0)
+                sizes.emplace_back(0, 0);
+
+            auto layouts = Yolo::pack_mosaic(sizes, config);
+            vector<int> placed(sizes.size(), 0);
+            for (auto &layout : layouts)
+            {
+                cv::Mat covered(config.canvas_height, config.canvas_width, CV_8U, cv::Scalar(0));
+                int area = 0;
+                for (auto &slot : layout.slots)
+                {
+                    placed[slot.frame]++;
+                    num_layout_errors += !((slot.region & cv::Rect(0, 0, config.canvas_width, config.canvas_height)) == slot.region);
+                    covered(slot.region).setTo(1);
+                    area += slot.region.area();
+                }
+                num_layout_errors += cv::countNonZero(covered) != area;
+
+                // 每帧内部一个随机框，另外每对水平相邻的帧一个跨过接缝的框
+                ObjectDetector::BoxArray canvas_boxes;
+                vector<ObjectDetector::BoxArray> expected(sizes.size()), outputs(sizes.size());
+                for (auto &slot : layout.slots)
+                {
+                    float w = slot.size.width, h = slot.size.height;
+                    float left = unit(rng) * w * 0.5f, top = unit(rng) * h * 0.5f;
+                    float right = left + (0.1f + unit(rng) * 0.4f) * w, bottom = top + (0.1f + unit(rng) * 0.4f) * h;
+                    const float *m = slot.i2d;
+                    canvas_boxes.emplace_back(m[0] * left + m[2], m[4] * top + m[5], m[0] * right + m[2], m[4] * bottom + m[5], 0.9f, slot.frame);
+                    expected[slot.frame].emplace_back(left, top, right, bottom, 0.9f, slot.frame);
+                }
+
+                int num_straddle = 0;
+                for (auto &a : layout.slots)
+                {
+                    for (auto &b : layout.slots)
+                    {
+                        if (b.region.y != a.region.y || b.region.x != a.region.x + a.region.width + config.gap)
+                            continue;
+
+                        float seam = a.region.x + a.region.width;
+                        float y = a.region.y + min(a.region.height, b.region.height) * 0.5f;
+                        canvas_boxes.emplace_back(seam - 10, y - 5, seam + config.gap + 10, y + 5, 0.8f, 99);
+                        num_straddle++;
+                    }
+                }
+
+                int num_dropped = Yolo::unpack_mosaic(canvas_boxes, layout, config, outputs);
+                num_straddle_kept += num_straddle - num_dropped;
+                for (int i = 0; i < (int)sizes.size(); ++i)
+                {
+                    if (outputs[i].size() != expected[i].size())
+                    {
+                        num_box_errors++;
+                        continue;
+                    }
+
+                    for (int k = 0; k < (int)outputs[i].size(); ++k)
+                    {
+                        auto &a = outputs[i][k];
+                        auto &b = expected[i][k];
+                        num_box_errors += fabs(a.left - b.left) > 1e-2f || fabs(a.top - b.top) > 1e-2f ||
+                                          fabs(a.right - b.right) > 1e-2f || fabs(a.bottom - b.bottom) > 1e-2f;
+                    }
+                }
+
+                // 不缩放时画布上的区域与原帧逐像素相同
+                if (config.frame_scale == 1.0f && t < 20)
+                {
+                    vector<cv::Mat> frames(sizes.size());
+                    for (auto &slot : layout.slots)
+                        frames[slot.frame] = BenchTools::make_image(slot.size.width, slot.size.height, slot.frame);
+
+                    cv::Mat canvas;
+                    Yolo::render_mosaic(frames, layout, config, canvas);
+                    for (auto &slot : layout.slots)
+                    {
+                        if (!(slot.region.size() == slot.size))
+                            continue;
+
+                        for (int y = 0; y < slot.size.height; ++y)
+                            num_pixel_errors += memcmp(canvas.ptr<uint8_t>(slot.region.y + y) + slot.region.x * 3,
+                                                       frames[slot.frame].ptr<uint8_t>(y), slot.size.width * 3) != 0;
+                    }
+                }
+            }
+
+            for (int i = 0; i < (int)sizes.size(); ++i)
+                num_layout_errors += placed[i] != (sizes[i].area() > 0 ? 1 : 0);
+        }
+        bool ok = num_layout_errors == 0 && num_box_errors == 0 && num_straddle_kept == 0 && num_pixel_errors == 0;
+        INFO("pack/unpack on 200 random layouts: %d layout errors, %d box errors, %d straddling kept, %d pixel rows differ, %s",
+             num_layout_errors, num_box_errors, num_straddle_kept, num_pixel_errors, ok ? "PASS" : "FAIL");
+        num_fail += !ok;
+    }
+
+    auto model = TRT::cpu_yolo_model(8, 320, 320, 400, 80, 2.0f, 0.5f);
+    auto infer = CPUYolo::create_infer(model, 0.25f, 0.5f);
+    if (infer == nullptr)
+    {
+        INFOE("Create cpu infer failed.");
+        return -1;
+    }
+
+    // 两种子码流，156x100与100x60，放进320x320的网络输入
+    vector<cv::Mat> frames;
+    vector<vector<cv::Rect>> objects(num_cameras);
+    int num_objects = 0;
+    for (int i = 0; i < num_cameras; ++i)
+    {
+        bool small = i % 3 == 2;
+        frames.emplace_back(make_substream(small ? 100 : 156, small ? 60 : 100, i + 1, objects[i]));
+        num_objects += objects[i].size();
+    }
+    INFO("%d cameras (156x100 and 100x60 substreams, %d objects of 32x32), network input 320x320, %d rounds",
+         num_cameras, num_objects, num_rounds);
+
+    for (bool mosaic : {false, true})
+    {
+        Yolo::MosaicConfig config;
+        config.canvas_width = 320;
+        config.canvas_height = 320;
+        config.gap = 8;
+        auto packer = Yolo::create_mosaic_infer(infer, config);
+
+        // 逐帧letterbox时帧占网络输入的比例
+        float letterbox_fill = 0;
+        for (auto &frame : frames)
+        {
+            float scale = min(320.0f / frame.cols, 320.0f / frame.rows);
+            letterbox_fill += frame.cols * scale * frame.rows * scale / (320.0f * 320.0f);
+        }
+        letterbox_fill /= frames.size();
+
+        auto before = infer->metrics();
+        auto tick = iLogger::timestamp_now_float();
+        int num_found = 0, num_boxes = 0;
+        for (int round = 0; round < num_rounds; ++round)
+        {
+            auto results = mosaic ? packer->commits(frames) : infer->commits(frames);
+            for (int i = 0; i < num_cameras; ++i)
+            {
+                auto &boxes = results[i].get();
+                num_boxes += boxes.size();
+                num_found += count_found(boxes, objects[i], 8);
+            }
+        }
+        double elapsed = iLogger::timestamp_now_float() - tick;
+        auto after = infer->metrics();
+        long long num_jobs = after.num_jobs - before.num_jobs;
+        float recall = num_found / (float)(num_objects * num_rounds);
+        auto report = packer->report();
+        INFO("%-10s %lld engine images, %.2f frames/image, fill %.3f, recall %.3f, %.2f boxes/found, %.1f ms, %.1f frames/s",
+             mosaic ? "mosaic" : "letterbox", num_jobs, num_cameras * num_rounds / (float)num_jobs,
+             mosaic ? report.fill_ratio : letterbox_fill, recall, num_boxes / max(1.0f, (float)num_found), elapsed, num_cameras * num_rounds / elapsed * 1000);
+        if (mosaic)
+        {
+            INFO("%-10s %lld raw boxes, %lld straddling dropped, pack %.3f ms/canvas, unpack %.3f ms/canvas",
+                 "", report.num_raw_boxes, report.num_straddle_boxes, report.pack_ms / report.num_canvases,
+                 report.unpack_ms / report.num_canvases);
+        }
+        num_fail += recall < 0.95f;
+    }
+
+    // latest_only不作用于同一批帧的画布，结果可以用wait_for轮询，被取消的画布上各帧结果为空
+    {
+        Yolo::MosaicConfig config;
+        config.canvas_width = 320;
+        config.canvas_height = 320;
+        config.gap = 8;
+        auto packer = Yolo::create_mosaic_infer(infer, config);
+        auto expected = packer->commits(frames);
+
+        JobOptions stream = JobOptions::stream(1);
+        stream.outcome = JobOutcome::create();
+        auto results = packer->commits(frames, stream);
+        bool complete = true;
+        for (int i = 0; i < num_cameras; ++i)
+        {
+            while (results[i].wait_for(chrono::milliseconds(0)) != future_status::ready)
+                this_thread::sleep_for(chrono::milliseconds(1));
+            complete = complete && BenchTools::same_boxes(results[i].get(), expected[i].get());
+        }
+        complete = complete && !stream.outcome->rejected();
+
+        JobOptions cancelled;
+        cancelled.cancel_token = CancellationToken::create();
+        cancelled.cancel_token->cancel();
+        cancelled.outcome = JobOutcome::create();
+        bool rejected = cancelled.outcome != nullptr;
+        for (auto &result : packer->commits(frames, cancelled))
+            rejected = rejected && result.get().empty();
+        auto report = packer->report();
+        rejected = rejected && cancelled.outcome->rejected() && report.num_rejected_canvases > 0;
+        INFO("latest_only canvases complete %s, cancelled canvases rejected %s (%lld canvases)",
+             complete ? "PASS" : "FAIL", rejected ? "PASS" : "FAIL", report.num_rejected_canvases);
+        num_fail += !complete + !rejected;
+    }
+    return num_fail == 0 ? 0 : -1;
+}
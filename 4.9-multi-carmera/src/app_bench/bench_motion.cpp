@@ -0,0 +1,219 @@
+#include "bench.hpp"
+#include "bench_tools.hpp"
+#include "cpu_yolo.hpp"
+#include <random>
+
+using namespace std;
+
+// 模拟的相机画面：带纹理的背景，static加传感器噪声，drift整体亮度缓慢变化，moving有一个移动的方块，busy整幅画面滚动
+class CameraSource
+{
+public:
+    enum Kind : int
+    {
+        Static = 0,
+        Drift = 1,
+        Moving = 2,
+        Busy = 3
+    };
+
+    CameraSource(Kind kind, int width, int height, unsigned seed) : kind_(kind), width_(width), height_(height)
+    {
+        mt19937 rng(seed);
+        uniform_int_distribution<int> noise(-6, 6);
+        background_ = cv::Mat(height, width, CV_8UC3);
+        for (int y = 0; y < height; ++y)
+        {
+            uint8_t *p = background_.ptr<uint8_t>(y);
+            for (int x = 0; x < width * 3; ++x)
+                p[x] = 40 + ((x / 3 / 40 + y / 40) % 2) * 40;
+        }
+
+        for (int i = 0; i < 4; ++i)
+        {
+            noisy_.emplace_back(height, width, CV_8UC3);
+            for (int y = 0; y < height; ++y)
+            {
+                const uint8_t *src = background_.ptr<uint8_t>(y);
+                uint8_t *dst = noisy_[i].ptr<uint8_t>(y);
+                for (int x = 0; x < width * 3; ++x)
+                    dst[x] = src[x] + noise(rng);
+            }
+        }
+    }
+
+    cv::Mat frame(int index)
+    {
+        const cv::Mat &base = noisy_[index % noisy_.size()];
+        cv::Mat output(height_, width_, CV_8UC3);
+        int shift = kind_ == Busy ? index * 7 : 0;
+        int drift = kind_ == Drift ? index / 10 : 0;
+        for (int y = 0; y < height_; ++y)
+        {
+            const uint8_t *src = base.ptr<uint8_t>((y + shift) % height_);
+            uint8_t *dst = output.ptr<uint8_t>(y);
+            for (int x = 0; x < width_ * 3; ++x)
+                dst[x] = min(255, src[x] + drift);
+        }
+
+        if (kind_ == Moving)
+            output(object(index)).setTo(cv::Scalar(230, 230, 230));
+        return output;
+    }
+
+    // 每帧移动4个像素，来回往返
+    cv::Rect object(int index) const
+    {
+        int range = width_ - 128;
+        int x = (index * 4) % (2 * range);
+        if (x > range)
+            x = 2 * range - x;
+        return cv::Rect(x, height_ / 2 - 64, 128, 128);
+    }
+
+private:
+    Kind kind_;
+    int width_, height_;
+    cv::Mat background_;
+    vector<cv::Mat> noisy_;
+};
+
+static bool contains_object(const ObjectDetector::BoxArray &boxes, const cv::Rect &object)
+{
+    for (auto &box : boxes)
+    {
+        float cx = (box.left + box.right) * 0.5f;
+        float cy = (box.top + box.bottom) * 0.5f;
+        if (cx >= object.x - 16 && cx <= object.x + object.width + 16 && cy >= object.y - 16 && cy <= object.y + object.height + 16)
+            return true;
+    }
+    return false;
+}
+
+/* 1. 运动检测：静止、带噪声、亮度缓慢变化的画面没有运动，移动的方块有运动且区域包含方块
+   2. 4路相机(静止、亮度漂移、小目标移动、整幅滚动)不门控与门控时：提交给引擎的帧数、总耗时、每路的跳过率、
+      局部推理的比例、运动检测的耗时，以及移动方块在每一帧结果中的召回
+*/
+int bench_motion(int num_frames, int width, int height)
+{
+    int num_fail = 0;
+    const char *names[] = {"static", "drift", "moving", "busy"};
+    vector<shared_ptr<CameraSource>> sources;
+    for (int i = 0; i < 4; ++i)
+        sources.emplace_back(new CameraSource((CameraSource::Kind)i, width, height, i + 1));
+
+    for (auto method : {Yolo::MotionMethod::FrameDiff, Yolo::MotionMethod::RunningAverage})
+    {
+        Yolo::MotionConfig config;
+        config.method = method;
+        int false_motion = 0, missed_motion = 0, region_miss = 0;
+        for (int kind : {0, 1, 2})
+        {
+            auto detector = Yolo::create_motion_detector(config);
+            for (int i = 0; i < num_frames; ++i)
+            {
+                auto motion = detector->detect(sources[kind]->frame(i));
+                if (i == 0)
+                    continue;
+
+                if (kind != CameraSource::Moving)
+                {
+                    false_motion += motion.motion;
+                    continue;
+                }
+
+                missed_motion += !motion.motion;
+                cv::Rect object = sources[kind]->object(i);
+                region_miss += motion.motion && (motion.region & object).area() != object.area();
+            }
+        }
+        bool ok = false_motion == 0 && missed_motion == 0 && region_miss == 0;
+        INFO("%s: %d false motion on static/drift, %d missed and %d region misses on moving, %s",
+             Yolo::motion_method_name(method), false_motion, missed_motion, region_miss, ok ? "PASS" : "FAIL");
+        num_fail += !ok;
+    }
+
+    auto model = TRT::cpu_yolo_model(8, 320, 320, 400, 80, 2.0f, 0.5f);
+    auto infer = CPUYolo::create_infer(model, 0.25f, 0.5f);
+    if (infer == nullptr)
+    {
+        INFOE("Create cpu infer failed.");
+        return -1;
+    }
+
+    vector<vector<cv::Mat>> frames(4);
+    for (int camera = 0; camera < 4; ++camera)
+    {
+        for (int i = 0; i < num_frames; ++i)
+            frames[camera].emplace_back(sources[camera]->frame(i));
+    }
+
+    for (bool gated : {false, true})
+    {
+        auto gate = Yolo::create_motion_gated_infer(infer);
+
+        // 亮度漂移的相机阈值更高，滚动的相机不做局部推理
+        Yolo::MotionConfig drift_config;
+        drift_config.pixel_threshold = 20;
+        gate->set_camera_config(1, drift_config);
+        Yolo::MotionConfig busy_config;
+        busy_config.crop = false;
+        gate->set_camera_config(3, busy_config);
+
+        auto before = infer->metrics();
+        auto tick = iLogger::timestamp_now_float();
+        vector<vector<shared_future<ObjectDetector::BoxArray>>> results(4);
+        for (int i = 0; i < num_frames; ++i)
+        {
+            for (int camera = 0; camera < 4; ++camera)
+                results[camera].emplace_back(gated ? gate->commit(camera, frames[camera][i]) : infer->commit(frames[camera][i]));
+        }
+
+        int num_found = 0;
+        for (int camera = 0; camera < 4; ++camera)
+        {
+            for (int i = 0; i < num_frames; ++i)
+            {
+                auto &boxes = results[camera][i].get();
+                if (camera == CameraSource::Moving)
+                    num_found += contains_object(boxes, sources[camera]->object(i));
+            }
+        }
+        double elapsed = iLogger::timestamp_now_float() - tick;
+        auto after = infer->metrics();
+        long long num_jobs = after.num_jobs - before.num_jobs;
+        float recall = num_found / (float)num_frames;
+        INFO("%-8s %d frames, %lld engine jobs, %.1f ms, %.1f fps, moving object recall %.3f",
+             gated ? "gated" : "ungated", num_frames * 4, num_jobs, elapsed, num_frames * 4 / elapsed * 1000, recall);
+        num_fail += recall < 0.95f;
+
+        if (!gated)
+            continue;
+
+        for (auto &report : gate->reports())
+        {
+            INFO("  camera %d %-7s skip %.3f, %lld full (%lld forced), %lld cropped, %lld skipped, inferred area %.3f, detect %.1f us",
+                 report.camera, names[report.camera], report.skip_rate, report.num_full, report.num_forced,
+                 report.num_cropped, report.num_skipped, report.inferred_area, report.detect_us);
+        }
+    }
+
+    // 被取消的帧沿用上一次的结果，下一帧即使静止也强制推理
+    {
+        auto gate = Yolo::create_motion_gated_infer(infer);
+        int camera = CameraSource::Moving;
+        auto first = gate->commit(camera, frames[camera][0]).get();
+
+        JobOptions cancelled;
+        cancelled.cancel_token = CancellationToken::create();
+        cancelled.cancel_token->cancel();
+        cancelled.outcome = JobOutcome::create();
+        auto kept = gate->commit(camera, frames[camera][1], cancelled).get();
+        auto refreshed = gate->commit(camera, frames[camera][1]).get();
+        bool ok = cancelled.outcome->rejected() && BenchTools::same_boxes(kept, first) && !first.empty() &&
+                  contains_object(refreshed, sources[camera]->object(1));
+        INFO("cancelled frame keeps previous boxes, next frame refreshed %s", ok ? "PASS" : "FAIL");
+        num_fail += !ok;
+    }
+    return num_fail == 0 ? 0 : -1;
+}
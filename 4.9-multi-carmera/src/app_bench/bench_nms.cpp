@@ -0,0 +1,367 @@
+#include "bench.hpp"
+#include "bench_tools.hpp"
+#include "app_yolo/yolo.hpp"
+#include <thread>
+#include <random>
+#include <cstring>
+#include <cmath>
+#include <functional>
+
+using namespace std;
+using namespace ObjectDetector;
+
+/* 模拟解码后、nms之前的框：num_objects个目标，每个目标附近有若干个抖动的框，类别在num_classes中随机
+   约1/8的框随机散布，另有少量宽高为0或者左右颠倒的退化框
+*/
+static BoxArray make_boxes(int num_boxes, int num_classes, int seed, float width = 1280, float height = 720)
+{
+    mt19937 rng(seed);
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    BoxArray boxes;
+    boxes.reserve(num_boxes);
+
+    int num_objects = max(1, num_boxes / 12);
+    vector<Box> objects(num_objects);
+    for (auto &item : objects)
+    {
+        float w = 16 + unit(rng) * 200, h = 16 + unit(rng) * 200;
+        float x = unit(rng) * (width - w), y = unit(rng) * (height - h);
+        item = Box(x, y, x + w, y + h, 0, rng() % num_classes);
+    }
+
+    for (int i = 0; i < num_boxes; ++i)
+    {
+        float confidence = 0.05f + unit(rng) * 0.95f;
+        int kind = rng() % 64;
+        if (kind == 0)
+        {
+            // 退化框
+            float x = unit(rng) * width, y = unit(rng) * height;
+            boxes.emplace_back(x, y, x - unit(rng) * 4, y, confidence, rng() % num_classes);
+        }
+        else if (kind < 8)
+        {
+            float w = 8 + unit(rng) * 300, h = 8 + unit(rng) * 300;
+            float x = unit(rng) * width, y = unit(rng) * height;
+            boxes.emplace_back(x, y, x + w, y + h, confidence, rng() % num_classes);
+        }
+        else
+        {
+            auto &obj = objects[rng() % num_objects];
+            float w = obj.right - obj.left, h = obj.bottom - obj.top;
+            float dx = (unit(rng) - 0.5f) * w * 0.3f, dy = (unit(rng) - 0.5f) * h * 0.3f;
+            float sw = 0.8f + unit(rng) * 0.4f, sh = 0.8f + unit(rng) * 0.4f;
+            float cx = (obj.left + obj.right) * 0.5f + dx, cy = (obj.top + obj.bottom) * 0.5f + dy;
+            boxes.emplace_back(cx - w * sw * 0.5f, cy - h * sh * 0.5f, cx + w * sw * 0.5f, cy + h * sh * 0.5f, confidence, obj.class_label);
+        }
+    }
+    return boxes;
+}
+
+// 对每种方法重复repeat次，返回每次的平均耗时(ms)
+template <class _Func>
+static double time_nms(const BoxArray &input, int repeat, BoxArray &output, _Func func)
+{
+    BoxArray boxes;
+    double total_ms = 0;
+    for (int i = 0; i < repeat; ++i)
+    {
+        boxes = input;
+        auto tick = iLogger::timestamp_now_float();
+        func(boxes);
+        total_ms += iLogger::timestamp_now_float() - tick;
+    }
+    output = boxes;
+    return total_ms / repeat;
+}
+
+/* 1. 正确性：不同数量、类别数、阈值(包括0和1)下cpu_nms_fast与cpu_nms、cpu_nms_inplace的结果逐位比较
+   2. 单张图：64~4096个框、80类与1类时三种实现的耗时
+   3. batch：batch_size张图依次cpu_nms_fast与cpu_nms_batch并行
+*/
+int bench_nms(int batch_size, int repeat)
+{
+    int num_mismatch = 0;
+    int num_cases = 0;
+    for (int num_boxes : {0, 1, 7, 64, 300, 1024, 3000})
+    {
+        for (int num_classes : {1, 3, 80})
+        {
+            for (float threshold : {0.0f, 0.3f, 0.45f, 0.7f, 1.0f})
+            {
+                for (int seed = 0; seed < 3; ++seed)
+                {
+                    auto input = make_boxes(num_boxes, num_classes, seed * 131 + num_boxes);
+                    BoxArray reference, inplace, fast;
+                    time_nms(input, 1, reference, [&](BoxArray &boxes)
+                             { boxes = Yolo::cpu_nms(boxes, threshold); });
+                    time_nms(input, 1, inplace, [&](BoxArray &boxes)
+                             { Yolo::cpu_nms_inplace(boxes, threshold); });
+                    time_nms(input, 1, fast, [&](BoxArray &boxes)
+                             { Yolo::cpu_nms_fast(boxes, threshold); });
+
+                    num_cases++;
+                    if (!BenchTools::same_boxes(reference, fast) || !BenchTools::same_boxes(inplace, fast))
+                    {
+                        num_mismatch++;
+                        INFOE("mismatch: %d boxes, %d classes, threshold %.2f, seed %d: cpu_nms %d, fast %d",
+                              num_boxes, num_classes, threshold, seed, (int)reference.size(), (int)fast.size());
+                    }
+                }
+            }
+        }
+    }
+    INFO("correctness: %d cases, %d mismatch, %s", num_cases, num_mismatch, num_mismatch == 0 ? "PASS" : "FAIL");
+
+    for (int num_classes : {80, 1})
+    {
+        for (int num_boxes : {64, 256, 1024, 4096})
+        {
+            auto input = make_boxes(num_boxes, num_classes, num_boxes);
+            int n = max(3, repeat * 1024 / num_boxes / (num_classes == 1 ? 4 : 1));
+            BoxArray output;
+            double reference_ms = time_nms(input, n, output, [&](BoxArray &boxes)
+                                           { boxes = Yolo::cpu_nms(boxes, 0.45f); });
+            double inplace_ms = time_nms(input, n, output, [&](BoxArray &boxes)
+                                         { Yolo::cpu_nms_inplace(boxes, 0.45f); });
+            double fast_ms = time_nms(input, n, output, [&](BoxArray &boxes)
+                                      { Yolo::cpu_nms_fast(boxes, 0.45f); });
+            INFO("%4d boxes, %2d classes, %3d kept: cpu_nms %.3f ms, inplace %.3f ms, fast %.3f ms, %.1fx",
+                 num_boxes, num_classes, (int)output.size(), reference_ms, inplace_ms, fast_ms, reference_ms / fast_ms);
+        }
+    }
+
+    vector<BoxArray> inputs(batch_size);
+    for (int i = 0; i < batch_size; ++i)
+        inputs[i] = make_boxes(1024, 80, 1000 + i);
+
+    vector<BoxArray> batch(batch_size);
+    vector<BoxArray *> pointers(batch_size);
+    double sequential_ms = 0, parallel_ms = 0;
+    int batch_repeat = max(1, repeat / 4);
+    for (int r = 0; r < batch_repeat; ++r)
+    {
+        batch = inputs;
+        auto tick = iLogger::timestamp_now_float();
+        for (auto &boxes : batch)
+            Yolo::cpu_nms_fast(boxes, 0.45f);
+        sequential_ms += iLogger::timestamp_now_float() - tick;
+
+        batch = inputs;
+        for (int i = 0; i < batch_size; ++i)
+            pointers[i] = &batch[i];
+
+        tick = iLogger::timestamp_now_float();
+        Yolo::cpu_nms_batch(pointers, 0.45f);
+        parallel_ms += iLogger::timestamp_now_float() - tick;
+    }
+    INFO("batch %d x 1024 boxes: sequential %.3f ms, parallel %.3f ms on %d threads",
+         batch_size, sequential_ms / batch_repeat, parallel_ms / batch_repeat, (int)thread::hardware_concurrency());
+    return num_mismatch == 0 ? 0 : -1;
+}
+
+// 逐对比较的DIoU-NMS，与cpu_diou_nms的运算顺序相同
+static void reference_diou_nms(BoxArray &boxes, float threshold)
+{
+    std::sort(boxes.begin(), boxes.end(), [](BoxArray::const_reference a, BoxArray::const_reference b)
+              { return a.confidence > b.confidence; });
+
+    auto area = [](const Box &a)
+    { return max(0.0f, a.right - a.left) * max(0.0f, a.bottom - a.top); };
+
+    int num_keep = 0;
+    for (int i = 0; i < (int)boxes.size(); ++i)
+    {
+        auto &b = boxes[i];
+        bool keep = true;
+        for (int j = 0; j < num_keep && keep; ++j)
+        {
+            auto &a = boxes[j];
+            if (a.class_label != b.class_label)
+                continue;
+
+            float c_area = max(min(a.right, b.right) - max(a.left, b.left), 0.0f) * max(min(a.bottom, b.bottom) - max(a.top, b.top), 0.0f);
+            float iou = c_area == 0.0f ? 0.0f : c_area / (area(a) + area(b) - c_area);
+            float ew = max(a.right, b.right) - min(a.left, b.left);
+            float eh = max(a.bottom, b.bottom) - min(a.top, b.top);
+            float c2 = ew * ew + eh * eh;
+            float dx = (a.left + a.right) - (b.left + b.right);
+            float dy = (a.top + a.bottom) - (b.top + b.bottom);
+            float penalty = c2 > 0.0f ? (dx * dx + dy * dy) * 0.25f / c2 : 0.0f;
+            keep = !(iou - penalty >= threshold);
+        }
+
+        if (keep)
+            boxes[num_keep++] = b;
+    }
+    boxes.resize(num_keep);
+}
+
+// 逐个选最大、逐个衰减的soft nms，exp使用std::exp
+static void reference_soft_nms(BoxArray &boxes, float threshold, bool gaussian, float sigma, float score_threshold)
+{
+    BoxArray remain;
+    for (auto &box : boxes)
+    {
+        if (box.confidence >= score_threshold)
+            remain.emplace_back(box);
+    }
+
+    BoxArray output;
+    while (!remain.empty())
+    {
+        int best = 0;
+        for (int i = 1; i < (int)remain.size(); ++i)
+        {
+            if (remain[i].confidence > remain[best].confidence)
+                best = i;
+        }
+
+        auto selected = remain[best];
+        output.emplace_back(selected);
+        remain.erase(remain.begin() + best);
+
+        BoxArray next;
+        for (auto &box : remain)
+        {
+            if (box.class_label == selected.class_label)
+            {
+                float c_area = max(min(box.right, selected.right) - max(box.left, selected.left), 0.0f) *
+                               max(min(box.bottom, selected.bottom) - max(box.top, selected.top), 0.0f);
+                float union_area = max(0.0f, box.right - box.left) * max(0.0f, box.bottom - box.top) +
+                                   max(0.0f, selected.right - selected.left) * max(0.0f, selected.bottom - selected.top) - c_area;
+                float iou = c_area == 0.0f ? 0.0f : c_area / union_area;
+                box.confidence *= gaussian ? std::exp(-iou * iou / sigma) : (iou > threshold ? 1 - iou : 1.0f);
+            }
+
+            if (box.confidence >= score_threshold)
+                next.emplace_back(box);
+        }
+        remain.swap(next);
+    }
+    boxes = output;
+}
+
+// 按类别与坐标排序后比较，返回置信度的最大误差，数量或坐标不同时返回-1
+static float compare_by_position(BoxArray a, BoxArray b)
+{
+    if (a.size() != b.size())
+        return -1;
+
+    auto less = [](const Box &x, const Box &y)
+    {
+        if (x.class_label != y.class_label)
+            return x.class_label < y.class_label;
+        return memcmp(&x.left, &y.left, sizeof(float) * 4) < 0;
+    };
+    std::sort(a.begin(), a.end(), less);
+    std::sort(b.begin(), b.end(), less);
+
+    float max_error = 0;
+    for (int i = 0; i < (int)a.size(); ++i)
+    {
+        if (memcmp(&a[i].left, &b[i].left, sizeof(float) * 4) != 0 || a[i].class_label != b[i].class_label)
+            return -1;
+        max_error = max(max_error, std::abs(a[i].confidence - b[i].confidence));
+    }
+    return max_error;
+}
+
+/* 1. 正确性：cpu_diou_nms与逐对比较的实现逐位一致，cpu_nms_agnostic与把类别都设为0的cpu_nms一致，
+      soft nms与逐个衰减的实现保留相同的框，置信度的误差在1e-5以内
+   2. 1024与4096个框、80类与1类时每种方法每1k个框的耗时
+*/
+int bench_nms_methods(int repeat)
+{
+    const float threshold = 0.45f, sigma = 0.5f, score_threshold = 0.05f;
+    int num_fail = 0;
+    float max_soft_error = 0;
+    for (int num_boxes : {0, 5, 64, 300, 1024})
+    {
+        for (int num_classes : {1, 3, 80})
+        {
+            for (int seed = 0; seed < 3; ++seed)
+            {
+                auto input = make_boxes(num_boxes, num_classes, seed * 17 + num_boxes);
+                BoxArray reference = input, output = input;
+                reference_diou_nms(reference, threshold);
+                Yolo::cpu_diou_nms(output, threshold);
+                bool diou_ok = BenchTools::same_boxes(reference, output);
+
+                reference = input;
+                for (auto &box : reference)
+                    box.class_label = 0;
+                Yolo::cpu_nms_inplace(reference, threshold);
+                output = input;
+                Yolo::cpu_nms_agnostic(output, threshold);
+                for (auto &box : output)
+                    box.class_label = 0;
+                bool agnostic_ok = BenchTools::same_boxes(reference, output);
+
+                bool soft_ok = true;
+                for (bool gaussian : {false, true})
+                {
+                    reference = input;
+                    output = input;
+                    reference_soft_nms(reference, threshold, gaussian, sigma, score_threshold);
+                    Yolo::cpu_soft_nms(output, threshold, gaussian, sigma, score_threshold);
+                    float error = compare_by_position(reference, output);
+                    soft_ok = soft_ok && error >= 0 && error < 1e-5f;
+                    max_soft_error = max(max_soft_error, error);
+                    for (int i = 1; i < (int)output.size(); ++i)
+                        soft_ok = soft_ok && output[i - 1].confidence >= output[i].confidence;
+                }
+
+                if (!diou_ok || !agnostic_ok || !soft_ok)
+                {
+                    num_fail++;
+                    INFOE("mismatch: %d boxes, %d classes, seed %d: diou %s, agnostic %s, soft %s", num_boxes, num_classes, seed,
+                          diou_ok ? "ok" : "fail", agnostic_ok ? "ok" : "fail", soft_ok ? "ok" : "fail");
+                }
+            }
+        }
+    }
+    INFO("correctness: %d fail, max soft nms confidence error %g, %s", num_fail, max_soft_error, num_fail == 0 ? "PASS" : "FAIL");
+
+    struct Method
+    {
+        const char *name;
+        function<void(BoxArray &)> run;
+    };
+    Method methods[] = {
+        {"cpu_nms", [&](BoxArray &boxes)
+         { boxes = Yolo::cpu_nms(boxes, threshold); }},
+        {"CPU", [&](BoxArray &boxes)
+         { Yolo::cpu_nms_method(boxes, Yolo::NMSMethod::CPU, threshold, score_threshold); }},
+        {"ClassAgnostic", [&](BoxArray &boxes)
+         { Yolo::cpu_nms_method(boxes, Yolo::NMSMethod::ClassAgnostic, threshold, score_threshold); }},
+        {"DIoU", [&](BoxArray &boxes)
+         { Yolo::cpu_nms_method(boxes, Yolo::NMSMethod::DIoU, threshold, score_threshold); }},
+        {"SoftLinear", [&](BoxArray &boxes)
+         { Yolo::cpu_nms_method(boxes, Yolo::NMSMethod::SoftLinear, threshold, score_threshold); }},
+        {"SoftGaussian", [&](BoxArray &boxes)
+         { Yolo::cpu_nms_method(boxes, Yolo::NMSMethod::SoftGaussian, threshold, score_threshold); }},
+        {"soft (scalar)", [&](BoxArray &boxes)
+         { reference_soft_nms(boxes, threshold, true, sigma, score_threshold); }}};
+
+    for (int num_classes : {80, 1})
+    {
+        for (int num_boxes : {1024, 4096})
+        {
+            auto input = make_boxes(num_boxes, num_classes, num_boxes + 7);
+            double baseline_ms = 0;
+            for (auto &method : methods)
+            {
+                int n = max(2, repeat * 1024 / num_boxes / (num_classes == 1 ? 8 : 1));
+                BoxArray output;
+                double ms = time_nms(input, n, output, method.run);
+                if (baseline_ms == 0)
+                    baseline_ms = ms;
+
+                INFO("%4d boxes, %2d classes, %-14s %4d kept, %.3f ms per 1k boxes, %.2fx cpu_nms",
+                     num_boxes, num_classes, method.name, (int)output.size(), ms * 1024 / num_boxes, ms / baseline_ms);
+            }
+        }
+    }
+    return num_fail == 0 ? 0 : -1;
+}
@@ -0,0 +1,482 @@
+#include "bench.hpp"
+#include "bench_tools.hpp"
+#include "cpu_yolo.hpp"
+#include <thread>
+#include <atomic>
+#include <functional>
+
+using namespace std;
+
+struct ProducerResult
+{
+    BenchTools::LatencyStat latency;
+    double elapsed_ms = 0;
+    long long num_images = 0;
+    long long num_boxes = 0;
+};
+
+/* num_producers个线程同时提交
+   interval_ms = 0：闭环，每个线程等待结果后再提交下一张
+   interval_ms > 0：开环，每个线程按固定间隔提交，由单独的线程按顺序等待结果
+*/
+static ProducerResult run_producers(shared_ptr<Yolo::Infer> infer, int num_producers, int images_per_producer, double interval_ms = 0, const JobOptions &options = JobOptions())
+{
+    vector<cv::Mat> images;
+    for (int i = 0; i < 16; ++i)
+        images.push_back(BenchTools::make_image(640, 360, i));
+
+    // warmup
+    infer->commit(images[0]).get();
+
+    vector<BenchTools::LatencyStat> latencys(num_producers);
+    atomic<long long> num_boxes(0);
+    auto tick = iLogger::timestamp_now_float();
+    vector<thread> producers;
+    for (int iproducer = 0; iproducer < num_producers; ++iproducer)
+    {
+        producers.emplace_back([&, iproducer]()
+                               {
+            auto &latency = latencys[iproducer];
+            if (interval_ms <= 0)
+            {
+                for (int i = 0; i < images_per_producer; ++i)
+                {
+                    auto begin = iLogger::timestamp_now_float();
+                    auto boxes = infer->commit(images[(i + iproducer) % images.size()], options).get();
+                    latency.add(iLogger::timestamp_now_float() - begin);
+                    num_boxes += boxes.size();
+                }
+                return;
+            }
+
+            vector<pair<double, shared_future<ObjectDetector::BoxArray>>> pending(images_per_producer);
+            atomic<int> num_committed(0);
+            thread waiter([&]()
+                          {
+                for (int i = 0; i < images_per_producer; ++i)
+                {
+                    while (num_committed <= i)
+                        this_thread::yield();
+
+                    auto boxes = pending[i].second.get();
+                    latency.add(iLogger::timestamp_now_float() - pending[i].first);
+                    num_boxes += boxes.size();
+                } });
+
+            auto next = iLogger::timestamp_now_float();
+            for (int i = 0; i < images_per_producer; ++i)
+            {
+                while (iLogger::timestamp_now_float() < next)
+                    this_thread::sleep_for(chrono::microseconds(50));
+
+                next += interval_ms;
+                pending[i].first = iLogger::timestamp_now_float();
+                pending[i].second = infer->commit(images[(i + iproducer) % images.size()], options);
+                num_committed++;
+            }
+            waiter.join(); });
+    }
+
+    for (auto &t : producers)
+        t.join();
+
+    ProducerResult result;
+    result.elapsed_ms = iLogger::timestamp_now_float() - tick;
+    result.num_images = num_producers * (long long)images_per_producer;
+    result.num_boxes = num_boxes;
+    for (auto &stat : latencys)
+        result.latency.merge(stat);
+    return result;
+}
+
+int bench_cpu_pipeline(int num_producers, int images_per_producer, float base_cost_ms, float per_image_cost_ms)
+{
+    // 小尺寸的输入和bbox数量，让耗时主要由配置的计算开销决定
+    auto model = TRT::cpu_yolo_model(8, 320, 320, 400, 80, base_cost_ms, per_image_cost_ms);
+    auto infer = CPUYolo::create_infer(model, 0.25f, 0.45f);
+    if (infer == nullptr)
+    {
+        INFOE("Create cpu infer failed.");
+        return -1;
+    }
+
+    auto result = run_producers(infer, num_producers, images_per_producer);
+    INFO("cpu pipeline: %d producers, cost %.2f ms + %.2f ms x batch", num_producers, base_cost_ms, per_image_cost_ms);
+    INFO("throughput: %.2f images/s, %lld boxes", result.num_images / result.elapsed_ms * 1000, result.num_boxes);
+    INFO("latency: %s", result.latency.summary().c_str());
+    INFO("batching: %s", infer->batching_report().to_string().c_str());
+    return 0;
+}
+
+int bench_batching(int num_producers, int images_per_producer, double interval_ms)
+{
+    // 固定开销较大的引擎，batch越大单张越便宜
+    auto model = TRT::cpu_yolo_model(8, 320, 320, 400, 80, 4.0f, 0.25f);
+    auto infer = CPUYolo::create_infer(model, 0.25f, 0.45f);
+    if (infer == nullptr)
+    {
+        INFOE("Create cpu infer failed.");
+        return -1;
+    }
+
+    int delays_us[] = {0, 1000, 2000, 4000};
+    for (int delay_us : delays_us)
+    {
+        infer->set_batching_policy(BatchingPolicy::deadline(delay_us, 8));
+        infer->batching_report(true);
+
+        auto result = run_producers(infer, num_producers, images_per_producer, interval_ms);
+        INFO("max queue delay %.1f ms: throughput %.2f images/s", delay_us / 1000.0f, result.num_images / result.elapsed_ms * 1000);
+        INFO("  latency: %s", result.latency.summary().c_str());
+        INFO("  batching: %s", infer->batching_report().to_string().c_str());
+    }
+    return 0;
+}
+
+int bench_stages(int num_producers, int images_per_producer)
+{
+    // 置信度阈值为0，每张图保留全部2304个box，CPU NMS成为主要的后处理开销
+    auto model = TRT::cpu_yolo_model(8, 320, 320, 2304, 80, 4.0f, 0.5f);
+    PipelineConfig configs[] = {
+        PipelineConfig::inline_stages(),
+        PipelineConfig::pools(2, 2),
+    };
+
+    int num_fail = 0;
+    for (auto &config : configs)
+    {
+        auto infer = CPUYolo::create_infer(model, 0.0f, 0.45f, 4096, config);
+        if (infer == nullptr)
+        {
+            INFOE("Create cpu infer failed.");
+            return -1;
+        }
+
+        infer->pipeline_report(true);
+        auto result = run_producers(infer, num_producers, images_per_producer);
+        INFO("preprocess threads %d, postprocess threads %d: throughput %.2f images/s",
+             config.num_preprocess_threads, config.num_postprocess_threads, result.num_images / result.elapsed_ms * 1000);
+        INFO("  latency: %s", result.latency.summary().c_str());
+        INFO("  stages: %s", infer->pipeline_report().to_string().c_str());
+
+        // 预处理失败的job计入failed，预处理线程池中失败时commit已经返回Accepted
+        infer->admission_report(true);
+        bool empty = infer->commit(cv::Mat()).get().empty();
+        bool failed = infer->admission_report().failed == 1;
+        INFO("  failed preprocess recorded %s", empty && failed ? "PASS" : "FAIL");
+        num_fail += !empty || !failed;
+    }
+    return num_fail == 0 ? 0 : -1;
+}
+
+int bench_priority(int num_cameras, int frames_per_camera, int num_bulk_images)
+{
+    auto model = TRT::cpu_yolo_model(8, 320, 320, 400, 80, 4.0f, 0.5f);
+    vector<cv::Mat> bulk_images;
+    for (int i = 0; i < num_bulk_images; ++i)
+        bulk_images.push_back(BenchTools::make_image(640, 360, i));
+
+    for (int use_priority = 0; use_priority < 2; ++use_priority)
+    {
+        auto infer = CPUYolo::create_infer(model, 0.25f, 0.45f);
+        if (infer == nullptr)
+        {
+            INFOE("Create cpu infer failed.");
+            return -1;
+        }
+
+        // 批量任务与相机同时开始，FIFO时相机帧排在整批之后
+        double bulk_elapsed_ms = 0;
+        thread bulk([&]()
+                    {
+            auto tick = iLogger::timestamp_now_float();
+            auto results = infer->commits(bulk_images, use_priority ? JobOptions::bulk(1) : JobOptions());
+            for (auto &item : results)
+                item.get();
+            bulk_elapsed_ms = iLogger::timestamp_now_float() - tick; });
+
+        auto live = run_producers(infer, num_cameras, frames_per_camera, 40, use_priority ? JobOptions::realtime(0) : JobOptions());
+        bulk.join();
+
+        INFO("%s: bulk %d images in %.2f ms", use_priority ? "priority" : "fifo", num_bulk_images, bulk_elapsed_ms);
+        INFO("  live latency: %s", live.latency.summary().c_str());
+        INFO("  classes: %s", infer->scheduling_report().to_string().c_str());
+    }
+    return 0;
+}
+
+typedef function<shared_future<ObjectDetector::BoxArray>(const cv::Mat &image, int icamera, int iframe)> SubmitFunction;
+
+/* num_cameras个相机按固定间隔开环提交，由submit决定提交方式
+   测试图上一定有检测结果，结果为空即视为被拒绝、丢弃或者取消，不计入延迟
+*/
+static ProducerResult run_cameras(int num_cameras, int frames_per_camera, double interval_ms, const SubmitFunction &submit)
+{
+    vector<cv::Mat> images;
+    for (int i = 0; i < 16; ++i)
+        images.push_back(BenchTools::make_image(640, 360, i));
+
+    vector<BenchTools::LatencyStat> latencys(num_cameras);
+    vector<thread> cameras;
+    auto tick = iLogger::timestamp_now_float();
+    for (int icamera = 0; icamera < num_cameras; ++icamera)
+    {
+        cameras.emplace_back([&, icamera]()
+                             {
+            vector<pair<double, shared_future<ObjectDetector::BoxArray>>> pending(frames_per_camera);
+            atomic<int> num_committed(0);
+            thread waiter([&]()
+                          {
+                for (int i = 0; i < frames_per_camera; ++i)
+                {
+                    while (num_committed <= i)
+                        this_thread::yield();
+
+                    if (!pending[i].second.valid())
+                        continue;
+
+                    auto boxes = pending[i].second.get();
+                    if (!boxes.empty())
+                        latencys[icamera].add(iLogger::timestamp_now_float() - pending[i].first);
+                } });
+
+            auto next = iLogger::timestamp_now_float();
+            for (int i = 0; i < frames_per_camera; ++i)
+            {
+                while (iLogger::timestamp_now_float() < next)
+                    this_thread::sleep_for(chrono::microseconds(50));
+
+                next += interval_ms;
+                pending[i].first = iLogger::timestamp_now_float();
+                pending[i].second = submit(images[(i + icamera) % images.size()], icamera, i);
+                num_committed++;
+            }
+            waiter.join(); });
+    }
+
+    for (auto &t : cameras)
+        t.join();
+
+    ProducerResult result;
+    result.elapsed_ms = iLogger::timestamp_now_float() - tick;
+    result.num_images = num_cameras * frames_per_camera;
+    for (auto &item : latencys)
+        result.latency.merge(item);
+    return result;
+}
+
+/* 生产者快于引擎时三种处理方式的对比
+   unlimited：原来的行为，commit阻塞等待空闲的tensor，延迟持续增长
+   bounded：限制队列深度和排队时长，超出的帧被拒绝或丢弃
+   stream：try_commit + latest_only，每个相机只保留最新的一帧
+*/
+int bench_admission(int num_cameras, int frames_per_camera, double interval_ms)
+{
+    auto model = TRT::cpu_yolo_model(4, 320, 320, 400, 80, 4.0f, 0.5f);
+    const char *modes[] = {"unlimited", "bounded", "stream"};
+    for (int mode = 0; mode < 3; ++mode)
+    {
+        auto infer = CPUYolo::create_infer(model, 0.25f, 0.45f);
+        if (infer == nullptr)
+        {
+            INFOE("Create cpu infer failed.");
+            return -1;
+        }
+
+        if (mode > 0)
+            infer->set_admission_policy(AdmissionPolicy::bounded(8, 100));
+
+        infer->commit(BenchTools::make_image(640, 360)).get();
+        infer->admission_report(true);
+
+        auto result = run_cameras(num_cameras, frames_per_camera, interval_ms, [&](const cv::Mat &image, int icamera, int iframe)
+                                  {
+            shared_future<ObjectDetector::BoxArray> output;
+            if (mode == 2)
+                infer->try_commit(image, output, JobOptions::stream(icamera));
+            else
+                output = infer->commit(image, JobOptions::realtime(icamera));
+            return output; });
+
+        INFO("%s: %d frames offered in %.2f ms, served %d", modes[mode], (int)result.num_images, result.elapsed_ms, (int)result.latency.count());
+        INFO("  latency: %s", result.latency.summary().c_str());
+        INFO("  admission: %s", infer->admission_report().to_string().c_str());
+    }
+    return 0;
+}
+
+/* 过载时截止时间与取消节省的工作量
+   none：不设截止时间，所有帧都完成推理和后处理
+   deadline：超过deadline_ms的帧在凑batch或后处理前被跳过
+   cancel：在deadline的基础上，每隔一帧模拟客户端断开，提交后立即取消
+*/
+int bench_cancellation(int num_cameras, int frames_per_camera, double interval_ms, int deadline_ms)
+{
+    auto model = TRT::cpu_yolo_model(4, 320, 320, 400, 80, 4.0f, 0.5f);
+    const char *modes[] = {"none", "deadline", "cancel"};
+    for (int mode = 0; mode < 3; ++mode)
+    {
+        auto infer = CPUYolo::create_infer(model, 0.25f, 0.45f);
+        if (infer == nullptr)
+        {
+            INFOE("Create cpu infer failed.");
+            return -1;
+        }
+
+        infer->commit(BenchTools::make_image(640, 360)).get();
+        infer->pipeline_report(true);
+
+        auto result = run_cameras(num_cameras, frames_per_camera, interval_ms, [&](const cv::Mat &image, int icamera, int iframe)
+                                  {
+            JobOptions options = JobOptions::realtime(icamera);
+            if (mode > 0)
+                options.deadline_ms = deadline_ms;
+
+            if (mode == 2 && iframe % 2 == 1)
+                options.cancel_token = CancellationToken::create();
+
+            auto output = infer->commit(image, options);
+            if (options.cancel_token)
+                options.cancel_token->cancel();
+            return output; });
+
+        INFO("%s: %d frames offered in %.2f ms, served %d", modes[mode], (int)result.num_images, result.elapsed_ms, (int)result.latency.count());
+        INFO("  latency: %s", result.latency.summary().c_str());
+        INFO("  skipped: %s", infer->cancellation_report().to_string().c_str());
+        INFO("  stages: %s", infer->pipeline_report().to_string().c_str());
+    }
+    return 0;
+}
+
+/* 单缓冲与双缓冲的推理线程
+   1. 顺序校验：不同尺寸、内容的图片并发提交，双缓冲下每张图的结果必须与单缓冲逐张推理的结果完全一致
+      slot之间的输入、输出或者job错位都会导致结果不一致，乱序完成时CPU后端会输出错误日志
+   2. 相同负载下的吞吐、延迟和上传、前向阶段的耗时
+*/
+int bench_staging(int num_producers, int images_per_producer)
+{
+    auto model = TRT::cpu_yolo_model(8, 640, 640, 400, 80, 4.0f, 0.5f);
+    vector<cv::Mat> images;
+    for (int i = 0; i < 32; ++i)
+        images.push_back(i % 2 == 0 ? BenchTools::make_image(640, 360, i) : BenchTools::make_image(360, 480, i));
+
+    PipelineConfig single_buffer;
+    single_buffer.num_staging_buffers = 1;
+    auto reference_infer = CPUYolo::create_infer(model, 0.25f, 0.45f, 1024, single_buffer);
+    auto infer = CPUYolo::create_infer(model, 0.25f, 0.45f);
+    if (reference_infer == nullptr || infer == nullptr)
+    {
+        INFOE("Create cpu infer failed.");
+        return -1;
+    }
+
+    vector<ObjectDetector::BoxArray> references;
+    for (auto &image : images)
+        references.emplace_back(reference_infer->commit(image).get());
+
+    infer->set_batching_policy(BatchingPolicy::deadline(1000));
+    atomic<int> num_mismatch(0);
+    atomic<int> num_checked(0);
+    vector<thread> producers;
+    for (int iproducer = 0; iproducer < num_producers; ++iproducer)
+    {
+        producers.emplace_back([&, iproducer]()
+                               {
+            vector<pair<int, shared_future<ObjectDetector::BoxArray>>> pending;
+            for (int i = 0; i < images_per_producer; ++i)
+            {
+                int index = (i * 7 + iproducer * 13) % images.size();
+                pending.emplace_back(index, infer->commit(images[index]));
+                if (pending.size() < 4 && i + 1 < images_per_producer)
+                    continue;
+
+                for (auto &item : pending)
+                {
+                    if (!BenchTools::same_boxes(item.second.get(), references[item.first]))
+                        num_mismatch++;
+                    num_checked++;
+                }
+                pending.clear();
+            } });
+    }
+
+    for (auto &t : producers)
+        t.join();
+
+    INFO("ordering check: %d results, %d mismatch, %s", (int)num_checked, (int)num_mismatch, num_mismatch == 0 ? "PASS" : "FAIL");
+    infer.reset();
+    reference_infer.reset();
+
+    const char *names[] = {"single buffer", "double buffer"};
+    for (int num_buffers = 1; num_buffers <= 2; ++num_buffers)
+    {
+        PipelineConfig config;
+        config.num_staging_buffers = num_buffers;
+        auto infer = CPUYolo::create_infer(model, 0.25f, 0.45f, 1024, config);
+        if (infer == nullptr)
+        {
+            INFOE("Create cpu infer failed.");
+            return -1;
+        }
+
+        infer->metrics(true);
+        auto result = run_producers(infer, num_producers, images_per_producer);
+        auto snapshot = infer->metrics();
+        INFO("%s: throughput %.2f images/s, inference occupancy %.1f%%", names[num_buffers - 1],
+             result.num_images / result.elapsed_ms * 1000, infer->pipeline_report().inference.occupancy * 100);
+        INFO("  latency: %s", result.latency.summary().c_str());
+        INFO("  upload:  %s", snapshot.stage(MetricStage::Upload).to_string().c_str());
+        INFO("  forward: %s", snapshot.stage(MetricStage::Forward).to_string().c_str());
+    }
+    return 0;
+}
+
+/* 吞吐在batch 5附近饱和的模型：batch耗时 = max(8 + 1 x batch, 2.6 x batch) ms
+   batch 5以上吞吐不再增加，延迟随batch线性增长
+*/
+static TRT::CPUModelConfig saturating_model(int max_batch_size)
+{
+    auto model = TRT::cpu_yolo_model(max_batch_size, 320, 320, 400, 80);
+    model.compute = [](TRT::Infer *engine, int batch_size)
+    {
+        for (int i = 0; i < engine->num_output(); ++i)
+        {
+            auto output = engine->output(i);
+            memset(output->cpu(), 0, output->bytes());
+        }
+
+        double cost_ms = max(8.0 + 1.0 * batch_size, 2.6 * batch_size);
+        this_thread::sleep_for(chrono::microseconds((long long)(cost_ms * 1000)));
+    };
+    return model;
+}
+
+int bench_adaptive(int num_producers, int images_per_producer, double interval_ms, double latency_slo_ms)
+{
+    const char *modes[] = {"fixed max batch", "adaptive"};
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        auto infer = CPUYolo::create_infer(saturating_model(16), 0.25f, 0.45f);
+        if (infer == nullptr)
+        {
+            INFOE("Create cpu infer failed.");
+            return -1;
+        }
+
+        // 等待凑满batch的策略下，batch上限直接决定排队时间
+        infer->set_batching_policy(BatchingPolicy::deadline(30000));
+        if (mode == 1)
+        {
+            auto policy = AdaptiveBatchingPolicy::slo(latency_slo_ms, 200);
+            policy.probe_every = 8;
+            infer->set_adaptive_batching(policy);
+        }
+
+        auto result = run_producers(infer, num_producers, images_per_producer, interval_ms);
+        INFO("%s: %d producers every %.1f ms, throughput %.2f images/s", modes[mode], num_producers, interval_ms, result.num_images / result.elapsed_ms * 1000);
+        INFO("  latency: %s", result.latency.summary().c_str());
+        INFO("  batching: %s", infer->batching_report().to_string().c_str());
+        INFO("  adaptive: %s", infer->adaptive_batching_report().to_string().c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,221 @@
+#include "bench.hpp"
+#include "bench_tools.hpp"
+#include "app_yolo/yolo.hpp"
+#include "TrtLib/common/preprocess_cpu.hpp"
+#include <thread>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+using CUDAKernel::ChannelType;
+using CUDAKernel::Norm;
+using CUDAKernel::NormType;
+
+// 与warp_affine_bilinear_and_normalize_plane_kernel逐像素相同的标量实现
+static void reference_warp(
+    const uint8_t *src, int src_line_size, int src_width, int src_height,
+    float *dst, int dst_width, int dst_height,
+    const float *m, uint8_t const_value_st, const Norm &norm)
+{
+    int area = dst_width * dst_height;
+    for (int dy = 0; dy < dst_height; ++dy)
+    {
+        for (int dx = 0; dx < dst_width; ++dx)
+        {
+            float src_x = m[0] * dx + m[1] * dy + m[2];
+            float src_y = m[3] * dx + m[4] * dy + m[5];
+            float c0, c1, c2;
+            if (src_x <= -1 || src_x >= src_width || src_y <= -1 || src_y >= src_height)
+            {
+                c0 = const_value_st;
+                c1 = const_value_st;
+                c2 = const_value_st;
+            }
+            else
+            {
+                int y_low = floorf(src_y);
+                int x_low = floorf(src_x);
+                int y_high = y_low + 1;
+                int x_high = x_low + 1;
+
+                uint8_t const_value[] = {const_value_st, const_value_st, const_value_st};
+                float ly = src_y - y_low;
+                float lx = src_x - x_low;
+                float hy = 1 - ly;
+                float hx = 1 - lx;
+                float w1 = hy * hx, w2 = hy * lx, w3 = ly * hx, w4 = ly * lx;
+                const uint8_t *v1 = const_value;
+                const uint8_t *v2 = const_value;
+                const uint8_t *v3 = const_value;
+                const uint8_t *v4 = const_value;
+                if (y_low >= 0)
+                {
+                    if (x_low >= 0)
+                        v1 = src + y_low * src_line_size + x_low * 3;
+
+                    if (x_high < src_width)
+                        v2 = src + y_low * src_line_size + x_high * 3;
+                }
+
+                if (y_high < src_height)
+                {
+                    if (x_low >= 0)
+                        v3 = src + y_high * src_line_size + x_low * 3;
+
+                    if (x_high < src_width)
+                        v4 = src + y_high * src_line_size + x_high * 3;
+                }
+
+                c0 = floorf(w1 * v1[0] + w2 * v2[0] + w3 * v3[0] + w4 * v4[0] + 0.5f);
+                c1 = floorf(w1 * v1[1] + w2 * v2[1] + w3 * v3[1] + w4 * v4[1] + 0.5f);
+                c2 = floorf(w1 * v1[2] + w2 * v2[2] + w3 * v3[2] + w4 * v4[2] + 0.5f);
+            }
+
+            if (norm.channel_type == ChannelType::Invert)
+                swap(c0, c2);
+
+            if (norm.type == NormType::MeanStd)
+            {
+                c0 = (c0 * norm.alpha - norm.mean[0]) / norm.std[0];
+                c1 = (c1 * norm.alpha - norm.mean[1]) / norm.std[1];
+                c2 = (c2 * norm.alpha - norm.mean[2]) / norm.std[2];
+            }
+            else if (norm.type == NormType::AlphaBeta)
+            {
+                c0 = c0 * norm.alpha + norm.beta;
+                c1 = c1 * norm.alpha + norm.beta;
+                c2 = c2 * norm.alpha + norm.beta;
+            }
+
+            float *pdst = dst + dy * dst_width + dx;
+            pdst[0] = c0;
+            pdst[area] = c1;
+            pdst[area * 2] = c2;
+        }
+    }
+}
+
+// 原来的CPU预处理：cv::warpAffine得到letterbox图，再逐像素BGR->RGB、归一化、转planar
+static void opencv_preprocess(const cv::Mat &image, float *dst, int dst_width, int dst_height, float *i2d, const Norm &norm)
+{
+    cv::Mat m2x3_i2d(2, 3, CV_32F, i2d);
+    cv::Mat letterbox;
+    cv::warpAffine(image, letterbox, m2x3_i2d, cv::Size(dst_width, dst_height), cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar::all(114));
+
+    int area = dst_width * dst_height;
+    float *pdst_c0 = dst;
+    float *pdst_c1 = pdst_c0 + area;
+    float *pdst_c2 = pdst_c1 + area;
+    for (int i = 0; i < dst_height; ++i)
+    {
+        const uint8_t *p = letterbox.ptr<uint8_t>(i);
+        for (int j = 0; j < dst_width; ++j, p += 3)
+        {
+            *pdst_c0++ = p[2] * norm.alpha + norm.beta;
+            *pdst_c1++ = p[1] * norm.alpha + norm.beta;
+            *pdst_c2++ = p[0] * norm.alpha + norm.beta;
+        }
+    }
+}
+
+/* 1. 正确性：CPUKernel::warp_affine_bilinear_and_normalize_plane与标量实现逐位比较，
+      包括3种Norm、奇数宽度、非连续的ROI(step大于cols * 3)、放大与缩小，单线程与多线程
+   2. 1080p/720p -> 640x640时cv::warpAffine + 逐像素归一化、标量实现、融合的单线程与多线程的耗时
+*/
+int bench_preprocess(int repeat)
+{
+    float mean[] = {0.485f, 0.456f, 0.406f};
+    float std[] = {0.229f, 0.224f, 0.225f};
+    Norm norms[] = {
+        Norm::alpha_beta(1 / 255.0f, 0.0f, ChannelType::Invert),
+        Norm::mean_std(mean, std, 1 / 255.0f, ChannelType::Invert),
+        Norm::None()};
+    const char *norm_names[] = {"alpha_beta", "mean_std", "none"};
+
+    struct Case
+    {
+        int src_width, src_height, dst_width, dst_height;
+        bool roi;
+    };
+    Case cases[] = {
+        {1920, 1080, 640, 640, false},
+        {1280, 720, 640, 640, false},
+        {637, 355, 320, 320, false},
+        {200, 150, 637, 413, false},
+        {801, 601, 640, 640, true}};
+
+    int num_fail = 0;
+    int seed = 0;
+    for (auto &item : cases)
+    {
+        cv::Mat full = BenchTools::make_image(item.src_width + 37, item.src_height + 11, ++seed);
+        cv::Mat image = item.roi ? full(cv::Rect(13, 5, item.src_width, item.src_height)) : BenchTools::make_image(item.src_width, item.src_height, seed);
+
+        Yolo::AffineMatrix affine;
+        affine.compute(image.size(), cv::Size(item.dst_width, item.dst_height));
+        size_t volume = (size_t)item.dst_width * item.dst_height * 3;
+        vector<float> reference(volume), output(volume);
+        for (int inorm = 0; inorm < 3; ++inorm)
+        {
+            reference_warp(image.data, image.step, image.cols, image.rows, reference.data(),
+                           item.dst_width, item.dst_height, affine.d2i, 114, norms[inorm]);
+
+            for (int num_threads : {1, 0})
+            {
+                memset(output.data(), 0xFF, volume * sizeof(float));
+                CPUKernel::warp_affine_bilinear_and_normalize_plane(
+                    image.data, image.step, image.cols, image.rows, output.data(),
+                    item.dst_width, item.dst_height, affine.d2i, 114, norms[inorm], num_threads);
+
+                if (memcmp(reference.data(), output.data(), volume * sizeof(float)) != 0)
+                {
+                    num_fail++;
+                    INFOE("mismatch: %dx%d%s -> %dx%d, %s, %d threads", item.src_width, item.src_height, item.roi ? " roi" : "",
+                          item.dst_width, item.dst_height, norm_names[inorm], num_threads);
+                }
+            }
+        }
+    }
+    INFO("correctness: %d fail, %s", num_fail, num_fail == 0 ? "PASS" : "FAIL");
+
+    // opencv的双线性插值使用定点数，结果与kernel有±1的差异，只比较耗时
+    for (auto &item : cases)
+    {
+        if (item.dst_width != 640 || item.roi)
+            continue;
+
+        cv::Mat image = BenchTools::make_image(item.src_width, item.src_height, 1);
+        Yolo::AffineMatrix affine;
+        affine.compute(image.size(), cv::Size(item.dst_width, item.dst_height));
+        vector<float> output((size_t)item.dst_width * item.dst_height * 3);
+
+        double opencv_ms = 0, reference_ms = 0, single_ms = 0, multi_ms = 0;
+        for (int i = 0; i < repeat; ++i)
+        {
+            auto tick = iLogger::timestamp_now_float();
+            opencv_preprocess(image, output.data(), item.dst_width, item.dst_height, affine.i2d, norms[0]);
+            opencv_ms += iLogger::timestamp_now_float() - tick;
+
+            tick = iLogger::timestamp_now_float();
+            reference_warp(image.data, image.step, image.cols, image.rows, output.data(),
+                           item.dst_width, item.dst_height, affine.d2i, 114, norms[0]);
+            reference_ms += iLogger::timestamp_now_float() - tick;
+
+            tick = iLogger::timestamp_now_float();
+            CPUKernel::warp_affine_bilinear_and_normalize_plane(
+                image.data, image.step, image.cols, image.rows, output.data(),
+                item.dst_width, item.dst_height, affine.d2i, 114, norms[0], 1);
+            single_ms += iLogger::timestamp_now_float() - tick;
+
+            tick = iLogger::timestamp_now_float();
+            CPUKernel::warp_affine_bilinear_and_normalize_plane(
+                image.data, image.step, image.cols, image.rows, output.data(),
+                item.dst_width, item.dst_height, affine.d2i, 114, norms[0], 0);
+            multi_ms += iLogger::timestamp_now_float() - tick;
+        }
+        INFO("%dx%d -> %dx%d: opencv warpAffine + normalize %.3f ms, scalar %.3f ms, fused %.3f ms, fused %d threads %.3f ms",
+             item.src_width, item.src_height, item.dst_width, item.dst_height, opencv_ms / repeat, reference_ms / repeat,
+             single_ms / repeat, (int)thread::hardware_concurrency(), multi_ms / repeat);
+    }
+    return num_fail == 0 ? 0 : -1;
+}
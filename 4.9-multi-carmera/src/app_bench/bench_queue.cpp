@@ -0,0 +1,140 @@
+#include "bench.hpp"
+#include "bench_tools.hpp"
+#include "TrtLib/common/mpmc_queue.hpp"
+#include <queue>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+
+using namespace std;
+
+// 与改造前InferController/HttpServerImpl相同的mutex + condition_variable队列
+template <class _ItemType>
+class LockedQueue
+{
+public:
+    bool push(_ItemType &&item)
+    {
+        {
+            unique_lock<mutex> l(lock_);
+            if (closed_)
+                return false;
+            queue_.push(std::move(item));
+        };
+        cv_.notify_one();
+        return true;
+    }
+
+    bool pop_wait(_ItemType &item)
+    {
+        unique_lock<mutex> l(lock_);
+        cv_.wait(l, [&]()
+                 { return closed_ || !queue_.empty(); });
+
+        if (queue_.empty())
+            return false;
+
+        item = std::move(queue_.front());
+        queue_.pop();
+        return true;
+    }
+
+    void close()
+    {
+        {
+            unique_lock<mutex> l(lock_);
+            closed_ = true;
+        };
+        cv_.notify_all();
+    }
+
+private:
+    bool closed_ = false;
+    mutex lock_;
+    queue<_ItemType> queue_;
+    condition_variable cv_;
+};
+
+struct QueueItem
+{
+    double commit_time = 0;
+};
+
+struct QueueResult
+{
+    double elapsed_ms = 0;
+    BenchTools::LatencyStat latency;
+};
+
+template <class _QueueType>
+static QueueResult run_queue(_QueueType &queue, int num_producers, int num_consumers, int items_per_producer)
+{
+    vector<BenchTools::LatencyStat> latencys(num_consumers);
+    vector<thread> consumers;
+    for (int iconsumer = 0; iconsumer < num_consumers; ++iconsumer)
+    {
+        consumers.emplace_back([&, iconsumer]()
+                               {
+            auto &latency = latencys[iconsumer];
+            QueueItem item;
+            int index = 0;
+            while (queue.pop_wait(item))
+            {
+                // 采样记录，避免统计本身干扰吞吐
+                if (index++ % 16 == 0)
+                    latency.add(iLogger::timestamp_now_float() - item.commit_time);
+            } });
+    }
+
+    auto tick = iLogger::timestamp_now_float();
+    vector<thread> producers;
+    for (int iproducer = 0; iproducer < num_producers; ++iproducer)
+    {
+        producers.emplace_back([&]()
+                               {
+            for (int i = 0; i < items_per_producer; ++i)
+            {
+                QueueItem item;
+                item.commit_time = iLogger::timestamp_now_float();
+                queue.push(std::move(item));
+            } });
+    }
+
+    for (auto &t : producers)
+        t.join();
+
+    queue.close();
+    for (auto &t : consumers)
+        t.join();
+
+    QueueResult result;
+    result.elapsed_ms = iLogger::timestamp_now_float() - tick;
+    for (auto &stat : latencys)
+        result.latency.merge(stat);
+    return result;
+}
+
+int bench_job_queue(int num_consumers, int total_items)
+{
+    int producer_counts[] = {1, 2, 4, 8, 16, 32, 64};
+    for (int num_producers : producer_counts)
+    {
+        int items_per_producer = max(1, total_items / num_producers);
+        long long num_items = (long long)items_per_producer * num_producers;
+
+        LockedQueue<QueueItem> locked;
+        auto locked_result = run_queue(locked, num_producers, num_consumers, items_per_producer);
+
+        // 容量足够放下全部元素，与无界的std::queue比较时不引入满队列阻塞
+        MPMCQueue<QueueItem> lockfree(num_items);
+        auto lockfree_result = run_queue(lockfree, num_producers, num_consumers, items_per_producer);
+
+        INFO("%2d producers, %d consumers, %lld items", num_producers, num_consumers, num_items);
+        INFO("  mutex+condvar: %.2f Mops/s, latency %s",
+             num_items / locked_result.elapsed_ms / 1000, locked_result.latency.summary().c_str());
+        INFO("  mpmc+futex   : %.2f Mops/s, latency %s",
+             num_items / lockfree_result.elapsed_ms / 1000, lockfree_result.latency.summary().c_str());
+    }
+    return 0;
+}
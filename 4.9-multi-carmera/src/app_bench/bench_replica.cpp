@@ -0,0 +1,212 @@
+#include "bench.hpp"
+#include "bench_tools.hpp"
+#include "cpu_yolo.hpp"
+#include "TrtLib/common/replica_set.hpp"
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <condition_variable>
+
+using namespace std;
+
+/* 模拟的副本：一个工作线程按固定耗时逐个处理job，broken为true时提交直接失败
+   只用来验证ReplicaSet的分发和健康检查，与推理无关
+*/
+class MockReplica
+{
+public:
+    typedef function<void()> Task;
+
+    MockReplica(double cost_ms, bool broken) : cost_ms_(cost_ms), broken_(broken)
+    {
+        worker_ = thread(&MockReplica::worker, this);
+    }
+
+    ~MockReplica()
+    {
+        {
+            unique_lock<mutex> l(lock_);
+            running_ = false;
+        }
+        cond_.notify_one();
+        worker_.join();
+    }
+
+    bool broken() const { return broken_; }
+
+    void push(const Task &task)
+    {
+        {
+            unique_lock<mutex> l(lock_);
+            tasks_.push_back(task);
+        }
+        cond_.notify_one();
+    }
+
+private:
+    void worker()
+    {
+        while (true)
+        {
+            Task task;
+            {
+                unique_lock<mutex> l(lock_);
+                cond_.wait(l, [&]()
+                           { return !running_ || !tasks_.empty(); });
+                if (tasks_.empty())
+                    break;
+
+                task = tasks_.front();
+                tasks_.pop_front();
+            }
+
+            this_thread::sleep_for(chrono::microseconds((long long)(cost_ms_ * 1000)));
+            task();
+        }
+    }
+
+private:
+    double cost_ms_;
+    bool broken_;
+    bool running_ = true;
+    mutex lock_;
+    condition_variable cond_;
+    deque<Task> tasks_;
+    thread worker_;
+};
+
+// 按固定速率开环提交num_jobs个job，返回端到端延迟
+static LatencySummary run_mock_replicas(ReplicaSet<MockReplica> &replicas, int num_jobs, double interval_ms)
+{
+    LatencyHistogram latency;
+    atomic<int> num_finished(0);
+    auto next = iLogger::timestamp_now_float();
+    for (int i = 0; i < num_jobs; ++i)
+    {
+        while (iLogger::timestamp_now_float() < next)
+            this_thread::sleep_for(chrono::microseconds(50));
+        next += interval_ms;
+
+        long long dispatch_us = StageStatistics::now_us();
+        uint64_t tried_mask = 0;
+        int index = -1;
+        while ((index = replicas.acquire(tried_mask)) != -1)
+        {
+            tried_mask |= 1ULL << index;
+            auto &replica = replicas.replica(index);
+            if (replica->broken())
+            {
+                replicas.release(index, CommitStatus::Failed);
+                continue;
+            }
+
+            replica->push([&, index, dispatch_us]()
+                          {
+                long long elapsed_us = StageStatistics::now_us() - dispatch_us;
+                replicas.release(index, CommitStatus::Accepted, elapsed_us);
+                latency.record(elapsed_us);
+                num_finished++; });
+            break;
+        }
+
+        if (index == -1)
+            num_finished++;
+    }
+
+    while (num_finished < num_jobs)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    return latency.summary();
+}
+
+/* 1. 模拟副本：速度为1:2:4的三个副本加一个总是失败的副本，对比轮询与最少未完成数的延迟、分发比例和健康状态
+   2. CPU后端：快慢两个实例组成副本集，与只用快的实例对比吞吐和延迟
+*/
+int bench_replicas(int num_jobs, double interval_ms)
+{
+    const char *policy_names[] = {"round robin", "least outstanding"};
+    for (auto policy : {ReplicaPolicy::RoundRobin, ReplicaPolicy::LeastOutstanding})
+    {
+        vector<shared_ptr<MockReplica>> mocks;
+        mocks.emplace_back(new MockReplica(1.0, false));
+        mocks.emplace_back(new MockReplica(2.0, false));
+        mocks.emplace_back(new MockReplica(4.0, false));
+        mocks.emplace_back(new MockReplica(1.0, true));
+
+        ReplicaHealthPolicy health;
+        health.retry_after_ms = 200;
+        ReplicaSet<MockReplica> replicas(mocks, policy, health);
+        const char *names[] = {"fast", "medium", "slow", "broken"};
+        for (int i = 0; i < replicas.size(); ++i)
+            replicas.set_name(i, names[i]);
+
+        auto latency = run_mock_replicas(replicas, num_jobs, interval_ms);
+        INFO("mock %s: latency {%s}", policy_names[(int)policy], latency.to_string().c_str());
+        INFO("  %s", replicas.report().to_string().c_str());
+    }
+
+    auto fast_model = TRT::cpu_yolo_model(8, 320, 320, 400, 80, 2.0f, 0.5f);
+    auto slow_model = TRT::cpu_yolo_model(8, 320, 320, 400, 80, 6.0f, 1.5f);
+    vector<cv::Mat> images;
+    for (int i = 0; i < 16; ++i)
+        images.push_back(BenchTools::make_image(640, 360, i));
+
+    const int num_producers = 8;
+    const int images_per_producer = max(1, num_jobs / 40);
+    const char *modes[] = {"single fast", "replicas round robin", "replicas least outstanding"};
+    for (int mode = 0; mode < 3; ++mode)
+    {
+        shared_ptr<Yolo::Infer> infer;
+        shared_ptr<Yolo::ReplicaInfer> replica_infer;
+        auto fast = CPUYolo::create_infer(fast_model, 0.25f, 0.45f);
+        if (mode == 0)
+        {
+            infer = fast;
+        }
+        else
+        {
+            auto slow = CPUYolo::create_infer(slow_model, 0.25f, 0.45f);
+            auto policy = mode == 1 ? ReplicaPolicy::RoundRobin : ReplicaPolicy::LeastOutstanding;
+            replica_infer = Yolo::create_replica_infer({fast, slow}, policy);
+            infer = replica_infer;
+        }
+
+        if (infer == nullptr)
+        {
+            INFOE("Create cpu infer failed.");
+            return -1;
+        }
+
+        infer->commit(images[0]).get();
+        if (replica_infer)
+            replica_infer->replica_report(true);
+
+        vector<BenchTools::LatencyStat> latencys(num_producers);
+        vector<thread> producers;
+        auto tick = iLogger::timestamp_now_float();
+        for (int iproducer = 0; iproducer < num_producers; ++iproducer)
+        {
+            producers.emplace_back([&, iproducer]()
+                                   {
+                for (int i = 0; i < images_per_producer; ++i)
+                {
+                    auto begin = iLogger::timestamp_now_float();
+                    infer->commit(images[(i + iproducer) % images.size()]).get();
+                    latencys[iproducer].add(iLogger::timestamp_now_float() - begin);
+                } });
+        }
+
+        for (auto &t : producers)
+            t.join();
+
+        double elapsed_ms = iLogger::timestamp_now_float() - tick;
+        BenchTools::LatencyStat latency;
+        for (auto &item : latencys)
+            latency.merge(item);
+
+        INFO("cpu %s: %.2f images/s, latency {%s}", modes[mode], latency.count() / (elapsed_ms / 1000.0), latency.summary().c_str());
+        if (replica_infer)
+            INFO("  %s", replica_infer->replica_report().to_string().c_str());
+    }
+    return 0;
+}
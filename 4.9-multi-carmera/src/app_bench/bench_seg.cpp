@@ -0,0 +1,353 @@
+#include "bench.hpp"
+#include "bench_tools.hpp"
+#include "app_yolo/seg.hpp"
+#include "app_yolo/yolo.hpp"
+#include "TrtLib/common/preprocess_cpu.hpp"
+#include <random>
+
+using namespace std;
+
+static const int SEG_CLASSES = 21;
+static const float SEG_FOREGROUND = 0.95f;
+
+// 第c类区域的灰度，第0类为背景
+static int seg_shade(int label)
+{
+    return 20 + label * 11;
+}
+
+// 暗背景上不同灰度的方块，label为每个像素的类别
+static cv::Mat make_seg_frame(int width, int height, int seed, cv::Mat &label, int &num_objects)
+{
+    cv::Mat image(height, width, CV_8UC3, cv::Scalar(seg_shade(0), seg_shade(0), seg_shade(0)));
+    label = cv::Mat(height, width, CV_8U, cv::Scalar(0));
+    num_objects = 0;
+    mt19937 rng(seed);
+    for (int y = 20; y + 140 <= height; y += 160)
+    {
+        for (int x = 20; x + 140 <= width; x += 160)
+        {
+            int size = 60 + rng() % 60;
+            int c = 1 + rng() % (SEG_CLASSES - 1);
+            cv::Rect rect(x + rng() % 20, y + rng() % 20, size, size + rng() % 20);
+            image(rect).setTo(cv::Scalar(seg_shade(c), seg_shade(c), seg_shade(c)));
+            label(rect).setTo(cv::Scalar(c));
+            num_objects++;
+        }
+    }
+    return image;
+}
+
+/* 与4.3的unet相同的[h, w, num_classes]概率输出，输出为输入的1/2
+   每个输出像素取输入第0个plane对应的2x2个像素，最接近的类别概率为SEG_FOREGROUND减去距离，其余类别平分剩下的概率
+   2x2的灰度不一致(方块边缘插值出的中间灰度)时为背景，不形成其他类别的环
+*/
+static void render_seg_output(const float *input, int input_width, int input_height, float *output, int output_width, int output_height)
+{
+    for (int y = 0; y < output_height; ++y)
+    {
+        const float *row0 = input + (y * 2) * input_width;
+        const float *row1 = row0 + input_width;
+        for (int x = 0; x < output_width; ++x)
+        {
+            float v[4] = {row0[x * 2], row0[x * 2 + 1], row1[x * 2], row1[x * 2 + 1]};
+            float low = *min_element(v, v + 4) * 255;
+            float high = *max_element(v, v + 4) * 255;
+            float gray = (low + high) * 0.5f;
+            int nearest = max(0, min(SEG_CLASSES - 1, (int)round((gray - seg_shade(0)) / 11)));
+            float distance = fabs(gray - seg_shade(nearest));
+            if (high - low > 3 || distance > 3)
+            {
+                nearest = 0;
+                distance = 3;
+            }
+
+            float foreground = SEG_FOREGROUND - distance * 0.05f;
+            float other = (1 - foreground) / (SEG_CLASSES - 1);
+            float *p = output + (y * output_width + x) * SEG_CLASSES;
+            for (int c = 0; c < SEG_CLASSES; ++c)
+                p[c] = c == nearest ? foreground : other;
+        }
+    }
+}
+
+static TRT::CPUModelConfig seg_model(int max_batch_size, int input_size, float base_cost_ms, float per_image_cost_ms)
+{
+    TRT::CPUModelConfig model;
+    model.inputs.push_back(make_pair(string("images"), vector<int>{max_batch_size, 3, input_size, input_size}));
+    model.outputs.push_back(make_pair(string("output"), vector<int>{max_batch_size, input_size / 2, input_size / 2, SEG_CLASSES}));
+    model.max_batch_size = max_batch_size;
+    model.base_cost_ms = base_cost_ms;
+    model.per_image_cost_ms = per_image_cost_ms;
+    model.compute = [](TRT::Infer *engine, int batch_size)
+    {
+        auto input = engine->input(0);
+        auto output = engine->output(0);
+        for (int ibatch = 0; ibatch < batch_size; ++ibatch)
+            render_seg_output(input->cpu<float>(ibatch), input->size(3), input->size(2), output->cpu<float>(ibatch), output->size(2), output->size(1));
+    };
+    return model;
+}
+
+/* 4.3-unet-seg的后处理：整个输出逐像素max_element，再对概率图与类别图各做一次原图大小的逆仿射采样
+   (warpAffine的INTER_LINEAR与INTER_NEAREST)，m为原图到网络输出的2x3矩阵
+*/
+static void reference_post(const float *output, int output_width, int output_height, int num_classes,
+                           const float m[6], int width, int height, cv::Mat &label, cv::Mat &prob)
+{
+    cv::Mat net_prob(output_height, output_width, CV_32F);
+    cv::Mat net_label(output_height, output_width, CV_8U);
+    const float *pnet = output;
+    float *pprob = net_prob.ptr<float>(0);
+    unsigned char *plabel = net_label.ptr<unsigned char>(0);
+    for (int i = 0; i < output_width * output_height; ++i, pnet += num_classes)
+    {
+        int ic = max_element(pnet, pnet + num_classes) - pnet;
+        pprob[i] = pnet[ic];
+        plabel[i] = ic;
+    }
+
+    label.create(height, width, CV_8U);
+    prob.create(height, width, CV_32F);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            float ox = m[0] * x + m[1] * y + m[2];
+            float oy = m[3] * x + m[4] * y + m[5];
+            int nx = max(0, min(output_width - 1, (int)floor(ox + 0.5f)));
+            int ny = max(0, min(output_height - 1, (int)floor(oy + 0.5f)));
+            label.ptr<unsigned char>(y)[x] = net_label.ptr<unsigned char>(ny)[nx];
+
+            int x0 = (int)floor(ox), y0 = (int)floor(oy);
+            float wx = ox - x0, wy = oy - y0;
+            int x1 = max(0, min(output_width - 1, x0 + 1)), y1 = max(0, min(output_height - 1, y0 + 1));
+            x0 = max(0, min(output_width - 1, x0));
+            y0 = max(0, min(output_height - 1, y0));
+            float a = net_prob.ptr<float>(y0)[x0], b = net_prob.ptr<float>(y0)[x1];
+            float c = net_prob.ptr<float>(y1)[x0], d = net_prob.ptr<float>(y1)[x1];
+            float top = a + (b - a) * wx, bottom = c + (d - c) * wx;
+            prob.ptr<float>(y)[x] = top + (bottom - top) * wy;
+        }
+    }
+}
+
+/* 1. cpu_argmax与std::max_element、std::exp的softmax逐像素比较，NHWC与NCHW，以及256x256x21时的耗时
+   2. 与4.3后处理(标量argmax + 两次原图大小的逆仿射)的结果比较与耗时
+   3. Seg::Infer的RLE、多边形、像素准确率，逐帧提交与批量提交的吞吐
+*/
+int bench_seg(int num_frames, int width, int height)
+{
+    int num_fail = 0;
+    {
+        mt19937 rng(5);
+        uniform_real_distribution<float> logit(-4, 4);
+        int num_errors = 0;
+        float max_error = 0;
+        for (int t = 0; t < 240; ++t)
+        {
+            int num_classes = vector<int>{1, 2, 3, 4, 5, 7, 8, 21, 33}[t % 9];
+            int count = 1 + rng() % 67;
+            bool softmax = t % 2 == 0;
+            auto layout = (t / 2) % 2 == 0 ? Seg::OutputLayout::NHWC : Seg::OutputLayout::NCHW;
+            int plane_stride = count + 3;
+            vector<float> values(num_classes * plane_stride);
+            for (auto &v : values)
+                v = t % 5 == 0 ? (float)(rng() % 3) : logit(rng);
+
+            vector<float> prob(count);
+            vector<unsigned char> label(count);
+            Seg::cpu_argmax(values.data(), count, num_classes, layout, plane_stride, softmax, prob.data(), label.data());
+            for (int i = 0; i < count; ++i)
+            {
+                vector<float> classes(num_classes);
+                for (int c = 0; c < num_classes; ++c)
+                    classes[c] = layout == Seg::OutputLayout::NCHW ? values[c * plane_stride + i] : values[i * num_classes + c];
+
+                int ic = max_element(classes.begin(), classes.end()) - classes.begin();
+                float expected = classes[ic];
+                if (softmax)
+                {
+                    double sum = 0;
+                    for (auto v : classes)
+                        sum += exp((double)v - classes[ic]);
+                    expected = 1 / sum;
+                }
+                num_errors += label[i] != ic;
+                max_error = max(max_error, fabs(prob[i] - expected) / max(fabs(expected), 1e-6f));
+            }
+        }
+        bool ok = num_errors == 0 && max_error < 1e-5f;
+        INFO("argmax %d label mismatches, prob max relative error %.2e on 240 NHWC/NCHW vectors, %s", num_errors, max_error, ok ? "PASS" : "FAIL");
+        num_fail += !ok;
+
+        // 256x256x21，与4.3的unet输出相同的类别数
+        int area = 256 * 256;
+        vector<float> values(area * SEG_CLASSES);
+        for (auto &v : values)
+            v = logit(rng);
+        vector<float> prob(area);
+        vector<unsigned char> label(area);
+        int repeat = 10;
+        auto tick = iLogger::timestamp_now_float();
+        for (int r = 0; r < repeat; ++r)
+        {
+            const float *pnet = values.data();
+            for (int i = 0; i < area; ++i, pnet += SEG_CLASSES)
+            {
+                int ic = max_element(pnet, pnet + SEG_CLASSES) - pnet;
+                prob[i] = pnet[ic];
+                label[i] = ic;
+            }
+        }
+        double scalar_ms = (iLogger::timestamp_now_float() - tick) / repeat;
+
+        double simd_ms[2];
+        for (int ilayout = 0; ilayout < 2; ++ilayout)
+        {
+            tick = iLogger::timestamp_now_float();
+            for (int r = 0; r < repeat; ++r)
+                Seg::cpu_argmax(values.data(), area, SEG_CLASSES, (Seg::OutputLayout)ilayout, area, false, prob.data(), label.data());
+            simd_ms[ilayout] = (iLogger::timestamp_now_float() - tick) / repeat;
+        }
+        INFO("256x256x21 argmax + max prob: scalar max_element %.3f ms, simd NHWC %.3f ms (%.1fx), simd NCHW %.3f ms (%.1fx)",
+             scalar_ms, simd_ms[0], scalar_ms / simd_ms[0], simd_ms[1], scalar_ms / simd_ms[1]);
+    }
+
+    int input_size = 512;
+    int output_size = input_size / 2;
+    vector<cv::Mat> images(num_frames), truths(num_frames);
+    vector<int> num_objects(num_frames);
+    for (int i = 0; i < num_frames; ++i)
+        images[i] = make_seg_frame(width, height, i + 1, truths[i], num_objects[i]);
+    INFO("%d frames of %dx%d, %d objects per frame, input %dx%d, output %dx%dx%d",
+         num_frames, width, height, num_objects[0], input_size, input_size, output_size, output_size, SEG_CLASSES);
+
+    Seg::SegConfig config;
+    config.output_prob = true;
+    config.output_runs = true;
+    config.output_polygons = true;
+    config.pipeline = PipelineConfig::pools(4, 2);
+    auto infer = Seg::create_cpu_infer(seg_model(8, input_size, 2.0f, 1.0f), config);
+    if (infer == nullptr)
+    {
+        INFOE("Create seg infer failed.");
+        return -1;
+    }
+
+    // 第0帧与4.3的后处理比较，网络输出由同一个模型在同一个输入上计算
+    {
+        Yolo::AffineMatrix affine;
+        affine.compute(images[0].size(), cv::Size(input_size, input_size));
+        vector<float> input(3 * input_size * input_size);
+        vector<float> output(output_size * output_size * SEG_CLASSES);
+        CUDAKernel::Norm norm = CUDAKernel::Norm::alpha_beta(1 / 255.0f, 0, CUDAKernel::ChannelType::Invert);
+        CPUKernel::warp_affine_bilinear_and_normalize_plane(
+            images[0].data, images[0].step, width, height, input.data(), input_size, input_size, affine.d2i, 114, norm, 1);
+        render_seg_output(input.data(), input_size, input_size, output.data(), output_size, output_size);
+
+        float m[6];
+        float ratio = output_size / (float)input_size;
+        m[0] = affine.i2d[0] * ratio;
+        m[1] = 0;
+        m[2] = (affine.i2d[2] + 0.5f) * ratio - 0.5f;
+        m[3] = 0;
+        m[4] = affine.i2d[4] * ratio;
+        m[5] = (affine.i2d[5] + 0.5f) * ratio - 0.5f;
+
+        cv::Mat label, prob;
+        int repeat = 5;
+        auto tick = iLogger::timestamp_now_float();
+        for (int r = 0; r < repeat; ++r)
+            reference_post(output.data(), output_size, output_size, SEG_CLASSES, m, width, height, label, prob);
+        double reference_ms = (iLogger::timestamp_now_float() - tick) / repeat;
+
+        infer->metrics(true);
+        for (int r = 0; r < repeat; ++r)
+            infer->commit(images[0]).get();
+        auto result = infer->commit(images[0]).get();
+        auto metrics = infer->metrics(true);
+
+        long long mismatch = 0;
+        float max_error = 0;
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                mismatch += result.label.ptr<unsigned char>(y)[x] != label.ptr<unsigned char>(y)[x];
+                max_error = max(max_error, fabs(result.prob.ptr<float>(y)[x] - prob.ptr<float>(y)[x]));
+            }
+        }
+
+        bool ok = mismatch == 0 && max_error < 1e-3f;
+        INFO("vs 4.3 post process: %lld label mismatches, prob max error %.2e, %s", mismatch, max_error, ok ? "PASS" : "FAIL");
+        INFO("post process %dx%d: 4.3 scalar %.3f ms, argmax %.3f ms + resample/rle/polygons %.3f ms",
+             width, height, reference_ms, metrics.stage(MetricStage::Decode).mean_ms, metrics.stage(MetricStage::NMS).mean_ms);
+        num_fail += !ok;
+    }
+
+    for (bool batched : {false, true})
+    {
+        infer->metrics(true);
+        vector<Seg::SegResult> results(num_frames);
+        auto tick = iLogger::timestamp_now_float();
+        if (batched)
+        {
+            auto futures = infer->commits(images);
+            for (int i = 0; i < num_frames; ++i)
+                results[i] = futures[i].get();
+        }
+        else
+        {
+            for (int i = 0; i < num_frames; ++i)
+                results[i] = infer->commit(images[i]).get();
+        }
+        double elapsed = iLogger::timestamp_now_float() - tick;
+        auto metrics = infer->metrics();
+
+        long long correct = 0, total = 0, runs = 0, polygons = 0;
+        int rle_errors = 0, polygon_errors = 0;
+        for (int i = 0; i < num_frames; ++i)
+        {
+            auto &result = results[i];
+            auto decoded = Seg::decode_runs(result.runs, result.width, result.height);
+            for (int y = 0; y < height; ++y)
+            {
+                const unsigned char *plabel = result.label.ptr<unsigned char>(y);
+                const unsigned char *ptruth = truths[i].ptr<unsigned char>(y);
+                const unsigned char *pdecoded = decoded.ptr<unsigned char>(y);
+                for (int x = 0; x < width; ++x)
+                {
+                    correct += plabel[x] == ptruth[x];
+                    rle_errors += plabel[x] != pdecoded[x];
+                }
+            }
+
+            // 每个方块一个多边形，中心点的类别与多边形的类别相同
+            for (auto &polygon : result.polygons)
+            {
+                int cx = 0, cy = 0;
+                for (auto &p : polygon.points)
+                {
+                    cx += p.x;
+                    cy += p.y;
+                }
+                cx /= max(1, (int)polygon.points.size());
+                cy /= max(1, (int)polygon.points.size());
+                polygon_errors += truths[i].ptr<unsigned char>(cy)[cx] != polygon.label;
+            }
+            polygon_errors += abs((int)result.polygons.size() - num_objects[i]);
+            total += width * height;
+            runs += result.runs.size();
+            polygons += result.polygons.size();
+        }
+
+        float accuracy = correct / (float)total;
+        bool ok = accuracy > 0.96f && rle_errors == 0 && polygon_errors == 0;
+        INFO("%-9s %.1f ms, %.1f frames/s, avg batch %.2f, pixel accuracy %.4f, %.0f runs/frame (%d errors), %.1f polygons/frame (%d errors), %s",
+             batched ? "batched" : "one by one", elapsed, num_frames / elapsed * 1000, metrics.average_batch_size, accuracy,
+             runs / (float)num_frames, rle_errors, polygons / (float)num_frames, polygon_errors, ok ? "PASS" : "FAIL");
+        num_fail += !ok;
+    }
+    return num_fail == 0 ? 0 : -1;
+}
@@ -0,0 +1,180 @@
+#include "bench.hpp"
+#include "bench_tools.hpp"
+#include "cpu_yolo.hpp"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+// 按间隔排列、带固定抖动的小方块，返回每个方块的位置
+static cv::Mat make_small_objects(int width, int height, int object_size, int spacing, vector<cv::Rect> &objects)
+{
+    cv::Mat image(height, width, CV_8UC3, cv::Scalar(30, 30, 30));
+    objects.clear();
+    int index = 0;
+    for (int y = spacing / 4; y + object_size < height; y += spacing)
+    {
+        for (int x = spacing / 4; x + object_size < width; x += spacing, ++index)
+        {
+            int jx = min(width - object_size - 1, x + (index * 37) % (spacing / 2));
+            int jy = min(height - object_size - 1, y + (index * 53) % (spacing / 2));
+            cv::Rect rect(jx, jy, object_size, object_size);
+            image(rect).setTo(cv::Scalar(230, 230, 230));
+            objects.emplace_back(rect);
+        }
+    }
+    return image;
+}
+
+// 中心落在方块内(放宽margin像素)的框认为检测到了这个方块
+static void count_hits(const ObjectDetector::BoxArray &boxes, const vector<cv::Rect> &objects, int margin, int &num_found, int &num_false)
+{
+    vector<int> hits(objects.size(), 0);
+    for (auto &box : boxes)
+    {
+        float cx = (box.left + box.right) * 0.5f;
+        float cy = (box.top + box.bottom) * 0.5f;
+        bool matched = false;
+        for (int i = 0; i < (int)objects.size(); ++i)
+        {
+            auto &o = objects[i];
+            if (cx >= o.x - margin && cx <= o.x + o.width + margin && cy >= o.y - margin && cy <= o.y + o.height + margin)
+            {
+                hits[i]++;
+                matched = true;
+                break;
+            }
+        }
+        num_false += !matched;
+    }
+
+    for (int v : hits)
+        num_found += v > 0;
+}
+
+/* 1. 正确性：图像不大于切片时结果与直接推理相同，切片的布局覆盖整图且与边缘对齐
+   2. 4K图上32像素的小目标：直接缩放到网络输入、不同切片大小与重叠比例、有无接缝过滤时的召回、每个目标的框数、吞吐与合并耗时
+   内置的网格模型输入320，每个单元16像素，整图缩放12倍后小目标只剩不到3像素，检测不到
+*/
+int bench_tiles(int num_images, int width, int height)
+{
+    int num_fail = 0;
+    auto model = TRT::cpu_yolo_model(8, 320, 320, 400, 80, 1.0f, 0.1f);
+    auto infer = CPUYolo::create_infer(model, 0.25f, 0.5f);
+    if (infer == nullptr)
+    {
+        INFOE("Create cpu infer failed.");
+        return -1;
+    }
+
+    {
+        Yolo::TilingConfig config;
+        auto tiled = Yolo::create_tiled_infer(infer, config);
+        cv::Mat image = BenchTools::make_image(320, 240, 3);
+        bool identity = BenchTools::same_boxes_unordered(tiled->commit(image).get(), infer->commit(image).get());
+
+        bool layout = true;
+        for (auto size : {cv::Size(3840, 2160), cv::Size(1000, 641), cv::Size(640, 640), cv::Size(100, 1000)})
+        {
+            auto tiles = Yolo::compute_tiles(size, config);
+            cv::Mat covered(size, CV_8U, cv::Scalar(0));
+            for (auto &tile : tiles)
+            {
+                layout = layout && (tile & cv::Rect(0, 0, size.width, size.height)) == tile;
+                covered(tile).setTo(1);
+            }
+            layout = layout && cv::countNonZero(covered) == size.area();
+            layout = layout && tiles.back().br() == cv::Point(size.width, size.height);
+        }
+        INFO("single tile identical to direct inference %s, tile layout covers image %s",
+             identity ? "PASS" : "FAIL", layout ? "PASS" : "FAIL");
+        num_fail += !identity + !layout;
+
+        // latest_only不作用于同一张图的切片，结果可以用wait_for轮询，被取消的图outcome为rejected
+        cv::Mat large = BenchTools::make_image(1000, 641, 5);
+        auto expected = tiled->commit(large).get();
+        JobOptions stream = JobOptions::stream(1);
+        stream.outcome = JobOutcome::create();
+        auto result = tiled->commit(large, stream);
+        while (result.wait_for(chrono::milliseconds(0)) != future_status::ready)
+            this_thread::sleep_for(chrono::milliseconds(1));
+        bool complete = !stream.outcome->rejected() && BenchTools::same_boxes_unordered(result.get(), expected);
+
+        JobOptions cancelled;
+        cancelled.cancel_token = CancellationToken::create();
+        cancelled.cancel_token->cancel();
+        cancelled.outcome = JobOutcome::create();
+        bool rejected = tiled->commit(large, cancelled).get().empty() && cancelled.outcome->rejected();
+        INFO("latest_only tiles complete %s, cancelled image rejected %s", complete ? "PASS" : "FAIL", rejected ? "PASS" : "FAIL");
+        num_fail += !complete + !rejected;
+    }
+
+    vector<cv::Rect> objects;
+    cv::Mat image = make_small_objects(width, height, 32, 160, objects);
+    vector<cv::Mat> images(num_images, image);
+    INFO("%d images of %dx%d, %d objects of 32x32 per image", num_images, width, height, (int)objects.size());
+
+    // 直接推理作为基线
+    {
+        auto tick = iLogger::timestamp_now_float();
+        auto results = infer->commits(images);
+        int num_found = 0, num_false = 0, num_boxes = 0;
+        for (auto &result : results)
+        {
+            auto &boxes = result.get();
+            num_boxes += boxes.size();
+            count_hits(boxes, objects, 8, num_found, num_false);
+        }
+        double elapsed = iLogger::timestamp_now_float() - tick;
+        INFO("%-32s recall %.3f, %.2f boxes/found, %d false, %.2f img/s",
+             "global only", num_found / (float)(objects.size() * num_images), num_boxes / max(1.0f, (float)num_found), num_false,
+             num_images / elapsed * 1000);
+    }
+
+    struct Case
+    {
+        const char *name;
+        int tile;
+        float overlap;
+        bool global_view;
+        bool drop_seam_boxes;
+    };
+    Case cases[] = {
+        {"tile 320 overlap 0.2", 320, 0.2f, true, true},
+        {"tile 320 overlap 0.2 no seam", 320, 0.2f, true, false},
+        {"tile 320 overlap 0.1", 320, 0.1f, true, true},
+        {"tile 320 overlap 0.2 no global", 320, 0.2f, false, true},
+        {"tile 640 overlap 0.2", 640, 0.2f, true, true}};
+
+    for (auto &item : cases)
+    {
+        Yolo::TilingConfig config;
+        config.tile_width = item.tile;
+        config.tile_height = item.tile;
+        config.overlap = item.overlap;
+        config.global_view = item.global_view;
+        config.drop_seam_boxes = item.drop_seam_boxes;
+        auto tiled = Yolo::create_tiled_infer(infer, config);
+
+        auto tick = iLogger::timestamp_now_float();
+        auto results = tiled->commits(images);
+        int num_found = 0, num_false = 0, num_boxes = 0;
+        for (auto &result : results)
+        {
+            auto &boxes = result.get();
+            num_boxes += boxes.size();
+            count_hits(boxes, objects, 8, num_found, num_false);
+        }
+        double elapsed = iLogger::timestamp_now_float() - tick;
+
+        auto report = tiled->report();
+        INFO("%-32s recall %.3f, %.2f boxes/found, %d false, %.2f img/s, %d tiles/img, %.2f tiles/s, "
+             "%lld raw -> %lld seam dropped -> %lld merged, merge %.3f ms/img",
+             item.name, num_found / (float)(objects.size() * num_images), num_boxes / max(1.0f, (float)num_found), num_false,
+             num_images / elapsed * 1000, (int)(report.num_tiles / max(1LL, report.num_images)), report.num_tiles / elapsed * 1000,
+             report.num_raw_boxes, report.num_seam_boxes, report.num_merged_boxes, report.merge_ms / max(1LL, report.num_images));
+        num_fail += num_false > 0;
+    }
+    return num_fail == 0 ? 0 : -1;
+}
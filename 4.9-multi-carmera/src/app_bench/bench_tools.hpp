@@ -0,0 +1,103 @@
+#ifndef BENCH_TOOLS_HPP
+#define BENCH_TOOLS_HPP
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <opencv2/opencv.hpp>
+#include "TrtLib/common/ilogger.hpp"
+#include "app_yolo/object_detector.hpp"
+
+namespace BenchTools
+{
+    // 收集耗时样本并输出分位数，单位ms
+    class LatencyStat
+    {
+    public:
+        void add(double ms) { samples_.push_back(ms); }
+        size_t count() const { return samples_.size(); }
+        void merge(const LatencyStat &other) { samples_.insert(samples_.end(), other.samples_.begin(), other.samples_.end()); }
+
+        double percentile(double p)
+        {
+            if (samples_.empty())
+                return 0;
+
+            std::sort(samples_.begin(), samples_.end());
+            size_t index = std::min(samples_.size() - 1, (size_t)(p * (samples_.size() - 1) + 0.5));
+            return samples_[index];
+        }
+
+        double mean() const
+        {
+            double sum = 0;
+            for (auto &v : samples_)
+                sum += v;
+            return samples_.empty() ? 0 : sum / samples_.size();
+        }
+
+        std::string summary()
+        {
+            return iLogger::format(
+                "n=%d, mean=%.3f ms, p50=%.3f ms, p90=%.3f ms, p99=%.3f ms, max=%.3f ms",
+                (int)samples_.size(), mean(), percentile(0.5), percentile(0.9), percentile(0.99), percentile(1.0));
+        }
+
+    private:
+        std::vector<double> samples_;
+    };
+
+    // 生成带若干亮色方块的测试图，保证内置模型能产生检测结果
+    inline cv::Mat make_image(int width, int height, int seed = 0)
+    {
+        cv::Mat image(height, width, CV_8UC3, cv::Scalar(30, 30, 30));
+        int num_blocks = 3 + seed % 5;
+        for (int i = 0; i < num_blocks; ++i)
+        {
+            int bw = width / 8;
+            int bh = height / 8;
+            int x = (i * 7919 + seed * 104729) % std::max(1, width - bw);
+            int y = (i * 6271 + seed * 1299709) % std::max(1, height - bh);
+            for (int r = y; r < y + bh; ++r)
+            {
+                uint8_t *p = image.ptr<uint8_t>(r) + x * 3;
+                for (int c = 0; c < bw * 3; ++c)
+                    p[c] = 230;
+            }
+        }
+        return image;
+    }
+
+    // 两组框按顺序逐个相同，坐标与置信度逐位比较
+    inline bool same_boxes(const ObjectDetector::BoxArray &a, const ObjectDetector::BoxArray &b)
+    {
+        if (a.size() != b.size())
+            return false;
+
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            if (memcmp(&a[i].left, &b[i].left, sizeof(float) * 5) != 0 || a[i].class_label != b[i].class_label)
+                return false;
+        }
+        return true;
+    }
+
+    // 不关心顺序，例如多个切片、画布的框合并之后
+    inline bool same_boxes_unordered(ObjectDetector::BoxArray a, ObjectDetector::BoxArray b)
+    {
+        auto less = [](const ObjectDetector::Box &x, const ObjectDetector::Box &y)
+        {
+            if (x.left != y.left)
+                return x.left < y.left;
+            if (x.top != y.top)
+                return x.top < y.top;
+            return x.confidence < y.confidence;
+        };
+        std::sort(a.begin(), a.end(), less);
+        std::sort(b.begin(), b.end(), less);
+        return same_boxes(a, b);
+    }
+};
+
+#endif // BENCH_TOOLS_HPP
@@ -0,0 +1,237 @@
+#include "bench.hpp"
+#include "bench_tools.hpp"
+#include "app_yolo/object_tracker.hpp"
+#include <random>
+#include <functional>
+
+using namespace std;
+using namespace ObjectTracker;
+
+// 不匹配的行按max_cost计的总代价
+static float assignment_cost(const vector<float> &cost, int num_cols, const vector<int> &row_match, float max_cost)
+{
+    float sum = 0;
+    for (int i = 0; i < (int)row_match.size(); ++i)
+        sum += row_match[i] == -1 ? max_cost : cost[i * num_cols + row_match[i]];
+    return sum;
+}
+
+// 穷举所有部分匹配的最小总代价
+static float brute_force_cost(const vector<float> &cost, int num_rows, int num_cols, float max_cost)
+{
+    vector<char> used(num_cols, 0);
+    function<float(int)> search = [&](int row) -> float
+    {
+        if (row == num_rows)
+            return 0;
+
+        float best = max_cost + search(row + 1);
+        for (int j = 0; j < num_cols; ++j)
+        {
+            float c = cost[row * num_cols + j];
+            if (used[j] || c >= max_cost)
+                continue;
+
+            used[j] = 1;
+            best = min(best, c + search(row + 1));
+            used[j] = 0;
+        }
+        return best;
+    };
+    return search(0);
+}
+
+struct SceneObject
+{
+    float cx, cy, w, h, vx, vy;
+    int class_label;
+
+    Box box() const { return Box(cx - w * 0.5f, cy - h * 0.5f, cx + w * 0.5f, cy + h * 0.5f, 1.0f, class_label); }
+};
+
+// 匀速运动、碰到边缘反弹的目标，检测结果带抖动、漏检、低分和误检
+class Scene
+{
+public:
+    Scene(int num_objects, int width, int height, unsigned seed) : width_(width), height_(height), rng_(seed)
+    {
+        uniform_real_distribution<float> size(30, 90), speed(-3, 3);
+        for (int i = 0; i < num_objects; ++i)
+        {
+            SceneObject o;
+            o.w = size(rng_);
+            o.h = size(rng_);
+            o.cx = uniform_real_distribution<float>(o.w, width - o.w)(rng_);
+            o.cy = uniform_real_distribution<float>(o.h, height - o.h)(rng_);
+            o.vx = speed(rng_);
+            o.vy = speed(rng_);
+            o.class_label = i % 3;
+            objects_.emplace_back(o);
+        }
+    }
+
+    void step()
+    {
+        for (auto &o : objects_)
+        {
+            o.cx += o.vx;
+            o.cy += o.vy;
+            if (o.cx < o.w * 0.5f || o.cx > width_ - o.w * 0.5f)
+                o.vx = -o.vx;
+            if (o.cy < o.h * 0.5f || o.cy > height_ - o.h * 0.5f)
+                o.vy = -o.vy;
+        }
+    }
+
+    BoxArray detect()
+    {
+        uniform_real_distribution<float> unit(0, 1), jitter(-2, 2);
+        BoxArray output;
+        for (auto &o : objects_)
+        {
+            float dice = unit(rng_);
+            if (dice < 0.05f)
+                continue;
+
+            Box box = o.box();
+            box.left += jitter(rng_);
+            box.top += jitter(rng_);
+            box.right += jitter(rng_);
+            box.bottom += jitter(rng_);
+            box.confidence = dice < 0.15f ? 0.2f + 0.25f * unit(rng_) : 0.6f + 0.35f * unit(rng_);
+            output.emplace_back(box);
+        }
+
+        if (unit(rng_) < 0.2f)
+        {
+            float x = unit(rng_) * (width_ - 60), y = unit(rng_) * (height_ - 60);
+            output.emplace_back(x, y, x + 60, y + 60, 0.55f, 0);
+        }
+        return output;
+    }
+
+    const vector<SceneObject> &objects() const { return objects_; }
+
+private:
+    int width_, height_;
+    mt19937 rng_;
+    vector<SceneObject> objects_;
+};
+
+static float iou(const Box &a, const Box &b)
+{
+    float cw = min(a.right, b.right) - max(a.left, b.left);
+    float ch = min(a.bottom, b.bottom) - max(a.top, b.top);
+    if (cw <= 0 || ch <= 0)
+        return 0;
+    float c = cw * ch;
+    return c / ((a.right - a.left) * (a.bottom - a.top) + (b.right - b.left) * (b.bottom - b.top) - c);
+}
+
+/* 1. 正确性：匈牙利算法与穷举的最小总代价相同，贪心不优于它
+   2. 模拟的场景中每帧检测与每N帧检测(有无不确定度触发)时：检测帧的比例即引擎负载、召回、精度、平均IoU、ID切换次数与跟踪的耗时
+*/
+int bench_tracker(int num_frames, int num_objects)
+{
+    int num_fail = 0;
+    {
+        mt19937 rng(7);
+        uniform_real_distribution<float> unit(0, 1);
+        int num_mismatch = 0, num_greedy_worse = 0;
+        for (int t = 0; t < 500; ++t)
+        {
+            int num_rows = 1 + t % 6, num_cols = 1 + (t / 6) % 6;
+            vector<float> cost(num_rows * num_cols);
+            for (auto &c : cost)
+                c = unit(rng);
+
+            float max_cost = 0.8f;
+            float best = brute_force_cost(cost, num_rows, num_cols, max_cost);
+            auto hungarian = linear_assignment(cost, num_rows, num_cols, max_cost, AssociationMethod::Hungarian);
+            auto greedy = linear_assignment(cost, num_rows, num_cols, max_cost, AssociationMethod::Greedy);
+            num_mismatch += fabs(assignment_cost(cost, num_cols, hungarian, max_cost) - best) > 1e-4f;
+            num_greedy_worse += assignment_cost(cost, num_cols, greedy, max_cost) > best + 1e-4f;
+        }
+        INFO("hungarian vs brute force on 500 random matrices: %d mismatch %s, greedy suboptimal on %d",
+             num_mismatch, num_mismatch == 0 ? "PASS" : "FAIL", num_greedy_worse);
+        num_fail += num_mismatch != 0;
+    }
+
+    struct Case
+    {
+        const char *name;
+        int detect_interval;
+        AssociationMethod association;
+        bool triggers;
+    };
+    Case cases[] = {
+        {"every frame, greedy", 1, AssociationMethod::Greedy, true},
+        {"every frame, hungarian", 1, AssociationMethod::Hungarian, true},
+        {"every 3 frames + triggers", 3, AssociationMethod::Hungarian, true},
+        {"every 5 frames + triggers", 5, AssociationMethod::Hungarian, true},
+        {"every 5 frames, no triggers", 5, AssociationMethod::Hungarian, false},
+        {"every 10 frames + triggers", 10, AssociationMethod::Hungarian, true}};
+
+    INFO("%d frames, %d objects at 1280x720, 5%% missed, 10%% low score, 0.2 false positives per frame", num_frames, num_objects);
+    for (auto &item : cases)
+    {
+        TrackerConfig config;
+        config.detect_interval = item.detect_interval;
+        config.association = item.association;
+        if (!item.triggers)
+        {
+            config.uncertainty_threshold = 0;
+            config.crowded_iou = 0;
+        }
+
+        auto tracker = create_tracker(config);
+        Scene scene(num_objects, 1280, 720, 1);
+        vector<int> last_id(num_objects, 0);
+        long long num_gt = 0, num_matched = 0, num_output = 0, num_switches = 0;
+        double sum_iou = 0;
+        for (int frame = 0; frame < num_frames; ++frame)
+        {
+            scene.step();
+            BoxArray detections = scene.detect();
+            const TrackedBoxArray &tracks = tracker->need_detection() != DetectTrigger::None ? tracker->update(detections) : tracker->predict();
+
+            // 按IoU >= 0.5把输出与真值一一对应
+            auto &objects = scene.objects();
+            vector<float> cost(objects.size() * tracks.size());
+            for (int i = 0; i < (int)objects.size(); ++i)
+            {
+                for (int j = 0; j < (int)tracks.size(); ++j)
+                    cost[i * tracks.size() + j] = 1 - iou(objects[i].box(), tracks[j]);
+            }
+            auto match = linear_assignment(cost, objects.size(), tracks.size(), 0.5f, AssociationMethod::Hungarian);
+            for (int i = 0; i < (int)objects.size(); ++i)
+            {
+                if (match[i] == -1)
+                    continue;
+
+                num_matched++;
+                sum_iou += 1 - cost[i * tracks.size() + match[i]];
+                int id = tracks[match[i]].track_id;
+                num_switches += last_id[i] != 0 && last_id[i] != id;
+                last_id[i] = id;
+            }
+            num_gt += objects.size();
+            num_output += tracks.size();
+        }
+
+        auto report = tracker->report();
+        INFO("%-28s detect %.1f%% frames, recall %.3f, precision %.3f, iou %.3f, %lld id switches, %lld tracks, update %.1f us, predict %.1f us",
+             item.name, report.num_detection_frames * 100.0 / report.num_frames, num_matched / (double)num_gt,
+             num_matched / (double)max(1LL, num_output), sum_iou / max(1LL, num_matched), num_switches,
+             report.num_tracks_created, report.average_update_us, report.average_predict_us);
+
+        string triggers;
+        for (int i = 0; i < 6; ++i)
+        {
+            if (report.num_triggers[i] > 0)
+                triggers += iLogger::format(" %s=%lld", detect_trigger_name((DetectTrigger)i), report.num_triggers[i]);
+        }
+        INFO("%-28s triggers:%s", "", triggers.c_str());
+    }
+    return num_fail == 0 ? 0 : -1;
+}
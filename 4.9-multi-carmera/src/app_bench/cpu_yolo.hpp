@@ -0,0 +1,31 @@
+#ifndef CPU_YOLO_HPP
+#define CPU_YOLO_HPP
+
+#include <memory>
+#include "app_yolo/yolo.hpp"
+#include "TrtLib/infer/trt_infer.hpp"
+
+/**
+ * @brief 压测用的CPU后端Yolo
+ * 即Yolo::create_infer的CPU后端，按YoloV5的归一化，用于在没有GPU的机器上压测InferController的吞吐和延迟
+ * 只固定了模型类型，nms_method为FastGPU时由Yolo::create_infer对CPU后端改为CPU
+ */
+namespace CPUYolo
+{
+    using namespace std;
+    using namespace ObjectDetector;
+
+    inline shared_ptr<Yolo::Infer> create_infer(
+        const TRT::CPUModelConfig &model,
+        float confidence_threshold = 0.25f, float nms_threshold = 0.5f,
+        int max_objects = 1024, const PipelineConfig &pipeline = PipelineConfig(),
+        Yolo::NMSMethod nms_method = Yolo::NMSMethod::CPU)
+    {
+        return Yolo::create_infer(
+            TRT::EngineSource(model), Yolo::Type::V5, confidence_threshold,
+            nms_threshold, nms_method, max_objects, false, pipeline);
+    }
+
+}; // namespace CPUYolo
+
+#endif // CPU_YOLO_HPP
@@ -9,6 +9,7 @@
 #include "mongoose.h"
 #include <future>
 #include <condition_variable>
+#include "../TrtLib/common/mpmc_queue.hpp"
 
 using namespace std;
 
@@ -900,7 +901,7 @@ public:
 	void worker_thread_proc();
 	static void on_work_complete(struct mg_connection *nc, int ev, void *ev_data);
 
-	void commit(shared_ptr<Session> user);
+	bool commit(shared_ptr<Session> user);
 
 private:
 	unordered_map<string, unordered_map<string, Handler>> router_map_; //回调函数映射表
@@ -915,9 +916,7 @@ private:
 	string docUrl_;
 	bool useResourceAccess_ = false;
 	vector<shared_ptr<thread>> threads_;
-	queue<shared_ptr<Session>> jobs_;
-	mutex lck_;
-	condition_variable cv_;
+	MPMCQueue<shared_ptr<Session>> jobs_{4096};
 
 	SessionID s_next_id_ = 0;
 	SessionManager session_manager_;
@@ -984,16 +983,8 @@ void HttpServerImpl::worker_thread_proc()
 	while (keeprun_)
 	{
 		shared_ptr<Session> session;
-		{
-			unique_lock<mutex> l(lck_);
-			cv_.wait(l, [&]
-					 { return !jobs_.empty() || !keeprun_; });
-
-			if (!keeprun_)
-				break;
-			session = jobs_.front();
-			jobs_.pop();
-		};
+		if (!jobs_.pop_wait(session) || !keeprun_)
+			break;
 
 		bool found_router = false;
 		auto it = router_map_.find(session->request.url);
@@ -1105,13 +1096,10 @@ void HttpServerImpl::loop()
 		mg_mgr_poll(&mgr_, 1000); // ms
 }
 
-void HttpServerImpl::commit(shared_ptr<Session> user)
+bool HttpServerImpl::commit(shared_ptr<Session> user)
 {
-	{
-		unique_lock<mutex> l(lck_);
-		jobs_.push(user);
-	};
-	cv_.notify_one();
+	// 在事件循环上不能阻塞：worker的mg_broadcast要等事件循环处理，队列满时阻塞会死锁
+	return jobs_.try_push(user);
 }
 
 void HttpServerImpl::on_http_event(mg_connection *connection, int event_type, void *event_data)
@@ -1150,7 +1138,14 @@ void HttpServerImpl::on_http_event(mg_connection *connection, int event_type, vo
 			user->request.headers[string(name.p, name.len)] = string(value.p, value.len);
 			i++;
 		}
-		server->commit(user);
+		if (!server->commit(user))
+		{
+			// 队列满，直接在事件循环上回复503
+			error_process(user, 503);
+			WorkerResult result;
+			result.conn_id = id;
+			on_work_complete(connection, event_type, &result);
+		}
 		break;
 	}
 
@@ -1207,7 +1202,7 @@ void HttpServerImpl::close()
 	{
 		INFO("Shutdown http server.");
 		keeprun_ = false;
-		cv_.notify_all();
+		jobs_.close();
 		loop_thread_->join();
 
 		for (auto &t : threads_)
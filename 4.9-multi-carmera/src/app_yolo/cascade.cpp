@@ -0,0 +1,217 @@
+#include "cascade.hpp"
+#include <atomic>
+#include <algorithm>
+#include "TrtLib/common/ilogger.hpp"
+
+namespace Cascade
+{
+    using namespace std;
+
+    struct CascadeStatistics
+    {
+        atomic<long long> num_frames{0};
+        atomic<long long> num_detections{0};
+        atomic<long long> num_crops{0};
+        atomic<long long> num_filtered{0};
+        atomic<long long> num_failed{0};
+        LatencyHistogram detect;
+        LatencyHistogram classify;
+        LatencyHistogram total;
+    };
+
+    // 一帧的状态，由检测和分类的回调共同持有
+    struct FrameState
+    {
+        cv::Mat image;
+        JobOptions classify_options;
+        long long commit_us = 0;
+        long long detected_us = 0;
+        ClassifiedBoxArray output;
+        atomic<int> remaining{0}; // 还没有完成的分类，加上提交循环本身的1
+        atomic<int> num_failed{0};
+        promise<ClassifiedBoxArray> result;
+    };
+
+    class CascadeInferImpl : public CascadeInfer
+    {
+    public:
+        bool startup(const shared_ptr<Yolo::Infer> &detector, const shared_ptr<Classifier::Infer> &classifier, const CascadeConfig &config)
+        {
+            if (detector == nullptr || classifier == nullptr)
+            {
+                INFOE("Detector or classifier is nullptr");
+                return false;
+            }
+
+            detector_ = detector;
+            classifier_ = classifier;
+            config_ = config;
+            statistics_.reset(new CascadeStatistics());
+            return true;
+        }
+
+        virtual shared_future<ClassifiedBoxArray> commit(const cv::Mat &image, const JobOptions &options) override
+        {
+            auto state = make_shared<FrameState>();
+            state->image = image;
+            state->commit_us = StageStatistics::now_us();
+
+            /* 分类只继承优先级、租户和截止时间
+               latest_only会让同一帧的裁剪互相替代，outcome、cancel_token属于整帧，由检测使用
+            */
+            state->classify_options.priority = options.priority;
+            state->classify_options.tenant = options.tenant;
+            state->classify_options.deadline_ms = options.deadline_ms;
+            shared_future<ClassifiedBoxArray> output = state->result.get_future().share();
+            statistics_->num_frames++;
+
+            // 检测被拒绝时回调同步执行，结果为空，这一帧直接完成
+            auto classifier = classifier_;
+            auto statistics = statistics_;
+            CascadeConfig config = config_;
+            detector_->commit(image, [state, classifier, statistics, config](BoxArray &boxes)
+                              { on_detected(state, boxes, classifier, statistics, config); },
+                              options);
+            return output;
+        }
+
+        virtual vector<shared_future<ClassifiedBoxArray>> commits(const vector<cv::Mat> &images, const JobOptions &options) override
+        {
+            vector<shared_future<ClassifiedBoxArray>> output;
+            output.reserve(images.size());
+            for (auto &image : images)
+                output.emplace_back(commit(image, options));
+            return output;
+        }
+
+        virtual CascadeReport report(bool reset) override
+        {
+            CascadeReport output;
+            auto &s = *statistics_;
+            output.num_frames = reset ? s.num_frames.exchange(0) : s.num_frames.load();
+            output.num_detections = reset ? s.num_detections.exchange(0) : s.num_detections.load();
+            output.num_crops = reset ? s.num_crops.exchange(0) : s.num_crops.load();
+            output.num_filtered = reset ? s.num_filtered.exchange(0) : s.num_filtered.load();
+            output.num_failed = reset ? s.num_failed.exchange(0) : s.num_failed.load();
+            output.crops_per_frame = output.num_frames > 0 ? output.num_crops / (float)output.num_frames : 0;
+            output.detect = s.detect.summary();
+            output.classify = s.classify.summary();
+            output.total = s.total.summary();
+            if (reset)
+            {
+                s.detect.reset();
+                s.classify.reset();
+                s.total.reset();
+            }
+
+            output.detector = detector_->metrics(reset);
+            output.classifier = classifier_->metrics(reset);
+            return output;
+        }
+
+    private:
+        static bool should_classify(const Box &box, const CascadeConfig &config)
+        {
+            if (box.confidence < config.min_confidence)
+                return false;
+
+            if (box.right - box.left < config.min_size || box.bottom - box.top < config.min_size)
+                return false;
+
+            return config.classes.empty() || find(config.classes.begin(), config.classes.end(), box.class_label) != config.classes.end();
+        }
+
+        static void finish(const shared_ptr<FrameState> &state, const shared_ptr<CascadeStatistics> &statistics)
+        {
+            auto now = StageStatistics::now_us();
+            statistics->classify.record(now - state->detected_us);
+            statistics->total.record(now - state->commit_us);
+            statistics->num_failed += state->num_failed.load();
+            state->image = cv::Mat();
+            state->result.set_value(std::move(state->output));
+        }
+
+        /* 在检测的推理线程或后处理线程上执行
+           所有需要分类的框立即提交，分类器的InferController把多帧的框凑成batch
+           分类器的准入控制满时这里会阻塞检测的回调，应当给分类器足够的队列或者使用非阻塞的准入策略
+        */
+        static void on_detected(const shared_ptr<FrameState> &state, BoxArray &boxes, const shared_ptr<Classifier::Infer> &classifier,
+                                const shared_ptr<CascadeStatistics> &statistics, const CascadeConfig &config)
+        {
+            state->detected_us = StageStatistics::now_us();
+            statistics->detect.record(state->detected_us - state->commit_us);
+            statistics->num_detections += boxes.size();
+
+            vector<int> selected;
+            for (int i = 0; i < (int)boxes.size(); ++i)
+            {
+                if (should_classify(boxes[i], config))
+                    selected.push_back(i);
+            }
+
+            if (config.max_crops_per_frame > 0 && (int)selected.size() > config.max_crops_per_frame)
+            {
+                stable_sort(selected.begin(), selected.end(), [&](int a, int b)
+                            { return boxes[a].confidence > boxes[b].confidence; });
+                selected.resize(config.max_crops_per_frame);
+            }
+
+            statistics->num_crops += selected.size();
+            statistics->num_filtered += boxes.size() - selected.size();
+            state->output.assign(boxes.begin(), boxes.end());
+
+            // 截止时间相对整帧的commit，分类只剩检测之后的部分，已经超过时分类被拒绝，计入num_failed
+            JobOptions classify_options = state->classify_options;
+            if (classify_options.deadline_ms > 0)
+            {
+                int elapsed_ms = (int)((state->detected_us - state->commit_us) / 1000);
+                classify_options.deadline_ms = max(1, classify_options.deadline_ms - elapsed_ms);
+            }
+
+            // 分类的回调可能在提交循环结束前全部完成，循环本身占一个计数，最后一个减到0的完成这一帧
+            state->remaining = selected.size() + 1;
+            for (int index : selected)
+            {
+                classifier->commit(state->image, boxes[index], [state, index, statistics](Classifier::Classification &result)
+                                   {
+                                       auto &box = state->output[index];
+                                       if (result.labels.empty())
+                                       {
+                                           state->num_failed++;
+                                       }
+                                       else
+                                       {
+                                           box.sub_label = result.labels[0];
+                                           box.sub_confidence = result.scores[0];
+                                           box.top_labels.swap(result.labels);
+                                           box.top_scores.swap(result.scores);
+                                       }
+
+                                       if (--state->remaining == 0)
+                                           finish(state, statistics); },
+                                   classify_options);
+            }
+
+            if (--state->remaining == 0)
+                finish(state, statistics);
+        }
+
+    private:
+        shared_ptr<Yolo::Infer> detector_;
+        shared_ptr<Classifier::Infer> classifier_;
+        CascadeConfig config_;
+        shared_ptr<CascadeStatistics> statistics_;
+    };
+
+    shared_ptr<CascadeInfer> create_cascade(
+        const shared_ptr<Yolo::Infer> &detector, const shared_ptr<Classifier::Infer> &classifier,
+        const CascadeConfig &config)
+    {
+        shared_ptr<CascadeInferImpl> instance(new CascadeInferImpl());
+        if (!instance->startup(detector, classifier, config))
+        {
+            instance.reset();
+        }
+        return instance;
+    }
+}; // namespace Cascade
@@ -0,0 +1,82 @@
+/**
+ * 检测 -> 分类的两级推理
+ * 解决的问题：
+ * 检测出的行人、车辆还需要第二级分类(属性、车型等)，原来是检测完成后在调用方逐个裁剪、逐个分类，
+ * 分类的batch为1，检测与分类串行
+ *
+ * 设计思路：
+ * 1. 检测用回调形式提交，回调中按类别、置信度、尺寸挑选框，立即把这一帧所有的框提交给分类器，
+ *    不等待调用方get；多路、多帧的框在分类器的InferController中凑成一个batch
+ * 2. 分类器直接从原图的框内warp，不裁剪中间图，见classifier.hpp
+ * 3. 返回的结果在get时把分类结果附加到框上，没有参与分类的框sub_label为-1
+ * 4. 每一级的InferMetricsSnapshot，加上每帧检测、分类与端到端的延迟分布
+ **/
+
+#ifndef CASCADE_HPP
+#define CASCADE_HPP
+
+#include "yolo.hpp"
+#include "classifier.hpp"
+#include "../TrtLib/common/latency_histogram.hpp"
+
+namespace Cascade
+{
+    using namespace std;
+    using ObjectDetector::Box;
+    using ObjectDetector::BoxArray;
+
+    struct ClassifiedBox : public Box
+    {
+        int sub_label = -1;       // 分类器top-1的类别，-1为没有分类
+        float sub_confidence = 0; // top-1的分数
+        vector<int> top_labels;   // 按分数降序的top-k
+        vector<float> top_scores;
+
+        ClassifiedBox() = default;
+        ClassifiedBox(const Box &box) : Box(box) {}
+    };
+
+    typedef vector<ClassifiedBox> ClassifiedBoxArray;
+
+    struct CascadeConfig
+    {
+        vector<int> classes;         // 需要分类的检测类别，空时全部分类
+        float min_confidence = 0.3f; // 置信度低于它的框不分类
+        int min_size = 8;            // 宽或高小于min_size像素的框不分类
+        int max_crops_per_frame = 64; // 每帧最多分类置信度最高的max_crops_per_frame个框，<= 0时不限制
+    };
+
+    struct CascadeReport
+    {
+        long long num_frames = 0;
+        long long num_detections = 0;
+        long long num_crops = 0;    // 提交给分类器的框
+        long long num_filtered = 0; // 按类别、置信度、尺寸、数量没有分类的框
+        long long num_failed = 0;   // 分类器拒绝或者失败的框，结果为空
+        float crops_per_frame = 0;
+
+        LatencySummary detect;   // commit到检测结果可用
+        LatencySummary classify; // 检测结果可用到这一帧所有框分类完成
+        LatencySummary total;    // commit到这一帧所有框分类完成
+
+        InferMetricsSnapshot detector;
+        InferMetricsSnapshot classifier;
+    };
+
+    // options作用于检测，分类只继承优先级、租户和剩余的截止时间
+    class CascadeInfer
+    {
+    public:
+        virtual shared_future<ClassifiedBoxArray> commit(const cv::Mat &image, const JobOptions &options = JobOptions()) = 0;
+        virtual vector<shared_future<ClassifiedBoxArray>> commits(const vector<cv::Mat> &images, const JobOptions &options = JobOptions()) = 0;
+
+        virtual CascadeReport report(bool reset = false) = 0;
+    };
+
+    shared_ptr<CascadeInfer> create_cascade(
+        const shared_ptr<Yolo::Infer> &detector, const shared_ptr<Classifier::Infer> &classifier,
+        const CascadeConfig &config = CascadeConfig());
+
+}; // namespace Cascade
+
+#endif // CASCADE_HPP
@@ -0,0 +1,412 @@
+#include "classifier.hpp"
+#include <cmath>
+#include <algorithm>
+#include "TrtLib/common/ilogger.hpp"
+#include "TrtLib/common/infer_controller.hpp"
+#include "TrtLib/common/preprocess_cpu.hpp"
+#include "TrtLib/common/simd.hpp"
+
+namespace Classifier
+{
+    using namespace std;
+
+    void crop_affine(const Box &box, const cv::Size &input, const ClassifierConfig &config, float i2d[6], float d2i[6])
+    {
+        float width = max(1.0f, (box.right - box.left) * (1 + 2 * config.crop_expand));
+        float height = max(1.0f, (box.bottom - box.top) * (1 + 2 * config.crop_expand));
+        float x0 = (box.left + box.right) * 0.5f - width * 0.5f;
+        float y0 = (box.top + box.bottom) * 0.5f - height * 0.5f;
+        float scale_x = input.width / width;
+        float scale_y = input.height / height;
+        float offset_x = 0;
+        float offset_y = 0;
+        if (config.keep_aspect)
+        {
+            scale_x = scale_y = min(scale_x, scale_y);
+            offset_x = (input.width - width * scale_x) * 0.5f;
+            offset_y = (input.height - height * scale_y) * 0.5f;
+        }
+
+        // 与Yolo::AffineMatrix相同的像素中心对齐
+        float tx = -x0 * scale_x + offset_x + scale_x * 0.5f - 0.5f;
+        float ty = -y0 * scale_y + offset_y + scale_y * 0.5f - 0.5f;
+        i2d[0] = scale_x;
+        i2d[1] = 0;
+        i2d[2] = tx;
+        i2d[3] = 0;
+        i2d[4] = scale_y;
+        i2d[5] = ty;
+
+        d2i[0] = 1 / scale_x;
+        d2i[1] = 0;
+        d2i[2] = -tx / scale_x;
+        d2i[3] = 0;
+        d2i[4] = 1 / scale_y;
+        d2i[5] = -ty / scale_y;
+    }
+
+    void cpu_softmax(float *values, int n)
+    {
+        if (n <= 0)
+            return;
+
+        int i = 0;
+        float max_value = values[0];
+        if (n >= SIMD::WIDTH)
+        {
+            SIMD::f32x4 vmax = SIMD::load(values);
+            for (i = SIMD::WIDTH; i + SIMD::WIDTH <= n; i += SIMD::WIDTH)
+                vmax = SIMD::max(vmax, SIMD::load(values + i));
+            max_value = SIMD::reduce_max(vmax);
+        }
+        for (; i < n; ++i)
+            max_value = max(max_value, values[i]);
+
+        SIMD::f32x4 vsub = SIMD::set1(max_value);
+        SIMD::f32x4 vsum = SIMD::zero();
+        for (i = 0; i + SIMD::WIDTH <= n; i += SIMD::WIDTH)
+        {
+            SIMD::f32x4 e = SIMD::exp(SIMD::sub(SIMD::load(values + i), vsub));
+            SIMD::store(values + i, e);
+            vsum = SIMD::add(vsum, e);
+        }
+
+        float sum = SIMD::reduce_add(vsum);
+        for (; i < n; ++i)
+        {
+            values[i] = exp(values[i] - max_value);
+            sum += values[i];
+        }
+
+        float inv = 1 / sum;
+        SIMD::f32x4 vinv = SIMD::set1(inv);
+        for (i = 0; i + SIMD::WIDTH <= n; i += SIMD::WIDTH)
+            SIMD::store(values + i, SIMD::mul(SIMD::load(values + i), vinv));
+        for (; i < n; ++i)
+            values[i] *= inv;
+    }
+
+    /* 保持一个按值降序的长度为k的表，第k个值作为门限
+       每次比较4个值，都不超过门限时整组跳过，k远小于n时几乎所有组都被跳过
+       只有严格大于门限的值才插入，相等时先出现(下标小)的在前
+    */
+    void cpu_top_k(const float *values, int n, int k, vector<int> &labels, vector<float> &scores)
+    {
+        k = max(0, min(k, n));
+        labels.clear();
+        scores.clear();
+        if (k == 0)
+            return;
+
+        float threshold = -INFINITY;
+        auto insert = [&](int index)
+        {
+            float value = values[index];
+            if ((int)labels.size() == k)
+            {
+                labels.pop_back();
+                scores.pop_back();
+            }
+
+            int pos = scores.size();
+            while (pos > 0 && scores[pos - 1] < value)
+                --pos;
+            labels.insert(labels.begin() + pos, index);
+            scores.insert(scores.begin() + pos, value);
+            if ((int)labels.size() == k)
+                threshold = scores.back();
+        };
+
+        int i = 0;
+        for (; i + SIMD::WIDTH <= n; i += SIMD::WIDTH)
+        {
+            int mask = SIMD::movemask(SIMD::cmpgt(SIMD::load(values + i), SIMD::set1(threshold)));
+            for (int lane = 0; mask != 0; ++lane, mask >>= 1)
+            {
+                // 前面的lane插入后门限可能升高，需要重新比较
+                if ((mask & 1) && ((int)labels.size() < k || values[i + lane] > threshold))
+                    insert(i + lane);
+            }
+        }
+
+        for (; i < n; ++i)
+        {
+            if ((int)labels.size() < k || values[i] > threshold)
+                insert(i);
+        }
+    }
+
+    // 回调的结果放回InferController的对象池时只清空，保留top-k与logits的容量，见object_pool.hpp
+    static void reset_for_reuse(Classification &object)
+    {
+        object.labels.clear();
+        object.scores.clear();
+    }
+
+    // 一个job是一个框，原图只增加引用计数
+    struct CropInput
+    {
+        cv::Mat image;
+        Box box;
+
+        CropInput() {}
+        CropInput(const cv::Mat &image, const Box &box) : image(image), box(box) {}
+    };
+
+    using ControllerImpl = InferController<
+        CropInput,        // input
+        Classification,   // output
+        TRT::EngineSource // start param
+        >;
+
+    class InferImpl : public Infer, public ControllerImpl
+    {
+    public:
+        /** 要求在InferImpl里面执行stop，而不是在基类执行stop **/
+        virtual ~InferImpl()
+        {
+            stop();
+        }
+
+        bool startup(const TRT::EngineSource &param, const ClassifierConfig &config)
+        {
+            config_ = config;
+            normalize_ = CUDAKernel::Norm::mean_std(
+                config.mean, config.std, 1 / 255.0f,
+                config.bgr_to_rgb ? CUDAKernel::ChannelType::Invert : CUDAKernel::ChannelType::None);
+            return ControllerImpl::startup(param, config.pipeline);
+        }
+
+        virtual void worker(promise<bool> &result) override
+        {
+            shared_ptr<TRT::Infer> engine;
+            int device_id = CPU_DEVICE_ID;
+            if (start_param_.backend == TRT::Backend::CPU)
+            {
+                engine = TRT::load_cpu_infer(start_param_.model);
+            }
+            else
+            {
+                TRT::set_device(start_param_.gpuid);
+                engine = TRT::load_infer(start_param_.file);
+                device_id = start_param_.gpuid;
+            }
+
+            if (engine == nullptr)
+            {
+                INFOE("Classifier engine %s load failed", start_param_.backend == TRT::Backend::CPU ? "CPU" : start_param_.file.c_str());
+                result.set_value(false);
+                return;
+            }
+
+            engine->print();
+            int max_batch_size = engine->get_max_batch_size();
+            auto input = engine->input(0);
+            auto output = engine->output(0);
+            if (input->ndims() != 4 || input->size(1) != 3)
+            {
+                INFOE("Classifier input must be [n, 3, h, w], got {%s}", input->shape_string());
+                result.set_value(false);
+                return;
+            }
+
+            input_width_ = input->size(3);
+            input_height_ = input->size(2);
+            num_classes_ = output->count(1);
+
+            // batch的输入与输出，GPU后端在引擎的stream上拷贝
+            auto batch_input = make_shared<TRT::Tensor>(input->dims(), input->type(), nullptr, device_id);
+            auto batch_output = make_shared<TRT::Tensor>(output->dims(), output->type(), nullptr, device_id);
+            batch_input->resize_single_dim(0, max_batch_size);
+            batch_output->resize_single_dim(0, max_batch_size);
+            if (start_param_.backend == TRT::Backend::CPU)
+            {
+                batch_input->to_cpu(false);
+                batch_output->to_cpu(false);
+            }
+            else
+            {
+                batch_input->set_stream(engine->get_stream());
+                batch_output->set_stream(engine->get_stream());
+                batch_input->to_gpu(false);
+                batch_output->to_gpu(false);
+            }
+
+            tensor_allocator_ = make_shared<MonopolyAllocator<TRT::Tensor>>(max_batch_size * 2, max_batch_size * 4);
+            result.set_value(true);
+
+            vector<Job> jobs;
+            while (get_jobs_and_wait(jobs, max_batch_size))
+            {
+                int infer_batch_size = jobs.size();
+                auto upload_begin = StageStatistics::now_us();
+                batch_input->resize_single_dim(0, infer_batch_size);
+                for (int ibatch = 0; ibatch < infer_batch_size; ++ibatch)
+                {
+                    auto &mono = jobs[ibatch].mono_tensor->data();
+                    batch_input->copy_from_cpu(batch_input->offset(ibatch), mono->cpu(), mono->count());
+                }
+
+                // 前向包括结果读回，GPU上to_cpu同步stream
+                auto forward_begin = StageStatistics::now_us();
+                engine->set_input(0, batch_input);
+                engine->set_output(0, batch_output);
+                engine->forward(false);
+                batch_output->to_cpu(true);
+
+                auto decode_begin = StageStatistics::now_us();
+                for (int ibatch = 0; ibatch < infer_batch_size; ++ibatch)
+                {
+                    auto &job = jobs[ibatch];
+                    const float *logits = batch_output->cpu<float>(ibatch);
+                    job.output.scores.assign(logits, logits + num_classes_);
+                    job.mono_tensor->release();
+                    job.input = CropInput();
+                }
+                auto decode_end = StageStatistics::now_us();
+                record_stage(MetricStage::Upload, forward_begin - upload_begin);
+                record_stage(MetricStage::Forward, decode_begin - forward_begin);
+                record_stage(MetricStage::Decode, decode_end - decode_begin);
+
+                for (auto &job : jobs)
+                    finish_job(job);
+            }
+
+            INFO("Classifier engine destroy.");
+        }
+
+        // softmax与top-k，在后处理线程上执行
+        virtual void postprocess(Job &job) override
+        {
+            auto &scores = job.output.scores;
+            if (config_.apply_softmax)
+                cpu_softmax(scores.data(), scores.size());
+
+            thread_local vector<float> top_scores;
+            cpu_top_k(scores.data(), scores.size(), config_.top_k, job.output.labels, top_scores);
+            scores.swap(top_scores);
+        }
+
+        virtual bool preprocess(Job &job, const CropInput &input) override
+        {
+            if (tensor_allocator_ == nullptr)
+            {
+                INFOE("tensor_allocator_ is nullptr");
+                return false;
+            }
+
+            const cv::Mat &image = input.image;
+            if (image.empty() || image.type() != CV_8UC3)
+            {
+                INFOE("Image must be a non-empty BGR image");
+                return false;
+            }
+
+            if (!(input.box.right > input.box.left && input.box.bottom > input.box.top))
+            {
+                INFOE("Invalid box [%.1f, %.1f, %.1f, %.1f]", input.box.left, input.box.top, input.box.right, input.box.bottom);
+                return false;
+            }
+
+            // 准入控制已经占用了tensor，见InferController::admit
+            if (job.mono_tensor == nullptr)
+                job.mono_tensor = tensor_allocator_->query();
+
+            if (job.mono_tensor == nullptr)
+            {
+                INFOE("Tensor allocator query failed.");
+                return false;
+            }
+
+            auto &tensor = job.mono_tensor->data();
+            if (tensor == nullptr)
+            {
+                // 只在主机上预处理，由worker拷贝到batch的输入
+                tensor = make_shared<TRT::Tensor>(TRT::DataType::Float, nullptr, CPU_DEVICE_ID);
+            }
+            tensor->resize(1, 3, input_height_, input_width_);
+
+            float i2d[6], d2i[6];
+            crop_affine(input.box, cv::Size(input_width_, input_height_), config_, i2d, d2i);
+
+            // 只采样框内的像素，不产生裁剪的中间图
+            CPUKernel::warp_affine_bilinear_and_normalize_plane(
+                image.data, image.step, image.cols, image.rows,
+                tensor->cpu<float>(), input_width_, input_height_,
+                d2i, 114, normalize_, 1);
+            return true;
+        }
+
+        virtual shared_future<Classification> commit(const cv::Mat &image, const Box &box, const JobOptions &options) override
+        {
+            return ControllerImpl::commit(CropInput(image, box), options);
+        }
+
+        virtual vector<shared_future<Classification>> commits(const cv::Mat &image, const BoxArray &boxes, const JobOptions &options) override
+        {
+            vector<CropInput> inputs;
+            inputs.reserve(boxes.size());
+            for (auto &box : boxes)
+                inputs.emplace_back(image, box);
+            return ControllerImpl::commits(inputs, options);
+        }
+
+        virtual CommitStatus commit(const cv::Mat &image, const Box &box, const Infer::Callback &callback, const JobOptions &options, bool blocking) override
+        {
+            return ControllerImpl::commit(CropInput(image, box), callback, options, blocking);
+        }
+
+        virtual void set_batching_policy(const BatchingPolicy &policy) override
+        {
+            ControllerImpl::set_batching_policy(policy);
+        }
+
+        virtual InferMetricsSnapshot metrics(bool reset) override
+        {
+            return ControllerImpl::get_metrics(reset);
+        }
+
+        virtual int num_classes() override
+        {
+            return num_classes_;
+        }
+
+        virtual ClassifierConfig config() override
+        {
+            return config_;
+        }
+
+    private:
+        int input_width_ = 0;
+        int input_height_ = 0;
+        int num_classes_ = 0;
+        ClassifierConfig config_;
+        CUDAKernel::Norm normalize_;
+    };
+
+    static shared_ptr<Infer> create(const TRT::EngineSource &param, const ClassifierConfig &config)
+    {
+        if (config.top_k <= 0)
+        {
+            INFOE("Invalid top_k %d", config.top_k);
+            return nullptr;
+        }
+
+        shared_ptr<InferImpl> instance(new InferImpl());
+        if (!instance->startup(param, config))
+        {
+            instance.reset();
+        }
+        return instance;
+    }
+
+    shared_ptr<Infer> create_infer(const string &engine_file, int gpuid, const ClassifierConfig &config)
+    {
+        return create(TRT::EngineSource(engine_file, gpuid), config);
+    }
+
+    shared_ptr<Infer> create_cpu_infer(const TRT::CPUModelConfig &model, const ClassifierConfig &config)
+    {
+        return create(TRT::EngineSource(model), config);
+    }
+}; // namespace Classifier
@@ -0,0 +1,103 @@
+/**
+ * 目标区域的分类
+ * 解决的问题：
+ * 第二级分类器(3.5-full-cnn-classifier)对每个目标先用OpenCV裁剪、缩放出一张小图，再一张一张地推理，
+ * 多一次整图大小无关的拷贝，并且每个目标都是batch = 1
+ *
+ * 设计思路：
+ * 1. 每个job是(原图, 框)，原图以cv::Mat的引用计数共享，不裁剪；预处理时按框到网络输入的仿射矩阵
+ *    用preprocess_cpu.hpp的SIMD warp直接从原图的框内采样、归一化并写入tensor，只读取框内的像素
+ *    一个框的输入只有224x224，GPU后端也在CPU上预处理，只上传网络输入，不上传原图
+ * 2. 所有帧的框进入同一个InferController，按batching_policy凑batch，不同帧的框共享batch
+ * 3. 后处理为SIMD的softmax与top-k，在后处理线程上执行
+ **/
+
+#ifndef CLASSIFIER_HPP
+#define CLASSIFIER_HPP
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <future>
+#include <functional>
+#include <opencv2/opencv.hpp>
+#include "../TrtLib/common/trt_tensor.hpp"
+#include "../TrtLib/common/batching_policy.hpp"
+#include "../TrtLib/common/pipeline_stage.hpp"
+#include "../TrtLib/common/job_scheduler.hpp"
+#include "../TrtLib/common/admission_control.hpp"
+#include "../TrtLib/common/infer_metrics.hpp"
+#include "../TrtLib/infer/trt_infer.hpp"
+#include "object_detector.hpp"
+
+namespace Classifier
+{
+    using namespace std;
+    using ObjectDetector::Box;
+    using ObjectDetector::BoxArray;
+
+    // 分数最高的top_k个类别，按分数降序，分类失败时为空
+    struct Classification
+    {
+        vector<int> labels;
+        vector<float> scores;
+
+        int label() const { return labels.empty() ? -1 : labels[0]; }
+        float score() const { return scores.empty() ? 0 : scores[0]; }
+    };
+
+    struct ClassifierConfig
+    {
+        int top_k = 5;
+        bool apply_softmax = true; // 模型输出logits时为true，输出已经是概率时为false
+
+        // 框每边向外扩展框边长的比例，超出原图的部分用114填充
+        float crop_expand = 0.0f;
+
+        // false：框拉伸到网络输入，与cv::resize相同；true：保持宽高比，居中并用114填充
+        bool keep_aspect = false;
+
+        // ImageNet的均值方差，BGR输入按RGB归一化
+        float mean[3] = {0.485f, 0.456f, 0.406f};
+        float std[3] = {0.229f, 0.224f, 0.225f};
+        bool bgr_to_rgb = true;
+
+        PipelineConfig pipeline;
+    };
+
+    // 框(扩展后)映射到网络输入的仿射矩阵，d2i为网络输入到原图
+    void crop_affine(const Box &box, const cv::Size &input, const ClassifierConfig &config, float i2d[6], float d2i[6]);
+
+    // 原地softmax，n个值，SIMD计算最大值、exp与求和
+    void cpu_softmax(float *values, int n);
+
+    // 最大的k个值，按值降序，相等时下标小的在前，k > n时取n个
+    void cpu_top_k(const float *values, int n, int k, vector<int> &labels, vector<float> &scores);
+
+    class Infer
+    {
+    public:
+        // image在推理完成前由引擎持有，框为原图坐标
+        virtual shared_future<Classification> commit(const cv::Mat &image, const Box &box, const JobOptions &options = JobOptions()) = 0;
+        virtual vector<shared_future<Classification>> commits(const cv::Mat &image, const BoxArray &boxes, const JobOptions &options = JobOptions()) = 0;
+
+        // 回调形式的提交，被拒绝时同步回调，结果为空；回调在推理线程或后处理线程上执行，应当尽快返回
+        typedef function<void(Classification &result)> Callback;
+        virtual CommitStatus commit(const cv::Mat &image, const Box &box, const Callback &callback, const JobOptions &options = JobOptions(), bool blocking = true) = 0;
+
+        virtual void set_batching_policy(const BatchingPolicy &policy) = 0;
+        virtual InferMetricsSnapshot metrics(bool reset = false) = 0;
+
+        virtual int num_classes() = 0;
+        virtual ClassifierConfig config() = 0;
+    };
+
+    // 输入为[batch, 3, h, w]，输出为[batch, num_classes]，按第0个输入输出绑定
+    shared_ptr<Infer> create_infer(const string &engine_file, int gpuid, const ClassifierConfig &config = ClassifierConfig());
+
+    // CPU后端，用于在没有GPU的机器上验证和压测
+    shared_ptr<Infer> create_cpu_infer(const TRT::CPUModelConfig &model, const ClassifierConfig &config = ClassifierConfig());
+
+}; // namespace Classifier
+
+#endif // CLASSIFIER_HPP
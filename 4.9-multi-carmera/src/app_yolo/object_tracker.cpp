@@ -0,0 +1,544 @@
+#include "object_tracker.hpp"
+#include <cmath>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+namespace ObjectTracker
+{
+    using namespace std;
+
+    const char *association_method_name(AssociationMethod method)
+    {
+        switch (method)
+        {
+        case AssociationMethod::Greedy:
+            return "Greedy";
+        case AssociationMethod::Hungarian:
+            return "Hungarian";
+        default:
+            return "Unknow";
+        }
+    }
+
+    const char *detect_trigger_name(DetectTrigger trigger)
+    {
+        switch (trigger)
+        {
+        case DetectTrigger::None:
+            return "None";
+        case DetectTrigger::FirstFrame:
+            return "FirstFrame";
+        case DetectTrigger::Interval:
+            return "Interval";
+        case DetectTrigger::NewTracks:
+            return "NewTracks";
+        case DetectTrigger::Uncertainty:
+            return "Uncertainty";
+        case DetectTrigger::Crowded:
+            return "Crowded";
+        default:
+            return "Unknow";
+        }
+    }
+
+    static float box_iou(const Box &a, const Box &b)
+    {
+        float cleft = max(a.left, b.left);
+        float ctop = max(a.top, b.top);
+        float cright = min(a.right, b.right);
+        float cbottom = min(a.bottom, b.bottom);
+        float c_area = max(cright - cleft, 0.0f) * max(cbottom - ctop, 0.0f);
+        if (c_area == 0.0f)
+            return 0.0f;
+
+        float a_area = max(0.0f, a.right - a.left) * max(0.0f, a.bottom - a.top);
+        float b_area = max(0.0f, b.right - b.left) * max(0.0f, b.bottom - b.top);
+        return c_area / (a_area + b_area - c_area);
+    }
+
+    static vector<int> greedy_assignment(const vector<float> &cost, int num_rows, int num_cols, float max_cost)
+    {
+        vector<pair<float, int>> candidates;
+        for (int i = 0; i < num_rows * num_cols; ++i)
+        {
+            if (cost[i] < max_cost)
+                candidates.emplace_back(cost[i], i);
+        }
+
+        // 代价相同时按下标，结果确定
+        sort(candidates.begin(), candidates.end());
+        vector<int> row_match(num_rows, -1);
+        vector<char> col_used(num_cols, 0);
+        for (auto &item : candidates)
+        {
+            int row = item.second / num_cols;
+            int col = item.second % num_cols;
+            if (row_match[row] != -1 || col_used[col])
+                continue;
+
+            row_match[row] = col;
+            col_used[col] = 1;
+        }
+        return row_match;
+    }
+
+    /* 匈牙利算法(带势函数的O(n^2 m)实现)
+       每一行额外有一个代价为max_cost的虚拟列，表示不匹配，因此任意一行都可以不匹配而不占用真实的列，
+       代价不小于max_cost的组合按max_cost计，与不匹配等价
+    */
+    static vector<int> hungarian_assignment(const vector<float> &cost, int num_rows, int num_cols, float max_cost)
+    {
+        int n = num_rows;
+        int m = num_cols + num_rows;
+        auto at = [&](int row, int col) -> double
+        {
+            if (col >= num_cols)
+                return max_cost;
+            return min(cost[row * num_cols + col], max_cost);
+        };
+
+        // 下标从1开始，p[j]为第j列匹配的行
+        const double inf = numeric_limits<double>::infinity();
+        vector<double> u(n + 1, 0), v(m + 1, 0);
+        vector<int> p(m + 1, 0), way(m + 1, 0);
+        vector<double> minv(m + 1);
+        vector<char> used(m + 1);
+        for (int i = 1; i <= n; ++i)
+        {
+            p[0] = i;
+            int j0 = 0;
+            fill(minv.begin(), minv.end(), inf);
+            fill(used.begin(), used.end(), 0);
+            do
+            {
+                used[j0] = 1;
+                int i0 = p[j0];
+                int j1 = 0;
+                double delta = inf;
+                for (int j = 1; j <= m; ++j)
+                {
+                    if (used[j])
+                        continue;
+
+                    double cur = at(i0 - 1, j - 1) - u[i0] - v[j];
+                    if (cur < minv[j])
+                    {
+                        minv[j] = cur;
+                        way[j] = j0;
+                    }
+                    if (minv[j] < delta)
+                    {
+                        delta = minv[j];
+                        j1 = j;
+                    }
+                }
+
+                for (int j = 0; j <= m; ++j)
+                {
+                    if (used[j])
+                    {
+                        u[p[j]] += delta;
+                        v[j] -= delta;
+                    }
+                    else
+                    {
+                        minv[j] -= delta;
+                    }
+                }
+                j0 = j1;
+            } while (p[j0] != 0);
+
+            do
+            {
+                int j1 = way[j0];
+                p[j0] = p[j1];
+                j0 = j1;
+            } while (j0);
+        }
+
+        vector<int> row_match(num_rows, -1);
+        for (int j = 1; j <= num_cols; ++j)
+        {
+            int row = p[j] - 1;
+            if (row >= 0 && cost[row * num_cols + j - 1] < max_cost)
+                row_match[row] = j - 1;
+        }
+        return row_match;
+    }
+
+    vector<int> linear_assignment(const vector<float> &cost, int num_rows, int num_cols, float max_cost, AssociationMethod method)
+    {
+        if (num_rows == 0 || num_cols == 0)
+            return vector<int>(num_rows, -1);
+
+        if (method == AssociationMethod::Greedy)
+            return greedy_assignment(cost, num_rows, num_cols, max_cost);
+        return hungarian_assignment(cost, num_rows, num_cols, max_cost);
+    }
+
+    /* 一个坐标的匀速卡尔曼滤波，状态为(位置, 速度)，只观测位置
+       P为2x2的对称协方差，P00、P01、P11
+    */
+    struct KalmanAxis
+    {
+        float x = 0, v = 0;
+        float P00 = 0, P01 = 0, P11 = 0;
+
+        void init(float z, float std_position, float std_velocity)
+        {
+            x = z;
+            v = 0;
+            P00 = 4 * std_position * std_position;
+            P01 = 0;
+            P11 = 100 * std_velocity * std_velocity;
+        }
+
+        // x = F x，P = F P F^T + Q，F = [1 1; 0 1]
+        void predict(float std_position, float std_velocity)
+        {
+            x += v;
+            P00 += 2 * P01 + P11 + std_position * std_position;
+            P01 += P11;
+            P11 += std_velocity * std_velocity;
+        }
+
+        // K = P H^T / (H P H^T + R)，P = (I - K H) P，H = [1 0]
+        void update(float z, float std_measurement)
+        {
+            float s = P00 + std_measurement * std_measurement;
+            float k0 = P00 / s;
+            float k1 = P01 / s;
+            float y = z - x;
+            x += k0 * y;
+            v += k1 * y;
+            P11 -= k1 * P01;
+            P01 *= 1 - k0;
+            P00 *= 1 - k0;
+        }
+
+        // 再预测一步后位置的方差，不改变状态
+        float next_variance(float std_position) const
+        {
+            return P00 + 2 * P01 + P11 + std_position * std_position;
+        }
+    };
+
+    struct Track
+    {
+        int id = 0;
+        int class_label = 0;
+        float confidence = 0;
+        KalmanAxis axis[4]; // cx, cy, w, h
+        int hits = 0;
+        int age = 0;
+        int last_update_frame = 0;
+        bool confirmed = false;
+        bool lost = false;
+
+        float width() const { return max(1.0f, axis[2].x); }
+        float height() const { return max(1.0f, axis[3].x); }
+
+        Box box() const
+        {
+            float w = width(), h = height();
+            return Box(axis[0].x - w * 0.5f, axis[1].x - h * 0.5f, axis[0].x + w * 0.5f, axis[1].x + h * 0.5f, confidence, class_label);
+        }
+
+        // 下一帧预测的框
+        Box next_box() const
+        {
+            float w = max(1.0f, axis[2].x + axis[2].v), h = max(1.0f, axis[3].x + axis[3].v);
+            float cx = axis[0].x + axis[0].v, cy = axis[1].x + axis[1].v;
+            return Box(cx - w * 0.5f, cy - h * 0.5f, cx + w * 0.5f, cy + h * 0.5f, confidence, class_label);
+        }
+    };
+
+    static long long now_us()
+    {
+        return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    class TrackerImpl : public Tracker
+    {
+    public:
+        explicit TrackerImpl(const TrackerConfig &config) : config_(config)
+        {
+            config_.detect_interval = max(1, config_.detect_interval);
+            config_.min_hits = max(1, config_.min_hits);
+        }
+
+        virtual const TrackedBoxArray &update(const BoxArray &detections) override
+        {
+            auto tick = now_us();
+            report_.num_triggers[(int)need_detection()]++;
+            report_.num_frames++;
+            report_.num_detection_frames++;
+            frame_id_++;
+            frames_since_detection_ = 0;
+            for (auto &track : tracks_)
+                predict_track(track);
+
+            vector<int> high, low;
+            for (int i = 0; i < (int)detections.size(); ++i)
+            {
+                float confidence = detections[i].confidence;
+                if (confidence >= config_.high_threshold)
+                    high.push_back(i);
+                else if (confidence >= config_.low_threshold)
+                    low.push_back(i);
+            }
+
+            // 第一轮：所有轨迹与高分检测
+            vector<int> candidates(tracks_.size());
+            for (int i = 0; i < (int)tracks_.size(); ++i)
+                candidates[i] = i;
+
+            vector<int> track_match(tracks_.size(), -1);
+            vector<char> detection_used(detections.size(), 0);
+            associate(candidates, high, detections, config_.match_iou, track_match, detection_used);
+
+            // 第二轮：上一次检测时还在跟踪的轨迹与低分检测
+            candidates.clear();
+            for (int i = 0; i < (int)tracks_.size(); ++i)
+            {
+                if (track_match[i] == -1 && tracks_[i].confirmed && !tracks_[i].lost)
+                    candidates.push_back(i);
+            }
+            associate(candidates, low, detections, config_.low_match_iou, track_match, detection_used);
+
+            vector<Track> alive;
+            alive.reserve(tracks_.size() + high.size());
+            for (int i = 0; i < (int)tracks_.size(); ++i)
+            {
+                auto &track = tracks_[i];
+                if (track_match[i] != -1)
+                {
+                    update_track(track, detections[track_match[i]]);
+                    alive.emplace_back(track);
+                }
+                else if (track.confirmed && frame_id_ - track.last_update_frame <= config_.max_lost_frames)
+                {
+                    // 待确认的轨迹没有匹配时直接删除
+                    track.lost = true;
+                    alive.emplace_back(track);
+                }
+            }
+
+            for (int index : high)
+            {
+                if (detection_used[index] || detections[index].confidence < config_.new_track_threshold)
+                    continue;
+
+                Track track;
+                track.id = ++next_id_;
+                track.class_label = detections[index].class_label;
+                track.confidence = detections[index].confidence;
+                track.hits = 1;
+                track.last_update_frame = frame_id_;
+                track.confirmed = frame_id_ == 1 || config_.min_hits <= 1;
+                init_track(track, detections[index]);
+                alive.emplace_back(track);
+                report_.num_tracks_created++;
+            }
+            tracks_.swap(alive);
+
+            output_.clear();
+            for (auto &track : tracks_)
+            {
+                if (track.confirmed && track.last_update_frame == frame_id_)
+                    output_.emplace_back(track.box(), track.id, false, track.age);
+            }
+            update_us_ += now_us() - tick;
+            return output_;
+        }
+
+        virtual const TrackedBoxArray &predict() override
+        {
+            auto tick = now_us();
+            report_.num_frames++;
+            frame_id_++;
+            frames_since_detection_++;
+
+            vector<Track> alive;
+            alive.reserve(tracks_.size());
+            for (auto &track : tracks_)
+            {
+                predict_track(track);
+                if (frame_id_ - track.last_update_frame <= config_.max_lost_frames)
+                    alive.emplace_back(track);
+            }
+            tracks_.swap(alive);
+
+            output_.clear();
+            for (auto &track : tracks_)
+            {
+                if (track.confirmed && !track.lost)
+                    output_.emplace_back(track.box(), track.id, true, track.age);
+            }
+            predict_us_ += now_us() - tick;
+            return output_;
+        }
+
+        virtual DetectTrigger need_detection() override
+        {
+            if (frame_id_ == 0)
+                return DetectTrigger::FirstFrame;
+
+            if (frames_since_detection_ + 1 >= config_.detect_interval)
+                return DetectTrigger::Interval;
+
+            vector<Box> boxes;
+            float max_uncertainty = 0;
+            for (auto &track : tracks_)
+            {
+                if (!track.confirmed)
+                    return DetectTrigger::NewTracks;
+
+                if (track.lost)
+                    continue;
+
+                float std_x = config_.std_weight_position * track.width();
+                float std_y = config_.std_weight_position * track.height();
+                max_uncertainty = max(max_uncertainty, sqrt(track.axis[0].next_variance(std_x)) / track.width());
+                max_uncertainty = max(max_uncertainty, sqrt(track.axis[1].next_variance(std_y)) / track.height());
+                boxes.emplace_back(track.next_box());
+            }
+
+            if (config_.uncertainty_threshold > 0 && max_uncertainty > config_.uncertainty_threshold)
+                return DetectTrigger::Uncertainty;
+
+            if (config_.crowded_iou > 0)
+            {
+                for (int i = 0; i < (int)boxes.size(); ++i)
+                {
+                    for (int j = i + 1; j < (int)boxes.size(); ++j)
+                    {
+                        if (box_iou(boxes[i], boxes[j]) > config_.crowded_iou)
+                            return DetectTrigger::Crowded;
+                    }
+                }
+            }
+            return DetectTrigger::None;
+        }
+
+        virtual void reset() override
+        {
+            tracks_.clear();
+            output_.clear();
+            frame_id_ = 0;
+            frames_since_detection_ = 0;
+        }
+
+        virtual TrackerReport report(bool reset) override
+        {
+            TrackerReport output = report_;
+            for (auto &track : tracks_)
+                output.num_active_tracks += track.confirmed && !track.lost;
+
+            long long num_predict_frames = report_.num_frames - report_.num_detection_frames;
+            if (report_.num_detection_frames > 0)
+                output.average_update_us = update_us_ / (double)report_.num_detection_frames;
+            if (num_predict_frames > 0)
+                output.average_predict_us = predict_us_ / (double)num_predict_frames;
+
+            if (reset)
+            {
+                report_ = TrackerReport();
+                update_us_ = 0;
+                predict_us_ = 0;
+            }
+            return output;
+        }
+
+    private:
+        void init_track(Track &track, const Box &box)
+        {
+            float w = max(1.0f, box.right - box.left), h = max(1.0f, box.bottom - box.top);
+            float z[] = {(box.left + box.right) * 0.5f, (box.top + box.bottom) * 0.5f, w, h};
+            float size[] = {w, h, w, h};
+            for (int k = 0; k < 4; ++k)
+                track.axis[k].init(z[k], config_.std_weight_position * size[k], config_.std_weight_velocity * size[k]);
+        }
+
+        void predict_track(Track &track)
+        {
+            float size[] = {track.width(), track.height(), track.width(), track.height()};
+            for (int k = 0; k < 4; ++k)
+                track.axis[k].predict(config_.std_weight_position * size[k], config_.std_weight_velocity * size[k]);
+            track.age++;
+        }
+
+        void update_track(Track &track, const Box &box)
+        {
+            float w = max(1.0f, box.right - box.left), h = max(1.0f, box.bottom - box.top);
+            float z[] = {(box.left + box.right) * 0.5f, (box.top + box.bottom) * 0.5f, w, h};
+            float size[] = {track.width(), track.height(), track.width(), track.height()};
+            for (int k = 0; k < 4; ++k)
+                track.axis[k].update(z[k], config_.std_weight_position * size[k]);
+
+            track.confidence = box.confidence;
+            track.class_label = box.class_label;
+            track.hits++;
+            track.last_update_frame = frame_id_;
+            track.lost = false;
+            track.confirmed = track.confirmed || track.hits >= config_.min_hits;
+        }
+
+        // rows为tracks_的下标，cols为detections的下标，匹配结果写入track_match与detection_used
+        void associate(const vector<int> &rows, const vector<int> &cols, const BoxArray &detections, float min_iou,
+                       vector<int> &track_match, vector<char> &detection_used)
+        {
+            vector<int> free_cols;
+            for (int index : cols)
+            {
+                if (!detection_used[index])
+                    free_cols.push_back(index);
+            }
+            if (rows.empty() || free_cols.empty())
+                return;
+
+            int num_rows = rows.size(), num_cols = free_cols.size();
+            vector<Box> boxes(num_rows);
+            for (int i = 0; i < num_rows; ++i)
+                boxes[i] = tracks_[rows[i]].box();
+
+            cost_.resize(num_rows * num_cols);
+            for (int i = 0; i < num_rows; ++i)
+            {
+                for (int j = 0; j < num_cols; ++j)
+                {
+                    auto &detection = detections[free_cols[j]];
+                    bool allowed = !config_.class_aware || detection.class_label == tracks_[rows[i]].class_label;
+                    cost_[i * num_cols + j] = allowed ? 1 - box_iou(boxes[i], detection) : 1.0f;
+                }
+            }
+
+            auto row_match = linear_assignment(cost_, num_rows, num_cols, 1 - min_iou, config_.association);
+            for (int i = 0; i < num_rows; ++i)
+            {
+                if (row_match[i] == -1)
+                    continue;
+
+                track_match[rows[i]] = free_cols[row_match[i]];
+                detection_used[free_cols[row_match[i]]] = 1;
+            }
+        }
+
+        TrackerConfig config_;
+        vector<Track> tracks_;
+        TrackedBoxArray output_;
+        vector<float> cost_;
+        int frame_id_ = 0;
+        int frames_since_detection_ = 0;
+        int next_id_ = 0;
+        TrackerReport report_;
+        long long update_us_ = 0;
+        long long predict_us_ = 0;
+    };
+
+    shared_ptr<Tracker> create_tracker(const TrackerConfig &config)
+    {
+        return make_shared<TrackerImpl>(config);
+    }
+}; // namespace ObjectTracker
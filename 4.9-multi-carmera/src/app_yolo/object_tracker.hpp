@@ -0,0 +1,121 @@
+/**
+ * 多目标跟踪
+ * 解决的问题：
+ * 视频流每一帧都要commit().get()，而相邻帧之间目标几乎不动，引擎的大部分负载花在重复的检测上；
+ * 逐帧独立的检测结果也没有跨帧的ID
+ *
+ * 设计思路：
+ * 1. 每个目标一个匀速模型的卡尔曼滤波，状态为中心、宽高及其速度，过程与观测噪声按目标尺寸缩放(与DeepSORT相同)
+ *    噪声矩阵是对角的，8维的滤波拆成4个独立的(位置, 速度)二维滤波，结果相同，不需要矩阵库
+ * 2. ByteTrack式的两轮关联：高分检测先与所有轨迹按IoU匹配，剩下的轨迹再与低分检测匹配，
+ *    低分检测只用于延续已有的轨迹，不创建新轨迹，遮挡时置信度下降的目标不会断开
+ *    匹配可以选贪心或者匈牙利算法，只在同一类别之间匹配
+ * 3. 新轨迹连续匹配min_hits次才输出，丢失超过max_lost_frames帧的轨迹被删除
+ * 4. 隔帧检测：没有检测结果的帧只做预测，need_detection按以下条件决定下一帧是否需要运行检测
+ *    距上次检测已经detect_interval帧、存在待确认的新轨迹、预测的位置不确定度超过阈值、两条轨迹的预测框重叠
+ *    其余的帧用预测的框输出，引擎的负载降为约1/detect_interval
+ *
+ * 一个Tracker对应一路视频，不是线程安全的
+ **/
+
+#ifndef OBJECT_TRACKER_HPP
+#define OBJECT_TRACKER_HPP
+
+#include <vector>
+#include <memory>
+#include "object_detector.hpp"
+
+namespace ObjectTracker
+{
+    using ObjectDetector::Box;
+    using ObjectDetector::BoxArray;
+
+    struct TrackedBox : public Box
+    {
+        int track_id = 0;
+        bool predicted = false; // 这一帧没有匹配的检测，框来自预测
+        int age = 0;            // 轨迹创建以来的帧数
+
+        TrackedBox() = default;
+        TrackedBox(const Box &box, int track_id, bool predicted, int age)
+            : Box(box), track_id(track_id), predicted(predicted), age(age) {}
+    };
+
+    typedef std::vector<TrackedBox> TrackedBoxArray;
+
+    enum class AssociationMethod : int
+    {
+        Greedy = 0,   // 按IoU从大到小贪心匹配
+        Hungarian = 1 // 最大化IoU之和的最优匹配，目标密集时ID切换更少
+    };
+
+    // 下一帧需要运行检测的原因
+    enum class DetectTrigger : int
+    {
+        None = 0,        // 只做预测
+        FirstFrame = 1,  // 还没有检测过
+        Interval = 2,    // 距上次检测已经detect_interval帧
+        NewTracks = 3,   // 有待确认的新轨迹
+        Uncertainty = 4, // 预测的位置不确定度超过阈值
+        Crowded = 5      // 两条轨迹的预测框重叠，容易交换ID
+    };
+
+    const char *association_method_name(AssociationMethod method);
+    const char *detect_trigger_name(DetectTrigger trigger);
+
+    struct TrackerConfig
+    {
+        AssociationMethod association = AssociationMethod::Hungarian;
+        float high_threshold = 0.5f;      // 第一轮关联的置信度下限，低于它的检测只参与第二轮
+        float low_threshold = 0.1f;       // 低于它的检测被忽略
+        float new_track_threshold = 0.6f; // 没有匹配的检测创建新轨迹的置信度下限，略高于high_threshold以减少误检产生的轨迹
+        float match_iou = 0.2f;           // 第一轮关联的最小IoU
+        float low_match_iou = 0.5f;       // 第二轮关联的最小IoU
+        int min_hits = 2;                 // 新轨迹连续匹配多少次后输出
+        int max_lost_frames = 30;         // 按帧数计，包括只做预测的帧，应当大于detect_interval
+        bool class_aware = true;          // 只在同一类别之间匹配
+
+        // 卡尔曼滤波的噪声，相对于目标的宽高
+        float std_weight_position = 1.0f / 20;
+        float std_weight_velocity = 1.0f / 160;
+
+        // 隔帧检测，detect_interval = 1时每帧都检测
+        int detect_interval = 1;
+        float uncertainty_threshold = 0.25f; // 预测的中心位置标准差 / 目标尺寸，<= 0时不按不确定度触发
+        float crowded_iou = 0.5f;            // 两条轨迹预测框的IoU，<= 0时不按重叠触发
+    };
+
+    struct TrackerReport
+    {
+        long long num_frames = 0;
+        long long num_detection_frames = 0; // update的帧数，其余为predict
+        long long num_triggers[6] = {0};    // 按DetectTrigger统计的检测帧，None为need_detection之外主动调用update的帧
+        long long num_tracks_created = 0;
+        int num_active_tracks = 0;          // 已确认、未丢失的轨迹
+        double average_update_us = 0;       // update的平均耗时，不含检测
+        double average_predict_us = 0;
+    };
+
+    class Tracker
+    {
+    public:
+        // 有检测结果的帧，返回这一帧已确认的轨迹，结果在下一次调用前有效
+        virtual const TrackedBoxArray &update(const BoxArray &detections) = 0;
+
+        // 没有检测结果的帧，所有轨迹前进一帧，返回预测的框
+        virtual const TrackedBoxArray &predict() = 0;
+
+        // 下一帧是否需要运行检测，None时调用predict
+        virtual DetectTrigger need_detection() = 0;
+
+        virtual void reset() = 0;
+        virtual TrackerReport report(bool reset = false) = 0;
+    };
+
+    std::shared_ptr<Tracker> create_tracker(const TrackerConfig &config = TrackerConfig());
+
+    // 行为tracks，列为detections，cost[i * num_cols + j] >= max_cost的组合不匹配，返回每一行匹配的列，-1为不匹配
+    std::vector<int> linear_assignment(const std::vector<float> &cost, int num_rows, int num_cols, float max_cost, AssociationMethod method);
+}; // namespace ObjectTracker
+
+#endif // OBJECT_TRACKER_HPP
@@ -0,0 +1,694 @@
+#include "seg.hpp"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "yolo.hpp"
+#include "TrtLib/common/ilogger.hpp"
+#include "TrtLib/common/infer_controller.hpp"
+#include "TrtLib/common/preprocess_cpu.hpp"
+#include "TrtLib/common/simd.hpp"
+
+namespace Seg
+{
+    using namespace std;
+
+    // 4个像素，第c类的4个值从values + c * class_stride开始连续存放
+    static void argmax4(const float *values, int class_stride, int num_classes, bool softmax, float *prob, unsigned char *label)
+    {
+        SIMD::f32x4 vmax = SIMD::load(values);
+        SIMD::f32x4 vindex = SIMD::zero();
+        for (int c = 1; c < num_classes; ++c)
+        {
+            // 严格大于才替换，相等时保留下标小的
+            SIMD::f32x4 v = SIMD::load(values + c * class_stride);
+            SIMD::f32x4 greater = SIMD::cmpgt(v, vmax);
+            vmax = SIMD::select(greater, v, vmax);
+            vindex = SIMD::select(greater, SIMD::set1((float)c), vindex);
+        }
+
+        if (prob != nullptr)
+        {
+            SIMD::f32x4 vprob = vmax;
+            if (softmax)
+            {
+                // 最大值的e^0 = 1，最大概率为1 / sum
+                SIMD::f32x4 vsum = SIMD::zero();
+                for (int c = 0; c < num_classes; ++c)
+                    vsum = SIMD::add(vsum, SIMD::exp(SIMD::sub(SIMD::load(values + c * class_stride), vmax)));
+                vprob = SIMD::div(SIMD::set1(1.0f), vsum);
+            }
+            SIMD::store(prob, vprob);
+        }
+
+        float index[4];
+        SIMD::store(index, vindex);
+        for (int i = 0; i < 4; ++i)
+            label[i] = (unsigned char)index[i];
+    }
+
+    static void argmax1(const float *values, int class_stride, int num_classes, bool softmax, float *prob, unsigned char *label)
+    {
+        int index = 0;
+        float value = values[0];
+        for (int c = 1; c < num_classes; ++c)
+        {
+            if (values[c * class_stride] > value)
+            {
+                value = values[c * class_stride];
+                index = c;
+            }
+        }
+
+        if (prob != nullptr)
+        {
+            if (softmax)
+            {
+                float sum = 0;
+                for (int c = 0; c < num_classes; ++c)
+                    sum += exp(values[c * class_stride] - value);
+                *prob = 1 / sum;
+            }
+            else
+            {
+                *prob = value;
+            }
+        }
+        *label = (unsigned char)index;
+    }
+
+    void cpu_argmax(const float *values, int count, int num_classes, OutputLayout layout, int plane_stride,
+                    bool softmax, float *prob, unsigned char *label)
+    {
+        if (count <= 0 || num_classes <= 0)
+            return;
+
+        int i = 0;
+        if (layout == OutputLayout::NCHW)
+        {
+            for (; i + SIMD::WIDTH <= count; i += SIMD::WIDTH)
+                argmax4(values + i, plane_stride, num_classes, softmax, prob ? prob + i : nullptr, label + i);
+
+            for (; i < count; ++i)
+                argmax1(values + i, plane_stride, num_classes, softmax, prob ? prob + i : nullptr, label + i);
+            return;
+        }
+
+        // NHWC：4个像素的num_classes x 4转置为4 x num_classes，每4个类别一次4x4转置
+        thread_local vector<float> block;
+        block.resize(num_classes * SIMD::WIDTH);
+        for (; i + SIMD::WIDTH <= count; i += SIMD::WIDTH)
+        {
+            const float *p0 = values + i * num_classes;
+            const float *p1 = p0 + num_classes;
+            const float *p2 = p1 + num_classes;
+            const float *p3 = p2 + num_classes;
+            float *pblock = block.data();
+            int c = 0;
+            for (; c + SIMD::WIDTH <= num_classes; c += SIMD::WIDTH)
+            {
+                SIMD::f32x4 a = SIMD::load(p0 + c);
+                SIMD::f32x4 b = SIMD::load(p1 + c);
+                SIMD::f32x4 d = SIMD::load(p2 + c);
+                SIMD::f32x4 e = SIMD::load(p3 + c);
+                SIMD::transpose4(a, b, d, e);
+                SIMD::store(pblock + (c + 0) * SIMD::WIDTH, a);
+                SIMD::store(pblock + (c + 1) * SIMD::WIDTH, b);
+                SIMD::store(pblock + (c + 2) * SIMD::WIDTH, d);
+                SIMD::store(pblock + (c + 3) * SIMD::WIDTH, e);
+            }
+
+            for (; c < num_classes; ++c)
+            {
+                pblock[c * SIMD::WIDTH + 0] = p0[c];
+                pblock[c * SIMD::WIDTH + 1] = p1[c];
+                pblock[c * SIMD::WIDTH + 2] = p2[c];
+                pblock[c * SIMD::WIDTH + 3] = p3[c];
+            }
+            argmax4(pblock, SIMD::WIDTH, num_classes, softmax, prob ? prob + i : nullptr, label + i);
+        }
+
+        for (; i < count; ++i)
+            argmax1(values + i * num_classes, 1, num_classes, softmax, prob ? prob + i : nullptr, label + i);
+    }
+
+    cv::Mat decode_runs(const vector<LabelRun> &runs, int width, int height)
+    {
+        cv::Mat output(height, width, CV_8U, cv::Scalar(0));
+        unsigned char *pdst = output.ptr<unsigned char>(0);
+        size_t total = (size_t)width * height;
+        size_t offset = 0;
+        for (auto &run : runs)
+        {
+            size_t count = min((size_t)run.count, total - offset);
+            memset(pdst + offset, run.label, count);
+            offset += count;
+        }
+        return output;
+    }
+
+    // 回调的结果放回InferController的对象池时只清空vector、保留容量；cv::Mat可能仍被调用方引用，不能复用
+    static void reset_for_reuse(SegResult &object)
+    {
+        object.width = 0;
+        object.height = 0;
+        object.label.release();
+        object.prob.release();
+        object.runs.clear();
+        object.polygons.clear();
+    }
+
+    /* 原图到网络输出的映射：ox = scale_x * x + offset_x，oy同理，letterbox只有缩放与平移
+       roi为原图覆盖的网络输出区域，外扩1个像素供双线性插值，argmax只计算roi
+    */
+    struct SegAdditional
+    {
+        int width = 0;
+        int height = 0;
+        float d2i[6];
+        float scale_x = 1;
+        float offset_x = 0;
+        float scale_y = 1;
+        float offset_y = 0;
+        cv::Rect roi;
+
+        cv::Mat net_label; // roi大小的类别
+        cv::Mat net_prob;  // roi大小的最大概率，output_prob为true时
+    };
+
+    using ControllerImpl = InferController<
+        cv::Mat,           // input
+        SegResult,         // output
+        TRT::EngineSource, // start param
+        SegAdditional      // additional
+        >;
+
+    // 按列(或按行)的采样表
+    struct AxisTable
+    {
+        vector<int> nearest; // 最近邻，roi内的下标
+        vector<int> index0;  // 双线性的两个下标与权重
+        vector<int> index1;
+        vector<float> weight;
+
+        void compute(int size, float scale, float offset, int roi_begin, int roi_size)
+        {
+            nearest.resize(size);
+            index0.resize(size);
+            index1.resize(size);
+            weight.resize(size);
+            for (int i = 0; i < size; ++i)
+            {
+                float o = scale * i + offset;
+                float base = floor(o);
+                nearest[i] = clamp_index((int)floor(o + 0.5f) - roi_begin, roi_size);
+                index0[i] = clamp_index((int)base - roi_begin, roi_size);
+                index1[i] = clamp_index((int)base + 1 - roi_begin, roi_size);
+                weight[i] = o - base;
+            }
+        }
+
+        static int clamp_index(int i, int size)
+        {
+            return max(0, min(i, size - 1));
+        }
+    };
+
+    class InferImpl : public Infer, public ControllerImpl
+    {
+    public:
+        /** 要求在InferImpl里面执行stop，而不是在基类执行stop **/
+        virtual ~InferImpl()
+        {
+            stop();
+        }
+
+        bool startup(const TRT::EngineSource &param, const SegConfig &config)
+        {
+            config_ = config;
+            normalize_ = CUDAKernel::Norm::mean_std(
+                config.mean, config.std, 1 / 255.0f,
+                config.bgr_to_rgb ? CUDAKernel::ChannelType::Invert : CUDAKernel::ChannelType::None);
+            return ControllerImpl::startup(param, config.pipeline);
+        }
+
+        virtual void worker(promise<bool> &result) override
+        {
+            shared_ptr<TRT::Infer> engine;
+            int device_id = CPU_DEVICE_ID;
+            if (start_param_.backend == TRT::Backend::CPU)
+            {
+                engine = TRT::load_cpu_infer(start_param_.model);
+            }
+            else
+            {
+                TRT::set_device(start_param_.gpuid);
+                engine = TRT::load_infer(start_param_.file);
+                device_id = start_param_.gpuid;
+            }
+
+            if (engine == nullptr)
+            {
+                INFOE("Seg engine %s load failed", start_param_.backend == TRT::Backend::CPU ? "CPU" : start_param_.file.c_str());
+                result.set_value(false);
+                return;
+            }
+
+            engine->print();
+            int max_batch_size = engine->get_max_batch_size();
+            auto input = engine->input(0);
+            auto output = engine->output(0);
+            if (input->ndims() != 4 || input->size(1) != 3 || output->ndims() != 4)
+            {
+                INFOE("Seg input must be [n, 3, h, w] and output must be 4 dims, got {%s} and {%s}",
+                      input->shape_string(), output->shape_string());
+                result.set_value(false);
+                return;
+            }
+
+            input_width_ = input->size(3);
+            input_height_ = input->size(2);
+            if (config_.layout == OutputLayout::NHWC)
+            {
+                output_height_ = output->size(1);
+                output_width_ = output->size(2);
+                num_classes_ = output->size(3);
+            }
+            else
+            {
+                num_classes_ = output->size(1);
+                output_height_ = output->size(2);
+                output_width_ = output->size(3);
+            }
+
+            if (num_classes_ < 1 || num_classes_ > 256)
+            {
+                INFOE("Seg num_classes must be in [1, 256], got %d, check SegConfig::layout for output {%s}",
+                      num_classes_, output->shape_string());
+                result.set_value(false);
+                return;
+            }
+
+            // batch的输入与输出，GPU后端在引擎的stream上拷贝
+            auto batch_input = make_shared<TRT::Tensor>(input->dims(), input->type(), nullptr, device_id);
+            auto batch_output = make_shared<TRT::Tensor>(output->dims(), output->type(), nullptr, device_id);
+            batch_input->resize_single_dim(0, max_batch_size);
+            batch_output->resize_single_dim(0, max_batch_size);
+            if (start_param_.backend == TRT::Backend::CPU)
+            {
+                batch_input->to_cpu(false);
+                batch_output->to_cpu(false);
+            }
+            else
+            {
+                batch_input->set_stream(engine->get_stream());
+                batch_output->set_stream(engine->get_stream());
+                batch_input->to_gpu(false);
+                batch_output->to_gpu(false);
+            }
+
+            tensor_allocator_ = make_shared<MonopolyAllocator<TRT::Tensor>>(max_batch_size * 2, max_batch_size * 4);
+            result.set_value(true);
+
+            vector<Job> jobs;
+            while (get_jobs_and_wait(jobs, max_batch_size))
+            {
+                int infer_batch_size = jobs.size();
+                auto upload_begin = StageStatistics::now_us();
+                batch_input->resize_single_dim(0, infer_batch_size);
+                for (int ibatch = 0; ibatch < infer_batch_size; ++ibatch)
+                {
+                    auto &mono = jobs[ibatch].mono_tensor->data();
+                    batch_input->copy_from_cpu(batch_input->offset(ibatch), mono->cpu(), mono->count());
+                }
+
+                // 前向包括结果读回，GPU上to_cpu同步stream
+                auto forward_begin = StageStatistics::now_us();
+                engine->set_input(0, batch_input);
+                engine->set_output(0, batch_output);
+                engine->forward(false);
+                batch_output->to_cpu(true);
+
+                auto decode_begin = StageStatistics::now_us();
+                for (int ibatch = 0; ibatch < infer_batch_size; ++ibatch)
+                {
+                    auto &job = jobs[ibatch];
+                    decode(batch_output->cpu<float>(ibatch), job.additional);
+                    job.mono_tensor->release();
+                    job.input = cv::Mat();
+                }
+                auto decode_end = StageStatistics::now_us();
+                record_stage(MetricStage::Upload, forward_begin - upload_begin);
+                record_stage(MetricStage::Forward, decode_begin - forward_begin);
+                record_stage(MetricStage::Decode, decode_end - decode_begin);
+
+                for (auto &job : jobs)
+                    finish_job(job);
+            }
+
+            INFO("Seg engine destroy.");
+        }
+
+        // 网络输出分辨率、roi内的argmax
+        void decode(const float *output, SegAdditional &additional)
+        {
+            const cv::Rect &roi = additional.roi;
+            bool need_prob = config_.output_prob;
+            additional.net_label.create(roi.height, roi.width, CV_8U);
+            if (need_prob)
+                additional.net_prob.create(roi.height, roi.width, CV_32F);
+
+            int plane_stride = output_width_ * output_height_;
+            for (int y = 0; y < roi.height; ++y)
+            {
+                int offset = (roi.y + y) * output_width_ + roi.x;
+                const float *values = config_.layout == OutputLayout::NCHW ? output + offset : output + offset * num_classes_;
+                cpu_argmax(values, roi.width, num_classes_, config_.layout, plane_stride, config_.apply_softmax,
+                           need_prob ? additional.net_prob.ptr<float>(y) : nullptr, additional.net_label.ptr<unsigned char>(y));
+            }
+        }
+
+        /* 反变换到原图，在后处理线程上执行
+           类别图为最近邻，与4.3的INTER_NEAREST相同；概率图为双线性，边界复制最外圈的像素
+        */
+        virtual void postprocess(Job &job) override
+        {
+            auto &additional = job.additional;
+            auto &output = job.output;
+            output.width = additional.width;
+            output.height = additional.height;
+            if (additional.net_label.empty())
+                return;
+
+            const cv::Rect &roi = additional.roi;
+            thread_local AxisTable columns, rows;
+            columns.compute(output.width, additional.scale_x, additional.offset_x, roi.x, roi.width);
+            rows.compute(output.height, additional.scale_y, additional.offset_y, roi.y, roi.height);
+
+            if (config_.output_label || config_.output_runs)
+                resample_label(additional, columns, rows, output);
+
+            if (config_.output_prob)
+                resample_prob(additional, columns, rows, output);
+
+            if (config_.output_polygons)
+                find_polygons(additional, columns, rows, output);
+
+            additional.net_label.release();
+            additional.net_prob.release();
+        }
+
+        /* 原图的相邻列常常映射到同一个源列，把列合并为区间(源列, 起点, 终点)
+           每个源行只把区间按类别合并为行内的RLE一次，原图的每一行按RLE memset，RLE同时追加到结果
+        */
+        void resample_label(const SegAdditional &additional, const AxisTable &columns, const AxisTable &rows, SegResult &output)
+        {
+            struct Span
+            {
+                int source;
+                int begin;
+                int end;
+            };
+
+            thread_local vector<Span> spans;
+            thread_local vector<LabelRun> row_runs;
+            spans.clear();
+            for (int x = 0; x < output.width; ++x)
+            {
+                int source = columns.nearest[x];
+                if (!spans.empty() && spans.back().source == source)
+                    spans.back().end = x + 1;
+                else
+                    spans.push_back({source, x, x + 1});
+            }
+
+            if (config_.output_label)
+                output.label.create(output.height, output.width, CV_8U);
+
+            int last_source_row = -1;
+            for (int y = 0; y < output.height; ++y)
+            {
+                int source_row = rows.nearest[y];
+                if (source_row != last_source_row)
+                {
+                    const unsigned char *psrc = additional.net_label.ptr<unsigned char>(source_row);
+                    row_runs.clear();
+                    for (auto &span : spans)
+                    {
+                        int label = psrc[span.source];
+                        if (!row_runs.empty() && row_runs.back().label == label)
+                            row_runs.back().count += span.end - span.begin;
+                        else
+                            row_runs.emplace_back(label, span.end - span.begin);
+                    }
+                    last_source_row = source_row;
+                }
+
+                if (config_.output_label)
+                {
+                    unsigned char *pdst = output.label.ptr<unsigned char>(y);
+                    for (auto &run : row_runs)
+                    {
+                        memset(pdst, run.label, run.count);
+                        pdst += run.count;
+                    }
+                }
+
+                if (config_.output_runs)
+                {
+                    for (auto &run : row_runs)
+                    {
+                        if (!output.runs.empty() && output.runs.back().label == run.label)
+                            output.runs.back().count += run.count;
+                        else
+                            output.runs.push_back(run);
+                    }
+                }
+            }
+        }
+
+        // 先在roi宽度上纵向插值(SIMD)，再按列表横向插值
+        void resample_prob(const SegAdditional &additional, const AxisTable &columns, const AxisTable &rows, SegResult &output)
+        {
+            int width = additional.roi.width;
+            thread_local vector<float> vertical;
+            vertical.resize(width);
+            output.prob.create(output.height, output.width, CV_32F);
+            for (int y = 0; y < output.height; ++y)
+            {
+                const float *p0 = additional.net_prob.ptr<float>(rows.index0[y]);
+                const float *p1 = additional.net_prob.ptr<float>(rows.index1[y]);
+                float wy = rows.weight[y];
+                SIMD::f32x4 vwy = SIMD::set1(wy);
+                int i = 0;
+                for (; i + SIMD::WIDTH <= width; i += SIMD::WIDTH)
+                {
+                    SIMD::f32x4 a = SIMD::load(p0 + i);
+                    SIMD::f32x4 b = SIMD::load(p1 + i);
+                    SIMD::store(vertical.data() + i, SIMD::add(a, SIMD::mul(SIMD::sub(b, a), vwy)));
+                }
+                for (; i < width; ++i)
+                    vertical[i] = p0[i] + (p1[i] - p0[i]) * wy;
+
+                float *pdst = output.prob.ptr<float>(y);
+                const float *pv = vertical.data();
+                for (int x = 0; x < output.width; ++x)
+                {
+                    float a = pv[columns.index0[x]];
+                    float b = pv[columns.index1[x]];
+                    pdst[x] = a + (b - a) * columns.weight[x];
+                }
+            }
+        }
+
+        /* 网络分辨率上每个出现的类别一次findContours，顶点映射回原图
+           只使用原图最近邻采样到的区域，roi外扩的一圈属于letterbox的填充，不参与
+        */
+        void find_polygons(const SegAdditional &additional, const AxisTable &columns, const AxisTable &rows, SegResult &output)
+        {
+            const cv::Mat &net_label = additional.net_label;
+            cv::Rect inner(columns.nearest.front(), rows.nearest.front(),
+                           columns.nearest.back() - columns.nearest.front() + 1, rows.nearest.back() - rows.nearest.front() + 1);
+
+            int histogram[256] = {0};
+            for (int y = inner.y; y < inner.y + inner.height; ++y)
+            {
+                const unsigned char *p = net_label.ptr<unsigned char>(y);
+                for (int x = inner.x; x < inner.x + inner.width; ++x)
+                    histogram[p[x]]++;
+            }
+
+            const cv::Rect &roi = additional.roi;
+            float area_scale = 1 / (additional.scale_x * additional.scale_y);
+            cv::Mat mask(net_label.rows, net_label.cols, CV_8U, cv::Scalar(0));
+            vector<vector<cv::Point>> contours;
+            vector<cv::Point> approx;
+            for (int label = 0; label < num_classes_; ++label)
+            {
+                if (histogram[label] == 0 || label == config_.background_label)
+                    continue;
+
+                for (int y = inner.y; y < inner.y + inner.height; ++y)
+                {
+                    const unsigned char *psrc = net_label.ptr<unsigned char>(y);
+                    unsigned char *pmask = mask.ptr<unsigned char>(y);
+                    for (int x = inner.x; x < inner.x + inner.width; ++x)
+                        pmask[x] = psrc[x] == label ? 255 : 0;
+                }
+
+                contours.clear();
+                cv::findContours(mask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+                for (auto &contour : contours)
+                {
+                    float area = cv::contourArea(contour);
+                    if (area < config_.min_polygon_area)
+                        continue;
+
+                    cv::approxPolyDP(contour, approx, config_.polygon_epsilon, true);
+                    Polygon polygon;
+                    polygon.label = label;
+                    polygon.area = area * area_scale;
+                    polygon.points.reserve(approx.size());
+                    for (auto &point : approx)
+                    {
+                        float x = (point.x + roi.x - additional.offset_x) / additional.scale_x;
+                        float y = (point.y + roi.y - additional.offset_y) / additional.scale_y;
+                        polygon.points.emplace_back(
+                            max(0, min((int)round(x), output.width - 1)),
+                            max(0, min((int)round(y), output.height - 1)));
+                    }
+                    output.polygons.emplace_back(std::move(polygon));
+                }
+            }
+        }
+
+        virtual bool preprocess(Job &job, const cv::Mat &image) override
+        {
+            if (tensor_allocator_ == nullptr)
+            {
+                INFOE("tensor_allocator_ is nullptr");
+                return false;
+            }
+
+            if (image.empty() || image.type() != CV_8UC3)
+            {
+                INFOE("Image must be a non-empty BGR image");
+                return false;
+            }
+
+            // 准入控制已经占用了tensor，见InferController::admit
+            if (job.mono_tensor == nullptr)
+                job.mono_tensor = tensor_allocator_->query();
+
+            if (job.mono_tensor == nullptr)
+            {
+                INFOE("Tensor allocator query failed.");
+                return false;
+            }
+
+            auto &tensor = job.mono_tensor->data();
+            if (tensor == nullptr)
+            {
+                // 只在主机上预处理，由worker拷贝到batch的输入
+                tensor = make_shared<TRT::Tensor>(TRT::DataType::Float, nullptr, CPU_DEVICE_ID);
+            }
+            tensor->resize(1, 3, input_height_, input_width_);
+
+            Yolo::AffineMatrix affine;
+            affine.compute(image.size(), cv::Size(input_width_, input_height_));
+
+            // 网络输入到网络输出的缩放，像素中心对齐
+            auto &additional = job.additional;
+            float ratio_x = output_width_ / (float)input_width_;
+            float ratio_y = output_height_ / (float)input_height_;
+            additional.width = image.cols;
+            additional.height = image.rows;
+            memcpy(additional.d2i, affine.d2i, sizeof(affine.d2i));
+            additional.scale_x = affine.i2d[0] * ratio_x;
+            additional.offset_x = (affine.i2d[2] + 0.5f) * ratio_x - 0.5f;
+            additional.scale_y = affine.i2d[4] * ratio_y;
+            additional.offset_y = (affine.i2d[5] + 0.5f) * ratio_y - 0.5f;
+
+            int left = max(0, (int)floor(additional.offset_x) - 1);
+            int top = max(0, (int)floor(additional.offset_y) - 1);
+            int right = min(output_width_, (int)ceil(additional.scale_x * (image.cols - 1) + additional.offset_x) + 2);
+            int bottom = min(output_height_, (int)ceil(additional.scale_y * (image.rows - 1) + additional.offset_y) + 2);
+            additional.roi = cv::Rect(left, top, max(1, right - left), max(1, bottom - top));
+
+            CPUKernel::warp_affine_bilinear_and_normalize_plane(
+                image.data, image.step, image.cols, image.rows,
+                tensor->cpu<float>(), input_width_, input_height_,
+                additional.d2i, 114, normalize_, 1);
+            return true;
+        }
+
+        virtual shared_future<SegResult> commit(const cv::Mat &image, const JobOptions &options) override
+        {
+            return ControllerImpl::commit(image, options);
+        }
+
+        virtual vector<shared_future<SegResult>> commits(const vector<cv::Mat> &images, const JobOptions &options) override
+        {
+            return ControllerImpl::commits(images, options);
+        }
+
+        virtual CommitStatus commit(const cv::Mat &image, const Infer::Callback &callback, const JobOptions &options, bool blocking) override
+        {
+            return ControllerImpl::commit(image, callback, options, blocking);
+        }
+
+        virtual void set_batching_policy(const BatchingPolicy &policy) override
+        {
+            ControllerImpl::set_batching_policy(policy);
+        }
+
+        virtual InferMetricsSnapshot metrics(bool reset) override
+        {
+            return ControllerImpl::get_metrics(reset);
+        }
+
+        virtual int num_classes() override
+        {
+            return num_classes_;
+        }
+
+        virtual SegConfig config() override
+        {
+            return config_;
+        }
+
+    private:
+        int input_width_ = 0;
+        int input_height_ = 0;
+        int output_width_ = 0;
+        int output_height_ = 0;
+        int num_classes_ = 0;
+        SegConfig config_;
+        CUDAKernel::Norm normalize_;
+    };
+
+    static shared_ptr<Infer> create(const TRT::EngineSource &param, const SegConfig &config)
+    {
+        if (config.output_polygons && (config.polygon_epsilon < 0 || config.min_polygon_area < 0))
+        {
+            INFOE("Invalid polygon_epsilon %f or min_polygon_area %f", config.polygon_epsilon, config.min_polygon_area);
+            return nullptr;
+        }
+
+        shared_ptr<InferImpl> instance(new InferImpl());
+        if (!instance->startup(param, config))
+        {
+            instance.reset();
+        }
+        return instance;
+    }
+
+    shared_ptr<Infer> create_infer(const string &engine_file, int gpuid, const SegConfig &config)
+    {
+        return create(TRT::EngineSource(engine_file, gpuid), config);
+    }
+
+    shared_ptr<Infer> create_cpu_infer(const TRT::CPUModelConfig &model, const SegConfig &config)
+    {
+        return create(TRT::EngineSource(model), config);
+    }
+}; // namespace Seg
@@ -0,0 +1,132 @@
+/**
+ * 语义分割
+ * 解决的问题：
+ * 4.3-unet-seg是单张图片的程序，后处理逐像素标量argmax，再对概率图和类别图各做一次原图大小的cv::warpAffine，
+ * 1080p时后处理比前向还慢，并且不能与检测一起以摄像头的帧率服务
+ *
+ * 设计思路：
+ * 1. 与检测相同的InferController，多路摄像头的帧凑成batch，letterbox的warp与归一化在CPU上用SIMD完成
+ * 2. 推理线程上只做网络输出分辨率的argmax与最大概率：SIMD一次比较4个像素，NCHW直接读4个像素，
+ *    NHWC每4个像素做一次4x4转置；letterbox填充的区域不参与计算
+ * 3. 后处理线程上把结果反变换到原图：letterbox的仿射只有缩放与平移，按列、按行各算一次采样表，
+ *    类别图按列的区间memset、相同的源行直接memcpy，概率图先在网络分辨率上纵向插值再横向插值，
+ *    替代两次原图大小的warpAffine
+ * 4. 可选原图类别图的行优先RLE(在反变换时顺带生成，不需要原图大小的类别图)与每个类别的多边形
+ *    (在网络分辨率上findContours，顶点映射回原图)
+ **/
+
+#ifndef SEG_HPP
+#define SEG_HPP
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <future>
+#include <functional>
+#include <opencv2/opencv.hpp>
+#include "../TrtLib/common/trt_tensor.hpp"
+#include "../TrtLib/common/batching_policy.hpp"
+#include "../TrtLib/common/pipeline_stage.hpp"
+#include "../TrtLib/common/job_scheduler.hpp"
+#include "../TrtLib/common/admission_control.hpp"
+#include "../TrtLib/common/infer_metrics.hpp"
+#include "../TrtLib/infer/trt_infer.hpp"
+
+namespace Seg
+{
+    using namespace std;
+
+    enum class OutputLayout : int
+    {
+        NHWC = 0, // [n, h, w, num_classes]，4.3-unet-seg导出的模型
+        NCHW = 1  // [n, num_classes, h, w]
+    };
+
+    // 类别图行优先的一段连续像素，可以跨行，所有count的和为width * height
+    struct LabelRun
+    {
+        int label = 0;
+        int count = 0;
+
+        LabelRun() = default;
+        LabelRun(int label, int count) : label(label), count(count) {}
+    };
+
+    // 一个类别的一个连通区域的外轮廓，原图坐标
+    struct Polygon
+    {
+        int label = 0;
+        float area = 0; // 原图的像素面积
+        vector<cv::Point> points;
+    };
+
+    struct SegResult
+    {
+        int width = 0; // 原图大小
+        int height = 0;
+        cv::Mat label;            // CV_8U，原图大小，output_label为false时为空
+        cv::Mat prob;             // CV_32F，原图大小，output_prob为true时
+        vector<LabelRun> runs;    // output_runs为true时
+        vector<Polygon> polygons; // output_polygons为true时
+    };
+
+    struct SegConfig
+    {
+        OutputLayout layout = OutputLayout::NHWC;
+        bool apply_softmax = false; // 模型输出logits时为true，4.3的unet输出已经是softmax之后的概率
+
+        bool output_label = true;
+        bool output_prob = false;
+        bool output_runs = false;
+        bool output_polygons = false;
+
+        int background_label = 0;      // 不输出多边形的类别，-1时所有类别都输出
+        float polygon_epsilon = 1.0f;  // approxPolyDP的精度，网络输出的像素
+        float min_polygon_area = 4.0f; // 面积小于它的区域不输出，网络输出的像素
+
+        // 默认与4.3相同：除以255，BGR转RGB
+        float mean[3] = {0, 0, 0};
+        float std[3] = {1, 1, 1};
+        bool bgr_to_rgb = true;
+
+        PipelineConfig pipeline;
+    };
+
+    /* count个像素的最大类别与最大概率，label为uint8，num_classes不超过256
+       NCHW：values指向第0类的plane，plane之间相隔plane_stride个float，像素连续
+       NHWC：每个像素num_classes个值连续，plane_stride不使用
+       softmax为true时prob为softmax之后的最大值，否则为原始的最大值；prob为nullptr时只计算类别
+       相等时取下标小的类别，与std::max_element相同
+    */
+    void cpu_argmax(const float *values, int count, int num_classes, OutputLayout layout, int plane_stride,
+                    bool softmax, float *prob, unsigned char *label);
+
+    // RLE还原为CV_8U的类别图
+    cv::Mat decode_runs(const vector<LabelRun> &runs, int width, int height);
+
+    class Infer
+    {
+    public:
+        virtual shared_future<SegResult> commit(const cv::Mat &image, const JobOptions &options = JobOptions()) = 0;
+        virtual vector<shared_future<SegResult>> commits(const vector<cv::Mat> &images, const JobOptions &options = JobOptions()) = 0;
+
+        // 回调形式的提交，被拒绝时同步回调，结果为空；回调返回后结果被回收，需要保留时move出去
+        typedef function<void(SegResult &result)> Callback;
+        virtual CommitStatus commit(const cv::Mat &image, const Callback &callback, const JobOptions &options = JobOptions(), bool blocking = true) = 0;
+
+        virtual void set_batching_policy(const BatchingPolicy &policy) = 0;
+        virtual InferMetricsSnapshot metrics(bool reset = false) = 0;
+
+        virtual int num_classes() = 0;
+        virtual SegConfig config() = 0;
+    };
+
+    // 输入为[batch, 3, h, w]，输出按config.layout，按第0个输入输出绑定
+    shared_ptr<Infer> create_infer(const string &engine_file, int gpuid, const SegConfig &config = SegConfig());
+
+    // CPU后端，用于在没有GPU的机器上验证和压测
+    shared_ptr<Infer> create_cpu_infer(const TRT::CPUModelConfig &model, const SegConfig &config = SegConfig());
+
+}; // namespace Seg
+
+#endif // SEG_HPP
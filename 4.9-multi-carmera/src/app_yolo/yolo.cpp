@@ -2,12 +2,15 @@
 #include <atomic>
 #include <mutex>
 #include <queue>
+#include <thread>
 #include <condition_variable>
 #include "TrtLib/infer/trt_infer.hpp"
 #include "TrtLib/common/ilogger.hpp"
 #include "TrtLib/common/infer_controller.hpp"
 #include "TrtLib/common/preprocess_kernel.cuh"
+#include "TrtLib/common/preprocess_cpu.hpp"
 #include "TrtLib/common/monopoly_allocator.hpp"
+#include "TrtLib/common/staging_pipeline.hpp"
 #include "TrtLib/common/cuda_tools.cuh"
 
 namespace Yolo
@@ -28,6 +31,27 @@ namespace Yolo
         }
     }
 
+    const char *nms_method_name(NMSMethod method)
+    {
+        switch (method)
+        {
+        case NMSMethod::CPU:
+            return "CPU";
+        case NMSMethod::FastGPU:
+            return "FastGPU";
+        case NMSMethod::SoftLinear:
+            return "SoftLinear";
+        case NMSMethod::SoftGaussian:
+            return "SoftGaussian";
+        case NMSMethod::DIoU:
+            return "DIoU";
+        case NMSMethod::ClassAgnostic:
+            return "ClassAgnostic";
+        default:
+            return "Unknow";
+        }
+    }
+
     void decode_kernel_invoker(
         float *predict, int num_bboxes, int num_classes, float confidence_threshold,
         float *invert_affine_matrix, float *parray,
@@ -36,80 +60,6 @@ namespace Yolo
     void nms_kernel_invoker(
         float *parray, float nms_threshold, int max_objects, cudaStream_t stream);
 
-    struct AffineMatrix
-    {
-        float i2d[6]; // image to dst(network), 2x3 matrix
-        float d2i[6]; // dst to image, 2x3 matrix
-
-        void compute(const cv::Size &from, const cv::Size &to)
-        {
-            float scale_x = to.width / (float)from.width;
-            float scale_y = to.height / (float)from.height;
-
-            // 这里取min的理由是
-            // 1. M矩阵是 from * M = to的方式进行映射，因此scale的分母一定是from
-            // 2. 取最小，即根据宽高比，算出最小的比例，如果取最大，则势必有一部分超出图像范围而被裁剪掉，这不是我们要的
-            // **
-            float scale = std::min(scale_x, scale_y);
-
-            /**
-            这里的仿射变换矩阵实质上是2x3的矩阵，具体实现是
-            scale, 0, -scale * from.width * 0.5 + to.width * 0.5
-            0, scale, -scale * from.height * 0.5 + to.height * 0.5
-
-            这里可以想象成，是经历过缩放、平移、平移三次变换后的组合，M = TPS
-            例如第一个S矩阵，定义为把输入的from图像，等比缩放scale倍，到to尺度下
-            S = [
-            scale,     0,      0
-            0,     scale,      0
-            0,         0,      1
-            ]
-
-            P矩阵定义为第一次平移变换矩阵，将图像的原点，从左上角，移动到缩放(scale)后图像的中心上
-            P = [
-            1,        0,      -scale * from.width * 0.5
-            0,        1,      -scale * from.height * 0.5
-            0,        0,                1
-            ]
-
-            T矩阵定义为第二次平移变换矩阵，将图像从原点移动到目标（to）图的中心上
-            T = [
-            1,        0,      to.width * 0.5,
-            0,        1,      to.height * 0.5,
-            0,        0,            1
-            ]
-
-            通过将3个矩阵顺序乘起来，即可得到下面的表达式：
-            M = [
-            scale,    0,     -scale * from.width * 0.5 + to.width * 0.5
-            0,     scale,    -scale * from.height * 0.5 + to.height * 0.5
-            0,        0,                     1
-            ]
-            去掉第三行就得到opencv需要的输入2x3矩阵
-            **/
-
-            /*
-                 + scale * 0.5 - 0.5 的主要原因是使得中心更加对齐，下采样不明显，但是上采样时就比较明显
-                参考：https://www.iteye.com/blog/handspeaker-1545126
-            */
-            i2d[0] = scale;
-            i2d[1] = 0;
-            i2d[2] = -scale * from.width * 0.5 + to.width * 0.5 + scale * 0.5 - 0.5;
-            i2d[3] = 0;
-            i2d[4] = scale;
-            i2d[5] = -scale * from.height * 0.5 + to.height * 0.5 + scale * 0.5 - 0.5;
-
-            cv::Mat m2x3_i2d(2, 3, CV_32F, i2d);
-            cv::Mat m2x3_d2i(2, 3, CV_32F, d2i);
-            cv::invertAffineTransform(m2x3_i2d, m2x3_d2i);
-        }
-
-        cv::Mat i2d_mat()
-        {
-            return cv::Mat(2, 3, CV_32F, i2d);
-        }
-    };
-
     static float iou(const Box &a, const Box &b)
     {
         float cleft = max(a.left, b.left);
@@ -126,7 +76,7 @@ namespace Yolo
         return c_area / (a_area + b_area - c_area);
     }
 
-    static BoxArray cpu_nms(BoxArray &boxes, float threshold)
+    BoxArray cpu_nms(BoxArray &boxes, float threshold)
     {
 
         std::sort(boxes.begin(), boxes.end(), [](BoxArray::const_reference a, BoxArray::const_reference b)
@@ -161,12 +111,209 @@ namespace Yolo
         return output;
     }
 
+    void cpu_nms_inplace(BoxArray &boxes, float threshold)
+    {
+        std::sort(boxes.begin(), boxes.end(), [](BoxArray::const_reference a, BoxArray::const_reference b)
+                  { return a.confidence > b.confidence; });
+
+        // 与cpu_nms等价：一个框被抑制当且仅当它与某个已保留的、置信度更高的同类框重叠
+        // 保留的框压缩到数组前部，不需要额外的输出数组和标记数组
+        int num_keep = 0;
+        for (int i = 0; i < (int)boxes.size(); ++i)
+        {
+            auto &b = boxes[i];
+            bool keep = true;
+            for (int j = 0; j < num_keep; ++j)
+            {
+                auto &a = boxes[j];
+                if (a.class_label == b.class_label && iou(a, b) >= threshold)
+                {
+                    keep = false;
+                    break;
+                }
+            }
+
+            if (keep)
+                boxes[num_keep++] = b;
+        }
+        boxes.resize(num_keep);
+    }
+
     using ControllerImpl = InferController<
-        Mat,                // input
-        BoxArray,           // output
-        tuple<string, int>, // start param
-        AffineMatrix        // additional
+        InferInput,        // input
+        BoxArray,          // output
+        TRT::EngineSource, // start param
+        AffineMatrix       // additional
         >;
+
+    // cv::Mat视为主机内存中的BGR帧，不拷贝数据
+    static ExternalFrame mat_frame(const Mat &image)
+    {
+        ExternalFrame frame;
+        frame.data = image.data;
+        frame.width = image.cols;
+        frame.height = image.rows;
+        frame.stride = image.step;
+        return frame;
+    }
+
+    static bool check_frame(const ExternalFrame &frame)
+    {
+        int min_line_size = frame.format == PixelFormat::NV12 ? (frame.width + 1) / 2 * 2 : frame.width * 3;
+        if (frame.line_size() < min_line_size)
+        {
+            INFOE("Frame stride %d is less than %d (%s, width %d)", frame.line_size(), min_line_size, pixel_format_name(frame.format), frame.width);
+            return false;
+        }
+        return true;
+    }
+
+    // normalize按BGR的输入设置，RGB的输入通道交换相反
+    static CUDAKernel::Norm format_norm(CUDAKernel::Norm norm, PixelFormat format)
+    {
+        if (format == PixelFormat::RGB)
+            norm.channel_type = norm.channel_type == CUDAKernel::ChannelType::Invert ? CUDAKernel::ChannelType::None : CUDAKernel::ChannelType::Invert;
+        return norm;
+    }
+
+    // 按行拷贝，dst每行width_bytes字节连续存放
+    static void copy_rows(uint8_t *dst, const uint8_t *src, int src_line_size, int width_bytes, int rows)
+    {
+        if (src_line_size == width_bytes)
+        {
+            memcpy(dst, src, (size_t)width_bytes * rows);
+            return;
+        }
+
+        for (int i = 0; i < rows; ++i)
+            memcpy(dst + (size_t)i * width_bytes, src + (size_t)i * src_line_size, width_bytes);
+    }
+
+    // 推理线程的一组输入输出缓冲，两组交替使用，见staging_pipeline.hpp
+    struct StagingBuffers
+    {
+        enum Event : int
+        {
+            Preprocessed = 0, // 预处理stream上的位置，上传stream等待它
+            UploadBegin,
+            Uploaded,
+            ForwardBegin,
+            DecodeBegin,
+            Done, // 读回结束
+            NumEvents
+        };
+
+        shared_ptr<TRT::Tensor> input;
+        shared_ptr<TRT::Tensor> output;
+        shared_ptr<TRT::Tensor> affine_matrix;
+        shared_ptr<TRT::Tensor> output_array;
+        cudaEvent_t events[NumEvents];
+    };
+    typedef StagingPipeline<ControllerImpl::Job, StagingBuffers>::Slot StagingSlot;
+
+    /* CPU后端用一个后台线程模拟cuda stream：任务按提交顺序执行，enqueue返回的序号相当于event
+       wait(sequence)相当于cudaEventSynchronize，在另一个stream的任务里调用相当于cudaStreamWaitEvent
+    */
+    class CPUStream
+    {
+    public:
+        CPUStream() { worker_ = thread(&CPUStream::worker, this); }
+
+        ~CPUStream()
+        {
+            {
+                unique_lock<mutex> l(lock_);
+                running_ = false;
+            }
+            cond_.notify_all();
+            worker_.join();
+        }
+
+        long long enqueue(const function<void()> &task)
+        {
+            unique_lock<mutex> l(lock_);
+            tasks_.push_back(task);
+            cond_.notify_all();
+            return ++num_enqueued_;
+        }
+
+        void wait(long long sequence)
+        {
+            unique_lock<mutex> l(lock_);
+            cond_.wait(l, [&]()
+                       { return num_finished_ >= sequence; });
+        }
+
+    private:
+        void worker()
+        {
+            while (true)
+            {
+                function<void()> task;
+                {
+                    unique_lock<mutex> l(lock_);
+                    cond_.wait(l, [&]()
+                               { return !running_ || head_ < tasks_.size(); });
+                    if (head_ == tasks_.size())
+                        break;
+                    task = std::move(tasks_[head_]);
+                    if (++head_ == tasks_.size())
+                    {
+                        // 取空后保留容量，稳态下enqueue不分配内存
+                        tasks_.clear();
+                        head_ = 0;
+                    }
+                }
+
+                task();
+                {
+                    unique_lock<mutex> l(lock_);
+                    num_finished_++;
+                }
+                cond_.notify_all();
+            }
+        }
+
+    private:
+        mutex lock_;
+        condition_variable cond_;
+        vector<function<void()>> tasks_;
+        size_t head_ = 0;
+        long long num_enqueued_ = 0;
+        long long num_finished_ = 0;
+        bool running_ = true;
+        thread worker_;
+    };
+
+    // CPU后端的一组输入输出缓冲，与StagingBuffers对应，event换成CPUStream的序号，耗时用墙上时间
+    struct CPUStagingBuffers
+    {
+        TRT::Infer *engine = nullptr;
+        CPUStream *upload_stream = nullptr;
+        int num_classes = 0;
+        shared_ptr<TRT::Tensor> input;
+        shared_ptr<TRT::Tensor> output;
+        long long uploaded = 0;
+        long long done = 0;
+        long long upload_begin_us = 0;
+        long long upload_end_us = 0;
+        long long forward_begin_us = 0;
+        long long decode_begin_us = 0;
+        long long decode_end_us = 0;
+    };
+    typedef StagingPipeline<ControllerImpl::Job, CPUStagingBuffers>::Slot CPUStagingSlot;
+
+    static int binding_index(const shared_ptr<TRT::Infer> &engine, const string &name, bool is_input)
+    {
+        int num = is_input ? engine->num_input() : engine->num_output();
+        for (int i = 0; i < num; ++i)
+        {
+            if ((is_input ? engine->get_input_name(i) : engine->get_output_name(i)) == name)
+                return i;
+        }
+        return 0;
+    }
+
     class InferImpl : public Infer, public ControllerImpl
     {
     public:
@@ -174,13 +321,21 @@ namespace Yolo
         virtual ~InferImpl()
         {
             stop();
+
+            // 被丢弃的job在stop中等待预处理stream，所以共用的stream在stop之后才销毁
+            if (preprocess_stream_ != nullptr)
+            {
+                CUDATools::AutoDevice auto_device(gpu_);
+                checkCudaRuntime(cudaStreamDestroy(preprocess_stream_));
+                preprocess_stream_ = nullptr;
+            }
         }
 
         virtual bool startup(
-            const string &file, Type type, int gpuid,
+            const TRT::EngineSource &source, Type type,
             float confidence_threshold, float nms_threshold,
             NMSMethod nms_method, int max_objects,
-            bool use_multi_preprocess_stream)
+            bool use_multi_preprocess_stream, const PipelineConfig &pipeline)
         {
             if (type == Type::V5)
             {
@@ -202,15 +357,25 @@ namespace Yolo
             confidence_threshold_ = confidence_threshold;
             nms_threshold_ = nms_threshold;
             nms_method_ = nms_method;
+            if (source.backend == TRT::Backend::CPU && nms_method == NMSMethod::FastGPU)
+                nms_method_ = NMSMethod::CPU;
+
             max_objects_ = max_objects;
-            return ControllerImpl::startup(make_tuple(file, gpuid));
+            return ControllerImpl::startup(source, pipeline);
         }
 
         virtual void worker(promise<bool> &result) override
         {
+            if (cpu_backend())
+                cpu_worker(result);
+            else
+                gpu_worker(result);
+        }
 
-            string file = get<0>(start_param_);
-            int gpuid = get<1>(start_param_);
+        void gpu_worker(promise<bool> &result)
+        {
+            const string &file = start_param_.file;
+            int gpuid = start_param_.gpuid;
 
             TRT::set_device(gpuid);
             auto engine = TRT::load_infer(file);
@@ -225,63 +390,109 @@ namespace Yolo
 
             const int MAX_IMAGE_BBOX = max_objects_;
             const int NUM_BOX_ELEMENT = 7; // left, top, right, bottom, confidence, class, keepflag
-            TRT::Tensor affin_matrix_device(TRT::DataType::Float);
-            TRT::Tensor output_array_device(TRT::DataType::Float);
             int max_batch_size = engine->get_max_batch_size();
             auto input = engine->tensor("images");
             auto output = engine->tensor("output");
             int num_classes = output->size(2) - 5;
+            int input_index = binding_index(engine, "images", true);
+            int output_index = binding_index(engine, "output", false);
 
             input_width_ = input->size(3);
             input_height_ = input->size(2);
-            tensor_allocator_ = make_shared<MonopolyAllocator<TRT::Tensor>>(max_batch_size * 2);
             stream_ = engine->get_stream();
             gpu_ = gpuid;
-            result.set_value(true);
 
-            input->resize_single_dim(0, max_batch_size).to_gpu();
-            affin_matrix_device.set_stream(stream_);
+            // 预处理与装配各用一个stream，装配时只需要等待预处理完成，不会被在途batch的前向阻塞
+            if (!use_multi_preprocess_stream_)
+                checkCudaRuntime(cudaStreamCreate(&preprocess_stream_));
 
-            // 这里8个值的目的是保证 8 * sizeof(float) % 32 == 0
-            affin_matrix_device.resize(max_batch_size, 8).to_gpu();
+            TRT::CUStream upload_stream = nullptr;
+            checkCudaRuntime(cudaStreamCreate(&upload_stream));
 
-            // 这里的 1 + MAX_IMAGE_BBOX结构是，counter + bboxes ...
-            output_array_device.resize(max_batch_size, 1 + MAX_IMAGE_BBOX * NUM_BOX_ELEMENT).to_gpu();
+            // 两组缓冲交替使用，见staging_pipeline.hpp
+            StagingPipeline<Job, StagingBuffers> staging(pipeline_config_.num_staging_buffers);
+            for (int i = 0; i < staging.num_slots(); ++i)
+            {
+                auto &buffers = staging.slot(i).buffers;
+                buffers.input = make_shared<TRT::Tensor>(input->dims(), input->type());
+                buffers.input->set_stream(upload_stream);
+                buffers.input->resize_single_dim(0, max_batch_size).to_gpu();
+
+                buffers.output = make_shared<TRT::Tensor>(output->dims(), output->type());
+                buffers.output->set_stream(stream_);
+                buffers.output->resize_single_dim(0, max_batch_size).to_gpu();
+
+                // 这里8个值的目的是保证 8 * sizeof(float) % 32 == 0
+                buffers.affine_matrix = make_shared<TRT::Tensor>(TRT::DataType::Float);
+                buffers.affine_matrix->set_stream(upload_stream);
+                buffers.affine_matrix->resize(max_batch_size, 8).to_gpu();
+
+                // 这里的 1 + MAX_IMAGE_BBOX结构是，counter + bboxes ...
+                buffers.output_array = make_shared<TRT::Tensor>(TRT::DataType::Float);
+                buffers.output_array->set_stream(stream_);
+                buffers.output_array->resize(max_batch_size, 1 + MAX_IMAGE_BBOX * NUM_BOX_ELEMENT).to_gpu();
+                buffers.output_array->get_data()->cpu(buffers.output_array->bytes());
+
+                for (auto &event : buffers.events)
+                    checkCudaRuntime(cudaEventCreate(&event));
+            }
+
+            // 每个slot持有一个batch的mono tensor，直到batch完成才释放，在此基础上常驻2倍batch，突发时最多扩到4倍batch
+            int num_staging = staging.num_slots();
+            tensor_allocator_ = make_shared<MonopolyAllocator<TRT::Tensor>>(max_batch_size * (1 + num_staging), max_batch_size * (3 + num_staging));
+            result.set_value(true);
 
-            vector<Job> fetch_jobs;
-            while (get_jobs_and_wait(fetch_jobs, max_batch_size))
+            auto fetch = [&](vector<Job> &jobs, bool blocking)
             {
+                return blocking ? get_jobs_and_wait(jobs, max_batch_size) : try_get_jobs(jobs, max_batch_size);
+            };
 
-                int infer_batch_size = fetch_jobs.size();
-                input->resize_single_dim(0, infer_batch_size);
+            // 在上传stream上把mono tensor和仿射矩阵拷贝到slot的输入，与在途batch的前向重叠
+            auto assemble = [&](StagingSlot &slot)
+            {
+                auto &buffers = slot.buffers;
+                int infer_batch_size = slot.jobs.size();
+                buffers.input->resize_single_dim(0, infer_batch_size);
 
+                checkCudaRuntime(cudaEventRecord(buffers.events[StagingBuffers::UploadBegin], upload_stream));
+                TRT::CUStream waited_stream = nullptr;
                 for (int ibatch = 0; ibatch < infer_batch_size; ++ibatch)
                 {
-                    auto &job = fetch_jobs[ibatch];
+                    auto &job = slot.jobs[ibatch];
                     auto &mono = job.mono_tensor->data();
-
-                    if (mono->get_stream() != stream_)
+                    if (mono->get_stream() != waited_stream)
                     {
-                        // synchronize preprocess stream finish
-                        checkCudaRuntime(cudaStreamSynchronize(mono->get_stream()));
+                        // 等待预处理完成，event可以复用，cudaStreamWaitEvent只看调用时最近一次的record
+                        waited_stream = mono->get_stream();
+                        checkCudaRuntime(cudaEventRecord(buffers.events[StagingBuffers::Preprocessed], waited_stream));
+                        checkCudaRuntime(cudaStreamWaitEvent(upload_stream, buffers.events[StagingBuffers::Preprocessed], 0));
                     }
 
-                    affin_matrix_device.copy_from_gpu(affin_matrix_device.offset(ibatch), mono->get_workspace()->gpu(), 6);
-                    input->copy_from_gpu(input->offset(ibatch), mono->gpu(), mono->count());
-                    job.mono_tensor->release();
+                    buffers.affine_matrix->copy_from_gpu(buffers.affine_matrix->offset(ibatch), mono->get_workspace()->gpu(), 6);
+                    buffers.input->copy_from_gpu(buffers.input->offset(ibatch), mono->gpu(), mono->count());
                 }
+                checkCudaRuntime(cudaEventRecord(buffers.events[StagingBuffers::Uploaded], upload_stream));
+            };
 
+            // 在推理stream上等待装配完成后前向、解码并异步读回，不等待完成
+            auto launch = [&](StagingSlot &slot)
+            {
+                auto &buffers = slot.buffers;
+                int infer_batch_size = slot.jobs.size();
+                checkCudaRuntime(cudaStreamWaitEvent(stream_, buffers.events[StagingBuffers::Uploaded], 0));
+                checkCudaRuntime(cudaEventRecord(buffers.events[StagingBuffers::ForwardBegin], stream_));
+                engine->set_input(input_index, buffers.input);
+                engine->set_output(output_index, buffers.output);
                 engine->forward(false);
-                output_array_device.to_gpu(false);
+
+                checkCudaRuntime(cudaEventRecord(buffers.events[StagingBuffers::DecodeBegin], stream_));
                 for (int ibatch = 0; ibatch < infer_batch_size; ++ibatch)
                 {
-
-                    auto &job = fetch_jobs[ibatch];
-                    float *image_based_output = output->gpu<float>(ibatch);
-                    float *output_array_ptr = output_array_device.gpu<float>(ibatch);
-                    auto affine_matrix = affin_matrix_device.gpu<float>(ibatch);
+                    float *image_based_output = buffers.output->gpu<float>(ibatch);
+                    float *output_array_ptr = buffers.output_array->gpu<float>(ibatch);
+                    auto affine_matrix = buffers.affine_matrix->gpu<float>(ibatch);
                     checkCudaRuntime(cudaMemsetAsync(output_array_ptr, 0, sizeof(int), stream_));
-                    decode_kernel_invoker(image_based_output, output->size(1), num_classes, confidence_threshold_, affine_matrix, output_array_ptr, MAX_IMAGE_BBOX, stream_);
+                    decode_kernel_invoker(image_based_output, buffers.output->size(1), num_classes, confidence_threshold_, affine_matrix, output_array_ptr, MAX_IMAGE_BBOX, stream_);
 
                     if (nms_method_ == NMSMethod::FastGPU)
                     {
@@ -289,12 +500,39 @@ namespace Yolo
                     }
                 }
 
-                output_array_device.to_cpu();
+                // Tensor::to_cpu会同步stream，这里直接异步拷贝到固定内存，complete时再读取
+                auto memory = buffers.output_array->get_data();
+                size_t bytes = buffers.output_array->count(1) * sizeof(float) * infer_batch_size;
+                checkCudaRuntime(cudaMemcpyAsync(memory->cpu(), memory->gpu(), bytes, cudaMemcpyDeviceToHost, stream_));
+                checkCudaRuntime(cudaEventRecord(buffers.events[StagingBuffers::Done], stream_));
+            };
+
+            auto complete = [&](StagingSlot &slot)
+            {
+                auto &buffers = slot.buffers;
+                int infer_batch_size = slot.jobs.size();
+                checkCudaRuntime(cudaEventSynchronize(buffers.events[StagingBuffers::Done]));
+
+                // 上传、前向、解码是异步的，用event测量在stream上的耗时
+                const MetricStage stages[] = {MetricStage::Upload, MetricStage::Forward, MetricStage::Decode};
+                const int ranges[][2] = {
+                    {StagingBuffers::UploadBegin, StagingBuffers::Uploaded},
+                    {StagingBuffers::ForwardBegin, StagingBuffers::DecodeBegin},
+                    {StagingBuffers::DecodeBegin, StagingBuffers::Done}};
+                for (int i = 0; i < 3; ++i)
+                {
+                    float elapsed_ms = 0;
+                    checkCudaRuntime(cudaEventElapsedTime(&elapsed_ms, buffers.events[ranges[i][0]], buffers.events[ranges[i][1]]));
+                    record_stage(stages[i], (long long)(elapsed_ms * 1000));
+                }
+
+                float *output_array_host = (float *)buffers.output_array->get_data()->cpu();
+                int stride = buffers.output_array->count(1);
                 for (int ibatch = 0; ibatch < infer_batch_size; ++ibatch)
                 {
-                    float *parray = output_array_device.cpu<float>(ibatch);
+                    float *parray = output_array_host + ibatch * stride;
                     int count = min(MAX_IMAGE_BBOX, (int)*parray);
-                    auto &job = fetch_jobs[ibatch];
+                    auto &job = slot.jobs[ibatch];
                     auto &image_based_boxes = job.output;
                     for (int i = 0; i < count; ++i)
                     {
@@ -307,20 +545,151 @@ namespace Yolo
                         }
                     }
 
-                    if (nms_method_ == NMSMethod::CPU)
-                    {
-                        image_based_boxes = cpu_nms(image_based_boxes, nms_threshold_);
-                    }
-                    job.pro->set_value(image_based_boxes);
+                    // 上传已经完成，mono tensor可以交给下一个job，外部的帧也不再被读取
+                    job.mono_tensor->release();
+                    job.input = InferInput();
+                    finish_job(job);
                 }
-                fetch_jobs.clear();
+            };
+
+            staging.run(fetch, assemble, launch, complete);
+
+            for (int i = 0; i < staging.num_slots(); ++i)
+            {
+                for (auto &event : staging.slot(i).buffers.events)
+                    checkCudaRuntime(cudaEventDestroy(event));
             }
+            checkCudaRuntime(cudaStreamDestroy(upload_stream));
             stream_ = nullptr;
-            tensor_allocator_.reset();
             INFO("Engine destroy.");
         }
 
-        virtual bool preprocess(Job &job, const Mat &image) override
+        // 与gpu_worker的流水线相同，上传与推理各用一个模拟的stream
+        void cpu_worker(promise<bool> &result)
+        {
+            auto engine = TRT::load_cpu_infer(start_param_.model);
+            if (engine == nullptr)
+            {
+                INFOE("CPU engine load failed");
+                result.set_value(false);
+                return;
+            }
+
+            engine->print();
+
+            int max_batch_size = engine->get_max_batch_size();
+            auto input = engine->tensor("images");
+            auto output = engine->tensor("output");
+            int num_classes = output->size(2) - 5;
+
+            input_width_ = input->size(3);
+            input_height_ = input->size(2);
+
+            CPUStream upload_stream;
+            CPUStream compute_stream;
+            StagingPipeline<Job, CPUStagingBuffers> staging(pipeline_config_.num_staging_buffers);
+            for (int i = 0; i < staging.num_slots(); ++i)
+            {
+                auto &buffers = staging.slot(i).buffers;
+                buffers.engine = engine.get();
+                buffers.upload_stream = &upload_stream;
+                buffers.num_classes = num_classes;
+                buffers.input = make_shared<TRT::Tensor>(input->dims(), input->type(), nullptr, CPU_DEVICE_ID);
+                buffers.input->resize_single_dim(0, max_batch_size).to_cpu();
+                buffers.output = make_shared<TRT::Tensor>(output->dims(), output->type(), nullptr, CPU_DEVICE_ID);
+                buffers.output->resize_single_dim(0, max_batch_size).to_cpu();
+            }
+
+            int num_staging = staging.num_slots();
+            tensor_allocator_ = make_shared<MonopolyAllocator<TRT::Tensor>>(max_batch_size * (1 + num_staging), max_batch_size * (3 + num_staging));
+            result.set_value(true);
+
+            auto fetch = [&](vector<Job> &jobs, bool blocking)
+            {
+                return blocking ? get_jobs_and_wait(jobs, max_batch_size) : try_get_jobs(jobs, max_batch_size);
+            };
+
+            // 任务只捕获this和slot，不超过std::function的内联存储，稳态下不分配内存
+            auto assemble = [&](CPUStagingSlot &slot)
+            {
+                slot.buffers.input->resize_single_dim(0, slot.jobs.size());
+                slot.buffers.uploaded = upload_stream.enqueue([this, &slot]()
+                                                              { cpu_upload(slot); });
+            };
+
+            auto launch = [&](CPUStagingSlot &slot)
+            {
+                slot.buffers.done = compute_stream.enqueue([this, &slot]()
+                                                           { cpu_forward_and_decode(slot); });
+            };
+
+            // 校验顺序：slot必须按提交的顺序完成
+            long long expected_sequence = 0;
+            auto complete = [&](CPUStagingSlot &slot)
+            {
+                auto &buffers = slot.buffers;
+                compute_stream.wait(buffers.done);
+                if (slot.sequence != expected_sequence)
+                    INFOE("Staging slot %d completed out of order, sequence %lld, expected %lld", slot.index, slot.sequence, expected_sequence);
+                expected_sequence = slot.sequence + 1;
+
+                record_stage(MetricStage::Upload, buffers.upload_end_us - buffers.upload_begin_us);
+                record_stage(MetricStage::Forward, buffers.decode_begin_us - buffers.forward_begin_us);
+                record_stage(MetricStage::Decode, buffers.decode_end_us - buffers.decode_begin_us);
+                for (auto &job : slot.jobs)
+                {
+                    job.mono_tensor->release();
+                    finish_job(job);
+                }
+            };
+
+            staging.run(fetch, assemble, launch, complete);
+            INFO("Engine destroy.");
+        }
+
+        // 在上传stream上执行
+        void cpu_upload(CPUStagingSlot &slot)
+        {
+            auto &buffers = slot.buffers;
+            buffers.upload_begin_us = StageStatistics::now_us();
+            for (int ibatch = 0; ibatch < (int)slot.jobs.size(); ++ibatch)
+            {
+                auto &mono = slot.jobs[ibatch].mono_tensor->data();
+                buffers.input->copy_from_cpu(buffers.input->offset(ibatch), mono->cpu(), mono->count());
+            }
+            buffers.upload_end_us = StageStatistics::now_us();
+        }
+
+        // 在推理stream上执行，先等待上传完成
+        void cpu_forward_and_decode(CPUStagingSlot &slot)
+        {
+            auto &buffers = slot.buffers;
+            buffers.upload_stream->wait(buffers.uploaded);
+            buffers.forward_begin_us = StageStatistics::now_us();
+            buffers.engine->set_input(0, buffers.input);
+            buffers.engine->set_output(0, buffers.output);
+            buffers.engine->forward(false);
+
+            buffers.decode_begin_us = StageStatistics::now_us();
+            for (int ibatch = 0; ibatch < (int)slot.jobs.size(); ++ibatch)
+            {
+                auto &job = slot.jobs[ibatch];
+                cpu_decode(buffers.output->cpu<float>(ibatch), buffers.output->size(1), buffers.num_classes, confidence_threshold_,
+                           job.additional.d2i, job.output, max_objects_, 0);
+            }
+            buffers.decode_end_us = StageStatistics::now_us();
+        }
+
+        virtual void postprocess(Job &job) override
+        {
+            // FastGPU已经在解码后完成，其余方法在CPU上做
+            if (nms_method_ != NMSMethod::FastGPU)
+            {
+                cpu_nms_method(job.output, nms_method_, nms_threshold_, confidence_threshold_);
+            }
+        }
+
+        virtual bool preprocess(Job &job, const InferInput &input) override
         {
 
             if (tensor_allocator_ == nullptr)
@@ -329,19 +698,39 @@ namespace Yolo
                 return false;
             }
 
-            if (image.empty())
+            ExternalFrame image_frame;
+            if (input.frame == nullptr)
+                image_frame = mat_frame(input.image);
+
+            const ExternalFrame &frame = input.frame ? *input.frame : image_frame;
+            if (frame.empty())
             {
                 INFOE("Image is empty");
                 return false;
             }
 
-            job.mono_tensor = tensor_allocator_->query();
+            if (!check_frame(frame))
+                return false;
+
+            if (cpu_backend() && frame.location == MemoryLocation::Device)
+            {
+                INFOE("CPU backend does not support device frames");
+                return false;
+            }
+
+            // 准入控制已经占用了tensor，见InferController::admit
+            if (job.mono_tensor == nullptr)
+                job.mono_tensor = tensor_allocator_->query();
+
             if (job.mono_tensor == nullptr)
             {
                 INFOE("Tensor allocator query failed.");
                 return false;
             }
 
+            if (cpu_backend())
+                return cpu_backend_preprocess(job, frame);
+
             CUDATools::AutoDevice auto_device(gpu_);
             auto &tensor = job.mono_tensor->data();
             TRT::CUStream preprocess_stream = nullptr;
@@ -361,7 +750,7 @@ namespace Yolo
                 }
                 else
                 {
-                    preprocess_stream = stream_;
+                    preprocess_stream = preprocess_stream_;
 
                     // owner = false, tensor ignored the stream
                     tensor->set_stream(preprocess_stream, false);
@@ -369,40 +758,169 @@ namespace Yolo
             }
 
             Size input_size(input_width_, input_height_);
-            job.additional.compute(image.size(), input_size);
+            job.additional.compute(Size(frame.width, frame.height), input_size);
 
             preprocess_stream = tensor->get_stream();
             tensor->resize(1, 3, input_height_, input_width_);
 
-            size_t size_image = image.cols * image.rows * 3;
+            /* workspace依次为仿射矩阵、上传的NV12平面、连续的BGR图，主机与显存的布局相同
+               1. 同一张卡上的BGR/RGB帧直接作为warp的输入，NV12帧在显存中转为BGR
+               2. 其他的帧先拷贝到显存，Pinned和其他卡上的帧直接异步拷贝，Host经过主机workspace中转
+               3. CPU预处理时不需要上传原图，NV12帧在主机workspace中转为BGR；显存中的帧总是在GPU上预处理
+            */
+            bool nv12 = frame.format == PixelFormat::NV12;
+            bool on_device = frame.location == MemoryLocation::Device && (frame.device_id == -1 || frame.device_id == gpu_);
+            bool cpu_preprocess = preprocess_method_ == PreprocessMethod::CPU && frame.location != MemoryLocation::Device;
+            int width = frame.width;
+            int height = frame.height;
+            int line_size = frame.line_size();
+            int nv12_line_size = (width + 1) / 2 * 2;
             size_t size_matrix = iLogger::upbound(sizeof(job.additional.d2i), 32);
+            size_t size_planes = nv12 && !on_device && !cpu_preprocess ? iLogger::upbound((size_t)nv12_line_size * (height + (height + 1) / 2), 32) : 0;
+            size_t size_image = (nv12 || (!on_device && !cpu_preprocess)) ? (size_t)width * height * 3 : 0;
+            size_t size_host = size_matrix + (frame.location == MemoryLocation::Host || cpu_preprocess ? size_planes + size_image : 0);
+
             auto workspace = tensor->get_workspace();
-            uint8_t *gpu_workspace = (uint8_t *)workspace->gpu(size_matrix + size_image);
+            uint8_t *gpu_workspace = (uint8_t *)workspace->gpu(size_matrix + size_planes + size_image);
             float *affine_matrix_device = (float *)gpu_workspace;
-            uint8_t *image_device = size_matrix + gpu_workspace;
+            uint8_t *planes_device = size_matrix + gpu_workspace;
+            uint8_t *image_device = size_planes + planes_device;
 
-            uint8_t *cpu_workspace = (uint8_t *)workspace->cpu(size_matrix + size_image);
+            uint8_t *cpu_workspace = (uint8_t *)workspace->cpu(size_host);
             float *affine_matrix_host = (float *)cpu_workspace;
-            uint8_t *image_host = size_matrix + cpu_workspace;
+            uint8_t *image_host = size_matrix + size_planes + cpu_workspace;
 
-            // checkCudaRuntime(cudaMemcpyAsync(image_host,   image.data, size_image, cudaMemcpyHostToHost,   stream_));
-            //  speed up
-            memcpy(image_host, image.data, size_image);
             memcpy(affine_matrix_host, job.additional.d2i, sizeof(job.additional.d2i));
-            checkCudaRuntime(cudaMemcpyAsync(image_device, image_host, size_image, cudaMemcpyHostToDevice, preprocess_stream));
             checkCudaRuntime(cudaMemcpyAsync(affine_matrix_device, affine_matrix_host, sizeof(job.additional.d2i), cudaMemcpyHostToDevice, preprocess_stream));
 
+            CUDAKernel::Norm norm = format_norm(normalize_, frame.format);
+            if (cpu_preprocess)
+            {
+                const uint8_t *src = frame.data;
+                int src_line_size = line_size;
+                if (nv12)
+                {
+                    CPUKernel::convert_nv12_to_bgr(frame.data, frame.uv_plane(), width, height, line_size, image_host);
+                    src = image_host;
+                    src_line_size = width * 3;
+                }
+
+                // 直接写tensor的主机内存，之后在预处理stream上异步上传
+                // tensor上一次的上传在job完成前已经结束，见worker中的release
+                tensor->to_cpu(false);
+                CPUKernel::warp_affine_bilinear_and_normalize_plane(
+                    src, src_line_size, width, height,
+                    tensor->cpu<float>(), input_width_, input_height_,
+                    job.additional.d2i, 114, norm);
+                tensor->to_gpu(true);
+                return true;
+            }
+
+            // 按行拷贝到显存workspace的offset处，每行width_bytes字节连续存放
+            auto upload = [&](size_t offset, const uint8_t *src, int src_line_size, int width_bytes, int rows)
+            {
+                if (frame.location != MemoryLocation::Host)
+                {
+                    checkCudaRuntime(cudaMemcpy2DAsync(
+                        gpu_workspace + offset, width_bytes, src, src_line_size, width_bytes, rows,
+                        cudaMemcpyDefault, preprocess_stream));
+                    return;
+                }
+
+                copy_rows(cpu_workspace + offset, src, src_line_size, width_bytes, rows);
+                checkCudaRuntime(cudaMemcpyAsync(gpu_workspace + offset, cpu_workspace + offset, (size_t)width_bytes * rows, cudaMemcpyHostToDevice, preprocess_stream));
+            };
+
+            const uint8_t *src_device = frame.data;
+            int src_line_size = line_size;
+            if (nv12)
+            {
+                const uint8_t *y = frame.data;
+                const uint8_t *uv = frame.uv_plane();
+                int nv12_line = line_size;
+                if (!on_device)
+                {
+                    size_t offset = planes_device - gpu_workspace;
+                    upload(offset, y, line_size, nv12_line_size, height);
+                    upload(offset + (size_t)nv12_line_size * height, uv, line_size, nv12_line_size, (height + 1) / 2);
+                    y = planes_device;
+                    uv = planes_device + (size_t)nv12_line_size * height;
+                    nv12_line = nv12_line_size;
+                }
+                CUDAKernel::convert_nv12_to_bgr_invoke(y, uv, width, height, nv12_line, image_device, preprocess_stream);
+                src_device = image_device;
+                src_line_size = width * 3;
+            }
+            else if (!on_device)
+            {
+                upload(image_device - gpu_workspace, frame.data, line_size, width * 3, height);
+                src_device = image_device;
+                src_line_size = width * 3;
+            }
+
             CUDAKernel::warp_affine_bilinear_and_normalize_plane(
-                image_device, image.cols * 3, image.cols, image.rows,
+                (uint8_t *)src_device, src_line_size, width, height,
                 tensor->gpu<float>(), input_width_, input_height_,
                 affine_matrix_device, 114,
-                normalize_, preprocess_stream);
+                norm, preprocess_stream);
+
+            // Pinned、Device的帧在预处理stream上异步读取，持有到job完成，见worker
+            if (input.frame && frame.location != MemoryLocation::Host)
+                job.input = input;
+            return true;
+        }
+
+        // Pinned、Device的帧在预处理stream上异步读取，丢弃job之前等待，否则release回调时GPU可能还在读
+        virtual void wait_input(Job &job) override
+        {
+            auto &frame = job.input.frame;
+            if (cpu_backend() || frame == nullptr || frame->location == MemoryLocation::Host || job.mono_tensor == nullptr)
+                return;
+
+            auto &tensor = job.mono_tensor->data();
+            if (tensor == nullptr || tensor->get_stream() == nullptr)
+                return;
+
+            CUDATools::AutoDevice auto_device(gpu_);
+            checkCudaRuntime(cudaStreamSynchronize(tensor->get_stream()));
+        }
+
+        // CPU后端的预处理，主机内存中的帧读取是同步的，预处理之后就可以释放
+        bool cpu_backend_preprocess(Job &job, const ExternalFrame &frame)
+        {
+            auto &tensor = job.mono_tensor->data();
+            if (tensor == nullptr)
+            {
+                // not init, host only
+                tensor = make_shared<TRT::Tensor>(TRT::DataType::Float, nullptr, CPU_DEVICE_ID);
+            }
+
+            Size input_size(input_width_, input_height_);
+            job.additional.compute(Size(frame.width, frame.height), input_size);
+            tensor->resize(1, 3, input_height_, input_width_);
+
+            // 预处理是流水线的一个阶段，并行度由PipelineConfig控制，这里单线程
+            const uint8_t *src = frame.data;
+            int src_line_size = frame.line_size();
+            if (frame.format == PixelFormat::NV12)
+            {
+                thread_local vector<uint8_t> bgr;
+                bgr.resize((size_t)frame.width * frame.height * 3);
+                CPUKernel::convert_nv12_to_bgr(src, frame.uv_plane(), frame.width, frame.height, src_line_size, bgr.data(), 1);
+                src = bgr.data();
+                src_line_size = frame.width * 3;
+            }
+
+            CPUKernel::warp_affine_bilinear_and_normalize_plane(
+                src, src_line_size, frame.width, frame.height,
+                tensor->cpu<float>(), input_width_, input_height_,
+                job.additional.d2i, 114, format_norm(normalize_, frame.format), 1);
             return true;
         }
 
         virtual vector<shared_future<BoxArray>> commits(const vector<Mat> &images) override
         {
-            return ControllerImpl::commits(images);
+            return ControllerImpl::commits(vector<InferInput>(images.begin(), images.end()));
         }
 
         virtual std::shared_future<BoxArray> commit(const Mat &image) override
@@ -410,6 +928,102 @@ namespace Yolo
             return ControllerImpl::commit(image);
         }
 
+        virtual void set_batching_policy(const BatchingPolicy &policy) override
+        {
+            ControllerImpl::set_batching_policy(policy);
+        }
+
+        virtual BatchingReport batching_report(bool reset) override
+        {
+            return ControllerImpl::get_batching_report(reset);
+        }
+
+        virtual void set_adaptive_batching(const AdaptiveBatchingPolicy &policy) override
+        {
+            ControllerImpl::set_adaptive_batching(policy);
+        }
+
+        virtual AdaptiveBatchingReport adaptive_batching_report() override
+        {
+            return ControllerImpl::get_adaptive_batching_report();
+        }
+
+        virtual void set_preprocess_method(PreprocessMethod method) override
+        {
+            preprocess_method_ = method;
+        }
+
+        virtual PipelineReport pipeline_report(bool reset) override
+        {
+            return ControllerImpl::get_pipeline_report(reset);
+        }
+
+        virtual std::shared_future<BoxArray> commit(const Mat &image, const JobOptions &options) override
+        {
+            return ControllerImpl::commit(image, options);
+        }
+
+        virtual vector<shared_future<BoxArray>> commits(const vector<Mat> &images, const JobOptions &options) override
+        {
+            return ControllerImpl::commits(vector<InferInput>(images.begin(), images.end()), options);
+        }
+
+        virtual void set_tenant_weight(int tenant, int weight) override
+        {
+            ControllerImpl::set_tenant_weight(tenant, weight);
+        }
+
+        virtual SchedulingReport scheduling_report(bool reset) override
+        {
+            return ControllerImpl::get_scheduling_report(reset);
+        }
+
+        virtual CommitStatus try_commit(const Mat &image, shared_future<BoxArray> &result, const JobOptions &options) override
+        {
+            return ControllerImpl::try_commit(image, result, options);
+        }
+
+        virtual CommitStatus commit(const Mat &image, const Infer::Callback &callback, const JobOptions &options, bool blocking) override
+        {
+            return ControllerImpl::commit(image, callback, options, blocking);
+        }
+
+        virtual void set_admission_policy(const AdmissionPolicy &policy) override
+        {
+            ControllerImpl::set_admission_policy(policy);
+        }
+
+        virtual AdmissionReport admission_report(bool reset) override
+        {
+            return ControllerImpl::get_admission_report(reset);
+        }
+
+        virtual shared_future<BoxArray> commit(const SharedFrame &frame, const JobOptions &options) override
+        {
+            return ControllerImpl::commit(frame, options);
+        }
+
+        virtual CommitStatus commit(const SharedFrame &frame, const Infer::Callback &callback, const JobOptions &options, bool blocking) override
+        {
+            return ControllerImpl::commit(frame, callback, options, blocking);
+        }
+
+        virtual CancellationReport cancellation_report(bool reset) override
+        {
+            return ControllerImpl::get_cancellation_report(reset);
+        }
+
+        virtual InferMetricsSnapshot metrics(bool reset) override
+        {
+            return ControllerImpl::get_metrics(reset);
+        }
+
+    private:
+        bool cpu_backend() const
+        {
+            return start_param_.backend == TRT::Backend::CPU;
+        }
+
     private:
         int input_width_ = 0;
         int input_height_ = 0;
@@ -419,27 +1033,40 @@ namespace Yolo
         int max_objects_ = 1024;
         NMSMethod nms_method_ = NMSMethod::FastGPU;
         TRT::CUStream stream_ = nullptr;
+        TRT::CUStream preprocess_stream_ = nullptr; // 不使用多个预处理stream时所有job共用
         bool use_multi_preprocess_stream_ = false;
+        atomic<PreprocessMethod> preprocess_method_{PreprocessMethod::GPU};
         CUDAKernel::Norm normalize_;
     };
 
     shared_ptr<Infer> create_infer(
-        const string &engine_file, Type type, int gpuid,
+        const TRT::EngineSource &source, Type type,
         float confidence_threshold, float nms_threshold,
         NMSMethod nms_method, int max_objects,
-        bool use_multi_preprocess_stream)
+        bool use_multi_preprocess_stream, const PipelineConfig &pipeline)
     {
         shared_ptr<InferImpl> instance(new InferImpl());
         if (!instance->startup(
-                engine_file, type, gpuid, confidence_threshold,
-                nms_threshold, nms_method, max_objects, use_multi_preprocess_stream))
+                source, type, confidence_threshold,
+                nms_threshold, nms_method, max_objects, use_multi_preprocess_stream, pipeline))
         {
             instance.reset();
         }
         return instance;
     }
 
-    void image_to_tensor(const cv::Mat &image, shared_ptr<TRT::Tensor> &tensor, Type type, int ibatch)
+    shared_ptr<Infer> create_infer(
+        const string &engine_file, Type type, int gpuid,
+        float confidence_threshold, float nms_threshold,
+        NMSMethod nms_method, int max_objects,
+        bool use_multi_preprocess_stream, const PipelineConfig &pipeline)
+    {
+        return create_infer(
+            TRT::EngineSource(engine_file, gpuid), type, confidence_threshold,
+            nms_threshold, nms_method, max_objects, use_multi_preprocess_stream, pipeline);
+    }
+
+    void image_to_tensor(const cv::Mat &image, shared_ptr<TRT::Tensor> &tensor, Type type, int ibatch, PreprocessMethod method)
     {
 
         CUDAKernel::Norm normalize;
@@ -463,6 +1090,16 @@ namespace Yolo
         AffineMatrix affine;
         affine.compute(image.size(), input_size);
 
+        if (method == PreprocessMethod::CPU)
+        {
+            // tensor的其他batch可能在GPU上，cpu()会先拷贝回来，使用时再上传
+            CPUKernel::warp_affine_bilinear_and_normalize_plane(
+                image.data, image.step, image.cols, image.rows,
+                tensor->cpu<float>(ibatch), input_size.width, input_size.height,
+                affine.d2i, 114, normalize);
+            return;
+        }
+
         size_t size_image = image.cols * image.rows * 3;
         size_t size_matrix = iLogger::upbound(sizeof(affine.d2i), 32);
         auto workspace = tensor->get_workspace();
@@ -475,7 +1112,7 @@ namespace Yolo
         uint8_t *image_host = size_matrix + cpu_workspace;
         auto stream = tensor->get_stream();
 
-        memcpy(image_host, image.data, size_image);
+        copy_rows(image_host, image.data, image.step, image.cols * 3, image.rows);
         memcpy(affine_matrix_host, affine.d2i, sizeof(affine.d2i));
         checkCudaRuntime(cudaMemcpyAsync(image_device, image_host, size_image, cudaMemcpyHostToDevice, stream));
         checkCudaRuntime(cudaMemcpyAsync(affine_matrix_device, affine_matrix_host, sizeof(affine.d2i), cudaMemcpyHostToDevice, stream));
@@ -13,8 +13,18 @@
 #include <memory>
 #include <string>
 #include <future>
+#include <functional>
 #include <opencv2/opencv.hpp>
 #include "../TrtLib/common/trt_tensor.hpp"
+#include "../TrtLib/common/batching_policy.hpp"
+#include "../TrtLib/common/adaptive_batching.hpp"
+#include "../TrtLib/common/pipeline_stage.hpp"
+#include "../TrtLib/common/job_scheduler.hpp"
+#include "../TrtLib/common/admission_control.hpp"
+#include "../TrtLib/common/infer_metrics.hpp"
+#include "../TrtLib/common/replica_set.hpp"
+#include "../TrtLib/common/external_frame.hpp"
+#include "../TrtLib/infer/trt_infer.hpp"
 #include "object_detector.hpp"
 
 /**
@@ -36,25 +46,453 @@ namespace Yolo
 
     enum class NMSMethod : int
     {
-        CPU = 0,    // General, for estimate mAP
-        FastGPU = 1 // Fast NMS with a small loss of accuracy in corner cases
+        CPU = 0,          // General, for estimate mAP
+        FastGPU = 1,      // Fast NMS with a small loss of accuracy in corner cases
+        SoftLinear = 2,   // Soft-NMS, score *= 1 - IoU when IoU > threshold, better recall in crowded scenes
+        SoftGaussian = 3, // Soft-NMS, score *= exp(-IoU^2 / sigma)
+        DIoU = 4,         // Greedy NMS on IoU minus normalized center distance
+        ClassAgnostic = 5 // Greedy NMS across all classes
     };
 
-    void image_to_tensor(const cv::Mat &image, shared_ptr<TRT::Tensor> &tensor, Type type, int ibatch);
+    // 仿射变换与归一化在哪里做，CPU为preprocess_cpu.hpp中的SIMD实现，只上传网络输入，不上传原图
+    enum class PreprocessMethod : int
+    {
+        GPU = 0,
+        CPU = 1
+    };
+
+    struct AffineMatrix
+    {
+        float i2d[6]; // image to dst(network), 2x3 matrix
+        float d2i[6]; // dst to image, 2x3 matrix
+
+        void compute(const cv::Size &from, const cv::Size &to)
+        {
+            float scale_x = to.width / (float)from.width;
+            float scale_y = to.height / (float)from.height;
+
+            // 这里取min的理由是
+            // 1. M矩阵是 from * M = to的方式进行映射，因此scale的分母一定是from
+            // 2. 取最小，即根据宽高比，算出最小的比例，如果取最大，则势必有一部分超出图像范围而被裁剪掉，这不是我们要的
+            // **
+            float scale = std::min(scale_x, scale_y);
+
+            /**
+            这里的仿射变换矩阵实质上是2x3的矩阵，具体实现是
+            scale, 0, -scale * from.width * 0.5 + to.width * 0.5
+            0, scale, -scale * from.height * 0.5 + to.height * 0.5
+
+            这里可以想象成，是经历过缩放、平移、平移三次变换后的组合，M = TPS
+            例如第一个S矩阵，定义为把输入的from图像，等比缩放scale倍，到to尺度下
+            S = [
+            scale,     0,      0
+            0,     scale,      0
+            0,         0,      1
+            ]
+
+            P矩阵定义为第一次平移变换矩阵，将图像的原点，从左上角，移动到缩放(scale)后图像的中心上
+            P = [
+            1,        0,      -scale * from.width * 0.5
+            0,        1,      -scale * from.height * 0.5
+            0,        0,                1
+            ]
+
+            T矩阵定义为第二次平移变换矩阵，将图像从原点移动到目标（to）图的中心上
+            T = [
+            1,        0,      to.width * 0.5,
+            0,        1,      to.height * 0.5,
+            0,        0,            1
+            ]
+
+            通过将3个矩阵顺序乘起来，即可得到下面的表达式：
+            M = [
+            scale,    0,     -scale * from.width * 0.5 + to.width * 0.5
+            0,     scale,    -scale * from.height * 0.5 + to.height * 0.5
+            0,        0,                     1
+            ]
+            去掉第三行就得到opencv需要的输入2x3矩阵
+            **/
+
+            /*
+                 + scale * 0.5 - 0.5 的主要原因是使得中心更加对齐，下采样不明显，但是上采样时就比较明显
+                参考：https://www.iteye.com/blog/handspeaker-1545126
+            */
+            i2d[0] = scale;
+            i2d[1] = 0;
+            i2d[2] = -scale * from.width * 0.5 + to.width * 0.5 + scale * 0.5 - 0.5;
+            i2d[3] = 0;
+            i2d[4] = scale;
+            i2d[5] = -scale * from.height * 0.5 + to.height * 0.5 + scale * 0.5 - 0.5;
+
+            cv::Mat m2x3_i2d(2, 3, CV_32F, i2d);
+            cv::Mat m2x3_d2i(2, 3, CV_32F, d2i);
+            cv::invertAffineTransform(m2x3_i2d, m2x3_d2i);
+        }
+
+        cv::Mat i2d_mat()
+        {
+            return cv::Mat(2, 3, CV_32F, i2d);
+        }
+    };
+
+    void image_to_tensor(const cv::Mat &image, shared_ptr<TRT::Tensor> &tensor, Type type, int ibatch,
+                         PreprocessMethod method = PreprocessMethod::GPU);
+
+    // 通用的按类别做的hard nms，会对boxes按置信度排序
+    BoxArray cpu_nms(BoxArray &boxes, float threshold);
+
+    // 结果与cpu_nms相同，直接在boxes上原地压缩，不分配内存
+    void cpu_nms_inplace(BoxArray &boxes, float threshold);
+
+    // 结果与cpu_nms_inplace逐位相同，按类别分桶、SIMD计算IoU、框多时用网格跳过不相交的框，见yolo_nms.cpp
+    void cpu_nms_fast(BoxArray &boxes, float threshold);
+
+    // 一个batch的多张图并行做cpu_nms_fast，num_threads <= 0时使用全部核心
+    void cpu_nms_batch(const vector<BoxArray *> &batch, float threshold, int num_threads = 0);
+
+    // 不区分类别的cpu_nms_fast
+    void cpu_nms_agnostic(BoxArray &boxes, float threshold);
+
+    // 按DIoU >= threshold抑制，中心离得远的重叠框更容易保留
+    void cpu_diou_nms(BoxArray &boxes, float threshold, bool class_agnostic = false);
+
+    /* soft nms，被抑制的框降低置信度而不是删除，低于score_threshold的框才删除
+       linear: IoU > threshold时乘以1 - IoU；gaussian: 乘以exp(-IoU^2 / sigma)，不使用threshold
+       输出按衰减后的置信度降序
+    */
+    void cpu_soft_nms(BoxArray &boxes, float threshold, bool gaussian, float sigma = 0.5f, float score_threshold = 0.001f, bool class_agnostic = false);
+
+    // 按method在CPU上做nms，FastGPU不做任何处理，score_threshold只用于soft nms
+    void cpu_nms_method(BoxArray &boxes, NMSMethod method, float threshold, float score_threshold);
+
+    /* 与decode_kernel相同的CPU解码，见yolo_cpu_decode.cpp
+       predict为num_bboxes个(cx, cy, w, h, objectness, num_classes个类别分数)，invert_affine_matrix为AffineMatrix::d2i
+       parray[0]为计数，由调用方清零，之后为max_objects个(left, top, right, bottom, confidence, class, keepflag)
+       结果按anchor的顺序，num_threads为1时单线程，<= 0时使用全部核心
+    */
+    void cpu_decode(
+        const float *predict, int num_bboxes, int num_classes, float confidence_threshold,
+        const float *invert_affine_matrix, float *parray, int max_objects, int num_threads = 1);
+
+    // 同上，结果直接追加到output，最多max_objects个
+    void cpu_decode(
+        const float *predict, int num_bboxes, int num_classes, float confidence_threshold,
+        const float *invert_affine_matrix, BoxArray &output, int max_objects, int num_threads = 1);
+
+    // 推理的输入，cv::Mat或者外部的帧，只有一个非空
+    struct InferInput
+    {
+        cv::Mat image;
+        SharedFrame frame;
+
+        InferInput() {}
+        InferInput(const cv::Mat &image) : image(image) {}
+        InferInput(const SharedFrame &frame) : frame(frame) {}
+    };
 
     class Infer
     {
     public:
         virtual shared_future<BoxArray> commit(const cv::Mat &image) = 0;
         virtual vector<shared_future<BoxArray>> commits(const vector<cv::Mat> &images) = 0;
+
+        // 动态批处理策略，默认不等待，见batching_policy.hpp
+        virtual void set_batching_policy(const BatchingPolicy &policy) = 0;
+        virtual BatchingReport batching_report(bool reset = false) = 0;
+
+        // 按实测的吞吐曲线和p99延迟目标在线调整batch上限，默认关闭，见adaptive_batching.hpp
+        virtual void set_adaptive_batching(const AdaptiveBatchingPolicy &policy) = 0;
+        virtual AdaptiveBatchingReport adaptive_batching_report() = 0;
+
+        // 默认GPU，GPU繁忙或者原图远大于网络输入时可以换成CPU；CPU后端总是在CPU上预处理
+        virtual void set_preprocess_method(PreprocessMethod method) = 0;
+
+        // 预处理、推理、后处理各阶段的占用率，见pipeline_stage.hpp
+        virtual PipelineReport pipeline_report(bool reset = false) = 0;
+
+        // 带优先级和租户的提交，高优先级在下一个batch边界抢占，同一优先级内按租户权重公平调度
+        virtual shared_future<BoxArray> commit(const cv::Mat &image, const JobOptions &options) = 0;
+        virtual vector<shared_future<BoxArray>> commits(const vector<cv::Mat> &images, const JobOptions &options) = 0;
+        virtual void set_tenant_weight(int tenant, int weight) = 0;
+
+        // 每个优先级的排队时间和端到端延迟
+        virtual SchedulingReport scheduling_report(bool reset = false) = 0;
+
+        // 准入控制，见admission_control.hpp
+        // try_commit不阻塞，只有返回Accepted时result才有效；commit被拒绝时结果为空
+        virtual CommitStatus try_commit(const cv::Mat &image, shared_future<BoxArray> &result, const JobOptions &options = JobOptions()) = 0;
+        virtual void set_admission_policy(const AdmissionPolicy &policy) = 0;
+
+        // 回调形式的提交，不分配promise，回调返回后boxes被回收，需要保留时std::swap出去
+        // 回调在推理线程或后处理线程上执行，应当尽快返回
+        typedef function<void(BoxArray &boxes)> Callback;
+        virtual CommitStatus commit(const cv::Mat &image, const Callback &callback, const JobOptions &options = JobOptions(), bool blocking = true) = 0;
+        virtual AdmissionReport admission_report(bool reset = false) = 0;
+
+        // 外部的帧，显存和固定内存中的帧不经过中转的拷贝，见external_frame.hpp
+        // 引擎持有frame直到推理完成，之后调用frame->release
+        virtual shared_future<BoxArray> commit(const SharedFrame &frame, const JobOptions &options = JobOptions()) = 0;
+        virtual CommitStatus commit(const SharedFrame &frame, const Callback &callback, const JobOptions &options = JobOptions(), bool blocking = true) = 0;
+
+        // JobOptions::cancel_token、deadline_ms跳过的job数量与节省的工作量，见job_cancellation.hpp
+        virtual CancellationReport cancellation_report(bool reset = false) = 0;
+
+        // 排队、预处理、上传、前向、解码、NMS、总延迟的分位数，吞吐、batch填充率与丢弃计数，见infer_metrics.hpp
+        virtual InferMetricsSnapshot metrics(bool reset = false) = 0;
     };
 
     shared_ptr<Infer> create_infer(
         const string &engine_file, Type type, int gpuid,
         float confidence_threshold = 0.25f, float nms_threshold = 0.5f,
         NMSMethod nms_method = NMSMethod::FastGPU, int max_objects = 1024,
-        bool use_multi_preprocess_stream = false);
+        bool use_multi_preprocess_stream = false,
+        const PipelineConfig &pipeline = PipelineConfig());
+
+    // 按source.backend选择TensorRT引擎或者CPU后端，CPU后端上预处理、解码、nms都在CPU上完成，nms_method为FastGPU时按CPU处理
+    shared_ptr<Infer> create_infer(
+        const TRT::EngineSource &source, Type type,
+        float confidence_threshold = 0.25f, float nms_threshold = 0.5f,
+        NMSMethod nms_method = NMSMethod::FastGPU, int max_objects = 1024,
+        bool use_multi_preprocess_stream = false,
+        const PipelineConfig &pipeline = PipelineConfig());
     const char *type_name(Type type);
+    const char *nms_method_name(NMSMethod method);
+
+    // 多个实例组成的副本集，对外与单个实例相同，见replica_set.hpp
+    // 设置类的接口广播到所有副本，统计类的接口返回所有副本合并后的结果
+    class ReplicaInfer : public Infer
+    {
+    public:
+        // 每个副本的健康状态、未完成数量、吞吐和延迟
+        virtual ReplicaSetReport replica_report(bool reset = false) = 0;
+
+        // 副本的相对处理能力，默认为1，最少未完成数按outstanding / weight比较
+        virtual void set_replica_weight(int index, int weight) = 0;
+    };
+
+    // replicas为已经创建好的实例，可以来自不同的卡，也可以是CPU后端；为nullptr的实例被忽略
+    // 副本只应通过返回的ReplicaInfer提交，否则最少未完成数的统计不准确
+    shared_ptr<ReplicaInfer> create_replica_infer(
+        const vector<shared_ptr<Infer>> &replicas,
+        ReplicaPolicy policy = ReplicaPolicy::LeastOutstanding,
+        const ReplicaHealthPolicy &health = ReplicaHealthPolicy());
+
+    // 在每个gpuid上创建instances_per_device个实例，每个实例拥有独立的引擎和allocator，任意一个创建失败则返回nullptr
+    shared_ptr<ReplicaInfer> create_replica_infer(
+        const string &engine_file, Type type, const vector<int> &gpuids, int instances_per_device = 1,
+        float confidence_threshold = 0.25f, float nms_threshold = 0.5f,
+        NMSMethod nms_method = NMSMethod::FastGPU, int max_objects = 1024,
+        bool use_multi_preprocess_stream = false,
+        const PipelineConfig &pipeline = PipelineConfig(),
+        ReplicaPolicy policy = ReplicaPolicy::LeastOutstanding);
+
+    // 切片推理的参数，见yolo_tiled.cpp
+    struct TilingConfig
+    {
+        // 原图分辨率下的切片大小，与网络输入相同时切片不经过缩放
+        int tile_width = 640;
+        int tile_height = 640;
+
+        // 相邻切片重叠的比例，[0, 0.9]，不小于目标的尺寸时被切片边缘截断的目标能在相邻切片中完整出现
+        float overlap = 0.2f;
+
+        // 额外提交一张缩放后的整图，检测大于切片的目标
+        bool global_view = true;
+
+        // 丢弃贴着切片内部边缘、并且完整落在相邻切片中的框，它们是被截断的目标，相邻切片中有完整的框
+        bool drop_seam_boxes = true;
+        float seam_margin = 2.0f; // 框的边离切片边缘不超过seam_margin像素时认为贴边
+
+        // 合并所有切片的框，FastGPU按CPU处理，score_threshold只用于soft nms
+        NMSMethod nms_method = NMSMethod::CPU;
+        float nms_threshold = 0.5f;
+        float score_threshold = 0.001f;
+    };
+
+    struct TilingReport
+    {
+        long long num_images = 0;
+        long long num_tiles = 0;           // 不含整图
+        long long num_raw_boxes = 0;       // 所有切片和整图的框
+        long long num_seam_boxes = 0;      // drop_seam_boxes丢弃的框
+        long long num_merged_boxes = 0;
+        long long num_rejected_images = 0; // 有切片被拒绝、丢弃，结果为空
+        double merge_ms = 0;               // 映射、过滤与nms的总耗时
+    };
+
+    // 按行排列的切片，最后一行、一列与图像的右、下边缘对齐，图像不大于切片时只有一个切片
+    vector<cv::Rect> compute_tiles(const cv::Size &image, const TilingConfig &config);
+
+    /* 高分辨率图像的切片推理
+       每张图的切片以ROI的方式引用原图，不拷贝，所有切片与整图以回调的形式逐个提交，在引擎中共享batch
+       引擎把框映射回切片，这里再平移回原图，合并重叠区域与整图的重复框
+       合并在最后一个完成的切片的回调中执行，之后future就绪，可以用wait_for轮询
+       JobOptions的latest_only不作用于切片；有切片被拒绝、丢弃时结果为空，options.outcome为rejected
+    */
+    class TiledInfer
+    {
+    public:
+        virtual shared_future<BoxArray> commit(const cv::Mat &image, const JobOptions &options = JobOptions()) = 0;
+        virtual vector<shared_future<BoxArray>> commits(const vector<cv::Mat> &images, const JobOptions &options = JobOptions()) = 0;
+
+        virtual TilingConfig config() = 0;
+        virtual TilingReport report(bool reset = false) = 0;
+    };
+
+    shared_ptr<TiledInfer> create_tiled_infer(const shared_ptr<Infer> &infer, const TilingConfig &config = TilingConfig());
+
+    enum class MotionMethod : int
+    {
+        FrameDiff = 0,     // 与上一帧比较，只对正在运动的目标敏感
+        RunningAverage = 1 // 与滑动平均的背景比较，缓慢移动的目标也会累积出差异，光照的缓慢变化被背景吸收
+    };
+
+    const char *motion_method_name(MotionMethod method);
+
+    // 运动检测与门控的参数，每路相机可以不同，见yolo_motion.cpp
+    struct MotionConfig
+    {
+        MotionMethod method = MotionMethod::RunningAverage;
+        int cell_size = 8;              // 每cell_size x cell_size个像素降采样为一个亮度值
+        float pixel_threshold = 12.0f;  // 单元的亮度差超过它时认为这个单元有变化
+        float area_threshold = 0.0005f; // 有变化的单元超过这个比例(至少1个)时认为有运动
+        float background_alpha = 0.05f; // RunningAverage背景的更新速度
+
+        // 连续跳过这么多帧后强制推理一次，避免长时间沿用过期的结果，<= 0时不强制
+        int max_skip_frames = 150;
+
+        // 运动区域扩展后占整图的比例不超过crop_max_area时只推理这个区域，区域外沿用上一次的结果
+        bool crop = true;
+        float crop_max_area = 0.5f;
+        float crop_margin = 0.25f; // 区域每边向外扩展区域边长的比例
+        int crop_min_size = 640;   // 区域的最小边长，避免小区域在仿射变换中被放大，目标尺度与整图推理时差异过大
+    };
+
+    // 一帧的运动检测结果，region为原图坐标下有变化的单元的外接矩形
+    struct MotionResult
+    {
+        bool motion = false;
+        float changed_ratio = 0;
+        cv::Rect region;
+    };
+
+    // 一路相机的运动检测，不是线程安全的
+    class MotionDetector
+    {
+    public:
+        // 第一帧、尺寸变化后的第一帧总是返回有运动，region为整图
+        virtual MotionResult detect(const cv::Mat &image) = 0;
+        virtual void reset() = 0;
+    };
+
+    shared_ptr<MotionDetector> create_motion_detector(const MotionConfig &config = MotionConfig());
+
+    struct MotionReport
+    {
+        int camera = 0;
+        long long num_frames = 0;
+        long long num_full = 0;    // 整图推理的帧
+        long long num_cropped = 0; // 只推理运动区域的帧
+        long long num_skipped = 0; // 没有运动，沿用上一次结果的帧
+        long long num_forced = 0;  // 因为max_skip_frames或者上一次提交失败而推理的帧，计入num_full
+        float skip_rate = 0;
+        float inferred_area = 0;   // 提交给引擎的像素占所有帧像素的比例
+        float detect_us = 0;       // 运动检测的平均耗时
+    };
+
+    /* 运动门控的推理
+       每一帧先在降采样的亮度图上做运动检测，静止的帧不提交给引擎，直接返回上一次的结果；
+       运动集中在局部时以ROI提交运动区域，引擎按区域的尺寸计算仿射矩阵，框平移回原图后与区域外的上一次结果合并
+       空闲的相机不再占用引擎的batch
+       提交被拒绝或者被丢弃时返回上一次的结果，options.outcome为rejected，下一帧强制整图推理
+    */
+    class MotionGatedInfer
+    {
+    public:
+        // 同一路相机的帧按顺序提交，不同相机可以在不同线程上提交
+        virtual shared_future<BoxArray> commit(int camera, const cv::Mat &image, const JobOptions &options = JobOptions()) = 0;
+
+        // 修改一路相机的参数，之后重新建立背景；没有设置过的相机使用创建时的默认参数
+        virtual void set_camera_config(int camera, const MotionConfig &config) = 0;
+
+        virtual MotionReport report(int camera, bool reset = false) = 0;
+        virtual vector<MotionReport> reports(bool reset = false) = 0;
+    };
+
+    shared_ptr<MotionGatedInfer> create_motion_gated_infer(const shared_ptr<Infer> &infer, const MotionConfig &default_config = MotionConfig());
+
+    // 拼图推理的参数，见yolo_mosaic.cpp
+    struct MosaicConfig
+    {
+        // 画布的大小，应当与网络输入相同，画布在引擎中不再缩放
+        int canvas_width = 640;
+        int canvas_height = 640;
+
+        // 帧放进画布前的缩放，帧大于画布时继续缩小到放得下；640x360的子码流在640的网络上用0.5时一张画布放6路
+        float frame_scale = 1.0f;
+
+        // 相邻帧之间的间隔，用114填充，避免两帧边缘的目标在网络中连成一个
+        int gap = 0;
+
+        // 框超出所属帧的区域不超过straddle_margin像素(画布坐标)时认为属于这一帧，否则是跨帧的框，丢弃
+        float straddle_margin = 2.0f;
+    };
+
+    // 一帧在画布中的位置，i2d把帧映射到画布，d2i把画布映射回帧
+    struct MosaicSlot
+    {
+        int frame = 0; // 在提交的帧中的下标
+        cv::Size size; // 帧的原始尺寸
+        cv::Rect region; // 画布坐标
+        float scale = 1;
+        float i2d[6];
+        float d2i[6];
+    };
+
+    struct MosaicCanvas
+    {
+        vector<MosaicSlot> slots;
+    };
+
+    struct MosaicReport
+    {
+        long long num_frames = 0;
+        long long num_canvases = 0;
+        long long num_rejected_canvases = 0; // 被拒绝、丢弃的画布，其上的帧结果为空
+        long long num_raw_boxes = 0;         // 画布上的框
+        long long num_straddle_boxes = 0;    // 跨帧或者落在空白处而丢弃的框
+        float frames_per_canvas = 0;
+        float fill_ratio = 0;                // 帧占画布面积的比例，逐帧letterbox时为帧占网络输入的比例
+        double pack_ms = 0;                  // 绘制画布的总耗时
+        double unpack_ms = 0;                // 框分配回帧的总耗时
+    };
+
+    // 按缩放后的高度降序做货架式排列，放不下时开新的画布；不合法的尺寸不放入任何画布
+    vector<MosaicCanvas> pack_mosaic(const vector<cv::Size> &frames, const MosaicConfig &config);
+
+    // 把帧画到画布上，canvas按画布大小重新分配，空白处为114
+    void render_mosaic(const vector<cv::Mat> &frames, const MosaicCanvas &layout, const MosaicConfig &config, cv::Mat &canvas);
+
+    // 画布上的框按所在区域分配回各帧并映射到帧的坐标，outputs按帧的下标索引，返回丢弃的框数
+    int unpack_mosaic(const BoxArray &boxes, const MosaicCanvas &layout, const MosaicConfig &config, vector<BoxArray> &outputs);
+
+    /* 低分辨率多路相机的拼图推理
+       一次commits的帧拼进尽量少的网络输入画布，每帧有自己的仿射矩阵，推理一次后按区域把框分回各帧，跨帧的框丢弃
+       子码流逐帧letterbox时约一半的网络输入是填充，并且每帧占一个batch位置
+       每张画布单独提交，框在画布的回调中分配回各帧，返回的future可以用wait_for轮询
+       latest_only不作用于画布之间；画布被拒绝时其上各帧的结果为空，options.outcome为rejected
+    */
+    class MosaicInfer
+    {
+    public:
+        virtual shared_future<BoxArray> commit(const cv::Mat &image, const JobOptions &options = JobOptions()) = 0;
+        virtual vector<shared_future<BoxArray>> commits(const vector<cv::Mat> &images, const JobOptions &options = JobOptions()) = 0;
+
+        virtual MosaicConfig config() = 0;
+        virtual MosaicReport report(bool reset = false) = 0;
+    };
+
+    shared_ptr<MosaicInfer> create_mosaic_infer(const shared_ptr<Infer> &infer, const MosaicConfig &config = MosaicConfig());
 
 }; // namespace Yolo
 
@@ -0,0 +1,211 @@
+#include "yolo.hpp"
+#include <climits>
+#include <algorithm>
+#include "TrtLib/common/simd.hpp"
+#include "TrtLib/common/parallel_for.hpp"
+
+/**
+ * 与decode_kernel相同的CPU解码
+ * 解决的问题：
+ * 解码只有cuda的decode_kernel，CPU后端和没有GPU时的兜底只能逐个anchor、逐个类别地标量循环
+ *
+ * 设计思路：
+ * 1. 先判断objectness，绝大多数anchor在这一步被过滤，不读取类别分数
+ * 2. 类别的argmax一次比较4个：先求最大值，再找第一个等于最大值的位置，与decode_kernel中严格大于才更新的结果相同
+ * 3. 通过的anchor很少，仿射投影在最后写出时逐个计算，运算与decode_kernel相同
+ * 4. anchor较多时按DECODE_CHUNK分段，在常驻线程上并行筛选，每段的结果按anchor顺序拼接，
+ *    输出与单线程完全相同，不像decode_kernel那样依赖atomicAdd的顺序
+ **/
+
+namespace Yolo
+{
+    using namespace std;
+
+    static const int DECODE_CHUNK = 2048; // 每个任务处理的anchor数量
+    static const int NUM_BOX_ELEMENT = 7; // left, top, right, bottom, confidence, class, keepflag
+
+    struct DecodeCandidate
+    {
+        int position;
+        int label;
+        float confidence;
+    };
+
+    // 第一个最大值的位置，与逐个比较、严格大于才更新的结果相同
+    static inline int class_argmax(const float *p, int n)
+    {
+        if (n >= SIMD::WIDTH * 2)
+        {
+            int i = SIMD::WIDTH;
+            SIMD::f32x4 vmax = SIMD::load(p);
+            for (; i + SIMD::WIDTH <= n; i += SIMD::WIDTH)
+                vmax = SIMD::max(vmax, SIMD::load(p + i));
+
+            float value = SIMD::reduce_max(vmax);
+            for (; i < n; ++i)
+                value = max(value, p[i]);
+
+            SIMD::f32x4 vvalue = SIMD::set1(value);
+            for (i = 0; i + SIMD::WIDTH <= n; i += SIMD::WIDTH)
+            {
+                int mask = SIMD::movemask(SIMD::cmpeq(SIMD::load(p + i), vvalue));
+                if (mask)
+                {
+                    while (!(mask & 1))
+                    {
+                        mask >>= 1;
+                        i++;
+                    }
+                    return i;
+                }
+            }
+
+            for (; i < n; ++i)
+            {
+                if (p[i] == value)
+                    return i;
+            }
+            // 含有NaN时找不到，退回逐个比较
+        }
+
+        int label = 0;
+        for (int i = 1; i < n; ++i)
+        {
+            if (p[i] > p[label])
+                label = i;
+        }
+        return label;
+    }
+
+    // [begin, end)范围内通过阈值的anchor追加到candidates，达到limit个时停止
+    static void decode_range(
+        const float *predict, int begin, int end, int num_classes, float confidence_threshold,
+        int limit, vector<DecodeCandidate> &candidates)
+    {
+        int stride = 5 + num_classes;
+        for (int position = begin; position < end; ++position)
+        {
+            const float *pitem = predict + stride * position;
+            float objectness = pitem[4];
+            if (objectness < confidence_threshold)
+                continue;
+
+            int label = class_argmax(pitem + 5, num_classes);
+            float confidence = pitem[5 + label] * objectness;
+            if (confidence < confidence_threshold)
+                continue;
+
+            candidates.push_back({position, label, confidence});
+            if ((int)candidates.size() >= limit)
+                return;
+        }
+    }
+
+    // 按anchor顺序筛选，返回每段的结果，多段时并行，每段最多limit个
+    static const vector<vector<DecodeCandidate>> &decode_candidates(
+        const float *predict, int num_bboxes, int num_classes, float confidence_threshold, int limit, int num_threads)
+    {
+        thread_local vector<vector<DecodeCandidate>> chunks;
+        int num_chunks = max(1, (num_bboxes + DECODE_CHUNK - 1) / DECODE_CHUNK);
+        if (num_threads == 1)
+            num_chunks = 1;
+
+        if ((int)chunks.size() < num_chunks)
+            chunks.resize(num_chunks);
+
+        for (auto &item : chunks)
+            item.clear();
+
+        if (num_chunks == 1)
+        {
+            decode_range(predict, 0, num_bboxes, num_classes, confidence_threshold, limit, chunks[0]);
+            return chunks;
+        }
+
+        // chunks是调用线程的thread_local，工作线程通过指针访问
+        // 只捕获一个指针，std::function不需要分配内存
+        struct Args
+        {
+            const float *predict;
+            int num_bboxes, num_classes;
+            float confidence_threshold;
+            int limit;
+            vector<vector<DecodeCandidate>> *chunks;
+        } args = {predict, num_bboxes, num_classes, confidence_threshold, limit, &chunks};
+
+        parallel_for(num_chunks, num_threads, [&args](int ichunk)
+                     {
+            int begin = ichunk * DECODE_CHUNK;
+            int end = min(args.num_bboxes, begin + DECODE_CHUNK);
+            decode_range(args.predict, begin, end, args.num_classes, args.confidence_threshold, args.limit, (*args.chunks)[ichunk]); });
+        return chunks;
+    }
+
+    static inline void project_box(const float *predict, int num_classes, const float *m, const DecodeCandidate &item, float *box)
+    {
+        const float *pitem = predict + (5 + num_classes) * item.position;
+        float cx = pitem[0];
+        float cy = pitem[1];
+        float width = pitem[2];
+        float height = pitem[3];
+        float left = cx - width * 0.5f;
+        float top = cy - height * 0.5f;
+        float right = cx + width * 0.5f;
+        float bottom = cy + height * 0.5f;
+        box[0] = m[0] * left + m[1] * top + m[2];
+        box[1] = m[3] * left + m[4] * top + m[5];
+        box[2] = m[0] * right + m[1] * bottom + m[2];
+        box[3] = m[3] * right + m[4] * bottom + m[5];
+    }
+
+    void cpu_decode(
+        const float *predict, int num_bboxes, int num_classes, float confidence_threshold,
+        const float *invert_affine_matrix, float *parray, int max_objects, int num_threads)
+    {
+        // 计数要包括所有通过的框，不能提前停止
+        auto &chunks = decode_candidates(predict, num_bboxes, num_classes, confidence_threshold, INT_MAX, num_threads);
+
+        // 与decode_kernel相同，计数包括超出max_objects的框，读取时取min(count, max_objects)
+        int index = (int)parray[0];
+        int total = 0;
+        for (auto &candidates : chunks)
+        {
+            total += candidates.size();
+            for (auto &item : candidates)
+            {
+                if (index >= max_objects)
+                    break;
+
+                float *pout_item = parray + 1 + index * NUM_BOX_ELEMENT;
+                project_box(predict, num_classes, invert_affine_matrix, item, pout_item);
+                pout_item[4] = item.confidence;
+                pout_item[5] = item.label;
+                pout_item[6] = 1; // 1 = keep, 0 = ignore
+                index++;
+            }
+        }
+        parray[0] += total;
+    }
+
+    void cpu_decode(
+        const float *predict, int num_bboxes, int num_classes, float confidence_threshold,
+        const float *invert_affine_matrix, BoxArray &output, int max_objects, int num_threads)
+    {
+        auto &chunks = decode_candidates(predict, num_bboxes, num_classes, confidence_threshold, max_objects, num_threads);
+        int count = 0;
+        for (auto &candidates : chunks)
+        {
+            for (auto &item : candidates)
+            {
+                if (count >= max_objects)
+                    return;
+
+                float box[4];
+                project_box(predict, num_classes, invert_affine_matrix, item, box);
+                output.emplace_back(box[0], box[1], box[2], box[3], item.confidence, item.label);
+                count++;
+            }
+        }
+    }
+
+}; // namespace Yolo
@@ -4,6 +4,8 @@
 
 namespace Yolo{
 
+#ifndef CPU_ONLY
+
     const int NUM_BOX_ELEMENT = 7;      // left, top, right, bottom, confidence, class, keepflag
     static __device__ void affine_project(float* matrix, float x, float y, float* ox, float* oy){
         *ox = matrix[0] * x + matrix[1] * y + matrix[2];
@@ -107,6 +109,7 @@ namespace Yolo{
             }
         }
     } 
+#endif // CPU_ONLY
 
     void decode_kernel_invoker(float* predict, int num_bboxes, int num_classes, float confidence_threshold, float* invert_affine_matrix, float* parray, int max_objects, cudaStream_t stream){
         
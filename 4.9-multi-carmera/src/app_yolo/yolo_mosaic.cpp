@@ -0,0 +1,380 @@
+#include "yolo.hpp"
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+#include "TrtLib/common/ilogger.hpp"
+
+namespace Yolo
+{
+    using namespace std;
+
+    // 帧在画布中的缩放，不超过frame_scale，并保证整帧放得进画布
+    static float slot_scale(const cv::Size &frame, const MosaicConfig &config)
+    {
+        float scale = config.frame_scale;
+        scale = min(scale, config.canvas_width / (float)frame.width);
+        scale = min(scale, config.canvas_height / (float)frame.height);
+        return scale;
+    }
+
+    // 与AffineMatrix相同的像素中心对齐，scale为1时是纯平移
+    static void slot_affine(MosaicSlot &slot)
+    {
+        float s = slot.scale;
+        float tx = slot.region.x + s * 0.5f - 0.5f;
+        float ty = slot.region.y + s * 0.5f - 0.5f;
+        slot.i2d[0] = s;
+        slot.i2d[1] = 0;
+        slot.i2d[2] = tx;
+        slot.i2d[3] = 0;
+        slot.i2d[4] = s;
+        slot.i2d[5] = ty;
+
+        slot.d2i[0] = 1 / s;
+        slot.d2i[1] = 0;
+        slot.d2i[2] = -tx / s;
+        slot.d2i[3] = 0;
+        slot.d2i[4] = 1 / s;
+        slot.d2i[5] = -ty / s;
+    }
+
+    /* 货架式排列(FFDH)
+       1. 按缩放后的高度降序，每帧放进当前画布第一个宽度还够、高度不超过货架的货架
+       2. 都放不下时在画布底部开新的货架，画布高度不够时开新的画布
+       高度相近的子码流在一行中排满，行与行之间没有浪费的高度
+    */
+    vector<MosaicCanvas> pack_mosaic(const vector<cv::Size> &frames, const MosaicConfig &config)
+    {
+        vector<MosaicCanvas> canvases;
+        if (config.canvas_width <= 0 || config.canvas_height <= 0 || config.frame_scale <= 0)
+            return canvases;
+
+        struct Shelf
+        {
+            int y, height, x;
+        };
+
+        vector<MosaicSlot> slots;
+        for (int i = 0; i < (int)frames.size(); ++i)
+        {
+            if (frames[i].width <= 0 || frames[i].height <= 0)
+                continue;
+
+            MosaicSlot slot;
+            slot.frame = i;
+            slot.size = frames[i];
+            slot.scale = slot_scale(frames[i], config);
+            slot.region.width = max(1, min(config.canvas_width, (int)round(frames[i].width * slot.scale)));
+            slot.region.height = max(1, min(config.canvas_height, (int)round(frames[i].height * slot.scale)));
+            slots.emplace_back(slot);
+        }
+
+        stable_sort(slots.begin(), slots.end(), [](const MosaicSlot &a, const MosaicSlot &b)
+                    { return a.region.height > b.region.height; });
+
+        vector<Shelf> shelves;
+        int bottom = 0;
+        for (auto &slot : slots)
+        {
+            int w = slot.region.width;
+            int h = slot.region.height;
+            bool placed = false;
+            for (auto &shelf : shelves)
+            {
+                if (h <= shelf.height && shelf.x + w <= config.canvas_width)
+                {
+                    slot.region.x = shelf.x;
+                    slot.region.y = shelf.y;
+                    shelf.x += w + config.gap;
+                    placed = true;
+                    break;
+                }
+            }
+
+            if (!placed)
+            {
+                int y = shelves.empty() ? 0 : bottom + config.gap;
+                if (canvases.empty() || y + h > config.canvas_height)
+                {
+                    canvases.emplace_back();
+                    shelves.clear();
+                    y = 0;
+                }
+
+                shelves.push_back({y, h, w + config.gap});
+                bottom = y + h;
+                slot.region.x = 0;
+                slot.region.y = y;
+            }
+
+            slot_affine(slot);
+            canvases.back().slots.emplace_back(slot);
+        }
+        return canvases;
+    }
+
+    void render_mosaic(const vector<cv::Mat> &frames, const MosaicCanvas &layout, const MosaicConfig &config, cv::Mat &canvas)
+    {
+        canvas.create(config.canvas_height, config.canvas_width, CV_8UC3);
+        canvas.setTo(cv::Scalar(114, 114, 114));
+
+        cv::Mat scaled;
+        for (auto &slot : layout.slots)
+        {
+            const cv::Mat &frame = frames[slot.frame];
+            const cv::Mat *source = &frame;
+            if (frame.cols != slot.region.width || frame.rows != slot.region.height)
+            {
+                cv::resize(frame, scaled, slot.region.size(), 0, 0, cv::INTER_LINEAR);
+                source = &scaled;
+            }
+
+            // 按行拷贝，帧可以是ROI
+            int row_bytes = slot.region.width * 3;
+            for (int y = 0; y < slot.region.height; ++y)
+                memcpy(canvas.ptr<uint8_t>(slot.region.y + y) + slot.region.x * 3, source->ptr<uint8_t>(y), row_bytes);
+        }
+    }
+
+    int unpack_mosaic(const BoxArray &boxes, const MosaicCanvas &layout, const MosaicConfig &config, vector<BoxArray> &outputs)
+    {
+        int num_dropped = 0;
+        float margin = config.straddle_margin;
+        for (auto &box : boxes)
+        {
+            // 交集最大的区域是框所属的帧
+            const MosaicSlot *owner = nullptr;
+            float best = 0;
+            for (auto &slot : layout.slots)
+            {
+                auto &r = slot.region;
+                float iw = min(box.right, (float)(r.x + r.width)) - max(box.left, (float)r.x);
+                float ih = min(box.bottom, (float)(r.y + r.height)) - max(box.top, (float)r.y);
+                if (iw > 0 && ih > 0 && iw * ih > best)
+                {
+                    best = iw * ih;
+                    owner = &slot;
+                }
+            }
+
+            if (owner == nullptr)
+            {
+                num_dropped++;
+                continue;
+            }
+
+            auto &r = owner->region;
+            if (box.left < r.x - margin || box.top < r.y - margin ||
+                box.right > r.x + r.width + margin || box.bottom > r.y + r.height + margin)
+            {
+                num_dropped++;
+                continue;
+            }
+
+            const float *m = owner->d2i;
+            float w = owner->size.width;
+            float h = owner->size.height;
+            float left = min(max(m[0] * box.left + m[2], 0.0f), w);
+            float top = min(max(m[4] * box.top + m[5], 0.0f), h);
+            float right = min(max(m[0] * box.right + m[2], 0.0f), w);
+            float bottom = min(max(m[4] * box.bottom + m[5], 0.0f), h);
+            outputs[owner->frame].emplace_back(left, top, right, bottom, box.confidence, box.class_label);
+        }
+        return num_dropped;
+    }
+
+    struct MosaicStatistics
+    {
+        atomic<long long> num_frames{0};
+        atomic<long long> num_canvases{0};
+        atomic<long long> num_rejected_canvases{0};
+        atomic<long long> num_raw_boxes{0};
+        atomic<long long> num_straddle_boxes{0};
+        atomic<long long> filled_pixels{0};
+        atomic<long long> pack_us{0};
+        atomic<long long> unpack_us{0};
+    };
+
+    // 一张画布的布局与各帧的结果，按slots的顺序
+    struct MosaicJob
+    {
+        MosaicCanvas layout;
+        MosaicConfig config;
+        shared_ptr<JobOutcome> outcome; // 调用方的，可以为空
+        vector<promise<BoxArray>> results;
+    };
+
+    // 画布完成时把框分配回各帧，被拒绝的画布上所有帧的结果为空，调用方的outcome为rejected
+    static void finish_canvas(MosaicJob &job, BoxArray &boxes, bool rejected, MosaicStatistics &statistics)
+    {
+        int num_frames = 0;
+        for (auto &slot : job.layout.slots)
+            num_frames = max(num_frames, slot.frame + 1);
+
+        vector<BoxArray> outputs(num_frames);
+        if (rejected)
+        {
+            statistics.num_rejected_canvases++;
+        }
+        else
+        {
+            auto tick = iLogger::timestamp_now_float();
+            int num_dropped = unpack_mosaic(boxes, job.layout, job.config, outputs);
+            statistics.num_raw_boxes += boxes.size();
+            statistics.num_straddle_boxes += num_dropped;
+            statistics.unpack_us += (long long)((iLogger::timestamp_now_float() - tick) * 1000);
+        }
+
+        if (job.outcome)
+            job.outcome->set(rejected);
+
+        for (int i = 0; i < (int)job.layout.slots.size(); ++i)
+            job.results[i].set_value(std::move(outputs[job.layout.slots[i].frame]));
+    }
+
+    class MosaicInferImpl : public MosaicInfer
+    {
+    public:
+        bool startup(const shared_ptr<Infer> &infer, const MosaicConfig &config)
+        {
+            if (infer == nullptr)
+            {
+                INFOE("Infer is nullptr");
+                return false;
+            }
+
+            if (config.canvas_width <= 0 || config.canvas_height <= 0)
+            {
+                INFOE("Invalid canvas size %dx%d", config.canvas_width, config.canvas_height);
+                return false;
+            }
+
+            if (config.frame_scale <= 0 || config.gap < 0)
+            {
+                INFOE("Invalid frame scale %f or gap %d", config.frame_scale, config.gap);
+                return false;
+            }
+
+            infer_ = infer;
+            config_ = config;
+            statistics_.reset(new MosaicStatistics());
+            return true;
+        }
+
+        virtual shared_future<BoxArray> commit(const cv::Mat &image, const JobOptions &options) override
+        {
+            return commits(vector<cv::Mat>{image}, options)[0];
+        }
+
+        virtual vector<shared_future<BoxArray>> commits(const vector<cv::Mat> &images, const JobOptions &options) override
+        {
+            auto tick = iLogger::timestamp_now_float();
+            vector<cv::Size> sizes(images.size());
+            for (int i = 0; i < (int)images.size(); ++i)
+            {
+                if (!images[i].empty() && images[i].type() == CV_8UC3)
+                    sizes[i] = images[i].size();
+            }
+
+            auto layouts = pack_mosaic(sizes, config_);
+            vector<cv::Mat> canvases(layouts.size());
+            long long filled = 0;
+            for (int i = 0; i < (int)layouts.size(); ++i)
+            {
+                render_mosaic(images, layouts[i], config_, canvases[i]);
+                for (auto &slot : layouts[i].slots)
+                    filled += slot.region.area();
+            }
+            statistics_->pack_us += (long long)((iLogger::timestamp_now_float() - tick) * 1000);
+
+            /* 各画布属于同一批帧，不能互相替代：latest_only会让同一租户的画布只剩最后一个
+               每张画布有自己的outcome，调用方的outcome在画布完成时写入
+            */
+            JobOptions canvas_options = options;
+            canvas_options.latest_only = false;
+            canvas_options.outcome = nullptr;
+
+            vector<shared_future<BoxArray>> output(images.size());
+            auto statistics = statistics_;
+            for (int i = 0; i < (int)layouts.size(); ++i)
+            {
+                auto job = make_shared<MosaicJob>();
+                job->layout = layouts[i];
+                job->config = config_;
+                job->outcome = options.outcome;
+                job->results.resize(layouts[i].slots.size());
+                for (int j = 0; j < (int)layouts[i].slots.size(); ++j)
+                    output[layouts[i].slots[j].frame] = job->results[j].get_future().share();
+
+                // 画布是新分配的，由引擎持有到推理完成，原图在返回后就可以复用
+                JobOptions job_options = canvas_options;
+                job_options.outcome = JobOutcome::create();
+                auto outcome = job_options.outcome;
+                infer_->commit(canvases[i], [job, statistics, outcome](BoxArray &boxes)
+                               { finish_canvas(*job, boxes, outcome->rejected(), *statistics); },
+                               job_options, true);
+            }
+
+            // 空图和格式不对的图没有放进画布，结果为空
+            for (auto &item : output)
+            {
+                if (!item.valid())
+                {
+                    if (options.outcome)
+                        options.outcome->set(true);
+
+                    promise<BoxArray> empty;
+                    empty.set_value(BoxArray());
+                    item = empty.get_future().share();
+                }
+            }
+
+            statistics_->num_frames += images.size();
+            statistics_->num_canvases += layouts.size();
+            statistics_->filled_pixels += filled;
+            return output;
+        }
+
+        virtual MosaicConfig config() override
+        {
+            return config_;
+        }
+
+        virtual MosaicReport report(bool reset) override
+        {
+            MosaicReport output;
+            auto &s = *statistics_;
+            output.num_frames = reset ? s.num_frames.exchange(0) : s.num_frames.load();
+            output.num_canvases = reset ? s.num_canvases.exchange(0) : s.num_canvases.load();
+            output.num_rejected_canvases = reset ? s.num_rejected_canvases.exchange(0) : s.num_rejected_canvases.load();
+            output.num_raw_boxes = reset ? s.num_raw_boxes.exchange(0) : s.num_raw_boxes.load();
+            output.num_straddle_boxes = reset ? s.num_straddle_boxes.exchange(0) : s.num_straddle_boxes.load();
+            long long filled = reset ? s.filled_pixels.exchange(0) : s.filled_pixels.load();
+            output.pack_ms = (reset ? s.pack_us.exchange(0) : s.pack_us.load()) / 1000.0;
+            output.unpack_ms = (reset ? s.unpack_us.exchange(0) : s.unpack_us.load()) / 1000.0;
+            if (output.num_canvases > 0)
+            {
+                output.frames_per_canvas = output.num_frames / (float)output.num_canvases;
+                output.fill_ratio = filled / ((double)output.num_canvases * config_.canvas_width * config_.canvas_height);
+            }
+            return output;
+        }
+
+    private:
+        shared_ptr<Infer> infer_;
+        MosaicConfig config_;
+
+        // 分配在画布的回调中执行，可能晚于MosaicInfer析构，统计由回调共同持有
+        shared_ptr<MosaicStatistics> statistics_;
+    };
+
+    shared_ptr<MosaicInfer> create_mosaic_infer(const shared_ptr<Infer> &infer, const MosaicConfig &config)
+    {
+        shared_ptr<MosaicInferImpl> instance(new MosaicInferImpl());
+        if (!instance->startup(infer, config))
+        {
+            instance.reset();
+        }
+        return instance;
+    }
+}; // namespace Yolo
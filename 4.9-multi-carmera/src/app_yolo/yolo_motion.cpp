@@ -0,0 +1,403 @@
+#include "yolo.hpp"
+#include <map>
+#include <mutex>
+#include <chrono>
+#include "TrtLib/common/ilogger.hpp"
+#include "TrtLib/common/simd.hpp"
+
+namespace Yolo
+{
+    using namespace std;
+
+    const char *motion_method_name(MotionMethod method)
+    {
+        switch (method)
+        {
+        case MotionMethod::FrameDiff:
+            return "FrameDiff";
+        case MotionMethod::RunningAverage:
+            return "RunningAverage";
+        default:
+            return "Unknow";
+        }
+    }
+
+    static long long motion_now_us()
+    {
+        return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /* 降采样的亮度图上做帧差或者背景差
+       1. 每个单元隔行隔列取样，亮度为(29B + 150G + 77R) >> 8的均值，1080p、cell_size = 8时约13万次取样
+       2. 单元的差值、阈值比较与背景更新每次处理4个单元，有变化时再逐个记录外接矩形
+    */
+    class MotionDetectorImpl : public MotionDetector
+    {
+    public:
+        explicit MotionDetectorImpl(const MotionConfig &config) : config_(config)
+        {
+            config_.cell_size = max(1, config_.cell_size);
+        }
+
+        virtual MotionResult detect(const cv::Mat &image) override
+        {
+            MotionResult result;
+            if (image.empty() || image.type() != CV_8UC3)
+            {
+                INFOE("Motion detection requires a BGR image");
+                return result;
+            }
+
+            int cell = config_.cell_size;
+            int cols = (image.cols + cell - 1) / cell;
+            int rows = (image.rows + cell - 1) / cell;
+            bool first = cols != cols_ || rows != rows_;
+            cols_ = cols;
+            rows_ = rows;
+            current_.resize(cols * rows);
+            downsample(image, cell, cols, rows, current_.data());
+
+            if (first)
+            {
+                background_ = current_;
+                result.motion = true;
+                result.changed_ratio = 1;
+                result.region = cv::Rect(0, 0, image.cols, image.rows);
+                return result;
+            }
+
+            int num_cells = cols * rows;
+            int num_changed = 0;
+            int x0 = cols, y0 = rows, x1 = -1, y1 = -1;
+            auto mark = [&](int i)
+            {
+                int x = i % cols, y = i / cols;
+                x0 = min(x0, x);
+                y0 = min(y0, y);
+                x1 = max(x1, x);
+                y1 = max(y1, y);
+                num_changed++;
+            };
+
+            float alpha = config_.method == MotionMethod::RunningAverage ? config_.background_alpha : 1.0f;
+            float *bg = background_.data();
+            const float *cur = current_.data();
+            SIMD::f32x4 threshold = SIMD::set1(config_.pixel_threshold);
+            SIMD::f32x4 valpha = SIMD::set1(alpha);
+            SIMD::f32x4 vzero = SIMD::zero();
+            int i = 0;
+            for (; i + SIMD::WIDTH <= num_cells; i += SIMD::WIDTH)
+            {
+                SIMD::f32x4 c = SIMD::load(cur + i);
+                SIMD::f32x4 b = SIMD::load(bg + i);
+                SIMD::f32x4 diff = SIMD::sub(c, b);
+                SIMD::f32x4 abs_diff = SIMD::max(diff, SIMD::sub(vzero, diff));
+                int mask = SIMD::movemask(SIMD::cmpgt(abs_diff, threshold));
+                if (mask)
+                {
+                    for (int k = 0; k < SIMD::WIDTH; ++k)
+                    {
+                        if (mask & (1 << k))
+                            mark(i + k);
+                    }
+                }
+                SIMD::store(bg + i, SIMD::add(b, SIMD::mul(valpha, diff)));
+            }
+
+            for (; i < num_cells; ++i)
+            {
+                float diff = cur[i] - bg[i];
+                if (fabs(diff) > config_.pixel_threshold)
+                    mark(i);
+                bg[i] += alpha * diff;
+            }
+
+            result.changed_ratio = num_changed / (float)num_cells;
+            result.motion = num_changed > 0 && num_changed >= max(1.0f, config_.area_threshold * num_cells);
+            if (result.motion)
+            {
+                cv::Rect region(x0 * cell, y0 * cell, (x1 - x0 + 1) * cell, (y1 - y0 + 1) * cell);
+                result.region = region & cv::Rect(0, 0, image.cols, image.rows);
+            }
+            return result;
+        }
+
+        virtual void reset() override
+        {
+            cols_ = 0;
+            rows_ = 0;
+        }
+
+    private:
+        // 按行遍历，同一行单元的和累加在sums_中，访问原图是连续的
+        void downsample(const cv::Mat &image, int cell, int cols, int rows, float *output)
+        {
+            int step = cell > 1 ? 2 : 1;
+            sums_.resize(cols);
+            counts_.resize(cols);
+            for (int cy = 0; cy < rows; ++cy)
+            {
+                fill(sums_.begin(), sums_.end(), 0);
+                fill(counts_.begin(), counts_.end(), 0);
+                int y_end = min(image.rows, (cy + 1) * cell);
+                for (int y = cy * cell; y < y_end; y += step)
+                {
+                    const uint8_t *p = image.ptr<uint8_t>(y);
+                    for (int cx = 0; cx < cols; ++cx)
+                    {
+                        int x_end = min(image.cols, (cx + 1) * cell);
+                        int sum = 0, count = 0;
+                        for (int x = cx * cell; x < x_end; x += step, ++count)
+                        {
+                            const uint8_t *pixel = p + x * 3;
+                            sum += (29 * pixel[0] + 150 * pixel[1] + 77 * pixel[2]) >> 8;
+                        }
+                        sums_[cx] += sum;
+                        counts_[cx] += count;
+                    }
+                }
+
+                for (int cx = 0; cx < cols; ++cx)
+                    output[cy * cols + cx] = sums_[cx] / (float)counts_[cx];
+            }
+        }
+
+        MotionConfig config_;
+        int cols_ = 0;
+        int rows_ = 0;
+        vector<float> current_;
+        vector<float> background_; // FrameDiff时alpha为1，即上一帧
+        vector<int> sums_;
+        vector<int> counts_;
+    };
+
+    shared_ptr<MotionDetector> create_motion_detector(const MotionConfig &config)
+    {
+        return make_shared<MotionDetectorImpl>(config);
+    }
+
+    // 一路相机的状态，boxes为最近一次完成的结果，在引擎的回调中更新
+    struct CameraState
+    {
+        mutex lock;
+        MotionConfig config;
+        shared_ptr<MotionDetector> detector;
+        shared_future<BoxArray> last;
+        BoxArray boxes;
+        bool has_result = false;
+        bool force = false; // 上一次提交被拒绝或丢弃，下一帧强制整图推理
+        int skipped = 0;    // 连续跳过的帧数
+        MotionReport report;
+        double inferred_pixels = 0;
+        double total_pixels = 0;
+        long long detect_us = 0;
+    };
+
+    // 运动区域向外扩展并保证最小边长，超出图像时向内平移
+    static cv::Rect expand_region(const cv::Rect &region, const cv::Size &image, const MotionConfig &config)
+    {
+        int margin_x = region.width * config.crop_margin;
+        int margin_y = region.height * config.crop_margin;
+        int width = min(image.width, max(region.width + 2 * margin_x, config.crop_min_size));
+        int height = min(image.height, max(region.height + 2 * margin_y, config.crop_min_size));
+        int cx = region.x + region.width / 2;
+        int cy = region.y + region.height / 2;
+        int x = min(max(0, cx - width / 2), image.width - width);
+        int y = min(max(0, cy - height / 2), image.height - height);
+        return cv::Rect(x, y, width, height);
+    }
+
+    class MotionGatedInferImpl : public MotionGatedInfer
+    {
+    public:
+        bool startup(const shared_ptr<Infer> &infer, const MotionConfig &config)
+        {
+            if (infer == nullptr)
+            {
+                INFOE("Infer is nullptr");
+                return false;
+            }
+
+            infer_ = infer;
+            default_config_ = config;
+            return true;
+        }
+
+        virtual shared_future<BoxArray> commit(int camera, const cv::Mat &image, const JobOptions &options) override
+        {
+            auto state = camera_state(camera);
+            cv::Rect region;
+            shared_ptr<promise<BoxArray>> pro;
+            {
+                unique_lock<mutex> l(state->lock);
+                auto &report = state->report;
+                auto tick = motion_now_us();
+                MotionResult motion = state->detector->detect(image);
+                state->detect_us += motion_now_us() - tick;
+                report.num_frames++;
+                state->total_pixels += image.total();
+
+                bool refresh = state->config.max_skip_frames > 0 && state->skipped >= state->config.max_skip_frames;
+                bool forced = !motion.motion && (state->force || refresh || !state->has_result);
+                if (!motion.motion && !forced)
+                {
+                    state->skipped++;
+                    report.num_skipped++;
+                    return state->last;
+                }
+
+                // 只有已经有结果时才能只推理局部，区域外沿用上一次的结果
+                if (state->config.crop && !forced && !state->force && state->has_result)
+                {
+                    region = expand_region(motion.region, image.size(), state->config);
+                    if (region.area() > state->config.crop_max_area * image.total())
+                        region = cv::Rect();
+                }
+
+                if (region.area() > 0 && region.area() < (int)image.total())
+                {
+                    report.num_cropped++;
+                    state->inferred_pixels += region.area();
+                }
+                else
+                {
+                    region = cv::Rect();
+                    report.num_full++;
+                    report.num_forced += forced;
+                    state->inferred_pixels += image.total();
+                }
+
+                state->skipped = 0;
+                state->force = false;
+                state->has_result = true;
+                pro = make_shared<promise<BoxArray>>();
+                state->last = pro->get_future().share();
+            }
+
+            /* 回调可能在commit返回前同步执行(被拒绝时)，因此在锁外提交
+               提交之后才被丢弃(排队超时、被更新的帧替代、取消)时回调的boxes同样为空，由outcome区分
+               被拒绝时沿用上一次的结果，下一帧强制整图推理
+            */
+            auto result = state->last;
+            JobOptions job_options = options;
+            job_options.outcome = JobOutcome::create();
+            auto outcome = job_options.outcome;
+            auto caller_outcome = options.outcome;
+            auto callback = [state, pro, region, outcome, caller_outcome](BoxArray &boxes)
+            {
+                BoxArray output;
+                bool rejected = outcome->rejected();
+                if (rejected)
+                {
+                    unique_lock<mutex> l(state->lock);
+                    output = state->boxes;
+                    state->force = true;
+                }
+                else
+                {
+                    if (region.area() > 0)
+                    {
+                        unique_lock<mutex> l(state->lock);
+                        for (auto &box : state->boxes)
+                        {
+                            float cx = (box.left + box.right) * 0.5f;
+                            float cy = (box.top + box.bottom) * 0.5f;
+                            if (cx < region.x || cx >= region.x + region.width || cy < region.y || cy >= region.y + region.height)
+                                output.emplace_back(box);
+                        }
+                    }
+
+                    float dx = region.x, dy = region.y;
+                    for (auto &box : boxes)
+                        output.emplace_back(box.left + dx, box.top + dy, box.right + dx, box.bottom + dy, box.confidence, box.class_label);
+
+                    unique_lock<mutex> l(state->lock);
+                    state->boxes = output;
+                }
+
+                if (caller_outcome)
+                    caller_outcome->set(rejected);
+                pro->set_value(std::move(output));
+            };
+
+            infer_->commit(region.area() > 0 ? image(region) : image, callback, job_options);
+            return result;
+        }
+
+        virtual void set_camera_config(int camera, const MotionConfig &config) override
+        {
+            auto state = camera_state(camera);
+            unique_lock<mutex> l(state->lock);
+            state->config = config;
+            state->detector = create_motion_detector(config);
+        }
+
+        virtual MotionReport report(int camera, bool reset) override
+        {
+            auto state = camera_state(camera);
+            unique_lock<mutex> l(state->lock);
+            MotionReport output = state->report;
+            output.camera = camera;
+            if (output.num_frames > 0)
+            {
+                output.skip_rate = output.num_skipped / (float)output.num_frames;
+                output.detect_us = state->detect_us / (float)output.num_frames;
+            }
+            if (state->total_pixels > 0)
+                output.inferred_area = state->inferred_pixels / state->total_pixels;
+
+            if (reset)
+            {
+                state->report = MotionReport();
+                state->inferred_pixels = 0;
+                state->total_pixels = 0;
+                state->detect_us = 0;
+            }
+            return output;
+        }
+
+        virtual vector<MotionReport> reports(bool reset) override
+        {
+            vector<int> cameras;
+            {
+                unique_lock<mutex> l(lock_);
+                for (auto &item : cameras_)
+                    cameras.push_back(item.first);
+            }
+
+            vector<MotionReport> output;
+            for (int camera : cameras)
+                output.emplace_back(report(camera, reset));
+            return output;
+        }
+
+    private:
+        shared_ptr<CameraState> camera_state(int camera)
+        {
+            unique_lock<mutex> l(lock_);
+            auto &state = cameras_[camera];
+            if (state == nullptr)
+            {
+                state = make_shared<CameraState>();
+                state->config = default_config_;
+                state->detector = create_motion_detector(default_config_);
+            }
+            return state;
+        }
+
+        shared_ptr<Infer> infer_;
+        MotionConfig default_config_;
+        mutex lock_;
+        map<int, shared_ptr<CameraState>> cameras_;
+    };
+
+    shared_ptr<MotionGatedInfer> create_motion_gated_infer(const shared_ptr<Infer> &infer, const MotionConfig &default_config)
+    {
+        shared_ptr<MotionGatedInferImpl> instance(new MotionGatedInferImpl());
+        if (!instance->startup(infer, default_config))
+        {
+            instance.reset();
+        }
+        return instance;
+    }
+}; // namespace Yolo
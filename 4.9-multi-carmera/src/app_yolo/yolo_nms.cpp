@@ -0,0 +1,624 @@
+#include "yolo.hpp"
+#include <cmath>
+#include <algorithm>
+#include "TrtLib/common/ilogger.hpp"
+#include "TrtLib/common/simd.hpp"
+#include "TrtLib/common/parallel_for.hpp"
+
+/**
+ * 快速的CPU NMS
+ * 解决的问题：
+ * cpu_nms排序后两两计算IoU，每一对都要判断类别，max_objects=1024、置信度阈值较低时每张图需要几个毫秒
+ *
+ * 设计思路：
+ * 1. 排序与cpu_nms_inplace完全相同，之后按类别稳定地分桶，每个类别内仍是置信度降序，不同类别之间不再比较
+ * 2. 每个类别的框与已保留的框都是SoA布局(left/top/right/bottom/area各一个数组)，一次计算4个框的IoU，见simd.hpp
+ * 3. 框较多的类别建立均匀网格(格子边长为框的平均宽高)，已保留的框登记到它覆盖的格子里，候选框只与覆盖相同格子的框比较
+ *    IoU >= threshold > 0需要交集面积大于0，交集内的点同时落在两个框覆盖的格子里，所以不会漏掉
+ *    覆盖格子过多的大框单独放在一个列表里，每个候选框都与它们比较
+ * 4. IoU的每一步运算与iou()相同(IEEE单精度的加减乘除，交集为0时IoU为0)，保留的框、顺序与cpu_nms_inplace逐位一致
+ * 5. 中间数组放在线程局部的工作区中，稳态下不分配内存
+ * 6. DIoU-NMS与class-agnostic NMS沿用同样的分桶、SIMD与网格，DIoU <= IoU，threshold > 0时网格同样不会漏掉
+ * 7. soft nms每一轮对剩余的框一次衰减4个，gaussian的exp也是向量化的，见SIMD::exp
+ **/
+
+namespace Yolo
+{
+    using namespace std;
+
+    static const int GRID_MIN_BOXES = 64;       // 类别内框的数量达到这个值才使用网格
+    static const int GRID_MAX_SIDE = 64;        // 每个方向最多的格子数
+    static const int GRID_MAX_CELLS = 16;       // 覆盖超过这么多格子的已保留框放到大框列表
+    static const int QUERY_MAX_CELLS = 64;      // 覆盖超过这么多格子的候选框直接与全部已保留框比较
+    static const int MAX_BUCKET_LABELS = 65536; // 类别号的跨度小于这个值时用计数排序分桶
+    static const float SOFT_NMS_SIGMA = 0.5f;   // cpu_nms_method中gaussian soft nms的sigma
+
+    struct BoxSoA
+    {
+        vector<float> left, top, right, bottom, area;
+        int size = 0;
+
+        void resize(int n)
+        {
+            if ((int)left.size() < n)
+            {
+                left.resize(n);
+                top.resize(n);
+                right.resize(n);
+                bottom.resize(n);
+                area.resize(n);
+            }
+            size = 0;
+        }
+
+        void push(float l, float t, float r, float b, float a)
+        {
+            left[size] = l;
+            top[size] = t;
+            right[size] = r;
+            bottom[size] = b;
+            area[size] = a;
+            size++;
+        }
+    };
+
+    struct NMSWorkspace
+    {
+        vector<int> counts;
+        vector<int> offsets;
+        vector<int> index; // 分桶后的位置 -> 排序后的位置
+        vector<unsigned char> keep;
+        BoxSoA boxes;
+        vector<float> scores; // 与boxes对应的置信度，soft nms中逐步衰减
+        BoxSoA kept;
+        BoxSoA gathered;
+
+        vector<int> cell_head;
+        vector<int> node_next;
+        vector<int> node_kept;
+        vector<int> wide;
+        vector<int> stamp;
+
+        vector<pair<int, float>> selected; // soft nms选出的框与衰减后的置信度
+        BoxArray scratch;
+    };
+
+    static NMSWorkspace &workspace()
+    {
+        thread_local NMSWorkspace ws;
+        return ws;
+    }
+
+    // 与yolo.cpp中的iou相同的面积公式
+    static inline float box_area(float left, float top, float right, float bottom)
+    {
+        return max(0.0f, right - left) * max(0.0f, bottom - top);
+    }
+
+    // 与iou(a, b) >= threshold逐位一致
+    static inline bool iou_ge(const BoxSoA &a, int i, float left, float top, float right, float bottom, float area, float threshold)
+    {
+        float cleft = max(a.left[i], left);
+        float ctop = max(a.top[i], top);
+        float cright = min(a.right[i], right);
+        float cbottom = min(a.bottom[i], bottom);
+
+        float c_area = max(cright - cleft, 0.0f) * max(cbottom - ctop, 0.0f);
+        if (c_area == 0.0f)
+            return 0.0f >= threshold;
+        return c_area / (a.area[i] + area - c_area) >= threshold;
+    }
+
+    /* DIoU = IoU - 中心距离的平方 / 最小外接框对角线的平方
+       运算顺序与overlaps_diou相同，包围框退化为一个点时惩罚项为0
+    */
+    static inline bool diou_ge(const BoxSoA &a, int i, float left, float top, float right, float bottom, float area, float threshold)
+    {
+        float cleft = max(a.left[i], left);
+        float ctop = max(a.top[i], top);
+        float cright = min(a.right[i], right);
+        float cbottom = min(a.bottom[i], bottom);
+
+        float c_area = max(cright - cleft, 0.0f) * max(cbottom - ctop, 0.0f);
+        float iou = c_area == 0.0f ? 0.0f : c_area / (a.area[i] + area - c_area);
+
+        float ew = max(a.right[i], right) - min(a.left[i], left);
+        float eh = max(a.bottom[i], bottom) - min(a.top[i], top);
+        float c2 = ew * ew + eh * eh;
+        float dx = (a.left[i] + a.right[i]) - (left + right);
+        float dy = (a.top[i] + a.bottom[i]) - (top + bottom);
+        float rho2 = (dx * dx + dy * dy) * 0.25f;
+        float penalty = c2 > 0.0f ? rho2 / c2 : 0.0f;
+        return iou - penalty >= threshold;
+    }
+
+    // a中是否存在与给定框IoU >= threshold的框，一次比较4个
+    static bool overlaps_iou(const BoxSoA &a, float left, float top, float right, float bottom, float area, float threshold)
+    {
+        SIMD::f32x4 bl = SIMD::set1(left), bt = SIMD::set1(top), br = SIMD::set1(right), bb = SIMD::set1(bottom), barea = SIMD::set1(area);
+        SIMD::f32x4 thr = SIMD::set1(threshold), fzero = SIMD::zero();
+        bool zero_overlaps = 0.0f >= threshold;
+
+        int i = 0;
+        for (; i + SIMD::WIDTH <= a.size; i += SIMD::WIDTH)
+        {
+            SIMD::f32x4 cleft = SIMD::max(SIMD::load(&a.left[i]), bl);
+            SIMD::f32x4 ctop = SIMD::max(SIMD::load(&a.top[i]), bt);
+            SIMD::f32x4 cright = SIMD::min(SIMD::load(&a.right[i]), br);
+            SIMD::f32x4 cbottom = SIMD::min(SIMD::load(&a.bottom[i]), bb);
+            SIMD::f32x4 c_area = SIMD::mul(SIMD::max(SIMD::sub(cright, cleft), fzero), SIMD::max(SIMD::sub(cbottom, ctop), fzero));
+            SIMD::f32x4 iou = SIMD::div(c_area, SIMD::sub(SIMD::add(SIMD::load(&a.area[i]), barea), c_area));
+            SIMD::f32x4 empty = SIMD::cmpeq(c_area, fzero);
+            SIMD::f32x4 hit = SIMD::cmpge(iou, thr);
+            hit = zero_overlaps ? SIMD::bit_or(hit, empty) : SIMD::bit_andnot(empty, hit);
+            if (SIMD::movemask(hit))
+                return true;
+        }
+
+        for (; i < a.size; ++i)
+        {
+            if (iou_ge(a, i, left, top, right, bottom, area, threshold))
+                return true;
+        }
+        return false;
+    }
+
+    // a中是否存在与给定框DIoU >= threshold的框
+    static bool overlaps_diou(const BoxSoA &a, float left, float top, float right, float bottom, float area, float threshold)
+    {
+        SIMD::f32x4 bl = SIMD::set1(left), bt = SIMD::set1(top), br = SIMD::set1(right), bb = SIMD::set1(bottom), barea = SIMD::set1(area);
+        SIMD::f32x4 bsum_x = SIMD::set1(left + right), bsum_y = SIMD::set1(top + bottom);
+        SIMD::f32x4 thr = SIMD::set1(threshold), fzero = SIMD::zero(), quarter = SIMD::set1(0.25f);
+
+        int i = 0;
+        for (; i + SIMD::WIDTH <= a.size; i += SIMD::WIDTH)
+        {
+            SIMD::f32x4 al = SIMD::load(&a.left[i]), at = SIMD::load(&a.top[i]);
+            SIMD::f32x4 ar = SIMD::load(&a.right[i]), ab = SIMD::load(&a.bottom[i]);
+            SIMD::f32x4 cleft = SIMD::max(al, bl);
+            SIMD::f32x4 ctop = SIMD::max(at, bt);
+            SIMD::f32x4 cright = SIMD::min(ar, br);
+            SIMD::f32x4 cbottom = SIMD::min(ab, bb);
+            SIMD::f32x4 c_area = SIMD::mul(SIMD::max(SIMD::sub(cright, cleft), fzero), SIMD::max(SIMD::sub(cbottom, ctop), fzero));
+            SIMD::f32x4 iou = SIMD::div(c_area, SIMD::sub(SIMD::add(SIMD::load(&a.area[i]), barea), c_area));
+            iou = SIMD::bit_andnot(SIMD::cmpeq(c_area, fzero), iou);
+
+            SIMD::f32x4 ew = SIMD::sub(SIMD::max(ar, br), SIMD::min(al, bl));
+            SIMD::f32x4 eh = SIMD::sub(SIMD::max(ab, bb), SIMD::min(at, bt));
+            SIMD::f32x4 c2 = SIMD::add(SIMD::mul(ew, ew), SIMD::mul(eh, eh));
+            SIMD::f32x4 dx = SIMD::sub(SIMD::add(al, ar), bsum_x);
+            SIMD::f32x4 dy = SIMD::sub(SIMD::add(at, ab), bsum_y);
+            SIMD::f32x4 rho2 = SIMD::mul(SIMD::add(SIMD::mul(dx, dx), SIMD::mul(dy, dy)), quarter);
+            SIMD::f32x4 penalty = SIMD::bit_and(SIMD::cmpgt(c2, fzero), SIMD::div(rho2, c2));
+            if (SIMD::movemask(SIMD::cmpge(SIMD::sub(iou, penalty), thr)))
+                return true;
+        }
+
+        for (; i < a.size; ++i)
+        {
+            if (diou_ge(a, i, left, top, right, bottom, area, threshold))
+                return true;
+        }
+        return false;
+    }
+
+    template <bool _DIoU>
+    static inline bool overlaps_any(const BoxSoA &a, float left, float top, float right, float bottom, float area, float threshold)
+    {
+        return _DIoU ? overlaps_diou(a, left, top, right, bottom, area, threshold) : overlaps_iou(a, left, top, right, bottom, area, threshold);
+    }
+
+    // 一个类别内的greedy nms，[begin, end)为分桶后的范围，保留的框在keep中标记
+    template <bool _DIoU>
+    static void nms_class_linear(NMSWorkspace &ws, int begin, int end, float threshold)
+    {
+        auto &boxes = ws.boxes;
+        auto &kept = ws.kept;
+        kept.resize(end - begin);
+        for (int i = begin; i < end; ++i)
+        {
+            float l = boxes.left[i], t = boxes.top[i], r = boxes.right[i], b = boxes.bottom[i], a = boxes.area[i];
+            if (overlaps_any<_DIoU>(kept, l, t, r, b, a, threshold))
+                continue;
+
+            kept.push(l, t, r, b, a);
+            ws.keep[ws.index[i]] = 1;
+        }
+    }
+
+    // 与nms_class_linear结果相同，要求threshold > 0
+    template <bool _DIoU>
+    static void nms_class_grid(NMSWorkspace &ws, int begin, int end, float threshold)
+    {
+        auto &boxes = ws.boxes;
+        float minx = boxes.left[begin], miny = boxes.top[begin];
+        float maxx = boxes.right[begin], maxy = boxes.bottom[begin];
+        double sum_width = 0, sum_height = 0;
+        for (int i = begin; i < end; ++i)
+        {
+            if (!std::isfinite(boxes.left[i]) || !std::isfinite(boxes.top[i]) || !std::isfinite(boxes.right[i]) || !std::isfinite(boxes.bottom[i]))
+                return nms_class_linear<_DIoU>(ws, begin, end, threshold);
+
+            minx = min(minx, boxes.left[i]);
+            miny = min(miny, boxes.top[i]);
+            maxx = max(maxx, boxes.right[i]);
+            maxy = max(maxy, boxes.bottom[i]);
+            sum_width += max(0.0f, boxes.right[i] - boxes.left[i]);
+            sum_height += max(0.0f, boxes.bottom[i] - boxes.top[i]);
+        }
+
+        int n = end - begin;
+        if (!(maxx > minx) || !(maxy > miny))
+            return nms_class_linear<_DIoU>(ws, begin, end, threshold);
+
+        // 格子的边长取框的平均宽高，多数框只覆盖2x2个格子
+        float mean_width = max(1e-6, sum_width / n), mean_height = max(1e-6, sum_height / n);
+        int grid_x = max(1, min(GRID_MAX_SIDE, (int)((maxx - minx) / mean_width)));
+        int grid_y = max(1, min(GRID_MAX_SIDE, (int)((maxy - miny) / mean_height)));
+        if (grid_x * grid_y < 4)
+            return nms_class_linear<_DIoU>(ws, begin, end, threshold);
+
+        // 坐标到格子的映射单调不减，交集内的点所在的格子一定在两个框的格子范围内
+        float scale_x = grid_x / (maxx - minx);
+        float scale_y = grid_y / (maxy - miny);
+        auto cell_x = [&](float x)
+        { return min(max((int)((x - minx) * scale_x), 0), grid_x - 1); };
+        auto cell_y = [&](float y)
+        { return min(max((int)((y - miny) * scale_y), 0), grid_y - 1); };
+
+        auto &kept = ws.kept;
+        auto &gathered = ws.gathered;
+        kept.resize(n);
+        gathered.resize(n);
+        ws.cell_head.assign(grid_x * grid_y, -1);
+        ws.node_next.clear();
+        ws.node_kept.clear();
+        ws.wide.clear();
+        ws.stamp.assign(n, -1);
+
+        for (int i = begin; i < end; ++i)
+        {
+            float l = boxes.left[i], t = boxes.top[i], r = boxes.right[i], b = boxes.bottom[i], a = boxes.area[i];
+            int x0 = cell_x(l), x1 = cell_x(r), y0 = cell_y(t), y1 = cell_y(b);
+            int num_cells = max(0, x1 - x0 + 1) * max(0, y1 - y0 + 1);
+
+            bool suppressed;
+            if (num_cells > QUERY_MAX_CELLS)
+            {
+                suppressed = overlaps_any<_DIoU>(kept, l, t, r, b, a, threshold);
+            }
+            else
+            {
+                gathered.size = 0;
+                auto gather = [&](int k)
+                {
+                    if (ws.stamp[k] == i)
+                        return;
+                    ws.stamp[k] = i;
+                    gathered.push(kept.left[k], kept.top[k], kept.right[k], kept.bottom[k], kept.area[k]);
+                };
+
+                for (int k : ws.wide)
+                    gather(k);
+
+                for (int y = y0; y <= y1; ++y)
+                {
+                    for (int x = x0; x <= x1; ++x)
+                    {
+                        for (int node = ws.cell_head[y * grid_x + x]; node != -1; node = ws.node_next[node])
+                            gather(ws.node_kept[node]);
+                    }
+                }
+                suppressed = overlaps_any<_DIoU>(gathered, l, t, r, b, a, threshold);
+            }
+
+            if (suppressed)
+                continue;
+
+            int k = kept.size;
+            kept.push(l, t, r, b, a);
+            ws.keep[ws.index[i]] = 1;
+            if (num_cells > GRID_MAX_CELLS)
+            {
+                ws.wide.push_back(k);
+                continue;
+            }
+
+            for (int y = y0; y <= y1; ++y)
+            {
+                for (int x = x0; x <= x1; ++x)
+                {
+                    int cell = y * grid_x + x;
+                    ws.node_next.push_back(ws.cell_head[cell]);
+                    ws.node_kept.push_back(k);
+                    ws.cell_head[cell] = (int)ws.node_kept.size() - 1;
+                }
+            }
+        }
+    }
+
+    /* 按类别稳定地分桶到ws.boxes与ws.scores，返回桶的数量，第c个桶为[offsets[c], offsets[c + 1])
+       class_agnostic时所有框在同一个桶里
+    */
+    static int bucket_by_class(NMSWorkspace &ws, const BoxArray &boxes, bool class_agnostic)
+    {
+        int n = boxes.size();
+        ws.index.resize(n);
+        ws.keep.assign(n, 0);
+        ws.boxes.resize(n);
+        ws.scores.resize(n);
+
+        auto label = [&](int i)
+        { return class_agnostic ? 0 : boxes[i].class_label; };
+
+        int min_label = label(0), max_label = label(0);
+        for (int i = 1; i < n; ++i)
+        {
+            min_label = min(min_label, label(i));
+            max_label = max(max_label, label(i));
+        }
+
+        int num_buckets = 0;
+        if ((long long)max_label - min_label < MAX_BUCKET_LABELS)
+        {
+            // 计数排序
+            num_buckets = max_label - min_label + 1;
+            ws.counts.assign(num_buckets, 0);
+            ws.offsets.resize(num_buckets + 1);
+            for (int i = 0; i < n; ++i)
+                ws.counts[label(i) - min_label]++;
+
+            ws.offsets[0] = 0;
+            for (int c = 0; c < num_buckets; ++c)
+                ws.offsets[c + 1] = ws.offsets[c] + ws.counts[c];
+
+            ws.counts.assign(num_buckets, 0);
+            for (int i = 0; i < n; ++i)
+            {
+                int c = label(i) - min_label;
+                ws.index[ws.offsets[c] + ws.counts[c]++] = i;
+            }
+        }
+        else
+        {
+            // 类别号的跨度过大，按类别号稳定排序
+            for (int i = 0; i < n; ++i)
+                ws.index[i] = i;
+
+            std::stable_sort(ws.index.begin(), ws.index.end(), [&](int a, int b)
+                             { return label(a) < label(b); });
+
+            ws.offsets.clear();
+            for (int pos = 0; pos < n; ++pos)
+            {
+                if (pos == 0 || label(ws.index[pos]) != label(ws.index[pos - 1]))
+                    ws.offsets.push_back(pos);
+            }
+            num_buckets = ws.offsets.size();
+            ws.offsets.push_back(n);
+        }
+
+        auto &soa = ws.boxes;
+        for (int pos = 0; pos < n; ++pos)
+        {
+            auto &box = boxes[ws.index[pos]];
+            soa.left[pos] = box.left;
+            soa.top[pos] = box.top;
+            soa.right[pos] = box.right;
+            soa.bottom[pos] = box.bottom;
+            soa.area[pos] = box_area(box.left, box.top, box.right, box.bottom);
+            ws.scores[pos] = box.confidence;
+        }
+        return num_buckets;
+    }
+
+    template <bool _DIoU>
+    static void greedy_nms(BoxArray &boxes, float threshold, bool class_agnostic)
+    {
+        std::sort(boxes.begin(), boxes.end(), [](BoxArray::const_reference a, BoxArray::const_reference b)
+                  { return a.confidence > b.confidence; });
+
+        int n = boxes.size();
+        if (n == 0)
+            return;
+
+        auto &ws = workspace();
+        int num_buckets = bucket_by_class(ws, boxes, class_agnostic);
+        for (int c = 0; c < num_buckets; ++c)
+        {
+            int begin = ws.offsets[c], end = ws.offsets[c + 1];
+            if (end - begin >= GRID_MIN_BOXES && threshold > 0)
+                nms_class_grid<_DIoU>(ws, begin, end, threshold);
+            else if (end > begin)
+                nms_class_linear<_DIoU>(ws, begin, end, threshold);
+        }
+
+        int num_keep = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            if (ws.keep[i])
+                boxes[num_keep++] = boxes[i];
+        }
+        boxes.resize(num_keep);
+    }
+
+    void cpu_nms_fast(BoxArray &boxes, float threshold)
+    {
+        greedy_nms<false>(boxes, threshold, false);
+    }
+
+    void cpu_nms_agnostic(BoxArray &boxes, float threshold)
+    {
+        greedy_nms<false>(boxes, threshold, true);
+    }
+
+    void cpu_diou_nms(BoxArray &boxes, float threshold, bool class_agnostic)
+    {
+        greedy_nms<true>(boxes, threshold, class_agnostic);
+    }
+
+    /* 一个类别内的soft nms，[begin, end)为分桶后的范围，选出的框追加到ws.selected
+       每次选出剩余框中置信度最高的一个，其余框的置信度乘以衰减系数，低于score_threshold的框删除
+       删除时用最后一个框填补空位，剩余框的顺序不重要
+    */
+    static void soft_nms_class(NMSWorkspace &ws, int begin, int end, float threshold, bool gaussian, float sigma, float score_threshold)
+    {
+        float *left = &ws.boxes.left[begin];
+        float *top = &ws.boxes.top[begin];
+        float *right = &ws.boxes.right[begin];
+        float *bottom = &ws.boxes.bottom[begin];
+        float *area = &ws.boxes.area[begin];
+        float *score = &ws.scores[begin];
+        int *index = &ws.index[begin];
+        int n = end - begin;
+
+        auto remove = [&](int i)
+        {
+            n--;
+            left[i] = left[n];
+            top[i] = top[n];
+            right[i] = right[n];
+            bottom[i] = bottom[n];
+            area[i] = area[n];
+            score[i] = score[n];
+            index[i] = index[n];
+        };
+
+        // 从后往前删除，换过来的框已经检查过
+        auto remove_low_scores = [&]()
+        {
+            for (int i = n - 1; i >= 0; --i)
+            {
+                if (!(score[i] >= score_threshold))
+                    remove(i);
+            }
+        };
+
+        SIMD::f32x4 fzero = SIMD::zero(), one = SIMD::set1(1.0f), thr = SIMD::set1(threshold);
+        SIMD::f32x4 neg_inv_sigma = SIMD::set1(-1.0f / sigma);
+
+        // 4个框的衰减，l/t/r/b/a/s指向4个连续的框
+        auto decay = [&](const float *l, const float *t, const float *r, const float *b, const float *a, float *s,
+                         SIMD::f32x4 bl, SIMD::f32x4 bt, SIMD::f32x4 br, SIMD::f32x4 bb, SIMD::f32x4 barea)
+        {
+            SIMD::f32x4 cleft = SIMD::max(SIMD::load(l), bl);
+            SIMD::f32x4 ctop = SIMD::max(SIMD::load(t), bt);
+            SIMD::f32x4 cright = SIMD::min(SIMD::load(r), br);
+            SIMD::f32x4 cbottom = SIMD::min(SIMD::load(b), bb);
+            SIMD::f32x4 c_area = SIMD::mul(SIMD::max(SIMD::sub(cright, cleft), fzero), SIMD::max(SIMD::sub(cbottom, ctop), fzero));
+            SIMD::f32x4 iou = SIMD::div(c_area, SIMD::sub(SIMD::add(SIMD::load(a), barea), c_area));
+            iou = SIMD::bit_andnot(SIMD::cmpeq(c_area, fzero), iou);
+
+            SIMD::f32x4 weight;
+            if (gaussian)
+                weight = SIMD::exp(SIMD::mul(SIMD::mul(iou, iou), neg_inv_sigma));
+            else
+                weight = SIMD::select(SIMD::cmpgt(iou, thr), SIMD::sub(one, iou), one);
+            SIMD::store(s, SIMD::mul(SIMD::load(s), weight));
+        };
+
+        remove_low_scores();
+        while (n > 0)
+        {
+            SIMD::f32x4 vmax = SIMD::set1(score[0]);
+            int i = 0;
+            for (; i + SIMD::WIDTH <= n; i += SIMD::WIDTH)
+                vmax = SIMD::max(vmax, SIMD::load(&score[i]));
+
+            float best_score = SIMD::reduce_max(vmax);
+            for (; i < n; ++i)
+                best_score = max(best_score, score[i]);
+
+            int best = 0;
+            while (score[best] != best_score)
+                best++;
+
+            ws.selected.emplace_back(index[best], best_score);
+            SIMD::f32x4 bl = SIMD::set1(left[best]), bt = SIMD::set1(top[best]), br = SIMD::set1(right[best]);
+            SIMD::f32x4 bb = SIMD::set1(bottom[best]), barea = SIMD::set1(area[best]);
+            remove(best);
+
+            i = 0;
+            for (; i + SIMD::WIDTH <= n; i += SIMD::WIDTH)
+                decay(&left[i], &top[i], &right[i], &bottom[i], &area[i], &score[i], bl, bt, br, bb, barea);
+
+            // 不足4个的尾部复制到临时数组中计算，结果与整组计算相同
+            int tail = n - i;
+            if (tail > 0)
+            {
+                float l[4] = {0}, t[4] = {0}, r[4] = {0}, b[4] = {0}, a[4] = {0}, s[4] = {0};
+                for (int k = 0; k < tail; ++k)
+                {
+                    l[k] = left[i + k];
+                    t[k] = top[i + k];
+                    r[k] = right[i + k];
+                    b[k] = bottom[i + k];
+                    a[k] = area[i + k];
+                    s[k] = score[i + k];
+                }
+
+                decay(l, t, r, b, a, s, bl, bt, br, bb, barea);
+                for (int k = 0; k < tail; ++k)
+                    score[i + k] = s[k];
+            }
+            remove_low_scores();
+        }
+    }
+
+    void cpu_soft_nms(BoxArray &boxes, float threshold, bool gaussian, float sigma, float score_threshold, bool class_agnostic)
+    {
+        int n = boxes.size();
+        if (n == 0)
+            return;
+
+        auto &ws = workspace();
+        int num_buckets = bucket_by_class(ws, boxes, class_agnostic);
+        ws.selected.clear();
+        for (int c = 0; c < num_buckets; ++c)
+            soft_nms_class(ws, ws.offsets[c], ws.offsets[c + 1], threshold, gaussian, sigma, score_threshold);
+
+        // 每个类别内选出的顺序已经是置信度降序，合并所有类别
+        std::stable_sort(ws.selected.begin(), ws.selected.end(), [](const pair<int, float> &a, const pair<int, float> &b)
+                         { return a.second > b.second; });
+
+        ws.scratch = boxes;
+        boxes.resize(ws.selected.size());
+        for (int i = 0; i < (int)ws.selected.size(); ++i)
+        {
+            boxes[i] = ws.scratch[ws.selected[i].first];
+            boxes[i].confidence = ws.selected[i].second;
+        }
+    }
+
+    void cpu_nms_method(BoxArray &boxes, NMSMethod method, float threshold, float score_threshold)
+    {
+        switch (method)
+        {
+        case NMSMethod::CPU:
+            cpu_nms_fast(boxes, threshold);
+            break;
+        case NMSMethod::SoftLinear:
+            cpu_soft_nms(boxes, threshold, false, SOFT_NMS_SIGMA, score_threshold);
+            break;
+        case NMSMethod::SoftGaussian:
+            cpu_soft_nms(boxes, threshold, true, SOFT_NMS_SIGMA, score_threshold);
+            break;
+        case NMSMethod::DIoU:
+            cpu_diou_nms(boxes, threshold);
+            break;
+        case NMSMethod::ClassAgnostic:
+            cpu_nms_agnostic(boxes, threshold);
+            break;
+        default:
+            // FastGPU已经在解码后完成
+            break;
+        }
+    }
+
+    void cpu_nms_batch(const vector<BoxArray *> &batch, float threshold, int num_threads)
+    {
+        parallel_for(batch.size(), num_threads, [&](int i)
+                     { cpu_nms_fast(*batch[i], threshold); });
+    }
+
+}; // namespace Yolo
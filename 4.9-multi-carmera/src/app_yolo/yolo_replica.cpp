@@ -0,0 +1,463 @@
+#include "yolo.hpp"
+#include <atomic>
+#include "TrtLib/common/ilogger.hpp"
+
+namespace Yolo
+{
+    using namespace std;
+
+    typedef ReplicaSet<Infer> InferReplicaSet;
+
+    /* 一次提交，在副本的回调与提交线程之间传递结果
+       副本被拒绝时回调在commit返回前同步执行，此时需要根据commit的返回值决定换副本重试还是交付结果，
+       因此回调和commit返回两者中后发生的一方负责收尾
+    */
+    struct ReplicaJob
+    {
+        enum State : int
+        {
+            Submitting = 0, // 副本的commit还未返回
+            Submitted = 1,  // commit已经返回，等待回调
+            Finished = 2    // 回调已经执行
+        };
+
+        InferReplicaSet *replicas = nullptr; // 副本集析构时先停止副本，回调不会晚于副本集
+        Infer::Callback callback;
+        shared_ptr<promise<BoxArray>> pro;
+        BoxArray boxes;
+        int index = -1;
+        long long dispatch_us = 0;
+        atomic<int> state{Submitting};
+
+        void deliver()
+        {
+            if (callback)
+                callback(boxes);
+            else
+                pro->set_value(std::move(boxes));
+        }
+
+        void finish()
+        {
+            replicas->release(index, CommitStatus::Accepted, StageStatistics::now_us() - dispatch_us);
+            deliver();
+        }
+    };
+
+    // 副本的直方图无法跨实例合并，均值按数量加权，分位数与最大值取各副本中最大的，作为上界
+    static void merge_summary(LatencySummary &output, const LatencySummary &other)
+    {
+        if (other.count == 0)
+            return;
+
+        long long count = output.count + other.count;
+        output.mean_ms = (output.mean_ms * output.count + other.mean_ms * other.count) / count;
+        output.p50_ms = max(output.p50_ms, other.p50_ms);
+        output.p90_ms = max(output.p90_ms, other.p90_ms);
+        output.p99_ms = max(output.p99_ms, other.p99_ms);
+        output.p999_ms = max(output.p999_ms, other.p999_ms);
+        output.max_ms = max(output.max_ms, other.max_ms);
+        output.count = count;
+    }
+
+    static void merge_stage(StageReport &output, const StageReport &other)
+    {
+        if (output.name.empty())
+            output.name = other.name;
+
+        output.num_threads += other.num_threads;
+        output.num_jobs += other.num_jobs;
+        output.busy_ms += other.busy_ms;
+        output.elapsed_ms = max(output.elapsed_ms, other.elapsed_ms);
+        output.queue_depth += other.queue_depth;
+        if (output.num_jobs > 0)
+            output.average_ms = output.busy_ms / output.num_jobs;
+    }
+
+    static void merge_admission(AdmissionReport &output, const AdmissionReport &other)
+    {
+        output.accepted += other.accepted;
+        output.rejected_queue_full += other.rejected_queue_full;
+        output.rejected_no_slot += other.rejected_no_slot;
+        output.failed += other.failed;
+        output.dropped_expired += other.dropped_expired;
+        output.dropped_superseded += other.dropped_superseded;
+        output.queue_depth += other.queue_depth;
+    }
+
+    static void merge_cancellation(CancellationReport &output, const CancellationReport &other)
+    {
+        output.cancelled_before_inference += other.cancelled_before_inference;
+        output.expired_before_inference += other.expired_before_inference;
+        output.cancelled_before_postprocess += other.cancelled_before_postprocess;
+        output.expired_before_postprocess += other.expired_before_postprocess;
+        output.saved_inference_ms += other.saved_inference_ms;
+        output.saved_postprocess_ms += other.saved_postprocess_ms;
+    }
+
+    class ReplicaInferImpl : public ReplicaInfer
+    {
+    public:
+        bool startup(const vector<shared_ptr<Infer>> &replicas, ReplicaPolicy policy, const ReplicaHealthPolicy &health)
+        {
+            vector<shared_ptr<Infer>> valid;
+            for (auto &item : replicas)
+            {
+                if (item != nullptr)
+                    valid.emplace_back(item);
+            }
+
+            if (valid.empty())
+            {
+                INFOE("No valid replica");
+                return false;
+            }
+
+            replicas_.reset(new InferReplicaSet(valid, policy, health));
+            for (int i = 0; i < replicas_->size(); ++i)
+                replicas_->set_name(i, iLogger::format("replica%d", i));
+            return true;
+        }
+
+        void set_name(int index, const string &name) { replicas_->set_name(index, name); }
+
+        virtual shared_future<BoxArray> commit(const cv::Mat &image) override
+        {
+            return commit(image, JobOptions());
+        }
+
+        virtual vector<shared_future<BoxArray>> commits(const vector<cv::Mat> &images) override
+        {
+            return commits(images, JobOptions());
+        }
+
+        virtual shared_future<BoxArray> commit(const cv::Mat &image, const JobOptions &options) override
+        {
+            shared_future<BoxArray> result;
+            submit(image, options, true, result);
+            return result;
+        }
+
+        virtual vector<shared_future<BoxArray>> commits(const vector<cv::Mat> &images, const JobOptions &options) override
+        {
+            vector<shared_future<BoxArray>> output(images.size());
+            for (int i = 0; i < (int)images.size(); ++i)
+                submit(images[i], options, true, output[i]);
+            return output;
+        }
+
+        virtual CommitStatus try_commit(const cv::Mat &image, shared_future<BoxArray> &result, const JobOptions &options) override
+        {
+            return submit(image, options, false, result);
+        }
+
+        virtual CommitStatus commit(const cv::Mat &image, const Callback &callback, const JobOptions &options, bool blocking) override
+        {
+            auto job = make_job();
+            job->callback = callback;
+            return dispatch(image, options, blocking, job);
+        }
+
+        // 显存中的帧分到其他卡上的副本时，多一次卡间拷贝
+        virtual shared_future<BoxArray> commit(const SharedFrame &frame, const JobOptions &options) override
+        {
+            shared_future<BoxArray> result;
+            submit(frame, options, true, result);
+            return result;
+        }
+
+        virtual CommitStatus commit(const SharedFrame &frame, const Callback &callback, const JobOptions &options, bool blocking) override
+        {
+            auto job = make_job();
+            job->callback = callback;
+            return dispatch(frame, options, blocking, job);
+        }
+
+        virtual void set_batching_policy(const BatchingPolicy &policy) override
+        {
+            for (int i = 0; i < replicas_->size(); ++i)
+                replicas_->replica(i)->set_batching_policy(policy);
+        }
+
+        virtual void set_adaptive_batching(const AdaptiveBatchingPolicy &policy) override
+        {
+            for (int i = 0; i < replicas_->size(); ++i)
+                replicas_->replica(i)->set_adaptive_batching(policy);
+        }
+
+        // 每个副本按自己的曲线独立学习，曲线之间不能合并，这里返回第一个副本的，其他副本通过各自的实例查询
+        virtual AdaptiveBatchingReport adaptive_batching_report() override
+        {
+            return replicas_->replica(0)->adaptive_batching_report();
+        }
+
+        virtual void set_preprocess_method(PreprocessMethod method) override
+        {
+            for (int i = 0; i < replicas_->size(); ++i)
+                replicas_->replica(i)->set_preprocess_method(method);
+        }
+
+        virtual void set_tenant_weight(int tenant, int weight) override
+        {
+            for (int i = 0; i < replicas_->size(); ++i)
+                replicas_->replica(i)->set_tenant_weight(tenant, weight);
+        }
+
+        virtual void set_admission_policy(const AdmissionPolicy &policy) override
+        {
+            for (int i = 0; i < replicas_->size(); ++i)
+                replicas_->replica(i)->set_admission_policy(policy);
+        }
+
+        virtual void set_replica_weight(int index, int weight) override
+        {
+            if (index < 0 || index >= replicas_->size())
+            {
+                INFOE("Invalid replica index %d, %d replicas", index, replicas_->size());
+                return;
+            }
+            replicas_->set_weight(index, weight);
+        }
+
+        virtual BatchingReport batching_report(bool reset) override
+        {
+            BatchingReport output;
+            double wait_sum_ms = 0;
+            for (int i = 0; i < replicas_->size(); ++i)
+            {
+                auto report = replicas_->replica(i)->batching_report(reset);
+                if (report.batch_size_histogram.size() > output.batch_size_histogram.size())
+                    output.batch_size_histogram.resize(report.batch_size_histogram.size());
+
+                for (int j = 0; j < (int)report.batch_size_histogram.size(); ++j)
+                    output.batch_size_histogram[j] += report.batch_size_histogram[j];
+
+                output.num_batches += report.num_batches;
+                output.num_jobs += report.num_jobs;
+                wait_sum_ms += report.queue_wait_mean_ms * report.num_jobs;
+                output.queue_wait_p50_ms = max(output.queue_wait_p50_ms, report.queue_wait_p50_ms);
+                output.queue_wait_p99_ms = max(output.queue_wait_p99_ms, report.queue_wait_p99_ms);
+                output.queue_wait_max_ms = max(output.queue_wait_max_ms, report.queue_wait_max_ms);
+            }
+
+            if (output.num_batches > 0)
+                output.average_batch_size = output.num_jobs / (double)output.num_batches;
+
+            if (output.num_jobs > 0)
+                output.queue_wait_mean_ms = wait_sum_ms / output.num_jobs;
+            return output;
+        }
+
+        virtual PipelineReport pipeline_report(bool reset) override
+        {
+            PipelineReport output;
+            double occupancy[3] = {0};
+            int n = replicas_->size();
+            for (int i = 0; i < n; ++i)
+            {
+                auto report = replicas_->replica(i)->pipeline_report(reset);
+                merge_stage(output.preprocess, report.preprocess);
+                merge_stage(output.inference, report.inference);
+                merge_stage(output.postprocess, report.postprocess);
+                occupancy[0] += report.preprocess.occupancy;
+                occupancy[1] += report.inference.occupancy;
+                occupancy[2] += report.postprocess.occupancy;
+            }
+
+            // 占用率取各副本的平均
+            output.preprocess.occupancy = occupancy[0] / n;
+            output.inference.occupancy = occupancy[1] / n;
+            output.postprocess.occupancy = occupancy[2] / n;
+            return output;
+        }
+
+        virtual SchedulingReport scheduling_report(bool reset) override
+        {
+            SchedulingReport output;
+            for (int i = 0; i < replicas_->size(); ++i)
+            {
+                auto report = replicas_->replica(i)->scheduling_report(reset);
+                if (output.classes.empty())
+                {
+                    output = report;
+                    continue;
+                }
+
+                for (int j = 0; j < (int)report.classes.size() && j < (int)output.classes.size(); ++j)
+                {
+                    auto &klass = output.classes[j];
+                    klass.num_pending += report.classes[j].num_pending;
+                    merge_summary(klass.queue_wait, report.classes[j].queue_wait);
+                    merge_summary(klass.latency, report.classes[j].latency);
+                }
+            }
+            return output;
+        }
+
+        virtual AdmissionReport admission_report(bool reset) override
+        {
+            AdmissionReport output;
+            for (int i = 0; i < replicas_->size(); ++i)
+                merge_admission(output, replicas_->replica(i)->admission_report(reset));
+            return output;
+        }
+
+        virtual CancellationReport cancellation_report(bool reset) override
+        {
+            CancellationReport output;
+            for (int i = 0; i < replicas_->size(); ++i)
+                merge_cancellation(output, replicas_->replica(i)->cancellation_report(reset));
+            return output;
+        }
+
+        virtual InferMetricsSnapshot metrics(bool reset) override
+        {
+            InferMetricsSnapshot output;
+            double capacity = 0;
+            for (int i = 0; i < replicas_->size(); ++i)
+            {
+                auto snapshot = replicas_->replica(i)->metrics(reset);
+                output.elapsed_ms = max(output.elapsed_ms, snapshot.elapsed_ms);
+                output.num_jobs += snapshot.num_jobs;
+                output.num_batches += snapshot.num_batches;
+                output.throughput += snapshot.throughput;
+                if (snapshot.batch_fill_ratio > 0)
+                    capacity += snapshot.num_jobs / snapshot.batch_fill_ratio;
+
+                for (int j = 0; j < NUM_METRIC_STAGES; ++j)
+                    merge_summary(output.stages[j], snapshot.stages[j]);
+
+                merge_admission(output.admission, snapshot.admission);
+                merge_cancellation(output.cancellation, snapshot.cancellation);
+            }
+
+            if (output.num_batches > 0)
+                output.average_batch_size = output.num_jobs / (double)output.num_batches;
+
+            if (capacity > 0)
+                output.batch_fill_ratio = output.num_jobs / capacity;
+            return output;
+        }
+
+        virtual ReplicaSetReport replica_report(bool reset) override
+        {
+            return replicas_->report(reset);
+        }
+
+    private:
+        shared_ptr<ReplicaJob> make_job()
+        {
+            auto job = make_shared<ReplicaJob>();
+            job->replicas = replicas_.get();
+            return job;
+        }
+
+        template <class _Input>
+        CommitStatus submit(const _Input &input, const JobOptions &options, bool blocking, shared_future<BoxArray> &result)
+        {
+            auto job = make_job();
+            job->pro = make_shared<promise<BoxArray>>();
+            result = job->pro->get_future();
+            return dispatch(input, options, blocking, job);
+        }
+
+        /* 按策略选择副本提交，副本拒绝或失败时换一个还没有尝试过的副本，全部失败时交付空的结果
+           与单个实例相同，返回Accepted以外的状态时结果为空
+        */
+        template <class _Input>
+        CommitStatus dispatch(const _Input &input, const JobOptions &options, bool blocking, const shared_ptr<ReplicaJob> &job)
+        {
+            CommitStatus status = CommitStatus::Failed;
+            uint64_t tried_mask = 0;
+            int index = -1;
+            while ((index = replicas_->acquire(tried_mask)) != -1)
+            {
+                if (index < 64)
+                    tried_mask |= 1ULL << index;
+
+                job->index = index;
+                job->state = ReplicaJob::Submitting;
+                job->dispatch_us = StageStatistics::now_us();
+                status = replicas_->replica(index)->commit(
+                    input, [job](BoxArray &boxes)
+                    {
+                        std::swap(job->boxes, boxes);
+                        if (job->state.exchange(ReplicaJob::Finished) == ReplicaJob::Submitted)
+                            job->finish(); },
+                    options, blocking);
+
+                if (job->state.exchange(ReplicaJob::Submitted) == ReplicaJob::Submitting)
+                {
+                    // 结果由之后的回调交付
+                    return status;
+                }
+
+                if (status == CommitStatus::Accepted)
+                {
+                    job->finish();
+                    return status;
+                }
+
+                replicas_->release(index, status);
+                job->boxes.clear();
+            }
+
+            job->deliver();
+            return status;
+        }
+
+    private:
+        unique_ptr<InferReplicaSet> replicas_;
+    };
+
+    shared_ptr<ReplicaInfer> create_replica_infer(
+        const vector<shared_ptr<Infer>> &replicas, ReplicaPolicy policy, const ReplicaHealthPolicy &health)
+    {
+        shared_ptr<ReplicaInferImpl> instance(new ReplicaInferImpl());
+        if (!instance->startup(replicas, policy, health))
+        {
+            instance.reset();
+        }
+        return instance;
+    }
+
+    shared_ptr<ReplicaInfer> create_replica_infer(
+        const string &engine_file, Type type, const vector<int> &gpuids, int instances_per_device,
+        float confidence_threshold, float nms_threshold,
+        NMSMethod nms_method, int max_objects,
+        bool use_multi_preprocess_stream, const PipelineConfig &pipeline,
+        ReplicaPolicy policy)
+    {
+        vector<shared_ptr<Infer>> replicas;
+        vector<string> names;
+        for (int gpuid : gpuids)
+        {
+            for (int i = 0; i < instances_per_device; ++i)
+            {
+                auto infer = create_infer(
+                    engine_file, type, gpuid, confidence_threshold, nms_threshold,
+                    nms_method, max_objects, use_multi_preprocess_stream, pipeline);
+
+                if (infer == nullptr)
+                {
+                    INFOE("Create replica %d on gpu %d failed", i, gpuid);
+                    return nullptr;
+                }
+                replicas.emplace_back(infer);
+                names.emplace_back(iLogger::format("gpu%d#%d", gpuid, i));
+            }
+        }
+
+        shared_ptr<ReplicaInferImpl> instance(new ReplicaInferImpl());
+        if (!instance->startup(replicas, policy, ReplicaHealthPolicy()))
+        {
+            instance.reset();
+            return instance;
+        }
+
+        for (int i = 0; i < (int)names.size(); ++i)
+            instance->set_name(i, names[i]);
+        return instance;
+    }
+
+}; // namespace Yolo
@@ -0,0 +1,302 @@
+#include "yolo.hpp"
+#include <atomic>
+#include "TrtLib/common/ilogger.hpp"
+
+namespace Yolo
+{
+    using namespace std;
+
+    // 一个方向上切片的起点，步长为tile * (1 - overlap)，最后一个切片与边缘对齐
+    static vector<int> tile_starts(int length, int tile, float overlap)
+    {
+        vector<int> starts;
+        if (length <= tile)
+        {
+            starts.push_back(0);
+            return starts;
+        }
+
+        int step = max(1, (int)round(tile * (1 - overlap)));
+        for (int start = 0;; start += step)
+        {
+            if (start + tile >= length)
+            {
+                starts.push_back(length - tile);
+                break;
+            }
+            starts.push_back(start);
+        }
+        return starts;
+    }
+
+    vector<cv::Rect> compute_tiles(const cv::Size &image, const TilingConfig &config)
+    {
+        vector<cv::Rect> tiles;
+        if (image.width <= 0 || image.height <= 0 || config.tile_width <= 0 || config.tile_height <= 0)
+            return tiles;
+
+        int width = min(config.tile_width, image.width);
+        int height = min(config.tile_height, image.height);
+        for (int y : tile_starts(image.height, config.tile_height, config.overlap))
+        {
+            for (int x : tile_starts(image.width, config.tile_width, config.overlap))
+                tiles.emplace_back(x, y, width, height);
+        }
+        return tiles;
+    }
+
+    struct TilingStatistics
+    {
+        atomic<long long> num_images{0};
+        atomic<long long> num_tiles{0};
+        atomic<long long> num_raw_boxes{0};
+        atomic<long long> num_seam_boxes{0};
+        atomic<long long> num_merged_boxes{0};
+        atomic<long long> num_rejected_images{0};
+        atomic<long long> merge_us{0};
+    };
+
+    /* 一张图的切片与对应的结果，切片按行排列，global_view时最后一个是整图
+       每个切片完成时回调写入自己的结果，最后一个完成的切片负责合并
+    */
+    struct TiledImage
+    {
+        TilingConfig config;
+        vector<int> xs;
+        vector<int> ys;
+        int tile_width = 0;
+        int tile_height = 0;
+        bool has_global = false;
+        vector<BoxArray> tiles;
+        atomic<int> num_remaining{0};
+        atomic<bool> rejected{false};   // 任意一个切片被拒绝、丢弃时整张图的结果不完整
+        shared_ptr<JobOutcome> outcome; // 调用方的，可以为空
+        promise<BoxArray> result;
+    };
+
+    /* 框是否是被切片内部边缘截断的目标
+       贴着右边缘并且左边不小于右侧相邻切片的起点时，目标在右侧切片中不会被左边缘截断，那里有完整的框，其他方向相同
+       最后一列、一行与图像边缘对齐，和前一个切片的重叠更大，因此按实际的相邻切片判断
+    */
+    static bool on_seam(const Box &box, const TiledImage &image, int col, int row)
+    {
+        float margin = image.config.seam_margin;
+        int x = image.xs[col];
+        int y = image.ys[row];
+        if (col + 1 < (int)image.xs.size() && box.right >= x + image.tile_width - margin && box.left >= image.xs[col + 1])
+            return true;
+
+        if (col > 0 && box.left <= x + margin && box.right <= image.xs[col - 1] + image.tile_width)
+            return true;
+
+        if (row + 1 < (int)image.ys.size() && box.bottom >= y + image.tile_height - margin && box.top >= image.ys[row + 1])
+            return true;
+
+        if (row > 0 && box.top <= y + margin && box.bottom <= image.ys[row - 1] + image.tile_height)
+            return true;
+        return false;
+    }
+
+    static BoxArray merge_tiles(TiledImage &image, TilingStatistics &statistics)
+    {
+        auto tick = iLogger::timestamp_now_float();
+        const TilingConfig &config = image.config;
+        BoxArray output;
+        long long num_raw = 0;
+        long long num_seam = 0;
+        int num_cols = image.xs.size();
+        int num_tiles = num_cols * (int)image.ys.size();
+        for (int i = 0; i < num_tiles; ++i)
+        {
+            int col = i % num_cols;
+            int row = i / num_cols;
+            float dx = image.xs[col];
+            float dy = image.ys[row];
+            const BoxArray &boxes = image.tiles[i];
+            num_raw += boxes.size();
+            for (auto &box : boxes)
+            {
+                Box mapped(box.left + dx, box.top + dy, box.right + dx, box.bottom + dy, box.confidence, box.class_label);
+                if (config.drop_seam_boxes && num_tiles > 1 && on_seam(mapped, image, col, row))
+                {
+                    num_seam++;
+                    continue;
+                }
+                output.emplace_back(mapped);
+            }
+        }
+
+        if (image.has_global)
+        {
+            const BoxArray &boxes = image.tiles[num_tiles];
+            num_raw += boxes.size();
+            output.insert(output.end(), boxes.begin(), boxes.end());
+        }
+
+        NMSMethod method = config.nms_method == NMSMethod::FastGPU ? NMSMethod::CPU : config.nms_method;
+        cpu_nms_method(output, method, config.nms_threshold, config.score_threshold);
+
+        statistics.num_raw_boxes += num_raw;
+        statistics.num_seam_boxes += num_seam;
+        statistics.num_merged_boxes += output.size();
+        statistics.merge_us += (long long)((iLogger::timestamp_now_float() - tick) * 1000);
+        return output;
+    }
+
+    // 所有切片都完成后合并，有切片被拒绝时结果为空，调用方的outcome为rejected
+    static void finish_image(TiledImage &image, TilingStatistics &statistics)
+    {
+        bool rejected = image.rejected || image.tiles.empty();
+        BoxArray output;
+        if (rejected)
+            statistics.num_rejected_images++;
+        else
+            output = merge_tiles(image, statistics);
+
+        if (image.outcome)
+            image.outcome->set(rejected);
+        image.result.set_value(std::move(output));
+    }
+
+    class TiledInferImpl : public TiledInfer
+    {
+    public:
+        bool startup(const shared_ptr<Infer> &infer, const TilingConfig &config)
+        {
+            if (infer == nullptr)
+            {
+                INFOE("Infer is nullptr");
+                return false;
+            }
+
+            if (config.tile_width <= 0 || config.tile_height <= 0)
+            {
+                INFOE("Invalid tile size %dx%d", config.tile_width, config.tile_height);
+                return false;
+            }
+
+            if (config.overlap < 0 || config.overlap > 0.9f)
+            {
+                INFOE("Invalid tile overlap %f, must be in [0, 0.9]", config.overlap);
+                return false;
+            }
+
+            infer_ = infer;
+            config_ = config;
+            statistics_.reset(new TilingStatistics());
+            return true;
+        }
+
+        virtual shared_future<BoxArray> commit(const cv::Mat &image, const JobOptions &options) override
+        {
+            return commits(vector<cv::Mat>{image}, options)[0];
+        }
+
+        virtual vector<shared_future<BoxArray>> commits(const vector<cv::Mat> &images, const JobOptions &options) override
+        {
+            /* 切片是同一张图的一部分，不能互相替代：latest_only会让同一租户的切片只剩最后一个
+               每个切片有自己的outcome，调用方的outcome在整张图完成时写入
+            */
+            JobOptions tile_options = options;
+            tile_options.latest_only = false;
+            tile_options.outcome = nullptr;
+
+            vector<shared_future<BoxArray>> output(images.size());
+            long long num_tiles = 0;
+            for (int i = 0; i < (int)images.size(); ++i)
+            {
+                auto &image = images[i];
+                auto state = make_shared<TiledImage>();
+                state->config = config_;
+                state->outcome = options.outcome;
+                output[i] = state->result.get_future().share();
+                if (image.empty())
+                {
+                    finish_image(*state, *statistics_);
+                    continue;
+                }
+
+                state->xs = tile_starts(image.cols, config_.tile_width, config_.overlap);
+                state->ys = tile_starts(image.rows, config_.tile_height, config_.overlap);
+                state->tile_width = min(config_.tile_width, image.cols);
+                state->tile_height = min(config_.tile_height, image.rows);
+
+                // 只有一个切片时它就是整图
+                int num_image_tiles = state->xs.size() * state->ys.size();
+                state->has_global = config_.global_view && num_image_tiles > 1;
+                vector<cv::Mat> inputs;
+                for (int y : state->ys)
+                {
+                    for (int x : state->xs)
+                        inputs.emplace_back(image(cv::Rect(x, y, state->tile_width, state->tile_height)));
+                }
+                if (state->has_global)
+                    inputs.emplace_back(image);
+
+                // 回调可能在提交时同步执行，计数先于提交设置
+                state->tiles.resize(inputs.size());
+                state->num_remaining = inputs.size();
+                num_tiles += num_image_tiles;
+
+                // ROI共享原图的数据，由引擎持有到推理完成
+                auto statistics = statistics_;
+                for (int j = 0; j < (int)inputs.size(); ++j)
+                {
+                    JobOptions job_options = tile_options;
+                    job_options.outcome = JobOutcome::create();
+                    auto outcome = job_options.outcome;
+                    infer_->commit(inputs[j], [state, statistics, outcome, j](BoxArray &boxes)
+                                   {
+                        if (outcome->rejected())
+                            state->rejected = true;
+                        else
+                            state->tiles[j].swap(boxes);
+
+                        if (--state->num_remaining == 0)
+                            finish_image(*state, *statistics); },
+                                   job_options, true);
+                }
+            }
+
+            statistics_->num_images += images.size();
+            statistics_->num_tiles += num_tiles;
+            return output;
+        }
+
+        virtual TilingConfig config() override
+        {
+            return config_;
+        }
+
+        virtual TilingReport report(bool reset) override
+        {
+            TilingReport output;
+            auto &s = *statistics_;
+            output.num_images = reset ? s.num_images.exchange(0) : s.num_images.load();
+            output.num_tiles = reset ? s.num_tiles.exchange(0) : s.num_tiles.load();
+            output.num_raw_boxes = reset ? s.num_raw_boxes.exchange(0) : s.num_raw_boxes.load();
+            output.num_seam_boxes = reset ? s.num_seam_boxes.exchange(0) : s.num_seam_boxes.load();
+            output.num_merged_boxes = reset ? s.num_merged_boxes.exchange(0) : s.num_merged_boxes.load();
+            output.num_rejected_images = reset ? s.num_rejected_images.exchange(0) : s.num_rejected_images.load();
+            output.merge_ms = (reset ? s.merge_us.exchange(0) : s.merge_us.load()) / 1000.0;
+            return output;
+        }
+
+    private:
+        shared_ptr<Infer> infer_;
+        TilingConfig config_;
+
+        // 合并在最后一个切片的回调中执行，可能晚于TiledInfer析构，统计由回调共同持有
+        shared_ptr<TilingStatistics> statistics_;
+    };
+
+    shared_ptr<TiledInfer> create_tiled_infer(const shared_ptr<Infer> &infer, const TilingConfig &config)
+    {
+        shared_ptr<TiledInferImpl> instance(new TiledInferImpl());
+        if (!instance->startup(infer, config))
+        {
+            instance.reset();
+        }
+        return instance;
+    }
+}; // namespace Yolo